@@ -0,0 +1,538 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* for utmpxname() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utmpx.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-dispatch.h"
+#include "usermon-names.h"
+#include "usermon-scan.h"
+#include "usermon-sessions.h"
+#include "usermon-utmp.h"
+
+/* default settings */
+#define DEFAULT_SIZES		"10,100,1000,10000,100000"
+#define DEFAULT_LIVE_RATIO	0.5
+#define DEFAULT_CHURN_RATIO	0.01
+#define DEFAULT_TICKS		100
+#define DEFAULT_USERS_COUNT	50
+#define DEFAULT_OUTPUT		"usermon-bench.json"
+/* what make check runs */
+#define CHECK_SIZE		1000
+#define CHECK_CHANGES		10
+#define CHECK_WARM_UP_TICKS	3
+
+/* allocations are counted by wrapping glibc's allocator */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static guint64 allocations_count = 0;
+
+void *malloc(size_t size)
+{
+	++allocations_count;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+	++allocations_count;
+	return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	++allocations_count;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+	__libc_free(ptr);
+}
+
+/* what the plugin does on each tick, minus the widgets */
+typedef struct {
+	UserMonitorNames *names;
+	UserMonitorScan *scan;
+	UserMonitorSessions *sessions;
+	UserMonitorDispatcher *dispatcher;
+	UserMonitorUtmp *utmp_reader;
+	GArray *changed_slots;
+	GArray *records;
+} UserMonitorBench;
+
+typedef struct {
+	const gchar *path;
+	guint size;
+	guint ticks;
+	gdouble ns_per_record;
+	gdouble ns_per_tick;
+	gdouble allocations_per_tick;
+	glong peak_rss;
+} UserMonitorBenchResult;
+
+static gchar *sizes_list = NULL;
+static gdouble live_ratio = DEFAULT_LIVE_RATIO;
+static gdouble churn_ratio = DEFAULT_CHURN_RATIO;
+static gint ticks_count = DEFAULT_TICKS;
+static gint users_count = DEFAULT_USERS_COUNT;
+static gchar *output_file = NULL;
+static gboolean check_mode = FALSE;
+static GOptionEntry entries[] = {
+	{"sizes", 's', 0, G_OPTION_ARG_STRING, &sizes_list,
+	 "Comma separated numbers of utmp records", "LIST"},
+	{"live", 'l', 0, G_OPTION_ARG_DOUBLE, &live_ratio,
+	 "Ratio of records that are live sessions", "RATIO"},
+	{"churn", 'c', 0, G_OPTION_ARG_DOUBLE, &churn_ratio,
+	 "Ratio of records that change on each tick", "RATIO"},
+	{"ticks", 't', 0, G_OPTION_ARG_INT, &ticks_count,
+	 "Number of ticks measured for each size", "COUNT"},
+	{"users", 'u', 0, G_OPTION_ARG_INT, &users_count,
+	 "Number of distinct user names", "COUNT"},
+	{"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_file,
+	 "File results are appended to", "FILE"},
+	{"check", 0, 0, G_OPTION_ARG_NONE, &check_mode,
+	 "Fail if steady state scans allocate, instead of measuring", NULL},
+	{NULL}
+};
+
+static void xfce_usermon_bench_deliver(UserMonitorUrgency urgency,
+				       const gchar * body,
+				       gpointer user_data)
+{
+}
+
+static void xfce_usermon_bench_fill(struct utmpx *u, guint slot,
+				    gboolean live, guint generation)
+{
+	memset(u, 0, sizeof(struct utmpx));
+	u->ut_type = (live == TRUE) ? USER_PROCESS : DEAD_PROCESS;
+	u->ut_pid = 1000 + slot + generation;
+	g_snprintf(u->ut_line, sizeof(u->ut_line), "pts/%u", slot);
+	g_snprintf(u->ut_id, sizeof(u->ut_id), "%x", slot);
+	if (live == TRUE) {
+		g_snprintf(u->ut_user, sizeof(u->ut_user), "user%u",
+			   g_random_int_range(0, users_count));
+		g_snprintf(u->ut_host, sizeof(u->ut_host), "host%u",
+			   slot % 16);
+	}
+	u->ut_tv.tv_sec = 1600000000 + generation;
+	u->ut_tv.tv_usec = slot;
+}
+
+static gboolean xfce_usermon_bench_generate(const gchar * path, guint size)
+{
+	struct utmpx u;
+	FILE *file = fopen(path, "w");
+	guint slot;
+
+	if (file == NULL) {
+		g_printerr("Failed to create %s: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	for (slot = 0; slot < size; ++slot) {
+		xfce_usermon_bench_fill(&u, slot,
+					g_random_double() < live_ratio, 0);
+		fwrite(&u, sizeof(u), 1, file);
+	}
+	fclose(file);
+
+	return TRUE;
+}
+
+/* rewrites records in place, the way login and logout do */
+static void xfce_usermon_bench_churn(gint fd, guint size, guint generation)
+{
+	guint changes_count = MAX(1, (guint) (size * churn_ratio));
+	struct utmpx u;
+	guint i;
+
+	for (i = 0; i < changes_count; ++i) {
+		guint slot = g_random_int_range(0, size);
+
+		xfce_usermon_bench_fill(&u, slot,
+					g_random_double() < live_ratio,
+					generation);
+		if (pwrite(fd, &u, sizeof(u), (off_t) slot * sizeof(u)) < 0) {
+			g_printerr("Failed to write record: %s\n",
+				   strerror(errno));
+		}
+	}
+}
+
+static const struct utmpx *xfce_usermon_bench_get_mapped_record(guint slot,
+								gpointer
+								user_data)
+{
+	UserMonitorBench *bench = (UserMonitorBench *) user_data;
+
+	return xfce_usermon_utmp_get_record(bench->utmp_reader, slot);
+}
+
+static const struct utmpx *xfce_usermon_bench_get_copied_record(guint slot,
+								gpointer
+								user_data)
+{
+	UserMonitorBench *bench = (UserMonitorBench *) user_data;
+
+	return &g_array_index(bench->records, struct utmpx, slot);
+}
+
+static void xfce_usermon_bench_apply(UserMonitorBench * bench)
+{
+	const GArray *logins, *logouts;
+	guint i;
+
+	logouts = xfce_usermon_scan_get_logouts(bench->scan);
+	for (i = 0; i < logouts->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(logouts, UserMonitorScanEntry, i);
+
+		xfce_usermon_sessions_remove(bench->sessions, &entry->key);
+		xfce_usermon_dispatcher_add_logout(bench->dispatcher,
+						   entry->user_name,
+						   xfce_usermon_sessions_get_user_count
+						   (bench->sessions,
+						    entry->user_name),
+						   USERMON_URGENCY_NORMAL);
+	}
+
+	logins = xfce_usermon_scan_get_logins(bench->scan);
+	for (i = 0; i < logins->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(logins, UserMonitorScanEntry, i);
+
+		if (xfce_usermon_sessions_add(bench->sessions, &entry->key,
+					      entry->user_name, entry->host,
+					      entry->login_time) != NULL) {
+			xfce_usermon_dispatcher_add_login(bench->dispatcher,
+							  entry->user_name,
+							  entry->host,
+							  xfce_usermon_sessions_get_user_count
+							  (bench->sessions,
+							   entry->user_name),
+							  USERMON_URGENCY_NORMAL);
+		}
+	}
+
+	xfce_usermon_dispatcher_flush(bench->dispatcher);
+}
+
+static void xfce_usermon_bench_tick(UserMonitorBench * bench)
+{
+	struct utmpx *u;
+
+	if (bench->utmp_reader != NULL) {
+		g_array_set_size(bench->changed_slots, 0);
+		if ((xfce_usermon_utmp_scan(bench->utmp_reader,
+					    bench->changed_slots) == FALSE) ||
+		    (bench->changed_slots->len == 0)) {
+			return;
+		}
+
+		xfce_usermon_scan_diff(bench->scan, bench->changed_slots, 0,
+				       xfce_usermon_bench_get_mapped_record,
+				       bench);
+	} else {
+		g_array_set_size(bench->records, 0);
+
+		setutxent();
+		while ((u = getutxent())) {
+			g_array_append_vals(bench->records, u, 1);
+		}
+		endutxent();
+
+		xfce_usermon_scan_diff(bench->scan, NULL, bench->records->len,
+				       xfce_usermon_bench_get_copied_record,
+				       bench);
+	}
+
+	xfce_usermon_bench_apply(bench);
+}
+
+static gboolean xfce_usermon_bench_run(const gchar * path, guint size,
+				       gboolean mapped,
+				       UserMonitorBenchResult * result)
+{
+	UserMonitorBench bench;
+	struct rusage usage;
+	gint64 elapsed = 0;
+	guint64 allocations = 0;
+	gint fd, tick;
+
+	if (xfce_usermon_bench_generate(path, size) == FALSE) {
+		return FALSE;
+	}
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		g_printerr("Failed to open %s: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	bench.names = xfce_usermon_names_new();
+	bench.scan = xfce_usermon_scan_new(bench.names);
+	bench.sessions = xfce_usermon_sessions_new();
+	bench.dispatcher = xfce_usermon_dispatcher_new(G_MAXUINT, 1,
+						       xfce_usermon_bench_deliver,
+						       NULL);
+	bench.utmp_reader = NULL;
+	bench.changed_slots = g_array_new(FALSE, FALSE, sizeof(guint));
+	bench.records = g_array_new(FALSE, FALSE, sizeof(struct utmpx));
+	if (mapped == TRUE) {
+		bench.utmp_reader = xfce_usermon_utmp_new(path);
+		if (bench.utmp_reader == NULL) {
+			g_printerr("Failed to map %s\n", path);
+		}
+	} else {
+		utmpxname(path);
+	}
+
+	/* the first tick finds everybody, it's not measured */
+	xfce_usermon_bench_tick(&bench);
+
+	for (tick = 1; tick <= ticks_count; ++tick) {
+		gint64 start_time;
+		guint64 start_allocations;
+
+		xfce_usermon_bench_churn(fd, size, tick);
+
+		start_allocations = allocations_count;
+		start_time = g_get_monotonic_time();
+		xfce_usermon_bench_tick(&bench);
+		elapsed += g_get_monotonic_time() - start_time;
+		allocations += allocations_count - start_allocations;
+	}
+	close(fd);
+
+	getrusage(RUSAGE_SELF, &usage);
+	result->path = (mapped == TRUE) ? "mapped" : "getutxent";
+	result->size = size;
+	result->ticks = ticks_count;
+	result->ns_per_tick = (elapsed * 1000.0) / ticks_count;
+	result->ns_per_record = result->ns_per_tick / size;
+	result->allocations_per_tick = (gdouble) allocations / ticks_count;
+	result->peak_rss = usage.ru_maxrss;
+
+	xfce_usermon_utmp_free(bench.utmp_reader);
+	g_array_free(bench.changed_slots, TRUE);
+	g_array_free(bench.records, TRUE);
+	xfce_usermon_dispatcher_free(bench.dispatcher);
+	xfce_usermon_sessions_free(bench.sessions);
+	xfce_usermon_scan_free(bench.scan);
+	xfce_usermon_names_free(bench.names);
+
+	return TRUE;
+}
+
+/* the same slots get a new session of the same user on each tick, so
+ * that after the first ones every array has the size it needs; from
+ * then on, neither reading utmp nor diffing it may allocate */
+static gboolean xfce_usermon_bench_check(const gchar * path)
+{
+	UserMonitorBench bench;
+	guint64 allocations = 0;
+	gint fd, tick;
+	guint i;
+
+	users_count = 1;
+	live_ratio = 1;
+	if (xfce_usermon_bench_generate(path, CHECK_SIZE) == FALSE) {
+		return FALSE;
+	}
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		g_printerr("Failed to open %s: %s\n", path, strerror(errno));
+		return FALSE;
+	}
+
+	bench.names = xfce_usermon_names_new();
+	bench.scan = xfce_usermon_scan_new(bench.names);
+	bench.changed_slots = g_array_new(FALSE, FALSE, sizeof(guint));
+	bench.utmp_reader = xfce_usermon_utmp_new(path);
+	if (bench.utmp_reader == NULL) {
+		g_printerr("Failed to open %s\n", path);
+		close(fd);
+		return FALSE;
+	}
+
+	for (tick = 0; tick <= CHECK_WARM_UP_TICKS + ticks_count; ++tick) {
+		guint64 start_allocations;
+		struct utmpx u;
+
+		for (i = 0; (tick > 0) && (i < CHECK_CHANGES); ++i) {
+			xfce_usermon_bench_fill(&u, i, TRUE, tick);
+			if (pwrite(fd, &u, sizeof(u),
+				   (off_t) i * sizeof(u)) < 0) {
+				g_printerr("Failed to write record: %s\n",
+					   strerror(errno));
+			}
+		}
+
+		/* twice, the second time without any change */
+		start_allocations = allocations_count;
+		for (i = 0; i < 2; ++i) {
+			g_array_set_size(bench.changed_slots, 0);
+			xfce_usermon_utmp_scan(bench.utmp_reader,
+					       bench.changed_slots);
+			xfce_usermon_scan_diff(bench.scan,
+					       bench.changed_slots, 0,
+					       xfce_usermon_bench_get_mapped_record,
+					       &bench);
+		}
+		if (tick > CHECK_WARM_UP_TICKS) {
+			allocations += allocations_count - start_allocations;
+		}
+	}
+	close(fd);
+
+	xfce_usermon_utmp_free(bench.utmp_reader);
+	g_array_free(bench.changed_slots, TRUE);
+	xfce_usermon_scan_free(bench.scan);
+	xfce_usermon_names_free(bench.names);
+
+	g_print("%" G_GUINT64_FORMAT " allocations in %d steady state ticks\n",
+		allocations, ticks_count);
+
+	return (allocations == 0) ? TRUE : FALSE;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	FILE *output;
+	gchar **sizes;
+	gchar *dir, *path;
+	gint i, pass;
+
+	context = g_option_context_new("- benchmark usermon's utmp scan");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (g_option_context_parse(context, &argc, &argv, &error) == FALSE) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+	if ((ticks_count <= 0) || (users_count <= 0)) {
+		g_printerr("Ticks and users must be positive\n");
+		return EXIT_FAILURE;
+	}
+
+	dir = g_dir_make_tmp("usermon-bench-XXXXXX", &error);
+	if (dir == NULL) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	path = g_build_filename(dir, "utmp", NULL);
+
+	if (check_mode == TRUE) {
+		gboolean passed = xfce_usermon_bench_check(path);
+
+		g_unlink(path);
+		g_rmdir(dir);
+		g_free(path);
+		g_free(dir);
+		return (passed == TRUE) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	output = fopen((output_file != NULL) ? output_file : DEFAULT_OUTPUT,
+		       "a");
+	if (output == NULL) {
+		g_printerr("Failed to open the output file: %s\n",
+			   strerror(errno));
+		g_rmdir(dir);
+		g_free(path);
+		g_free(dir);
+		return EXIT_FAILURE;
+	}
+
+	g_print("%-10s %8s %12s %12s %14s %12s\n", "path", "records",
+		"ns/record", "ns/tick", "allocs/tick", "peak RSS KB");
+
+	sizes = g_strsplit((sizes_list != NULL) ? sizes_list : DEFAULT_SIZES,
+			   ",", 0);
+	for (i = 0; sizes[i] != NULL; ++i) {
+		guint size = (guint) g_ascii_strtoull(sizes[i], NULL, 10);
+
+		if (size == 0) {
+			continue;
+		}
+
+		for (pass = 0; pass < 2; ++pass) {
+			UserMonitorBenchResult result;
+
+			if (xfce_usermon_bench_run(path, size, (pass == 0),
+						   &result) == FALSE) {
+				continue;
+			}
+
+			g_print("%-10s %8u %12.1f %12.1f %14.2f %12ld\n",
+				result.path, result.size,
+				result.ns_per_record, result.ns_per_tick,
+				result.allocations_per_tick, result.peak_rss);
+
+			/* one JSON object per line */
+			fprintf(output,
+				"{\"version\": \"%s\", \"path\": \"%s\", "
+				"\"records\": %u, \"live_ratio\": %.3f, "
+				"\"churn_ratio\": %.3f, \"ticks\": %u, "
+				"\"ns_per_record\": %.1f, \"ns_per_tick\": %.1f, "
+				"\"allocations_per_tick\": %.2f, "
+				"\"peak_rss_kb\": %ld}\n", PACKAGE_VERSION,
+				result.path, result.size, live_ratio,
+				churn_ratio, result.ticks,
+				result.ns_per_record, result.ns_per_tick,
+				result.allocations_per_tick,
+				result.peak_rss);
+		}
+	}
+	g_strfreev(sizes);
+
+	g_unlink(path);
+	g_rmdir(dir);
+	g_free(path);
+	g_free(dir);
+	fclose(output);
+
+	return EXIT_SUCCESS;
+}
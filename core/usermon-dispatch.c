@@ -0,0 +1,468 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <glib/gi18n-lib.h>
+
+#include "usermon-dispatch.h"
+
+/* how many names a summary lists */
+#define USERMON_DISPATCH_MAX_NAMES	5
+
+typedef struct {
+	const gchar *user_name;
+	/* where the last login came from, NULL if not known; a copy, as
+	 * delivered events outlive the session */
+	gchar *host;
+	guint sessions_count;
+	/* for users over a limit */
+	gdouble cpu_percent;
+	guint64 rss;
+} UserMonitorDispatchEvent;
+
+struct _UserMonitorDispatcher {
+	/* one event per user, and where to find it */
+	GArray *logins;
+	GHashTable *logins_index;
+	GArray *logouts;
+	GHashTable *logouts_index;
+	GArray *overloads;
+	GHashTable *overloads_index;
+	UserMonitorUrgency urgency;
+	/* what the last notification was about */
+	GArray *delivered_logins;
+	GArray *delivered_logouts;
+	GArray *delivered_overloads;
+	UserMonitorUrgency delivered_urgency;
+	/* token bucket */
+	gdouble tokens;
+	guint burst;
+	guint period;
+	gint64 last_refill;
+	guint retry_source_id;
+	GString *body;
+	UserMonitorDispatchHostFunc host_func;
+	gpointer host_data;
+	UserMonitorDeliverFunc func;
+	gpointer user_data;
+};
+
+UserMonitorDispatcher *xfce_usermon_dispatcher_new(guint burst,
+						   guint period,
+						   UserMonitorDeliverFunc
+						   func, gpointer user_data)
+{
+	UserMonitorDispatcher *dispatcher =
+	    g_slice_new0(UserMonitorDispatcher);
+
+	dispatcher->logins =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorDispatchEvent));
+	dispatcher->logins_index =
+	    g_hash_table_new(g_direct_hash, g_direct_equal);
+	dispatcher->logouts =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorDispatchEvent));
+	dispatcher->logouts_index =
+	    g_hash_table_new(g_direct_hash, g_direct_equal);
+	dispatcher->overloads =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorDispatchEvent));
+	dispatcher->overloads_index =
+	    g_hash_table_new(g_direct_hash, g_direct_equal);
+	dispatcher->urgency = USERMON_URGENCY_LOW;
+	dispatcher->delivered_logins =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorDispatchEvent));
+	dispatcher->delivered_logouts =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorDispatchEvent));
+	dispatcher->delivered_overloads =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorDispatchEvent));
+	dispatcher->delivered_urgency = USERMON_URGENCY_LOW;
+	dispatcher->burst = MAX(burst, 1);
+	dispatcher->period = MAX(period, 1);
+	dispatcher->tokens = dispatcher->burst;
+	dispatcher->last_refill = g_get_monotonic_time();
+	dispatcher->retry_source_id = 0;
+	dispatcher->body = g_string_sized_new(256);
+	dispatcher->host_func = NULL;
+	dispatcher->host_data = NULL;
+	dispatcher->func = func;
+	dispatcher->user_data = user_data;
+
+	return dispatcher;
+}
+
+static void xfce_usermon_dispatcher_clear(GArray * events)
+{
+	guint i;
+
+	for (i = 0; i < events->len; ++i) {
+		g_free(g_array_index(events, UserMonitorDispatchEvent, i).host);
+	}
+	g_array_set_size(events, 0);
+}
+
+void xfce_usermon_dispatcher_free(UserMonitorDispatcher * dispatcher)
+{
+	if (dispatcher == NULL) {
+		return;
+	}
+
+	if (dispatcher->retry_source_id > 0) {
+		g_source_remove(dispatcher->retry_source_id);
+	}
+	xfce_usermon_dispatcher_clear(dispatcher->logins);
+	xfce_usermon_dispatcher_clear(dispatcher->delivered_logins);
+	g_array_free(dispatcher->logins, TRUE);
+	g_hash_table_destroy(dispatcher->logins_index);
+	g_array_free(dispatcher->logouts, TRUE);
+	g_hash_table_destroy(dispatcher->logouts_index);
+	g_array_free(dispatcher->overloads, TRUE);
+	g_hash_table_destroy(dispatcher->overloads_index);
+	g_array_free(dispatcher->delivered_logins, TRUE);
+	g_array_free(dispatcher->delivered_logouts, TRUE);
+	g_array_free(dispatcher->delivered_overloads, TRUE);
+	g_string_free(dispatcher->body, TRUE);
+
+	g_slice_free(UserMonitorDispatcher, dispatcher);
+}
+
+void xfce_usermon_dispatcher_set_host_func(UserMonitorDispatcher *
+					   dispatcher,
+					   UserMonitorDispatchHostFunc func,
+					   gpointer user_data)
+{
+	dispatcher->host_func = func;
+	dispatcher->host_data = user_data;
+}
+
+static UserMonitorDispatchEvent *xfce_usermon_dispatcher_add(UserMonitorDispatcher
+							     * dispatcher,
+							     GArray * events,
+							     GHashTable *
+							     events_index,
+							     const gchar *
+							     user_name,
+							     guint
+							     sessions_count,
+							     UserMonitorUrgency
+							     urgency)
+{
+	UserMonitorDispatchEvent event;
+	guint position;
+
+	/* keep the latest count if the user was already seen */
+	position =
+	    GPOINTER_TO_UINT(g_hash_table_lookup(events_index, user_name));
+	if (position > 0) {
+		g_array_index(events, UserMonitorDispatchEvent,
+			      position - 1).sessions_count = sessions_count;
+	} else {
+		memset(&event, 0, sizeof(event));
+		event.user_name = user_name;
+		event.sessions_count = sessions_count;
+		g_array_append_val(events, event);
+		position = events->len;
+		g_hash_table_insert(events_index, (gpointer) user_name,
+				    GUINT_TO_POINTER(position));
+	}
+
+	dispatcher->urgency = MAX(dispatcher->urgency, urgency);
+
+	return &g_array_index(events, UserMonitorDispatchEvent, position - 1);
+}
+
+void xfce_usermon_dispatcher_add_login(UserMonitorDispatcher * dispatcher,
+				       const gchar * user_name,
+				       const gchar * host,
+				       guint sessions_count,
+				       UserMonitorUrgency urgency)
+{
+	UserMonitorDispatchEvent *event =
+	    xfce_usermon_dispatcher_add(dispatcher, dispatcher->logins,
+					dispatcher->logins_index, user_name,
+					sessions_count, urgency);
+
+	g_free(event->host);
+	event->host = g_strdup(host);
+}
+
+void xfce_usermon_dispatcher_add_logout(UserMonitorDispatcher * dispatcher,
+					const gchar * user_name,
+					guint sessions_count,
+					UserMonitorUrgency urgency)
+{
+	xfce_usermon_dispatcher_add(dispatcher, dispatcher->logouts,
+				    dispatcher->logouts_index, user_name,
+				    sessions_count, urgency);
+}
+
+void xfce_usermon_dispatcher_add_usage(UserMonitorDispatcher * dispatcher,
+				       const gchar * user_name,
+				       gdouble cpu_percent, guint64 rss,
+				       UserMonitorUrgency urgency)
+{
+	UserMonitorDispatchEvent *event =
+	    xfce_usermon_dispatcher_add(dispatcher, dispatcher->overloads,
+					dispatcher->overloads_index,
+					user_name, 0, urgency);
+
+	event->cpu_percent = cpu_percent;
+	event->rss = rss;
+}
+
+/* returns NULL for local sessions */
+static const gchar *xfce_usermon_dispatcher_get_host(UserMonitorDispatcher *
+						     dispatcher,
+						     const UserMonitorDispatchEvent
+						     * event)
+{
+	if ((event->host == NULL) || (event->host[0] == '\0') ||
+	    (event->host[0] == ':')) {
+		return NULL;
+	}
+	if (dispatcher->host_func != NULL) {
+		return dispatcher->host_func(event->host,
+					     dispatcher->host_data);
+	}
+
+	return event->host;
+}
+
+static void xfce_usermon_dispatcher_append_names(UserMonitorDispatcher *
+						 dispatcher, GString * body,
+						 GArray * events)
+{
+	guint i;
+
+	for (i = 0; (i < events->len) && (i < USERMON_DISPATCH_MAX_NAMES); ++i) {
+		const UserMonitorDispatchEvent *event =
+		    &g_array_index(events, UserMonitorDispatchEvent, i);
+		const gchar *host =
+		    xfce_usermon_dispatcher_get_host(dispatcher, event);
+
+		g_string_append_printf(body, "%s%s", (i > 0) ? ", " : " ",
+				       event->user_name);
+		if (host != NULL) {
+			g_string_append_printf(body, " (%s)", host);
+		}
+	}
+	if (events->len > USERMON_DISPATCH_MAX_NAMES) {
+		g_string_append(body, "\xe2\x80\xa6");
+	}
+}
+
+static void xfce_usermon_dispatcher_build_body(UserMonitorDispatcher *
+					       dispatcher, GArray * logins,
+					       GArray * logouts,
+					       GArray * overloads)
+{
+	GString *body = dispatcher->body;
+	UserMonitorDispatchEvent *event;
+	const gchar *host;
+
+	g_string_truncate(body, 0);
+
+	if (logins->len == 1) {
+		event = &g_array_index(logins, UserMonitorDispatchEvent, 0);
+		host = xfce_usermon_dispatcher_get_host(dispatcher, event);
+		if ((event->sessions_count > 1) && (host != NULL)) {
+			g_string_append_printf(body,
+					       _
+					       ("%s opened a new session from %s (%d sessions)"),
+					       event->user_name, host,
+					       event->sessions_count);
+		} else if (event->sessions_count > 1) {
+			g_string_append_printf(body,
+					       _
+					       ("%s opened a new session (%d sessions)"),
+					       event->user_name,
+					       event->sessions_count);
+		} else if (host != NULL) {
+			g_string_append_printf(body, _("%s logged in from %s"),
+					       event->user_name, host);
+		} else {
+			g_string_append_printf(body, _("%s logged in"),
+					       event->user_name);
+		}
+	} else if (logins->len > 1) {
+		g_string_append_printf(body,
+				       ngettext("%d user logged in:",
+						"%d users logged in:",
+						logins->len), logins->len);
+		xfce_usermon_dispatcher_append_names(dispatcher, body, logins);
+	}
+
+	if ((body->len > 0) && (logouts->len > 0)) {
+		g_string_append_c(body, '\n');
+	}
+
+	if (logouts->len == 1) {
+		event = &g_array_index(logouts, UserMonitorDispatchEvent, 0);
+		if (event->sessions_count > 0) {
+			g_string_append_printf(body,
+					       _("%s closed a session (%d left)"),
+					       event->user_name,
+					       event->sessions_count);
+		} else {
+			g_string_append_printf(body, _("%s logged out"),
+					       event->user_name);
+		}
+	} else if (logouts->len > 1) {
+		g_string_append_printf(body,
+				       ngettext("%d user logged out:",
+						"%d users logged out:",
+						logouts->len), logouts->len);
+		xfce_usermon_dispatcher_append_names(dispatcher, body,
+						     logouts);
+	}
+
+	if ((body->len > 0) && (overloads->len > 0)) {
+		g_string_append_c(body, '\n');
+	}
+
+	if (overloads->len == 1) {
+		gchar *rss_text;
+
+		event = &g_array_index(overloads, UserMonitorDispatchEvent, 0);
+		rss_text = g_format_size(event->rss);
+		g_string_append_printf(body,
+				       _("%s is using %.0f%% CPU and %s"),
+				       event->user_name, event->cpu_percent,
+				       rss_text);
+		g_free(rss_text);
+	} else if (overloads->len > 1) {
+		g_string_append_printf(body,
+				       ngettext("%d user is over a limit:",
+						"%d users are over a limit:",
+						overloads->len),
+				       overloads->len);
+		xfce_usermon_dispatcher_append_names(dispatcher, body,
+						     overloads);
+	}
+}
+
+static void xfce_usermon_dispatcher_swap(GArray ** events,
+					 GArray ** delivered_events)
+{
+	GArray *swapped = *delivered_events;
+
+	*delivered_events = *events;
+	xfce_usermon_dispatcher_clear(swapped);
+	*events = swapped;
+}
+
+static gboolean xfce_usermon_dispatcher_retry(gpointer user_data)
+{
+	UserMonitorDispatcher *dispatcher =
+	    (UserMonitorDispatcher *) user_data;
+
+	dispatcher->retry_source_id = 0;
+	xfce_usermon_dispatcher_flush(dispatcher);
+
+	return G_SOURCE_REMOVE;
+}
+
+void xfce_usermon_dispatcher_flush(UserMonitorDispatcher * dispatcher)
+{
+	gint64 now = g_get_monotonic_time();
+
+	if ((dispatcher->logins->len == 0) && (dispatcher->logouts->len == 0)
+	    && (dispatcher->overloads->len == 0)) {
+		return;
+	}
+
+	/* already waiting for the rate limit */
+	if (dispatcher->retry_source_id > 0) {
+		g_debug("Holding back %d logins and %d logouts",
+			dispatcher->logins->len, dispatcher->logouts->len);
+		return;
+	}
+
+	/* refill the bucket */
+	dispatcher->tokens +=
+	    (gdouble) (now - dispatcher->last_refill) /
+	    (dispatcher->period * G_USEC_PER_SEC);
+	dispatcher->tokens = MIN(dispatcher->tokens, dispatcher->burst);
+	dispatcher->last_refill = now;
+
+	if (dispatcher->tokens < 1.0) {
+		guint delay =
+		    (guint) ((1.0 - dispatcher->tokens) * dispatcher->period *
+			     1000) + 1;
+
+		g_debug("Rate limited, retrying in %d ms", delay);
+		dispatcher->retry_source_id =
+		    g_timeout_add(delay, xfce_usermon_dispatcher_retry,
+				  dispatcher);
+		return;
+	}
+	dispatcher->tokens -= 1.0;
+
+	xfce_usermon_dispatcher_build_body(dispatcher, dispatcher->logins,
+					   dispatcher->logouts,
+					   dispatcher->overloads);
+	g_debug("Dispatching %d logins and %d logouts",
+		dispatcher->logins->len, dispatcher->logouts->len);
+	dispatcher->func(dispatcher->urgency, dispatcher->body->str,
+			 dispatcher->user_data);
+
+	/* keep what was delivered, reuse the arrays of the one before */
+	xfce_usermon_dispatcher_swap(&dispatcher->logins,
+				     &dispatcher->delivered_logins);
+	g_hash_table_remove_all(dispatcher->logins_index);
+	xfce_usermon_dispatcher_swap(&dispatcher->logouts,
+				     &dispatcher->delivered_logouts);
+	g_hash_table_remove_all(dispatcher->logouts_index);
+	xfce_usermon_dispatcher_swap(&dispatcher->overloads,
+				     &dispatcher->delivered_overloads);
+	g_hash_table_remove_all(dispatcher->overloads_index);
+	dispatcher->delivered_urgency = dispatcher->urgency;
+	dispatcher->urgency = USERMON_URGENCY_LOW;
+}
+
+void xfce_usermon_dispatcher_refresh_host(UserMonitorDispatcher *
+					  dispatcher, const gchar * host)
+{
+	guint i;
+
+	for (i = 0; i < dispatcher->delivered_logins->len; ++i) {
+		if (g_strcmp0(g_array_index(dispatcher->delivered_logins,
+					    UserMonitorDispatchEvent,
+					    i).host, host) == 0) {
+			break;
+		}
+	}
+	if (i == dispatcher->delivered_logins->len) {
+		return;
+	}
+
+	/* replaces the notification rather than adds one, so it isn't
+	 * rate limited */
+	xfce_usermon_dispatcher_build_body(dispatcher,
+					   dispatcher->delivered_logins,
+					   dispatcher->delivered_logouts,
+					   dispatcher->delivered_overloads);
+	g_debug("Updating the notification for %s", host);
+	dispatcher->func(dispatcher->delivered_urgency,
+			 dispatcher->body->str, dispatcher->user_data);
+}
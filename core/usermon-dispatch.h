@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_DISPATCH_H__
+#define __USER_MONITOR_DISPATCH_H__
+
+G_BEGIN_DECLS typedef enum {
+	USERMON_URGENCY_LOW = 0,
+	USERMON_URGENCY_NORMAL,
+	USERMON_URGENCY_CRITICAL
+} UserMonitorUrgency;
+
+typedef struct _UserMonitorDispatcher UserMonitorDispatcher;
+
+typedef void (*UserMonitorDeliverFunc) (UserMonitorUrgency urgency,
+					const gchar * body,
+					gpointer user_data);
+
+/* returns what to show for host, eg its name if it's an address */
+typedef const gchar *(*UserMonitorDispatchHostFunc) (const gchar * host,
+						     gpointer user_data);
+
+/* up to burst notifications can be delivered at once, after which
+ * one more is allowed every period seconds */
+UserMonitorDispatcher *xfce_usermon_dispatcher_new(guint burst,
+						   guint period,
+						   UserMonitorDeliverFunc
+						   func, gpointer user_data);
+
+void xfce_usermon_dispatcher_free(UserMonitorDispatcher * dispatcher);
+
+/* hosts are shown as they are without one */
+void xfce_usermon_dispatcher_set_host_func(UserMonitorDispatcher *
+					   dispatcher,
+					   UserMonitorDispatchHostFunc func,
+					   gpointer user_data);
+
+/* user_name and host must outlive the dispatcher, eg be interned;
+ * host may be NULL */
+void xfce_usermon_dispatcher_add_login(UserMonitorDispatcher * dispatcher,
+				       const gchar * user_name,
+				       const gchar * host,
+				       guint sessions_count,
+				       UserMonitorUrgency urgency);
+
+void xfce_usermon_dispatcher_add_logout(UserMonitorDispatcher * dispatcher,
+					const gchar * user_name,
+					guint sessions_count,
+					UserMonitorUrgency urgency);
+
+/* the user's processes are over a limit */
+void xfce_usermon_dispatcher_add_usage(UserMonitorDispatcher * dispatcher,
+				       const gchar * user_name,
+				       gdouble cpu_percent, guint64 rss,
+				       UserMonitorUrgency urgency);
+
+/* delivers what was added since the last flush, or holds it back until
+ * the rate limit allows it */
+void xfce_usermon_dispatcher_flush(UserMonitorDispatcher * dispatcher);
+
+/* delivers the last notification again if it mentions host, so that
+ * it's updated in place with what the host function now returns */
+void xfce_usermon_dispatcher_refresh_host(UserMonitorDispatcher *
+					  dispatcher, const gchar * host);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_DISPATCH_H__ */
@@ -0,0 +1,365 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <errno.h>
+#include <grp.h>
+#include <pwd.h>
+#include <sys/types.h>
+
+#include <glib.h>
+
+#include "usermon-groups.h"
+#include "usermon-stats.h"
+
+/* users resolved at once */
+#define USERMON_GROUPS_THREADS	2
+/* getgrouplist() is asked again with the right size beyond that */
+#define USERMON_GROUPS_MAX	64
+#define USERMON_GROUPS_BUFFER_SIZE	1024
+#define USERMON_GROUPS_MAX_BUFFER_SIZE	(1024 * 1024)
+
+typedef struct {
+	/* FALSE until resolved the first time */
+	gboolean resolved;
+	gboolean found;
+	uid_t uid;
+	gchar **group_names;
+	/* monotonic time after which the entry is refreshed */
+	gint64 expiry;
+	/* queued or being resolved */
+	gboolean pending;
+} UserMonitorGroupsEntry;
+
+typedef struct {
+	gchar *user_name;
+	gboolean found;
+	uid_t uid;
+	GPtrArray *group_names;
+} UserMonitorGroupsRequest;
+
+struct _UserMonitorGroups {
+	gint64 ttl;
+	gint64 negative_ttl;
+	UserMonitorGroupsResolveFunc resolve_func;
+	UserMonitorGroupsFunc func;
+	gpointer user_data;
+	/* UserMonitorGroupsEntry, keyed by user name; only used in the
+	 * main loop */
+	GHashTable *entries;
+	GThreadPool *pool;
+	/* shared with the workers */
+	GMutex mutex;
+	GPtrArray *done;
+	guint done_source_id;
+	gboolean stopping;
+};
+
+static void xfce_usermon_groups_free_entry(gpointer data)
+{
+	UserMonitorGroupsEntry *entry = (UserMonitorGroupsEntry *) data;
+
+	g_strfreev(entry->group_names);
+	g_slice_free(UserMonitorGroupsEntry, entry);
+}
+
+static void xfce_usermon_groups_free_request(gpointer data)
+{
+	UserMonitorGroupsRequest *request = (UserMonitorGroupsRequest *) data;
+
+	g_free(request->user_name);
+	if (request->group_names != NULL) {
+		g_ptr_array_free(request->group_names, TRUE);
+	}
+	g_slice_free(UserMonitorGroupsRequest, request);
+}
+
+/* grows buffer until the answer fits */
+static gchar *xfce_usermon_groups_get_buffer(gchar * buffer, gsize * size,
+					     int error)
+{
+	if ((error != ERANGE) || (*size >= USERMON_GROUPS_MAX_BUFFER_SIZE)) {
+		g_free(buffer);
+		return NULL;
+	}
+	*size *= 2;
+
+	return g_realloc(buffer, *size);
+}
+
+static gboolean xfce_usermon_groups_resolve(const gchar * user_name,
+					    uid_t * uid,
+					    GPtrArray * group_names)
+{
+	struct passwd pwd, *passwd = NULL;
+	struct group grp, *group = NULL;
+	gsize size = USERMON_GROUPS_BUFFER_SIZE;
+	gchar *buffer = g_malloc(size);
+	gid_t *gids;
+	int error, count = USERMON_GROUPS_MAX, i;
+
+	while ((error = getpwnam_r(user_name, &pwd, buffer, size,
+				   &passwd)) != 0) {
+		if ((buffer =
+		     xfce_usermon_groups_get_buffer(buffer, &size,
+						    error)) == NULL) {
+			return FALSE;
+		}
+	}
+	if (passwd == NULL) {
+		g_free(buffer);
+		return FALSE;
+	}
+	*uid = pwd.pw_uid;
+
+#ifdef HAVE_GETGROUPLIST
+	gids = g_new(gid_t, count);
+	if (getgrouplist(user_name, pwd.pw_gid, gids, &count) < 0) {
+		/* count is how many there are now */
+		gids = g_renew(gid_t, gids, count);
+		if (getgrouplist(user_name, pwd.pw_gid, gids, &count) < 0) {
+			count = 0;
+		}
+	}
+#else
+	/* only the primary group is known */
+	gids = g_new(gid_t, 1);
+	gids[0] = pwd.pw_gid;
+	count = 1;
+#endif
+
+	for (i = 0; (i < count) && (buffer != NULL); ++i) {
+		while ((error = getgrgid_r(gids[i], &grp, buffer, size,
+					   &group)) != 0) {
+			if ((buffer =
+			     xfce_usermon_groups_get_buffer(buffer, &size,
+							    error)) == NULL) {
+				break;
+			}
+		}
+		if ((error == 0) && (group != NULL)) {
+			g_ptr_array_add(group_names, g_strdup(group->gr_name));
+		}
+	}
+	g_free(gids);
+	g_free(buffer);
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_groups_apply(gpointer user_data)
+{
+	UserMonitorGroups *groups = (UserMonitorGroups *) user_data;
+	GPtrArray *done;
+	gint64 now = g_get_monotonic_time();
+	guint i;
+
+	g_mutex_lock(&groups->mutex);
+	done = groups->done;
+	groups->done =
+	    g_ptr_array_new_with_free_func(xfce_usermon_groups_free_request);
+	groups->done_source_id = 0;
+	g_mutex_unlock(&groups->mutex);
+
+	for (i = 0; i < done->len; ++i) {
+		UserMonitorGroupsRequest *request = g_ptr_array_index(done, i);
+		UserMonitorGroupsEntry *entry =
+		    g_hash_table_lookup(groups->entries, request->user_name);
+
+		if (entry == NULL) {
+			continue;
+		}
+		g_strfreev(entry->group_names);
+		entry->group_names = NULL;
+		entry->resolved = TRUE;
+		entry->found = request->found;
+		entry->uid = request->uid;
+		entry->pending = FALSE;
+		if (request->found == TRUE) {
+			g_ptr_array_add(request->group_names, NULL);
+			entry->group_names =
+			    (gchar **) g_ptr_array_free(request->group_names,
+							FALSE);
+			request->group_names = NULL;
+			entry->expiry = now + groups->ttl;
+		} else {
+			entry->expiry = now + groups->negative_ttl;
+		}
+		g_debug("Resolved %s, %s", request->user_name,
+			(entry->found == TRUE) ? "found" : "not found");
+
+		if (groups->func != NULL) {
+			groups->func(request->user_name, groups->user_data);
+		}
+	}
+
+	g_ptr_array_free(done, TRUE);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void xfce_usermon_groups_work(gpointer data, gpointer user_data)
+{
+	UserMonitorGroupsRequest *request = (UserMonitorGroupsRequest *) data;
+	UserMonitorGroups *groups = (UserMonitorGroups *) user_data;
+	gboolean stopping;
+
+	g_mutex_lock(&groups->mutex);
+	stopping = groups->stopping;
+	g_mutex_unlock(&groups->mutex);
+
+	/* what's left in the queue when stopping isn't worth waiting for */
+	if (stopping == FALSE) {
+		request->group_names =
+		    g_ptr_array_new_with_free_func(g_free);
+		request->found =
+		    groups->resolve_func(request->user_name, &request->uid,
+					 request->group_names);
+		xfce_usermon_stats_count(USERMON_COUNTER_GROUP_LOOKUPS, 1);
+	}
+
+	g_mutex_lock(&groups->mutex);
+	g_ptr_array_add(groups->done, request);
+	if ((groups->done_source_id == 0) && (groups->stopping == FALSE)) {
+		groups->done_source_id =
+		    g_idle_add(xfce_usermon_groups_apply, groups);
+	}
+	g_mutex_unlock(&groups->mutex);
+}
+
+static UserMonitorGroupsEntry *xfce_usermon_groups_lookup(UserMonitorGroups *
+							  groups,
+							  const gchar *
+							  user_name)
+{
+	UserMonitorGroupsEntry *entry =
+	    g_hash_table_lookup(groups->entries, user_name);
+	UserMonitorGroupsRequest *request;
+
+	if (entry == NULL) {
+		entry = g_slice_new0(UserMonitorGroupsEntry);
+		g_hash_table_insert(groups->entries, g_strdup(user_name),
+				    entry);
+	} else if ((entry->pending == TRUE) ||
+		   ((entry->resolved == TRUE) &&
+		    (g_get_monotonic_time() < entry->expiry))) {
+		return entry;
+	}
+
+	/* only once at a time for each user */
+	request = g_slice_new0(UserMonitorGroupsRequest);
+	request->user_name = g_strdup(user_name);
+	request->found = FALSE;
+	request->group_names = NULL;
+	if (groups->pool == NULL) {
+		groups->pool =
+		    g_thread_pool_new(xfce_usermon_groups_work, groups,
+				      USERMON_GROUPS_THREADS, FALSE, NULL);
+	}
+	g_thread_pool_push(groups->pool, request, NULL);
+	entry->pending = TRUE;
+
+	return entry;
+}
+
+UserMonitorGroups *xfce_usermon_groups_new(guint ttl, guint negative_ttl,
+					   UserMonitorGroupsResolveFunc
+					   resolve_func,
+					   UserMonitorGroupsFunc func,
+					   gpointer user_data)
+{
+	UserMonitorGroups *groups = g_slice_new0(UserMonitorGroups);
+
+	groups->ttl = (gint64) ttl * G_USEC_PER_SEC;
+	groups->negative_ttl = (gint64) negative_ttl * G_USEC_PER_SEC;
+	groups->resolve_func = (resolve_func != NULL) ? resolve_func :
+	    xfce_usermon_groups_resolve;
+	groups->func = func;
+	groups->user_data = user_data;
+	groups->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free,
+						xfce_usermon_groups_free_entry);
+	groups->pool = NULL;
+	g_mutex_init(&groups->mutex);
+	groups->done =
+	    g_ptr_array_new_with_free_func(xfce_usermon_groups_free_request);
+	groups->done_source_id = 0;
+	groups->stopping = FALSE;
+
+	return groups;
+}
+
+void xfce_usermon_groups_free(UserMonitorGroups * groups)
+{
+	if (groups == NULL) {
+		return;
+	}
+
+	if (groups->pool != NULL) {
+		g_mutex_lock(&groups->mutex);
+		groups->stopping = TRUE;
+		g_mutex_unlock(&groups->mutex);
+
+		/* only lookups already under way are waited for */
+		g_thread_pool_free(groups->pool, FALSE, TRUE);
+	}
+	if (groups->done_source_id > 0) {
+		g_source_remove(groups->done_source_id);
+	}
+	g_ptr_array_free(groups->done, TRUE);
+	g_mutex_clear(&groups->mutex);
+	g_hash_table_destroy(groups->entries);
+
+	g_slice_free(UserMonitorGroups, groups);
+}
+
+UserMonitorMembership xfce_usermon_groups_is_member(UserMonitorGroups *
+						    groups,
+						    const gchar * user_name,
+						    const gchar * group_name)
+{
+	UserMonitorGroupsEntry *entry =
+	    xfce_usermon_groups_lookup(groups, user_name);
+
+	if (entry->resolved == FALSE) {
+		return USERMON_MEMBERSHIP_UNKNOWN;
+	}
+	if ((entry->group_names != NULL) &&
+	    (g_strv_contains((const gchar * const *)entry->group_names,
+			     group_name) == TRUE)) {
+		return USERMON_MEMBERSHIP_MEMBER;
+	}
+
+	return USERMON_MEMBERSHIP_NONE;
+}
+
+gboolean xfce_usermon_groups_get_uid(UserMonitorGroups * groups,
+				     const gchar * user_name, uid_t * uid)
+{
+	UserMonitorGroupsEntry *entry =
+	    xfce_usermon_groups_lookup(groups, user_name);
+
+	if ((entry->resolved == FALSE) || (entry->found == FALSE)) {
+		return FALSE;
+	}
+	*uid = entry->uid;
+
+	return TRUE;
+}
@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_GROUPS_H__
+#define __USER_MONITOR_GROUPS_H__
+
+#include <sys/types.h>
+
+/* what is known about a user being in a group */
+G_BEGIN_DECLS typedef enum {
+	USERMON_MEMBERSHIP_UNKNOWN = 0,
+	USERMON_MEMBERSHIP_NONE,
+	USERMON_MEMBERSHIP_MEMBER
+} UserMonitorMembership;
+
+/* caches the uid and the groups of users; lookups never block, users
+ * not known yet are resolved by a worker thread and answered after
+ * that, and expired entries keep answering while they are refreshed */
+typedef struct _UserMonitorGroups UserMonitorGroups;
+
+/* runs in the worker, fills uid and group_names with newly allocated
+ * names; returns FALSE if the user doesn't exist or on errors, and
+ * that is remembered for a shorter time */
+typedef gboolean(*UserMonitorGroupsResolveFunc) (const gchar * user_name,
+						 uid_t * uid,
+						 GPtrArray * group_names);
+
+/* runs in the main loop, once user_name was resolved */
+typedef void (*UserMonitorGroupsFunc) (const gchar * user_name,
+				       gpointer user_data);
+
+/* entries are kept for ttl seconds, negative_ttl for users that
+ * couldn't be resolved; resolve_func may be NULL to ask NSS */
+UserMonitorGroups *xfce_usermon_groups_new(guint ttl, guint negative_ttl,
+					   UserMonitorGroupsResolveFunc
+					   resolve_func,
+					   UserMonitorGroupsFunc func,
+					   gpointer user_data);
+
+void xfce_usermon_groups_free(UserMonitorGroups * groups);
+
+/* returns USERMON_MEMBERSHIP_UNKNOWN until user_name is resolved */
+UserMonitorMembership xfce_usermon_groups_is_member(UserMonitorGroups *
+						    groups,
+						    const gchar * user_name,
+						    const gchar * group_name);
+
+/* returns FALSE until user_name is resolved, or if it couldn't be */
+gboolean xfce_usermon_groups_get_uid(UserMonitorGroups * groups,
+				     const gchar * user_name, uid_t * uid);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_GROUPS_H__ */
@@ -0,0 +1,871 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-history.h"
+
+#define USERMON_HISTORY_MAGIC	0x48574d55	/* UMWH */
+#define USERMON_HISTORY_VERSION	3
+#define USERMON_HISTORY_HOUR	3600
+/* how many wtmp records are read at once */
+#define USERMON_HISTORY_CHUNK	256
+/* the least room made for each array of the index */
+#define USERMON_HISTORY_MIN_CAPACITY	64
+
+/* the index file is made of this header, followed by room for
+ * sessions_capacity UserMonitorHistorySession, of which sessions_count
+ * are used, sorted by login time, hours_capacity guint32 peaks, one
+ * per hour starting at first_hour, and open_capacity guint32 indexes
+ * of sessions still open; updates write what changed in place and the header last, the
+ * file is only written anew once an array is full */
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	guint64 wtmp_ino;
+	guint64 wtmp_offset;
+	guint32 sessions_count;
+	guint32 sessions_capacity;
+	gint64 first_hour;
+	guint32 hours_count;
+	guint32 hours_capacity;
+	guint32 open_count;
+	guint32 open_capacity;
+} UserMonitorHistoryHeader;
+
+struct _UserMonitorHistory {
+	gchar *wtmp_path;
+	gchar *index_path;
+	gint cancelled;
+	/* mapping of the index file */
+	gpointer map;
+	gsize map_size;
+	const UserMonitorHistoryHeader *header;
+	const UserMonitorHistorySession *sessions;
+	const guint32 *hours;
+	const guint32 *open_slots;
+	/* segment tree of hourly peaks */
+	GArray *tree;
+	/* segment tree of the sessions' logout times, over a power of two
+	 * leaves, so that sessions still open or that lasted long only
+	 * cost a query that overlaps them */
+	GArray *ends;
+};
+
+/* the index, while it's being extended */
+typedef struct {
+	GArray *sessions;
+	GArray *hours;
+	gint64 first_hour;
+	/* line to index of the session open on it */
+	GHashTable *open;
+	/* what changed since the index was loaded */
+	guint dirty_session;
+	guint dirty_hour;
+	/* a session was inserted before others, which moved */
+	gboolean shifted;
+} UserMonitorHistoryState;
+
+#ifdef HAVE_SYS_MMAN_H
+static void xfce_usermon_history_copy(gchar * dest, gsize dest_size,
+				      const gchar * src, gsize src_size)
+{
+	gsize len = strnlen(src, src_size);
+
+	/* wtmp strings aren't necessarily terminated */
+	len = MIN(len, dest_size - 1);
+	memcpy(dest, src, len);
+	dest[len] = '\0';
+}
+
+static gint64 xfce_usermon_history_get_end(const UserMonitorHistorySession *
+					   session)
+{
+	if (session->logout_time == 0) {
+		return G_MAXINT64;
+	}
+
+	return session->logout_time;
+}
+
+/* returns the size of the file; the sessions follow the header */
+static gsize xfce_usermon_history_layout(const UserMonitorHistoryHeader *
+					 header, gsize * hours_offset,
+					 gsize * open_offset)
+{
+	*hours_offset = sizeof(UserMonitorHistoryHeader) +
+	    (gsize) header->sessions_capacity *
+	    sizeof(UserMonitorHistorySession);
+	*open_offset = *hours_offset +
+	    (gsize) header->hours_capacity * sizeof(guint32);
+
+	return *open_offset + (gsize) header->open_capacity * sizeof(guint32);
+}
+
+static void xfce_usermon_history_unmap(UserMonitorHistory * history)
+{
+	if (history->map != NULL) {
+		munmap(history->map, history->map_size);
+	}
+	history->map = NULL;
+	history->map_size = 0;
+	history->header = NULL;
+	history->sessions = NULL;
+	history->hours = NULL;
+	history->open_slots = NULL;
+	g_array_set_size(history->tree, 0);
+	g_array_set_size(history->ends, 0);
+}
+
+static void xfce_usermon_history_build_tree(UserMonitorHistory * history)
+{
+	guint count = history->header->hours_count;
+	guint32 *tree;
+	guint i;
+
+	g_array_set_size(history->tree, 2 * count);
+	if (count == 0) {
+		return;
+	}
+	tree = (guint32 *) history->tree->data;
+
+	/* leaves are at the end, each parent is the max of its children */
+	for (i = 0; i < count; ++i) {
+		tree[count + i] = history->hours[i];
+	}
+	for (i = count - 1; i > 0; --i) {
+		tree[i] = MAX(tree[2 * i], tree[2 * i + 1]);
+	}
+}
+
+static void xfce_usermon_history_build_ends(UserMonitorHistory * history)
+{
+	guint count = history->header->sessions_count;
+	guint size = 1;
+	gint64 *ends;
+	guint i;
+
+	while (size < count) {
+		size *= 2;
+	}
+	g_array_set_size(history->ends, 2 * size);
+	ends = (gint64 *) history->ends->data;
+
+	/* the leaves past the sessions never match */
+	for (i = 0; i < size; ++i) {
+		ends[size + i] = (i < count) ?
+		    xfce_usermon_history_get_end(&history->sessions[i]) :
+		    G_MININT64;
+	}
+	for (i = size - 1; i > 0; --i) {
+		ends[i] = MAX(ends[2 * i], ends[2 * i + 1]);
+	}
+}
+
+static gboolean xfce_usermon_history_map(UserMonitorHistory * history)
+{
+	const UserMonitorHistoryHeader *header;
+	struct stat index_stat;
+	gsize expected_size, hours_offset, open_offset;
+	gint fd;
+
+	xfce_usermon_history_unmap(history);
+
+	fd = open(history->index_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return FALSE;
+	}
+	if ((fstat(fd, &index_stat) != 0) ||
+	    (index_stat.st_size < (off_t) sizeof(UserMonitorHistoryHeader))) {
+		close(fd);
+		return FALSE;
+	}
+
+	history->map = mmap(NULL, index_stat.st_size, PROT_READ, MAP_SHARED,
+			    fd, 0);
+	close(fd);
+	if (history->map == MAP_FAILED) {
+		g_debug("Failed to map %s: %s", history->index_path,
+			strerror(errno));
+		history->map = NULL;
+		return FALSE;
+	}
+	history->map_size = index_stat.st_size;
+
+	header = (const UserMonitorHistoryHeader *)history->map;
+	expected_size = xfce_usermon_history_layout(header, &hours_offset,
+						    &open_offset);
+	if ((header->magic != USERMON_HISTORY_MAGIC) ||
+	    (header->version != USERMON_HISTORY_VERSION) ||
+	    (header->sessions_count > header->sessions_capacity) ||
+	    (header->hours_count > header->hours_capacity) ||
+	    (header->open_count > header->open_capacity) ||
+	    (expected_size != history->map_size)) {
+		g_debug("Ignoring invalid index %s", history->index_path);
+		xfce_usermon_history_unmap(history);
+		return FALSE;
+	}
+
+	history->sessions = (const UserMonitorHistorySession *)
+	    ((gchar *) history->map + sizeof(UserMonitorHistoryHeader));
+	history->hours = (const guint32 *)((gchar *) history->map +
+					   hours_offset);
+	history->open_slots = (const guint32 *)((gchar *) history->map +
+						open_offset);
+	history->header = header;
+
+	xfce_usermon_history_build_tree(history);
+	xfce_usermon_history_build_ends(history);
+
+	g_debug("Mapped %s, %d sessions over %d hours", history->index_path,
+		header->sessions_count, header->hours_count);
+
+	return TRUE;
+}
+
+static void xfce_usermon_history_load(UserMonitorHistory * history,
+				      UserMonitorHistoryState * state)
+{
+	const UserMonitorHistoryHeader *header = history->header;
+	guint i;
+
+	state->sessions = g_array_new(FALSE, FALSE,
+				      sizeof(UserMonitorHistorySession));
+	state->hours = g_array_new(FALSE, FALSE, sizeof(guint32));
+	state->first_hour = 0;
+	state->open = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    g_free, NULL);
+	state->dirty_session = 0;
+	state->dirty_hour = 0;
+	state->shifted = FALSE;
+
+	if (header == NULL) {
+		return;
+	}
+
+	g_array_append_vals(state->sessions, history->sessions,
+			    header->sessions_count);
+	g_array_append_vals(state->hours, history->hours,
+			    header->hours_count);
+	state->first_hour = header->first_hour;
+	for (i = 0; i < header->open_count; ++i) {
+		guint slot = history->open_slots[i];
+
+		if (slot < header->sessions_count) {
+			g_hash_table_insert(state->open,
+					    g_strdup(history->sessions[slot].
+						     line),
+					    GUINT_TO_POINTER(slot));
+		}
+	}
+	state->dirty_session = state->sessions->len;
+	state->dirty_hour = state->hours->len;
+}
+
+static void xfce_usermon_history_clear(UserMonitorHistoryState * state)
+{
+	g_array_free(state->sessions, TRUE);
+	g_array_free(state->hours, TRUE);
+	g_hash_table_destroy(state->open);
+}
+
+/* hours without any event had the same sessions throughout */
+static void xfce_usermon_history_extend(UserMonitorHistoryState * state,
+					gint64 time)
+{
+	gint64 hour = time / USERMON_HISTORY_HOUR;
+	guint32 current = g_hash_table_size(state->open);
+
+	if (state->hours->len == 0) {
+		state->first_hour = hour;
+	}
+
+	while (state->first_hour + state->hours->len <= hour) {
+		g_array_append_val(state->hours, current);
+	}
+}
+
+/* the peak of the hour when something happens is at least the
+ * number of sessions open right after */
+static void xfce_usermon_history_account(UserMonitorHistoryState * state,
+					 gint64 time)
+{
+	gint64 hour = time / USERMON_HISTORY_HOUR;
+	guint32 current = g_hash_table_size(state->open);
+	guint32 *peak;
+
+	if (hour < state->first_hour) {
+		return;
+	}
+
+	peak = &g_array_index(state->hours, guint32, hour - state->first_hour);
+	if (current > *peak) {
+		*peak = current;
+		state->dirty_hour = MIN(state->dirty_hour,
+					(guint) (hour - state->first_hour));
+	}
+}
+
+static void xfce_usermon_history_end(UserMonitorHistoryState * state,
+				     guint slot, gint64 time)
+{
+	UserMonitorHistorySession *session =
+	    &g_array_index(state->sessions, UserMonitorHistorySession, slot);
+
+	session->logout_time = MAX(time, session->login_time);
+	state->dirty_session = MIN(state->dirty_session, slot);
+}
+
+/* returns where a session that started at time goes; wtmp is
+ * chronological unless the clock went back, in which case the later
+ * sessions move up to keep them sorted */
+static guint xfce_usermon_history_insert(UserMonitorHistoryState * state,
+					 gint64 time)
+{
+	UserMonitorHistorySession session;
+	guint position = state->sessions->len;
+	GHashTableIter iter;
+	gpointer value;
+
+	while ((position > 0) &&
+	       (g_array_index(state->sessions, UserMonitorHistorySession,
+			      position - 1).login_time > time)) {
+		--position;
+	}
+	memset(&session, 0, sizeof(session));
+	g_array_insert_val(state->sessions, position, session);
+	if (position == state->sessions->len - 1) {
+		return position;
+	}
+
+	g_hash_table_iter_init(&iter, state->open);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		if (GPOINTER_TO_UINT(value) >= position) {
+			g_hash_table_iter_replace(&iter,
+						  GUINT_TO_POINTER
+						  (GPOINTER_TO_UINT(value) +
+						   1));
+		}
+	}
+	state->dirty_session = MIN(state->dirty_session, position);
+	state->shifted = TRUE;
+
+	return position;
+}
+
+static void xfce_usermon_history_end_all(UserMonitorHistoryState * state,
+					 gint64 time)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, state->open);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		xfce_usermon_history_end(state, GPOINTER_TO_UINT(value), time);
+		g_hash_table_iter_remove(&iter);
+	}
+}
+
+static void xfce_usermon_history_process(UserMonitorHistoryState * state,
+					 const struct utmpx *u)
+{
+	UserMonitorHistorySession *session;
+	gchar line[sizeof(session->line)];
+	gint64 time = u->ut_tv.tv_sec;
+	gpointer slot;
+	guint position;
+
+	if (time <= 0) {
+		return;
+	}
+	xfce_usermon_history_copy(line, sizeof(line), u->ut_line,
+				  sizeof(u->ut_line));
+
+	xfce_usermon_history_extend(state, time);
+
+	switch (u->ut_type) {
+	case USER_PROCESS:
+		/* a login on a line implies a logout from it */
+		if (g_hash_table_lookup_extended(state->open, line, NULL,
+						 &slot) == TRUE) {
+			xfce_usermon_history_end(state, GPOINTER_TO_UINT(slot),
+						 time);
+		}
+
+		position = xfce_usermon_history_insert(state, time);
+		session = &g_array_index(state->sessions,
+					 UserMonitorHistorySession, position);
+		session->login_time = time;
+		xfce_usermon_history_copy(session->user_name,
+					  sizeof(session->user_name),
+					  u->ut_user, sizeof(u->ut_user));
+		memcpy(session->line, line, sizeof(line));
+		xfce_usermon_history_copy(session->host,
+					  sizeof(session->host), u->ut_host,
+					  sizeof(u->ut_host));
+
+		g_hash_table_replace(state->open, g_strdup(line),
+				     GUINT_TO_POINTER(position));
+		break;
+	case DEAD_PROCESS:
+		if (g_hash_table_lookup_extended(state->open, line, NULL,
+						 &slot) == TRUE) {
+			xfce_usermon_history_end(state, GPOINTER_TO_UINT(slot),
+						 time);
+			g_hash_table_remove(state->open, line);
+		}
+		break;
+	case BOOT_TIME:
+		xfce_usermon_history_end_all(state, time);
+		break;
+#ifdef RUN_LVL
+	case RUN_LVL:
+		if (strncmp(u->ut_user, "shutdown", sizeof(u->ut_user)) == 0) {
+			xfce_usermon_history_end_all(state, time);
+		}
+		break;
+#endif
+	default:
+		return;
+	}
+
+	xfce_usermon_history_account(state, time);
+}
+
+static gboolean xfce_usermon_history_write(gint fd, gconstpointer data,
+					   gsize size, gsize offset)
+{
+	const gchar *ptr = (const gchar *)data;
+
+	while (size > 0) {
+		ssize_t written = pwrite(fd, ptr, size, offset);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		ptr += written;
+		size -= written;
+		offset += written;
+	}
+
+	return TRUE;
+}
+
+/* writes the sessions from first_session on and the hours from
+ * first_hour on, the header last */
+static gboolean xfce_usermon_history_put(gint fd,
+					 const UserMonitorHistoryHeader *
+					 header,
+					 UserMonitorHistoryState * state,
+					 GArray * open_slots,
+					 guint first_session, guint first_hour)
+{
+	gsize hours_offset, open_offset;
+
+	xfce_usermon_history_layout(header, &hours_offset, &open_offset);
+
+	return xfce_usermon_history_write(fd,
+					  &g_array_index(state->sessions,
+							 UserMonitorHistorySession,
+							 first_session),
+					  (state->sessions->len -
+					   first_session) *
+					  sizeof(UserMonitorHistorySession),
+					  sizeof(UserMonitorHistoryHeader) +
+					  first_session *
+					  sizeof(UserMonitorHistorySession)) &&
+	    xfce_usermon_history_write(fd,
+				       &g_array_index(state->hours, guint32,
+						      first_hour),
+				       (state->hours->len - first_hour) *
+				       sizeof(guint32),
+				       hours_offset +
+				       first_hour * sizeof(guint32)) &&
+	    xfce_usermon_history_write(fd, open_slots->data,
+				       open_slots->len * sizeof(guint32),
+				       open_offset) &&
+	    xfce_usermon_history_write(fd, header,
+				       sizeof(UserMonitorHistoryHeader), 0);
+}
+
+/* writes the whole index anew, with room for it to grow */
+static gboolean xfce_usermon_history_rewrite(UserMonitorHistory * history,
+					     UserMonitorHistoryHeader * header,
+					     UserMonitorHistoryState * state,
+					     GArray * open_slots)
+{
+	gsize hours_offset, open_offset, size;
+	gchar *dir, *temp_path;
+	gboolean saved;
+	gint fd;
+
+	header->sessions_capacity = MAX(USERMON_HISTORY_MIN_CAPACITY,
+					header->sessions_count * 2);
+	header->hours_capacity = MAX(USERMON_HISTORY_MIN_CAPACITY,
+				     header->hours_count * 2);
+	header->open_capacity = MAX(USERMON_HISTORY_MIN_CAPACITY,
+				    header->open_count * 2);
+	size = xfce_usermon_history_layout(header, &hours_offset,
+					   &open_offset);
+
+	dir = g_path_get_dirname(history->index_path);
+	g_mkdir_with_parents(dir, 0755);
+	g_free(dir);
+
+	/* replace the index atomically */
+	temp_path = g_strdup_printf("%s.XXXXXX", history->index_path);
+	fd = g_mkstemp(temp_path);
+	if (fd < 0) {
+		g_debug("Failed to create %s: %s", temp_path, strerror(errno));
+		g_free(temp_path);
+		return FALSE;
+	}
+
+	saved = (ftruncate(fd, size) == 0) &&
+	    xfce_usermon_history_put(fd, header, state, open_slots, 0, 0);
+	if (close(fd) != 0) {
+		saved = FALSE;
+	}
+
+	if ((saved == FALSE) || (g_rename(temp_path, history->index_path) != 0)) {
+		g_debug("Failed to save %s: %s", history->index_path,
+			strerror(errno));
+		g_unlink(temp_path);
+		saved = FALSE;
+	}
+	g_free(temp_path);
+
+	return saved;
+}
+
+static gboolean xfce_usermon_history_save(UserMonitorHistory * history,
+					  UserMonitorHistoryState * state,
+					  guint64 wtmp_ino,
+					  guint64 wtmp_offset)
+{
+	const UserMonitorHistoryHeader *old_header = history->header;
+	UserMonitorHistoryHeader header;
+	GArray *open_slots;
+	GHashTableIter iter;
+	gpointer value;
+	gboolean saved;
+	gint fd;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = USERMON_HISTORY_MAGIC;
+	header.version = USERMON_HISTORY_VERSION;
+	header.wtmp_ino = wtmp_ino;
+	header.wtmp_offset = wtmp_offset;
+	header.sessions_count = state->sessions->len;
+	header.open_count = g_hash_table_size(state->open);
+	header.first_hour = state->first_hour;
+	header.hours_count = state->hours->len;
+
+	open_slots = g_array_sized_new(FALSE, FALSE, sizeof(guint32),
+				       header.open_count);
+	g_hash_table_iter_init(&iter, state->open);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		guint32 slot = GPOINTER_TO_UINT(value);
+
+		g_array_append_val(open_slots, slot);
+	}
+
+	/* sessions that moved aren't patched, a crash halfway would
+	 * leave them out of order */
+	if ((old_header == NULL) || (state->shifted == TRUE) ||
+	    (header.first_hour != old_header->first_hour) ||
+	    (header.sessions_count > old_header->sessions_capacity) ||
+	    (header.hours_count > old_header->hours_capacity) ||
+	    (header.open_count > old_header->open_capacity)) {
+		saved = xfce_usermon_history_rewrite(history, &header, state,
+						     open_slots);
+		g_array_free(open_slots, TRUE);
+		return saved;
+	}
+
+	header.sessions_capacity = old_header->sessions_capacity;
+	header.hours_capacity = old_header->hours_capacity;
+	header.open_capacity = old_header->open_capacity;
+	fd = open(history->index_path, O_WRONLY | O_CLOEXEC);
+	saved = (fd >= 0) &&
+	    xfce_usermon_history_put(fd, &header, state, open_slots,
+				     state->dirty_session, state->dirty_hour);
+	if ((fd >= 0) && (close(fd) != 0)) {
+		saved = FALSE;
+	}
+	if (saved == FALSE) {
+		/* indexed again from scratch next time */
+		g_debug("Failed to update %s: %s", history->index_path,
+			strerror(errno));
+		g_unlink(history->index_path);
+	}
+
+	g_array_free(open_slots, TRUE);
+
+	return saved;
+}
+#endif
+
+UserMonitorHistory *xfce_usermon_history_new(const gchar * wtmp_path,
+					     const gchar * index_path)
+{
+#ifdef HAVE_SYS_MMAN_H
+	UserMonitorHistory *history = g_slice_new0(UserMonitorHistory);
+
+	g_debug("xfce_usermon_history_new %s %s", wtmp_path, index_path);
+	history->wtmp_path = g_strdup(wtmp_path);
+	history->index_path = g_strdup(index_path);
+	history->cancelled = 0;
+	history->map = NULL;
+	history->tree = g_array_new(FALSE, FALSE, sizeof(guint32));
+	history->ends = g_array_new(FALSE, FALSE, sizeof(gint64));
+
+	/* whatever was indexed last time is available right away */
+	xfce_usermon_history_map(history);
+
+	return history;
+#else
+	g_debug("No mmap support");
+	return NULL;
+#endif
+}
+
+void xfce_usermon_history_free(UserMonitorHistory * history)
+{
+	if (history == NULL) {
+		return;
+	}
+
+#ifdef HAVE_SYS_MMAN_H
+	xfce_usermon_history_unmap(history);
+#endif
+	g_array_free(history->tree, TRUE);
+	g_array_free(history->ends, TRUE);
+	g_free(history->wtmp_path);
+	g_free(history->index_path);
+
+	g_slice_free(UserMonitorHistory, history);
+}
+
+gboolean xfce_usermon_history_update(UserMonitorHistory * history)
+{
+#ifdef HAVE_SYS_MMAN_H
+	UserMonitorHistoryState state;
+	struct utmpx records[USERMON_HISTORY_CHUNK];
+	struct stat wtmp_stat;
+	guint64 offset = 0;
+	gboolean updated = TRUE;
+	gint fd;
+
+	if (stat(history->wtmp_path, &wtmp_stat) != 0) {
+		g_debug("Failed to stat %s", history->wtmp_path);
+		return FALSE;
+	}
+
+	/* carry on from where the last update stopped, unless wtmp was
+	 * rotated or truncated */
+	if ((history->header != NULL) &&
+	    (history->header->wtmp_ino == (guint64) wtmp_stat.st_ino) &&
+	    (history->header->wtmp_offset <= (guint64) wtmp_stat.st_size)) {
+		offset = history->header->wtmp_offset;
+		if (offset + sizeof(struct utmpx) > (guint64) wtmp_stat.st_size) {
+			return TRUE;
+		}
+	}
+
+	fd = open(history->wtmp_path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		g_debug("Failed to open %s: %s", history->wtmp_path,
+			strerror(errno));
+		return FALSE;
+	}
+
+	g_debug("Indexing %s from offset %lu", history->wtmp_path,
+		(gulong) offset);
+	xfce_usermon_history_load(history, &state);
+
+	while (TRUE) {
+		ssize_t len = pread(fd, records, sizeof(records), offset);
+		guint count, i;
+
+		if ((len < 0) && (errno == EINTR)) {
+			continue;
+		}
+		/* a partially written record is left for next time */
+		count = (len > 0) ? len / sizeof(struct utmpx) : 0;
+		if (count == 0) {
+			break;
+		}
+
+		for (i = 0; i < count; ++i) {
+			xfce_usermon_history_process(&state, &records[i]);
+		}
+		offset += count * sizeof(struct utmpx);
+
+		if (g_atomic_int_get(&history->cancelled) != 0) {
+			g_debug("Indexing cancelled");
+			updated = FALSE;
+			break;
+		}
+	}
+	close(fd);
+
+	if (updated == TRUE) {
+		updated = xfce_usermon_history_save(history, &state,
+						    wtmp_stat.st_ino, offset);
+	}
+	xfce_usermon_history_clear(&state);
+
+	if (updated == TRUE) {
+		updated = xfce_usermon_history_map(history);
+	}
+
+	return updated;
+#else
+	return FALSE;
+#endif
+}
+
+void xfce_usermon_history_cancel(UserMonitorHistory * history)
+{
+	g_atomic_int_set(&history->cancelled, 1);
+}
+
+/* appends the sessions before last that end after from, among the
+ * leaves under node, which start at first; left first, so that they
+ * stay sorted by login time */
+static guint xfce_usermon_history_collect(UserMonitorHistory * history,
+					  guint node, guint first,
+					  guint size, guint last,
+					  gint64 from, GArray * sessions)
+{
+	const gint64 *ends = (const gint64 *)history->ends->data;
+
+	if ((first >= last) || (ends[node] <= from)) {
+		return 0;
+	}
+	if (size == 1) {
+		g_array_append_vals(sessions, &history->sessions[first], 1);
+		return 1;
+	}
+
+	size /= 2;
+	return xfce_usermon_history_collect(history, 2 * node, first, size,
+					    last, from, sessions) +
+	    xfce_usermon_history_collect(history, 2 * node + 1, first + size,
+					 size, last, from, sessions);
+}
+
+guint xfce_usermon_history_get_sessions(UserMonitorHistory * history,
+					gint64 from, gint64 to,
+					GArray * sessions)
+{
+	guint high, middle, last;
+
+	if ((history->header == NULL) || (from >= to) ||
+	    (history->header->sessions_count == 0)) {
+		return 0;
+	}
+
+	/* sessions from last on all started after to */
+	last = 0;
+	high = history->header->sessions_count;
+	while (last < high) {
+		middle = last + (high - last) / 2;
+		if (history->sessions[middle].login_time >= to) {
+			high = middle;
+		} else {
+			last = middle + 1;
+		}
+	}
+
+	/* subtrees that all ended by from are skipped whole, a session
+	 * still open only costs the queries it overlaps */
+	return xfce_usermon_history_collect(history, 1, 0,
+					    history->ends->len / 2, last,
+					    from, sessions);
+}
+
+guint xfce_usermon_history_get_peak(UserMonitorHistory * history,
+				    gint64 from, gint64 to)
+{
+	const guint32 *tree;
+	gint64 first_hour, last_hour, end_hour;
+	guint count, left, right;
+	guint peak = 0;
+
+	if ((history->header == NULL) || (from >= to) ||
+	    (history->header->hours_count == 0)) {
+		return 0;
+	}
+
+	first_hour = from / USERMON_HISTORY_HOUR;
+	last_hour = (to - 1) / USERMON_HISTORY_HOUR;
+	end_hour = history->header->first_hour + history->header->hours_count;
+	count = history->header->hours_count;
+	tree = (const guint32 *)history->tree->data;
+
+	/* query the hours that were indexed */
+	if ((last_hour >= history->header->first_hour) &&
+	    (first_hour < end_hour)) {
+		left = MAX(first_hour, history->header->first_hour) -
+		    history->header->first_hour + count;
+		right = MIN(last_hour + 1, end_hour) -
+		    history->header->first_hour + count;
+
+		while (left < right) {
+			if (left & 1) {
+				peak = MAX(peak, tree[left]);
+				++left;
+			}
+			if (right & 1) {
+				--right;
+				peak = MAX(peak, tree[right]);
+			}
+			left >>= 1;
+			right >>= 1;
+		}
+	}
+
+	/* nothing changed since the last event */
+	if (last_hour >= end_hour) {
+		peak = MAX(peak, history->header->open_count);
+	}
+
+	return peak;
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_HISTORY_H__
+#define __USER_MONITOR_HISTORY_H__
+
+#include <utmpx.h>
+
+/* where wtmp lives */
+#ifdef _PATH_WTMPX
+#define USERMON_WTMP_PATH	_PATH_WTMPX
+#else
+#define USERMON_WTMP_PATH	"/var/log/wtmp"
+#endif
+
+/* a past or current session, as found in wtmp */
+G_BEGIN_DECLS typedef struct {
+	gint64 login_time;
+	/* 0 if the session is still open */
+	gint64 logout_time;
+	/* as long as wtmp's, terminated */
+	gchar user_name[sizeof(((struct utmpx *) 0)->ut_user) + 1];
+	gchar line[sizeof(((struct utmpx *) 0)->ut_line) + 1];
+	gchar host[sizeof(((struct utmpx *) 0)->ut_host) + 1];
+} UserMonitorHistorySession;
+
+/* wtmp is indexed into a file that's extended in place as wtmp grows,
+ * and queries are answered from a mapping of that file */
+typedef struct _UserMonitorHistory UserMonitorHistory;
+
+UserMonitorHistory *xfce_usermon_history_new(const gchar * wtmp_path,
+					     const gchar * index_path);
+
+void xfce_usermon_history_free(UserMonitorHistory * history);
+
+/* indexes what was appended to wtmp since the last update; this may
+ * be called from another thread, as long as no query runs meanwhile */
+gboolean xfce_usermon_history_update(UserMonitorHistory * history);
+
+/* makes a running update give up, from any thread */
+void xfce_usermon_history_cancel(UserMonitorHistory * history);
+
+/* appends the sessions that overlap [from, to) to sessions, an array
+ * of UserMonitorHistorySession sorted by login time */
+guint xfce_usermon_history_get_sessions(UserMonitorHistory * history,
+					gint64 from, gint64 to,
+					GArray * sessions);
+
+/* the highest number of concurrent sessions over the hours that
+ * overlap [from, to) */
+guint xfce_usermon_history_get_peak(UserMonitorHistory * history,
+				    gint64 from, gint64 to);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_HISTORY_H__ */
@@ -0,0 +1,402 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-idle.h"
+#include "usermon-stats.h"
+
+/* statx requests in flight at once */
+#define USERMON_IDLE_RING_ENTRIES	128
+
+typedef struct {
+	gchar *path;
+	/* sessions on this tty */
+	guint sessions_count;
+	/* last access, in seconds since the epoch; 0 if unknown */
+	gint64 access_time;
+	gboolean idle;
+	/* set by the batch */
+	gint64 new_access_time;
+#ifdef HAVE_LIBURING
+	struct statx statx_buffer;
+#endif
+} UserMonitorTty;
+
+struct _UserMonitorIdle {
+	guint threshold;
+	/* UserMonitorTty, keyed by line */
+	GHashTable *ttys;
+	/* those to look at on this pass */
+	GPtrArray *due;
+	guint idle_count;
+#ifdef HAVE_LIBURING
+	struct io_uring ring;
+	gboolean ring_ready;
+#endif
+	/* workers, when io_uring isn't available */
+	GThreadPool *pool;
+	guint max_threads;
+	GMutex mutex;
+	GCond cond;
+	guint pending_count;
+};
+
+static void xfce_usermon_idle_free_tty(gpointer data)
+{
+	UserMonitorTty *tty = (UserMonitorTty *) data;
+
+	g_free(tty->path);
+	g_slice_free(UserMonitorTty, tty);
+}
+
+static gboolean xfce_usermon_idle_get_line(const UserMonitorSessionKey * key,
+					   gchar * line)
+{
+	/* ttys of other utmp files are in another mount namespace */
+	if ((key->source != 0) || (key->line[0] == '\0') ||
+	    (key->line[0] == ':')) {
+		return FALSE;
+	}
+
+	memcpy(line, key->line, sizeof(key->line));
+	line[sizeof(key->line)] = '\0';
+
+	return TRUE;
+}
+
+static void xfce_usermon_idle_stat(UserMonitorTty * tty)
+{
+	struct stat st;
+
+	tty->new_access_time = 0;
+	if (stat(tty->path, &st) == 0) {
+		tty->new_access_time = st.st_atime;
+	}
+}
+
+static void xfce_usermon_idle_work(gpointer data, gpointer user_data)
+{
+	UserMonitorIdle *idle = (UserMonitorIdle *) user_data;
+
+	xfce_usermon_idle_stat((UserMonitorTty *) data);
+
+	g_mutex_lock(&idle->mutex);
+	if (--idle->pending_count == 0) {
+		g_cond_signal(&idle->cond);
+	}
+	g_mutex_unlock(&idle->mutex);
+}
+
+#ifdef HAVE_LIBURING
+static void xfce_usermon_idle_reset_ring(UserMonitorIdle * idle,
+					 guint pending_count)
+{
+	struct io_uring_cqe *cqe;
+
+	/* requests still in flight write to the ttys' buffers, wait for
+	 * them; those not submitted yet go away with the ring */
+	while (pending_count > 0) {
+		gint ret = io_uring_wait_cqe(&idle->ring, &cqe);
+
+		if (ret == -EINTR) {
+			continue;
+		}
+		if (ret < 0) {
+			break;
+		}
+		io_uring_cqe_seen(&idle->ring, cqe);
+		--pending_count;
+	}
+
+	io_uring_queue_exit(&idle->ring);
+	idle->ring_ready = FALSE;
+	g_debug("Falling back to threads");
+}
+
+static gboolean xfce_usermon_idle_stat_ring(UserMonitorIdle * idle)
+{
+	struct io_uring_cqe *cqe;
+	guint done = 0;
+	gint ret;
+
+	while (done < idle->due->len) {
+		guint count = MIN(idle->due->len - done,
+				  USERMON_IDLE_RING_ENTRIES);
+		guint i;
+
+		for (i = 0; i < count; ++i) {
+			UserMonitorTty *tty =
+			    g_ptr_array_index(idle->due, done + i);
+			struct io_uring_sqe *sqe =
+			    io_uring_get_sqe(&idle->ring);
+
+			tty->new_access_time = 0;
+			io_uring_prep_statx(sqe, AT_FDCWD, tty->path, 0,
+					    STATX_ATIME, &tty->statx_buffer);
+			io_uring_sqe_set_data(sqe, tty);
+		}
+
+		/* one system call for the whole batch */
+		if (io_uring_submit_and_wait(&idle->ring, count) < 0) {
+			xfce_usermon_idle_reset_ring(idle, count -
+						     io_uring_sq_ready
+						     (&idle->ring));
+			return FALSE;
+		}
+		for (i = 0; i < count; ++i) {
+			UserMonitorTty *tty;
+
+			do {
+				ret = io_uring_wait_cqe(&idle->ring, &cqe);
+			} while (ret == -EINTR);
+			if (ret < 0) {
+				xfce_usermon_idle_reset_ring(idle, count - i);
+				return FALSE;
+			}
+			tty = io_uring_cqe_get_data(cqe);
+			if (cqe->res == 0) {
+				tty->new_access_time =
+				    tty->statx_buffer.stx_atime.tv_sec;
+			}
+			io_uring_cqe_seen(&idle->ring, cqe);
+		}
+		done += count;
+	}
+
+	return TRUE;
+}
+#endif
+
+static void xfce_usermon_idle_stat_all(UserMonitorIdle * idle)
+{
+	guint i;
+
+#ifdef HAVE_LIBURING
+	if ((idle->ring_ready == TRUE) &&
+	    (xfce_usermon_idle_stat_ring(idle) == TRUE)) {
+		return;
+	}
+#endif
+
+	if ((idle->due->len == 1) || (idle->max_threads == 1)) {
+		for (i = 0; i < idle->due->len; ++i) {
+			xfce_usermon_idle_stat(g_ptr_array_index(idle->due, i));
+		}
+		return;
+	}
+
+	if (idle->pool == NULL) {
+		idle->pool = g_thread_pool_new(xfce_usermon_idle_work, idle,
+					       idle->max_threads, FALSE, NULL);
+	}
+
+	g_mutex_lock(&idle->mutex);
+	idle->pending_count = idle->due->len;
+	g_mutex_unlock(&idle->mutex);
+
+	for (i = 0; i < idle->due->len; ++i) {
+		g_thread_pool_push(idle->pool,
+				   g_ptr_array_index(idle->due, i), NULL);
+	}
+
+	g_mutex_lock(&idle->mutex);
+	while (idle->pending_count > 0) {
+		g_cond_wait(&idle->cond, &idle->mutex);
+	}
+	g_mutex_unlock(&idle->mutex);
+}
+
+UserMonitorIdle *xfce_usermon_idle_new(guint threshold, guint max_threads)
+{
+	UserMonitorIdle *idle = g_slice_new0(UserMonitorIdle);
+
+	idle->threshold = MAX(threshold, 1);
+	idle->ttys = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+					   xfce_usermon_idle_free_tty);
+	idle->due = g_ptr_array_new();
+	idle->idle_count = 0;
+#ifdef HAVE_LIBURING
+	idle->ring_ready =
+	    (io_uring_queue_init(USERMON_IDLE_RING_ENTRIES, &idle->ring, 0) ==
+	     0) ? TRUE : FALSE;
+	if (idle->ring_ready == FALSE) {
+		g_debug("Falling back to threads");
+	}
+#endif
+	idle->pool = NULL;
+	idle->max_threads = MAX(max_threads, 1);
+	g_mutex_init(&idle->mutex);
+	g_cond_init(&idle->cond);
+	idle->pending_count = 0;
+
+	return idle;
+}
+
+void xfce_usermon_idle_free(UserMonitorIdle * idle)
+{
+	if (idle == NULL) {
+		return;
+	}
+
+	if (idle->pool != NULL) {
+		g_thread_pool_free(idle->pool, FALSE, TRUE);
+	}
+#ifdef HAVE_LIBURING
+	if (idle->ring_ready == TRUE) {
+		io_uring_queue_exit(&idle->ring);
+	}
+#endif
+	g_hash_table_destroy(idle->ttys);
+	g_ptr_array_free(idle->due, TRUE);
+	g_cond_clear(&idle->cond);
+	g_mutex_clear(&idle->mutex);
+
+	g_slice_free(UserMonitorIdle, idle);
+}
+
+void xfce_usermon_idle_add(UserMonitorIdle * idle,
+			   const UserMonitorSessionKey * key)
+{
+	gchar line[sizeof(key->line) + 1];
+	UserMonitorTty *tty;
+
+	if (xfce_usermon_idle_get_line(key, line) == FALSE) {
+		return;
+	}
+
+	tty = g_hash_table_lookup(idle->ttys, line);
+	if (tty == NULL) {
+		tty = g_slice_new0(UserMonitorTty);
+		xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 1);
+		tty->path = g_strconcat("/dev/", line, NULL);
+		/* looked at on the next pass */
+		tty->access_time = 0;
+		tty->idle = FALSE;
+		g_hash_table_insert(idle->ttys, tty->path + strlen("/dev/"),
+				    tty);
+	}
+	++tty->sessions_count;
+	if (tty->idle == TRUE) {
+		++idle->idle_count;
+	}
+}
+
+void xfce_usermon_idle_remove(UserMonitorIdle * idle,
+			      const UserMonitorSessionKey * key)
+{
+	gchar line[sizeof(key->line) + 1];
+	UserMonitorTty *tty;
+
+	if (xfce_usermon_idle_get_line(key, line) == FALSE) {
+		return;
+	}
+
+	tty = g_hash_table_lookup(idle->ttys, line);
+	if (tty == NULL) {
+		return;
+	}
+	if (tty->idle == TRUE) {
+		--idle->idle_count;
+	}
+	if (--tty->sessions_count == 0) {
+		g_hash_table_remove(idle->ttys, line);
+	}
+}
+
+gboolean xfce_usermon_idle_update(UserMonitorIdle * idle)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+	gboolean changed = FALSE;
+	guint i;
+
+	/* a tty used less than threshold seconds ago can't be idle yet */
+	g_ptr_array_set_size(idle->due, 0);
+	g_hash_table_iter_init(&iter, idle->ttys);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		UserMonitorTty *tty = (UserMonitorTty *) value;
+
+		if ((tty->access_time == 0) ||
+		    (now - tty->access_time >= idle->threshold)) {
+			g_ptr_array_add(idle->due, tty);
+		}
+	}
+	if (idle->due->len == 0) {
+		return FALSE;
+	}
+
+	xfce_usermon_idle_stat_all(idle);
+	xfce_usermon_stats_count(USERMON_COUNTER_TTY_STATS, idle->due->len);
+
+	for (i = 0; i < idle->due->len; ++i) {
+		UserMonitorTty *tty = g_ptr_array_index(idle->due, i);
+		gboolean was_idle = tty->idle;
+
+		/* a tty that can't be looked at is taken as active */
+		tty->access_time = tty->new_access_time;
+		tty->idle = ((tty->access_time > 0) &&
+			     (now - tty->access_time >=
+			      idle->threshold)) ? TRUE : FALSE;
+		if (tty->idle != was_idle) {
+			if (tty->idle == TRUE) {
+				idle->idle_count += tty->sessions_count;
+			} else {
+				idle->idle_count -= tty->sessions_count;
+			}
+			changed = TRUE;
+		}
+	}
+	g_debug("Looked at %d ttys, %d idle sessions", idle->due->len,
+		idle->idle_count);
+
+	return changed;
+}
+
+gboolean xfce_usermon_idle_is_idle(UserMonitorIdle * idle,
+				   const UserMonitorSessionKey * key)
+{
+	gchar line[sizeof(key->line) + 1];
+	UserMonitorTty *tty;
+
+	if (xfce_usermon_idle_get_line(key, line) == FALSE) {
+		return FALSE;
+	}
+	tty = g_hash_table_lookup(idle->ttys, line);
+
+	return (tty != NULL) ? tty->idle : FALSE;
+}
+
+guint xfce_usermon_idle_get_count(UserMonitorIdle * idle)
+{
+	return idle->idle_count;
+}
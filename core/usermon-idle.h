@@ -0,0 +1,50 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_IDLE_H__
+#define __USER_MONITOR_IDLE_H__
+
+#include "usermon-sessions.h"
+
+/* tells idle sessions from active ones by the last access time of
+ * their tty; ttys are looked at all at once, and those used recently
+ * enough aren't looked at again until they could have become idle */
+G_BEGIN_DECLS typedef struct _UserMonitorIdle UserMonitorIdle;
+
+/* sessions whose tty wasn't used for threshold seconds are idle */
+UserMonitorIdle *xfce_usermon_idle_new(guint threshold, guint max_threads);
+
+void xfce_usermon_idle_free(UserMonitorIdle * idle);
+
+/* sessions without a tty on this host are never idle */
+void xfce_usermon_idle_add(UserMonitorIdle * idle,
+			   const UserMonitorSessionKey * key);
+
+void xfce_usermon_idle_remove(UserMonitorIdle * idle,
+			      const UserMonitorSessionKey * key);
+
+/* returns TRUE if any session became idle or active */
+gboolean xfce_usermon_idle_update(UserMonitorIdle * idle);
+
+gboolean xfce_usermon_idle_is_idle(UserMonitorIdle * idle,
+				   const UserMonitorSessionKey * key);
+
+guint xfce_usermon_idle_get_count(UserMonitorIdle * idle);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_IDLE_H__ */
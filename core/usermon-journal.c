@@ -0,0 +1,674 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-journal.h"
+#include "usermon-stats.h"
+
+/* each segment starts with the magic, the version and the time the
+ * first record is relative to */
+#define USERMON_JOURNAL_MAGIC	"USJ"
+#define USERMON_JOURNAL_VERSION	1
+#define USERMON_JOURNAL_HEADER_SIZE	12
+/* how long a record may wait in the buffer */
+#define USERMON_JOURNAL_FLUSH_DELAY	1000
+/* written right away beyond that */
+#define USERMON_JOURNAL_BUFFER_SIZE	(64 * 1024)
+
+struct _UserMonitorJournal {
+	gchar *path;
+	gsize max_segment_size;
+	guint max_segments;
+	/* held on path.lock, which isn't rotated, while the journal is
+	 * written */
+	gint lock_fd;
+	gint fd;
+	/* including what's still in the buffer */
+	gsize segment_size;
+	/* records store the time since the previous one */
+	gint64 last_time;
+	GByteArray *buffer;
+	GByteArray *record;
+	guint flush_source_id;
+	/* syncs the batches written, off the main loop */
+	GThreadPool *pool;
+};
+
+struct _UserMonitorJournalReader {
+	UserMonitorNames *names;
+	/* oldest first */
+	GPtrArray *paths;
+	guint next_path;
+	gchar *contents;
+	gsize length;
+	gsize offset;
+	gint64 last_time;
+};
+
+static void xfce_usermon_journal_put_varint(GByteArray * buffer,
+					    guint64 value)
+{
+	guint8 bytes[10];
+	guint count = 0;
+
+	/* 7 bits at a time, lowest first */
+	do {
+		bytes[count] = value & 0x7f;
+		value >>= 7;
+		if (value != 0) {
+			bytes[count] |= 0x80;
+		}
+		++count;
+	} while (value != 0);
+
+	g_byte_array_append(buffer, bytes, count);
+}
+
+/* small negative numbers stay small */
+static void xfce_usermon_journal_put_signed(GByteArray * buffer,
+					    gint64 value)
+{
+	xfce_usermon_journal_put_varint(buffer,
+					((guint64) value << 1) ^
+					(guint64) (value >> 63));
+}
+
+static void xfce_usermon_journal_put_string(GByteArray * buffer,
+					    const gchar * value,
+					    gsize max_length)
+{
+	gsize length = (value != NULL) ? strnlen(value, max_length) : 0;
+
+	xfce_usermon_journal_put_varint(buffer, length);
+	g_byte_array_append(buffer, (const guint8 *)value, length);
+}
+
+static gboolean xfce_usermon_journal_get_varint(const guint8 ** data,
+						const guint8 * end,
+						guint64 * value)
+{
+	guint shift = 0;
+
+	*value = 0;
+	while ((*data < end) && (shift < 64)) {
+		guint8 byte = *(*data)++;
+
+		*value |= (guint64) (byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return TRUE;
+		}
+		shift += 7;
+	}
+
+	return FALSE;
+}
+
+static gboolean xfce_usermon_journal_get_signed(const guint8 ** data,
+						const guint8 * end,
+						gint64 * value)
+{
+	guint64 encoded;
+
+	if (xfce_usermon_journal_get_varint(data, end, &encoded) == FALSE) {
+		return FALSE;
+	}
+	*value = (gint64) (encoded >> 1) ^ -(gint64) (encoded & 1);
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_journal_get_string(const guint8 ** data,
+						const guint8 * end,
+						const guint8 ** value,
+						gsize * length)
+{
+	guint64 encoded;
+
+	if ((xfce_usermon_journal_get_varint(data, end, &encoded) == FALSE) ||
+	    (encoded > (guint64) (end - *data))) {
+		return FALSE;
+	}
+	*value = *data;
+	*length = (gsize) encoded;
+	*data += encoded;
+
+	return TRUE;
+}
+
+static void xfce_usermon_journal_put_header(GByteArray * buffer,
+					    gint64 time)
+{
+	guint8 header[USERMON_JOURNAL_HEADER_SIZE];
+	gint64 le_time = GINT64_TO_LE(time);
+
+	memcpy(header, USERMON_JOURNAL_MAGIC, 3);
+	header[3] = USERMON_JOURNAL_VERSION;
+	memcpy(header + 4, &le_time, sizeof(le_time));
+	g_byte_array_append(buffer, header, sizeof(header));
+}
+
+static void xfce_usermon_journal_sync_fd(gint fd)
+{
+#ifdef HAVE_FDATASYNC
+	fdatasync(fd);
+#else
+	fsync(fd);
+#endif
+}
+
+static void xfce_usermon_journal_sync(gpointer data, gpointer user_data)
+{
+	gint fd = GPOINTER_TO_INT(data) - 1;
+
+	xfce_usermon_journal_sync_fd(fd);
+	close(fd);
+}
+
+/* the sync waits for the disk, which may take long; a copy of the fd
+ * is synced by the pool unless sync_now is TRUE, so that the segment
+ * can be closed or rotated meanwhile */
+static void xfce_usermon_journal_write(UserMonitorJournal * journal,
+				       gboolean sync_now)
+{
+	const guint8 *data = journal->buffer->data;
+	gsize length = journal->buffer->len;
+
+	while ((journal->fd >= 0) && (length > 0)) {
+		gssize written = write(journal->fd, data, length);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			g_debug("Failed to write the journal: %s",
+				g_strerror(errno));
+			break;
+		}
+		data += written;
+		length -= written;
+	}
+	if ((journal->fd >= 0) && (journal->buffer->len > 0)) {
+		gint fd = -1;
+
+		/* one sync per batch of records */
+		if ((sync_now == FALSE) && (journal->pool == NULL)) {
+			journal->pool =
+			    g_thread_pool_new(xfce_usermon_journal_sync,
+					      journal, 1, FALSE, NULL);
+		}
+		if ((sync_now == FALSE) && (journal->pool != NULL)) {
+			fd = fcntl(journal->fd, F_DUPFD_CLOEXEC, 0);
+		}
+		if (fd >= 0) {
+			g_thread_pool_push(journal->pool,
+					   GINT_TO_POINTER(fd + 1), NULL);
+		} else {
+			xfce_usermon_journal_sync_fd(journal->fd);
+		}
+	}
+	g_byte_array_set_size(journal->buffer, 0);
+}
+
+static void xfce_usermon_journal_rotate(UserMonitorJournal * journal)
+{
+	guint i;
+
+	/* path.N-1 becomes path.N, the oldest one goes */
+	for (i = journal->max_segments; i > 0; --i) {
+		gchar *from = (i > 1) ?
+		    g_strdup_printf("%s.%u", journal->path, i - 1) :
+		    g_strdup(journal->path);
+		gchar *to = g_strdup_printf("%s.%u", journal->path, i);
+
+		g_rename(from, to);
+		g_free(to);
+		g_free(from);
+	}
+	if (journal->max_segments == 0) {
+		g_unlink(journal->path);
+	}
+}
+
+/* returns -1 if another process writes the journal */
+static gint xfce_usermon_journal_lock(const gchar * path)
+{
+	gchar *lock_path = g_strdup_printf("%s.lock", path);
+	gint fd;
+
+	fd = g_open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		g_debug("Failed to open %s: %s", lock_path, g_strerror(errno));
+	} else if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		g_debug("%s is written by another process, running without "
+			"a journal", path);
+		close(fd);
+		fd = -1;
+	}
+	g_free(lock_path);
+
+	return fd;
+}
+
+static void xfce_usermon_journal_open(UserMonitorJournal * journal,
+				      gint64 time)
+{
+	journal->fd = g_open(journal->path,
+			     O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	xfce_usermon_journal_put_header(journal->buffer, time);
+	journal->segment_size = USERMON_JOURNAL_HEADER_SIZE;
+	journal->last_time = time;
+}
+
+static gboolean xfce_usermon_journal_flush_later(gpointer user_data)
+{
+	UserMonitorJournal *journal = (UserMonitorJournal *) user_data;
+
+	journal->flush_source_id = 0;
+	xfce_usermon_journal_write(journal, FALSE);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean xfce_usermon_journal_reader_start(UserMonitorJournalReader *
+						  reader, const gchar * path);
+
+static gboolean xfce_usermon_journal_reader_step(UserMonitorJournalReader *
+						 reader,
+						 UserMonitorJournalRecord *
+						 record);
+
+/* the segment left by the last process is appended to, after its last
+ * complete record; returns FALSE if it isn't a journal */
+static gboolean xfce_usermon_journal_reopen(UserMonitorJournal * journal)
+{
+	UserMonitorJournalReader reader;
+	UserMonitorJournalRecord record;
+	gint fd;
+
+	memset(&reader, 0, sizeof(UserMonitorJournalReader));
+	if (g_file_get_contents(journal->path, &reader.contents,
+				&reader.length, NULL) == FALSE) {
+		return FALSE;
+	}
+	if (xfce_usermon_journal_reader_start(&reader, journal->path) ==
+	    FALSE) {
+		g_free(reader.contents);
+		return FALSE;
+	}
+	/* names are only interned when there's a table */
+	while (xfce_usermon_journal_reader_step(&reader, &record) == TRUE) ;
+	g_free(reader.contents);
+
+	fd = g_open(journal->path, O_WRONLY | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return FALSE;
+	}
+	if ((ftruncate(fd, reader.offset) != 0) ||
+	    (lseek(fd, 0, SEEK_END) < 0)) {
+		g_debug("Failed to append to %s: %s", journal->path,
+			g_strerror(errno));
+		close(fd);
+		return FALSE;
+	}
+	journal->fd = fd;
+	journal->segment_size = reader.offset;
+	journal->last_time = reader.last_time;
+	g_debug("Appending to %s at %" G_GSIZE_FORMAT, journal->path,
+		reader.offset);
+
+	return TRUE;
+}
+
+UserMonitorJournal *xfce_usermon_journal_new(const gchar * path,
+					     gsize max_segment_size,
+					     guint max_segments)
+{
+	UserMonitorJournal *journal;
+	struct stat path_stat;
+
+	journal = g_slice_new0(UserMonitorJournal);
+	journal->path = g_strdup(path);
+	journal->max_segment_size =
+	    MAX(max_segment_size, USERMON_JOURNAL_HEADER_SIZE * 2);
+	journal->max_segments = max_segments;
+	journal->buffer = g_byte_array_sized_new(USERMON_JOURNAL_BUFFER_SIZE);
+	journal->record = g_byte_array_sized_new(256);
+	journal->flush_source_id = 0;
+	journal->pool = NULL;
+	journal->fd = -1;
+	/* two writers would truncate and interleave each other's records */
+	journal->lock_fd = xfce_usermon_journal_lock(path);
+	if (journal->lock_fd < 0) {
+		xfce_usermon_journal_free(journal);
+		return NULL;
+	}
+	if (xfce_usermon_journal_reopen(journal) == FALSE) {
+		/* whatever is there is kept, as an older segment */
+		if ((g_stat(path, &path_stat) == 0) &&
+		    (path_stat.st_size > 0)) {
+			xfce_usermon_journal_rotate(journal);
+		}
+		xfce_usermon_journal_open(journal, g_get_real_time());
+	}
+	if (journal->fd < 0) {
+		g_debug("Failed to open %s: %s", path, g_strerror(errno));
+		xfce_usermon_journal_free(journal);
+		return NULL;
+	}
+
+	return journal;
+}
+
+void xfce_usermon_journal_free(UserMonitorJournal * journal)
+{
+	if (journal == NULL) {
+		return;
+	}
+
+	if (journal->flush_source_id > 0) {
+		g_source_remove(journal->flush_source_id);
+	}
+	/* the batches before the last one are synced first */
+	if (journal->pool != NULL) {
+		g_thread_pool_free(journal->pool, FALSE, TRUE);
+	}
+	xfce_usermon_journal_write(journal, TRUE);
+	if (journal->fd >= 0) {
+		close(journal->fd);
+	}
+	if (journal->lock_fd >= 0) {
+		close(journal->lock_fd);
+	}
+	g_byte_array_free(journal->record, TRUE);
+	g_byte_array_free(journal->buffer, TRUE);
+	g_free(journal->path);
+
+	g_slice_free(UserMonitorJournal, journal);
+}
+
+void xfce_usermon_journal_append(UserMonitorJournal * journal,
+				 UserMonitorJournalEvent event, gint64 time,
+				 const UserMonitorScanEntry * entry)
+{
+	GByteArray *record = journal->record;
+	guint8 type = (guint8) event;
+	guint buffer_len;
+
+	g_byte_array_set_size(record, 0);
+	g_byte_array_append(record, &type, 1);
+	xfce_usermon_journal_put_signed(record, time - journal->last_time);
+	xfce_usermon_journal_put_signed(record, entry->login_time -
+					time / G_USEC_PER_SEC);
+	xfce_usermon_journal_put_varint(record, (guint64) entry->key.pid);
+	xfce_usermon_journal_put_varint(record, entry->key.source);
+	xfce_usermon_journal_put_string(record, entry->key.id,
+					sizeof(entry->key.id));
+	xfce_usermon_journal_put_string(record, entry->key.line,
+					sizeof(entry->key.line));
+	xfce_usermon_journal_put_string(record, entry->user_name, G_MAXSIZE);
+	xfce_usermon_journal_put_string(record, entry->host, G_MAXSIZE);
+
+	/* start a new segment, the time is then relative to its own; the
+	 * length takes up to 10 bytes */
+	if ((journal->segment_size > USERMON_JOURNAL_HEADER_SIZE) &&
+	    (journal->segment_size + record->len + 10 >
+	     journal->max_segment_size)) {
+		xfce_usermon_journal_write(journal, FALSE);
+		if (journal->fd >= 0) {
+			close(journal->fd);
+		}
+		xfce_usermon_journal_rotate(journal);
+		xfce_usermon_journal_open(journal, time);
+		xfce_usermon_journal_append(journal, event, time, entry);
+		return;
+	}
+
+	buffer_len = journal->buffer->len;
+	xfce_usermon_journal_put_varint(journal->buffer, record->len);
+	g_byte_array_append(journal->buffer, record->data, record->len);
+	journal->segment_size += journal->buffer->len - buffer_len;
+	journal->last_time = time;
+	xfce_usermon_stats_count(USERMON_COUNTER_JOURNAL_RECORDS, 1);
+
+	if (journal->buffer->len >= USERMON_JOURNAL_BUFFER_SIZE) {
+		if (journal->flush_source_id > 0) {
+			g_source_remove(journal->flush_source_id);
+			journal->flush_source_id = 0;
+		}
+		xfce_usermon_journal_write(journal, FALSE);
+	} else if (journal->flush_source_id == 0) {
+		journal->flush_source_id =
+		    g_timeout_add(USERMON_JOURNAL_FLUSH_DELAY,
+				  xfce_usermon_journal_flush_later, journal);
+	}
+}
+
+void xfce_usermon_journal_flush(UserMonitorJournal * journal)
+{
+	if (journal->flush_source_id > 0) {
+		g_source_remove(journal->flush_source_id);
+		journal->flush_source_id = 0;
+	}
+	xfce_usermon_journal_write(journal, TRUE);
+}
+
+/* checks the header of the segment loaded, path's */
+static gboolean xfce_usermon_journal_reader_start(UserMonitorJournalReader *
+						  reader, const gchar * path)
+{
+	gint64 le_time;
+
+	if ((reader->length < USERMON_JOURNAL_HEADER_SIZE) ||
+	    (memcmp(reader->contents, USERMON_JOURNAL_MAGIC, 3) != 0) ||
+	    (reader->contents[3] != USERMON_JOURNAL_VERSION)) {
+		g_debug("Skipping %s, not a journal", path);
+		return FALSE;
+	}
+
+	memcpy(&le_time, reader->contents + 4, sizeof(le_time));
+	reader->last_time = GINT64_FROM_LE(le_time);
+	reader->offset = USERMON_JOURNAL_HEADER_SIZE;
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_journal_reader_load(UserMonitorJournalReader *
+						 reader)
+{
+	while (reader->next_path < reader->paths->len) {
+		const gchar *path =
+		    g_ptr_array_index(reader->paths, reader->next_path);
+
+		++reader->next_path;
+		g_free(reader->contents);
+		reader->contents = NULL;
+		if (g_file_get_contents(path, &reader->contents,
+					&reader->length, NULL) == FALSE) {
+			continue;
+		}
+		if (xfce_usermon_journal_reader_start(reader, path) == TRUE) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+UserMonitorJournalReader *xfce_usermon_journal_reader_new(const gchar * path,
+							  UserMonitorNames *
+							  names)
+{
+	UserMonitorJournalReader *reader;
+	GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+	guint i;
+
+	/* path.N is the oldest */
+	for (i = 1;; ++i) {
+		gchar *older_path = g_strdup_printf("%s.%u", path, i);
+
+		if (g_file_test(older_path, G_FILE_TEST_IS_REGULAR) == FALSE) {
+			g_free(older_path);
+			break;
+		}
+		g_ptr_array_insert(paths, 0, older_path);
+	}
+	if (g_file_test(path, G_FILE_TEST_IS_REGULAR) == TRUE) {
+		g_ptr_array_add(paths, g_strdup(path));
+	}
+	if (paths->len == 0) {
+		g_ptr_array_free(paths, TRUE);
+		return NULL;
+	}
+
+	reader = g_slice_new0(UserMonitorJournalReader);
+	reader->names = names;
+	reader->paths = paths;
+	reader->next_path = 0;
+	reader->contents = NULL;
+	reader->length = 0;
+	reader->offset = 0;
+
+	return reader;
+}
+
+void xfce_usermon_journal_reader_free(UserMonitorJournalReader * reader)
+{
+	if (reader == NULL) {
+		return;
+	}
+
+	g_free(reader->contents);
+	g_ptr_array_free(reader->paths, TRUE);
+
+	g_slice_free(UserMonitorJournalReader, reader);
+}
+
+static gboolean xfce_usermon_journal_reader_parse(UserMonitorJournalReader *
+						  reader,
+						  const guint8 * data,
+						  const guint8 * end,
+						  UserMonitorJournalRecord *
+						  record)
+{
+	UserMonitorScanEntry *entry = &record->entry;
+	const guint8 *value;
+	gsize length;
+	guint64 pid, source;
+	gint64 time_delta, login_delta;
+
+	if (data == end) {
+		return FALSE;
+	}
+	record->event = (UserMonitorJournalEvent) * data++;
+	if (((record->event != USERMON_JOURNAL_LOGIN) &&
+	     (record->event != USERMON_JOURNAL_LOGOUT)) ||
+	    (xfce_usermon_journal_get_signed(&data, end, &time_delta) ==
+	     FALSE) ||
+	    (xfce_usermon_journal_get_signed(&data, end, &login_delta) ==
+	     FALSE) ||
+	    (xfce_usermon_journal_get_varint(&data, end, &pid) == FALSE) ||
+	    (xfce_usermon_journal_get_varint(&data, end, &source) == FALSE)) {
+		return FALSE;
+	}
+	record->time = reader->last_time + time_delta;
+	memset(entry, 0, sizeof(UserMonitorScanEntry));
+	entry->key.pid = (pid_t) pid;
+	entry->key.source = (guint32) source;
+	entry->login_time = record->time / G_USEC_PER_SEC + login_delta;
+
+	if (xfce_usermon_journal_get_string(&data, end, &value, &length) ==
+	    FALSE) {
+		return FALSE;
+	}
+	memcpy(entry->key.id, value, MIN(length, sizeof(entry->key.id)));
+	if (xfce_usermon_journal_get_string(&data, end, &value, &length) ==
+	    FALSE) {
+		return FALSE;
+	}
+	memcpy(entry->key.line, value, MIN(length, sizeof(entry->key.line)));
+	if (xfce_usermon_journal_get_string(&data, end, &value, &length) ==
+	    FALSE) {
+		return FALSE;
+	}
+	entry->user_name = (reader->names != NULL) ?
+	    xfce_usermon_names_intern(reader->names, (const gchar *)value,
+				      length) : NULL;
+	if (xfce_usermon_journal_get_string(&data, end, &value, &length) ==
+	    FALSE) {
+		return FALSE;
+	}
+	memcpy(entry->host, value, MIN(length, sizeof(entry->host) - 1));
+
+	reader->last_time = record->time;
+
+	return TRUE;
+}
+
+/* returns FALSE at the end of the segment loaded, or where it was cut
+ * short */
+static gboolean xfce_usermon_journal_reader_step(UserMonitorJournalReader *
+						 reader,
+						 UserMonitorJournalRecord *
+						 record)
+{
+	const guint8 *data = (const guint8 *)reader->contents + reader->offset;
+	const guint8 *end = (const guint8 *)reader->contents + reader->length;
+	guint64 length;
+
+	if ((xfce_usermon_journal_get_varint(&data, end, &length) == FALSE) ||
+	    (length > (guint64) (end - data)) ||
+	    (xfce_usermon_journal_reader_parse(reader, data, data + length,
+					       record) == FALSE)) {
+		return FALSE;
+	}
+	reader->offset = (data + length) - (const guint8 *)reader->contents;
+
+	return TRUE;
+}
+
+gboolean xfce_usermon_journal_reader_next(UserMonitorJournalReader * reader,
+					  UserMonitorJournalRecord * record)
+{
+	while ((reader->contents != NULL) ||
+	       (xfce_usermon_journal_reader_load(reader) == TRUE)) {
+		/* the rest of a segment cut short is skipped */
+		if (xfce_usermon_journal_reader_step(reader, record) == TRUE) {
+			return TRUE;
+		}
+
+		g_free(reader->contents);
+		reader->contents = NULL;
+	}
+
+	return FALSE;
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_JOURNAL_H__
+#define __USER_MONITOR_JOURNAL_H__
+
+#include "usermon-names.h"
+#include "usermon-scan.h"
+
+/* what a record is about */
+G_BEGIN_DECLS typedef enum {
+	USERMON_JOURNAL_LOGIN = 1,
+	USERMON_JOURNAL_LOGOUT
+} UserMonitorJournalEvent;
+
+typedef struct {
+	UserMonitorJournalEvent event;
+	/* when it was seen, in microseconds since the epoch */
+	gint64 time;
+	/* slot is always 0 */
+	UserMonitorScanEntry entry;
+} UserMonitorJournalRecord;
+
+/* an append-only record of the logins and logouts seen; records are
+ * varint encoded and buffered, and written in batches that are synced
+ * on a thread */
+typedef struct _UserMonitorJournal UserMonitorJournal;
+
+/* reads the segments of a journal, oldest first */
+typedef struct _UserMonitorJournalReader UserMonitorJournalReader;
+
+/* once the segment at path reaches max_segment_size bytes, it's renamed
+ * to path.1, path.1 to path.2 and so on, up to path.max_segments; the
+ * segment left by the last process is appended to, after its last
+ * complete record, or rotated if it isn't a journal; returns NULL if
+ * path can't be opened */
+UserMonitorJournal *xfce_usermon_journal_new(const gchar * path,
+					     gsize max_segment_size,
+					     guint max_segments);
+
+/* writes and syncs what's left in the buffer */
+void xfce_usermon_journal_free(UserMonitorJournal * journal);
+
+/* time is in microseconds since the epoch; the record is written
+ * within a second */
+void xfce_usermon_journal_append(UserMonitorJournal * journal,
+				 UserMonitorJournalEvent event, gint64 time,
+				 const UserMonitorScanEntry * entry);
+
+/* writes and syncs now */
+void xfce_usermon_journal_flush(UserMonitorJournal * journal);
+
+/* path is the journal's, its older segments are read before it;
+ * returns NULL if there's none */
+UserMonitorJournalReader *xfce_usermon_journal_reader_new(const gchar * path,
+							  UserMonitorNames *
+							  names);
+
+void xfce_usermon_journal_reader_free(UserMonitorJournalReader * reader);
+
+/* returns FALSE after the last record; a segment cut short, eg by a
+ * crash, ends where the last complete record does */
+gboolean xfce_usermon_journal_reader_next(UserMonitorJournalReader * reader,
+					  UserMonitorJournalRecord * record);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_JOURNAL_H__ */
@@ -0,0 +1,285 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-log.h"
+#include "usermon-stats.h"
+
+/* how long a message may wait in the buffer */
+#define USERMON_LOG_FLUSH_DELAY	(G_USEC_PER_SEC)
+
+struct _UserMonitorLog {
+	gchar *path;
+	gsize max_file_size;
+	guint max_files;
+	/* shared with the worker */
+	GMutex mutex;
+	GCond cond;
+	gchar *buffer;
+	gsize buffer_size;
+	gsize head;
+	gsize length;
+	gint64 first_time;
+	guint dropped_count;
+	gboolean quit;
+	/* only used by the worker */
+	GThread *thread;
+	gint fd;
+	gsize file_size;
+};
+
+static void xfce_usermon_log_open(UserMonitorLog * log)
+{
+	struct stat fd_stat;
+
+	/* append, what was logged before the last start may matter */
+	log->fd = g_open(log->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+			 0644);
+	log->file_size = 0;
+	if ((log->fd >= 0) && (fstat(log->fd, &fd_stat) == 0)) {
+		log->file_size = fd_stat.st_size;
+	}
+}
+
+static void xfce_usermon_log_rotate(UserMonitorLog * log)
+{
+	guint i;
+
+	if (log->fd >= 0) {
+		close(log->fd);
+	}
+
+	/* path.N-1 becomes path.N, the oldest one goes */
+	for (i = log->max_files; i > 0; --i) {
+		gchar *from = (i > 1) ?
+		    g_strdup_printf("%s.%u", log->path, i - 1) :
+		    g_strdup(log->path);
+		gchar *to = g_strdup_printf("%s.%u", log->path, i);
+
+		g_rename(from, to);
+		g_free(to);
+		g_free(from);
+	}
+	if (log->max_files == 0) {
+		g_unlink(log->path);
+	}
+
+	xfce_usermon_log_open(log);
+}
+
+static void xfce_usermon_log_write_chunk(UserMonitorLog * log,
+					 const gchar * chunk, gsize length)
+{
+	if ((log->file_size > 0) &&
+	    (log->file_size + length > log->max_file_size)) {
+		xfce_usermon_log_rotate(log);
+	}
+	if (log->fd < 0) {
+		return;
+	}
+
+	while (length > 0) {
+		gssize written = write(log->fd, chunk, length);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			/* give up on this chunk rather than spin */
+			return;
+		}
+		chunk += written;
+		length -= written;
+		log->file_size += written;
+	}
+}
+
+static gpointer xfce_usermon_log_run(gpointer user_data)
+{
+	UserMonitorLog *log = (UserMonitorLog *) user_data;
+	gboolean quit = FALSE;
+
+	xfce_usermon_log_open(log);
+
+	g_mutex_lock(&log->mutex);
+	while (quit == FALSE) {
+		gsize head, length, first_length;
+		guint dropped_count;
+
+		while ((log->quit == FALSE) && (log->length == 0) &&
+		       (log->dropped_count == 0)) {
+			g_cond_wait(&log->cond, &log->mutex);
+		}
+
+		/* let messages accumulate, unless the buffer fills up */
+		while ((log->quit == FALSE) &&
+		       (log->length < log->buffer_size / 2) &&
+		       (g_cond_wait_until(&log->cond, &log->mutex,
+					  log->first_time +
+					  USERMON_LOG_FLUSH_DELAY) == TRUE)) ;
+
+		quit = log->quit;
+		head = log->head;
+		length = log->length;
+		dropped_count = log->dropped_count;
+		log->dropped_count = 0;
+		g_mutex_unlock(&log->mutex);
+
+		/* writers don't touch what's between head and head + length */
+		first_length = MIN(length, log->buffer_size - head);
+		xfce_usermon_log_write_chunk(log, log->buffer + head,
+					     first_length);
+		if (length > first_length) {
+			xfce_usermon_log_write_chunk(log, log->buffer,
+						     length - first_length);
+		}
+		if (dropped_count > 0) {
+			gchar line[64];
+
+			g_snprintf(line, sizeof(line),
+				   "%-10s %-25s dropped %u messages\n", "LOG",
+				   G_LOG_DOMAIN, dropped_count);
+			xfce_usermon_log_write_chunk(log, line, strlen(line));
+		}
+
+		g_mutex_lock(&log->mutex);
+		log->head = (head + length) % log->buffer_size;
+		log->length -= length;
+		log->first_time = g_get_monotonic_time();
+	}
+	g_mutex_unlock(&log->mutex);
+
+	if (log->fd >= 0) {
+		close(log->fd);
+		log->fd = -1;
+	}
+
+	return NULL;
+}
+
+static void xfce_usermon_log_copy(UserMonitorLog * log, gsize * tail,
+				  const gchar * data, gsize length)
+{
+	gsize first_length = MIN(length, log->buffer_size - *tail);
+
+	memcpy(log->buffer + *tail, data, first_length);
+	memcpy(log->buffer, data + first_length, length - first_length);
+	*tail = (*tail + length) % log->buffer_size;
+}
+
+UserMonitorLog *xfce_usermon_log_new(const gchar * path,
+				     gsize buffer_size,
+				     gsize max_file_size, guint max_files)
+{
+	UserMonitorLog *log = g_slice_new0(UserMonitorLog);
+
+	log->path = g_strdup(path);
+	log->max_file_size = max_file_size;
+	log->max_files = max_files;
+	g_mutex_init(&log->mutex);
+	g_cond_init(&log->cond);
+	log->buffer_size = MAX(buffer_size, 1024);
+	log->buffer = g_malloc(log->buffer_size);
+	log->head = 0;
+	log->length = 0;
+	log->first_time = 0;
+	log->dropped_count = 0;
+	log->quit = FALSE;
+	log->fd = -1;
+	log->file_size = 0;
+
+	log->thread = g_thread_new("usermon-log", xfce_usermon_log_run, log);
+
+	return log;
+}
+
+void xfce_usermon_log_free(UserMonitorLog * log)
+{
+	if (log == NULL) {
+		return;
+	}
+
+	/* stop the worker, it flushes the buffer first */
+	g_mutex_lock(&log->mutex);
+	log->quit = TRUE;
+	g_cond_signal(&log->cond);
+	g_mutex_unlock(&log->mutex);
+	g_thread_join(log->thread);
+
+	g_cond_clear(&log->cond);
+	g_mutex_clear(&log->mutex);
+	g_free(log->buffer);
+	g_free(log->path);
+
+	g_slice_free(UserMonitorLog, log);
+}
+
+void xfce_usermon_log_write(UserMonitorLog * log,
+			    const gchar * prefix,
+			    const gchar * domain, const gchar * message)
+{
+	gchar header[64];
+	gsize header_length, message_length, tail;
+
+	/* the same layout as "%-10s %-25s %s\n" */
+	header_length = g_snprintf(header, sizeof(header), "%-10s %-25s ",
+				   prefix, (domain != NULL) ? domain : "");
+	header_length = MIN(header_length, sizeof(header) - 1);
+	message_length = strlen(message);
+
+	g_mutex_lock(&log->mutex);
+	if (log->length + header_length + message_length + 1 >
+	    log->buffer_size) {
+		++log->dropped_count;
+		g_mutex_unlock(&log->mutex);
+		xfce_usermon_stats_count(USERMON_COUNTER_LOG_MESSAGES_DROPPED,
+					 1);
+		return;
+	}
+
+	tail = (log->head + log->length) % log->buffer_size;
+	xfce_usermon_log_copy(log, &tail, header, header_length);
+	xfce_usermon_log_copy(log, &tail, message, message_length);
+	xfce_usermon_log_copy(log, &tail, "\n", 1);
+
+	/* wake the worker up when there's something to wait for, and
+	 * when it shouldn't wait any longer */
+	if (log->length == 0) {
+		log->first_time = g_get_monotonic_time();
+		g_cond_signal(&log->cond);
+	}
+	log->length += header_length + message_length + 1;
+	if (log->length >= log->buffer_size / 2) {
+		g_cond_signal(&log->cond);
+	}
+	g_mutex_unlock(&log->mutex);
+}
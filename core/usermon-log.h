@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_LOG_H__
+#define __USER_MONITOR_LOG_H__
+
+/* messages are copied to a ring buffer and written to the file in
+ * batches from a worker thread, so that logging never waits for the
+ * disk; when the buffer is full, messages are dropped and counted */
+G_BEGIN_DECLS typedef struct _UserMonitorLog UserMonitorLog;
+
+/* once the file reaches max_file_size bytes, it's renamed to path.1,
+ * path.1 to path.2 and so on, up to path.max_files */
+UserMonitorLog *xfce_usermon_log_new(const gchar * path,
+				     gsize buffer_size,
+				     gsize max_file_size, guint max_files);
+
+/* writes what's left in the buffer */
+void xfce_usermon_log_free(UserMonitorLog * log);
+
+/* safe to call from any thread, doesn't allocate */
+void xfce_usermon_log_write(UserMonitorLog * log,
+			    const gchar * prefix,
+			    const gchar * domain, const gchar * message);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_LOG_H__ */
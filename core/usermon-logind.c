@@ -0,0 +1,343 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "usermon-logind.h"
+
+#define LOGIND_NAME		"org.freedesktop.login1"
+#define LOGIND_PATH		"/org/freedesktop/login1"
+#define LOGIND_MANAGER		"org.freedesktop.login1.Manager"
+#define LOGIND_SESSION		"org.freedesktop.login1.Session"
+#define LOGIND_CALL_TIMEOUT	5000
+
+struct _UserMonitorLogind {
+	GDBusConnection *connection;
+	GCancellable *cancellable;
+	guint subscription_id;
+	UserMonitorNames *names;
+	/* session id to UserMonitorScanEntry; ids aren't reused, so they
+	 * are copied rather than interned */
+	GHashTable *entries;
+	/* ids of sessions whose properties haven't been received yet */
+	GHashTable *pending;
+	guint pending_count;
+	GArray *logins;
+	GArray *logouts;
+	UserMonitorLogindFunc func;
+	gpointer user_data;
+};
+
+typedef struct {
+	UserMonitorLogind *logind;
+	gchar *id;
+} UserMonitorLogindRequest;
+
+static void xfce_usermon_logind_entry_free(gpointer data)
+{
+	g_slice_free(UserMonitorScanEntry, data);
+}
+
+static void xfce_usermon_logind_request_free(UserMonitorLogindRequest *
+					     request)
+{
+	g_free(request->id);
+	g_slice_free(UserMonitorLogindRequest, request);
+}
+
+static void xfce_usermon_logind_emit(UserMonitorLogind * logind)
+{
+	if ((logind->logins->len == 0) && (logind->logouts->len == 0)) {
+		return;
+	}
+
+	logind->func(logind->logins, logind->logouts, logind->user_data);
+
+	g_array_set_size(logind->logins, 0);
+	g_array_set_size(logind->logouts, 0);
+}
+
+static void xfce_usermon_logind_got_properties(GObject * source,
+					       GAsyncResult * result,
+					       gpointer user_data)
+{
+	UserMonitorLogindRequest *request =
+	    (UserMonitorLogindRequest *) user_data;
+	UserMonitorLogind *logind = request->logind;
+	GError *error = NULL;
+	GVariant *reply, *properties;
+	const gchar *user_name = NULL, *host = NULL, *class = NULL;
+	guint64 timestamp = 0;
+	UserMonitorScanEntry *entry;
+
+	reply =
+	    g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result,
+					  &error);
+	if ((reply == NULL) &&
+	    (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ==
+	     TRUE)) {
+		/* logind may be gone already */
+		g_error_free(error);
+		xfce_usermon_logind_request_free(request);
+		return;
+	}
+	--logind->pending_count;
+
+	/* was the session removed in the meantime? */
+	if (g_hash_table_remove(logind->pending, request->id) == FALSE) {
+		g_debug("Session %s is gone", request->id);
+	} else if (reply == NULL) {
+		g_debug("Failed to get the properties of session %s: %s",
+			request->id, error->message);
+	} else {
+		properties = g_variant_get_child_value(reply, 0);
+		g_variant_lookup(properties, "Name", "&s", &user_name);
+		g_variant_lookup(properties, "RemoteHost", "&s", &host);
+		g_variant_lookup(properties, "Class", "&s", &class);
+		g_variant_lookup(properties, "Timestamp", "t", &timestamp);
+
+		/* greeters and the like aren't user sessions */
+		if ((user_name != NULL) && (g_strcmp0(class, "user") == 0)) {
+			entry = g_slice_new0(UserMonitorScanEntry);
+			strncpy(entry->key.line, request->id,
+				sizeof(entry->key.line));
+			entry->user_name =
+			    xfce_usermon_names_intern(logind->names,
+						      user_name, -1);
+			if (host != NULL) {
+				g_strlcpy(entry->host, host,
+					  sizeof(entry->host));
+			}
+			entry->login_time = timestamp / G_USEC_PER_SEC;
+
+			g_hash_table_insert(logind->entries,
+					    g_strdup(request->id), entry);
+			g_array_append_vals(logind->logins, entry, 1);
+		}
+
+		g_variant_unref(properties);
+	}
+
+	if (reply != NULL) {
+		g_variant_unref(reply);
+	} else {
+		g_error_free(error);
+	}
+	xfce_usermon_logind_request_free(request);
+
+	/* report sessions that appeared together in one go */
+	if (logind->pending_count == 0) {
+		xfce_usermon_logind_emit(logind);
+	}
+}
+
+static void xfce_usermon_logind_add(UserMonitorLogind * logind,
+				    const gchar * id,
+				    const gchar * object_path)
+{
+	UserMonitorLogindRequest *request;
+
+	if ((g_hash_table_contains(logind->entries, id) == TRUE) ||
+	    (g_hash_table_contains(logind->pending, id) == TRUE)) {
+		return;
+	}
+
+	g_debug("New session %s", id);
+	g_hash_table_add(logind->pending, g_strdup(id));
+	++logind->pending_count;
+
+	request = g_slice_new0(UserMonitorLogindRequest);
+	request->logind = logind;
+	request->id = g_strdup(id);
+
+	g_dbus_connection_call(logind->connection, LOGIND_NAME, object_path,
+			       "org.freedesktop.DBus.Properties", "GetAll",
+			       g_variant_new("(s)", LOGIND_SESSION),
+			       G_VARIANT_TYPE("(a{sv})"),
+			       G_DBUS_CALL_FLAGS_NONE, LOGIND_CALL_TIMEOUT,
+			       logind->cancellable,
+			       xfce_usermon_logind_got_properties, request);
+}
+
+static void xfce_usermon_logind_remove(UserMonitorLogind * logind,
+				       const gchar * id)
+{
+	UserMonitorScanEntry *entry;
+
+	g_debug("Removed session %s", id);
+	g_hash_table_remove(logind->pending, id);
+
+	entry = g_hash_table_lookup(logind->entries, id);
+	if (entry == NULL) {
+		return;
+	}
+
+	g_array_append_vals(logind->logouts, entry, 1);
+	g_hash_table_remove(logind->entries, id);
+
+	xfce_usermon_logind_emit(logind);
+}
+
+static void xfce_usermon_logind_signal(GDBusConnection * connection,
+				       const gchar * sender_name,
+				       const gchar * object_path,
+				       const gchar * interface_name,
+				       const gchar * signal_name,
+				       GVariant * parameters,
+				       gpointer user_data)
+{
+	UserMonitorLogind *logind = (UserMonitorLogind *) user_data;
+	const gchar *id = NULL, *session_path = NULL;
+
+	if (g_variant_is_of_type(parameters, G_VARIANT_TYPE("(so)")) == FALSE) {
+		return;
+	}
+	g_variant_get(parameters, "(&s&o)", &id, &session_path);
+
+	if (g_strcmp0(signal_name, "SessionNew") == 0) {
+		xfce_usermon_logind_add(logind, id, session_path);
+	} else if (g_strcmp0(signal_name, "SessionRemoved") == 0) {
+		xfce_usermon_logind_remove(logind, id);
+	}
+}
+
+static void xfce_usermon_logind_listed_sessions(GObject * source,
+						GAsyncResult * result,
+						gpointer user_data)
+{
+	UserMonitorLogind *logind;
+	GError *error = NULL;
+	GVariant *reply;
+	GVariantIter *iter;
+	const gchar *id, *session_path;
+
+	reply =
+	    g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result,
+					  &error);
+	if (reply == NULL) {
+		if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED) ==
+		    FALSE) {
+			g_warning("Failed to list sessions: %s",
+				  error->message);
+		}
+		g_error_free(error);
+		return;
+	}
+	logind = (UserMonitorLogind *) user_data;
+
+	g_variant_get(reply, "(a(susso))", &iter);
+	while (g_variant_iter_next(iter, "(&su&s&s&o)", &id, NULL, NULL,
+				   NULL, &session_path) == TRUE) {
+		xfce_usermon_logind_add(logind, id, session_path);
+	}
+	g_variant_iter_free(iter);
+	g_variant_unref(reply);
+}
+
+UserMonitorLogind *xfce_usermon_logind_new(const gchar * address,
+					   UserMonitorNames * names,
+					   UserMonitorLogindFunc func,
+					   gpointer user_data)
+{
+	UserMonitorLogind *logind;
+	GDBusConnection *connection;
+	GError *error = NULL;
+
+	g_debug("xfce_usermon_logind_new %s",
+		(address != NULL) ? address : "system bus");
+	if (address != NULL) {
+		connection = g_dbus_connection_new_for_address_sync(address,
+								    G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+								    |
+								    G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+								    NULL, NULL,
+								    &error);
+	} else {
+		connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+	}
+	if (connection == NULL) {
+		g_debug("Failed to connect to logind's bus: %s",
+			error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	logind = g_slice_new0(UserMonitorLogind);
+	logind->connection = connection;
+	logind->cancellable = g_cancellable_new();
+	logind->names = names;
+	logind->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free,
+						xfce_usermon_logind_entry_free);
+	logind->pending = g_hash_table_new_full(g_str_hash, g_str_equal,
+						g_free, NULL);
+	logind->pending_count = 0;
+	logind->logins = g_array_new(FALSE, FALSE,
+				     sizeof(UserMonitorScanEntry));
+	logind->logouts = g_array_new(FALSE, FALSE,
+				      sizeof(UserMonitorScanEntry));
+	logind->func = func;
+	logind->user_data = user_data;
+
+	/* subscribe first so that no session is missed */
+	logind->subscription_id =
+	    g_dbus_connection_signal_subscribe(connection, LOGIND_NAME,
+					       LOGIND_MANAGER, NULL,
+					       LOGIND_PATH, NULL,
+					       G_DBUS_SIGNAL_FLAGS_NONE,
+					       xfce_usermon_logind_signal,
+					       logind, NULL);
+
+	g_dbus_connection_call(connection, LOGIND_NAME, LOGIND_PATH,
+			       LOGIND_MANAGER, "ListSessions", NULL,
+			       G_VARIANT_TYPE("(a(susso))"),
+			       G_DBUS_CALL_FLAGS_NONE, LOGIND_CALL_TIMEOUT,
+			       logind->cancellable,
+			       xfce_usermon_logind_listed_sessions, logind);
+
+	return logind;
+}
+
+void xfce_usermon_logind_free(UserMonitorLogind * logind)
+{
+	if (logind == NULL) {
+		return;
+	}
+
+	/* pending calls complete later on, without logind */
+	g_cancellable_cancel(logind->cancellable);
+	g_object_unref(logind->cancellable);
+	g_dbus_connection_signal_unsubscribe(logind->connection,
+					     logind->subscription_id);
+	g_object_unref(logind->connection);
+
+	g_hash_table_destroy(logind->entries);
+	g_hash_table_destroy(logind->pending);
+	g_array_free(logind->logins, TRUE);
+	g_array_free(logind->logouts, TRUE);
+
+	g_slice_free(UserMonitorLogind, logind);
+}
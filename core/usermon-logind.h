@@ -0,0 +1,45 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_LOGIND_H__
+#define __USER_MONITOR_LOGIND_H__
+
+#include "usermon-names.h"
+#include "usermon-scan.h"
+
+/* sessions are reported as scan entries, keyed on the logind session
+ * id, so that they can be handled like those found in utmp */
+G_BEGIN_DECLS typedef struct _UserMonitorLogind UserMonitorLogind;
+
+/* logins and logouts are arrays of UserMonitorScanEntry, only valid
+ * for the duration of the call */
+typedef void (*UserMonitorLogindFunc) (const GArray * logins,
+				       const GArray * logouts,
+				       gpointer user_data);
+
+/* address is that of the bus logind is on, the system bus if NULL;
+ * returns NULL if the bus can't be reached */
+UserMonitorLogind *xfce_usermon_logind_new(const gchar * address,
+					   UserMonitorNames * names,
+					   UserMonitorLogindFunc func,
+					   gpointer user_data);
+
+void xfce_usermon_logind_free(UserMonitorLogind * logind);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_LOGIND_H__ */
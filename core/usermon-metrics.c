@@ -0,0 +1,276 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-metrics.h"
+#include "usermon-stats.h"
+
+/* enough for a few dozen users without growing */
+#define USERMON_METRICS_BUFFER_SIZE	8192
+
+struct _UserMonitorMetrics {
+	gchar *path;
+	guint period;
+	/* built in place, then swapped with the content last written */
+	GString *buffer;
+	GString *written;
+	/* monotonic, 0 until the file is first written */
+	gint64 export_time;
+};
+
+static void xfce_usermon_metrics_append_header(GString * buffer,
+					       const gchar * name,
+					       const gchar * type,
+					       const gchar * help)
+{
+	g_string_append_printf(buffer, "# HELP %s %s\n# TYPE %s %s\n",
+			       name, help, name, type);
+}
+
+/* label values escape backslashes, double quotes and new lines */
+static void xfce_usermon_metrics_append_label_value(GString * buffer,
+						    const gchar * value)
+{
+	const gchar *p;
+
+	for (p = value; *p != '\0'; ++p) {
+		if ((*p == '\\') || (*p == '"')) {
+			g_string_append_c(buffer, '\\');
+			g_string_append_c(buffer, *p);
+		} else if (*p == '\n') {
+			g_string_append(buffer, "\\n");
+		} else {
+			g_string_append_c(buffer, *p);
+		}
+	}
+}
+
+static void xfce_usermon_metrics_append_user(const gchar * user_name,
+					     const GPtrArray * user_sessions,
+					     gpointer user_data)
+{
+	GString *buffer = (GString *) user_data;
+
+	g_string_append(buffer, "usermon_user_sessions{user=\"");
+	xfce_usermon_metrics_append_label_value(buffer, user_name);
+	g_string_append_printf(buffer, "\"} %u\n", user_sessions->len);
+}
+
+/* microseconds are written as is, with an exponent, so that the
+ * locale's decimal separator doesn't get in the way */
+static void xfce_usermon_metrics_append_histogram(GString * buffer,
+						  const gchar * name,
+						  UserMonitorHistogram
+						  histogram)
+{
+	guint buckets[USERMON_STATS_BUCKETS];
+	gint64 sum = xfce_usermon_stats_get_histogram(histogram, buckets);
+	guint count = 0;
+	guint i;
+
+	/* the last bucket has no upper bound */
+	for (i = 0; i < USERMON_STATS_BUCKETS - 1; ++i) {
+		count += buckets[i];
+		g_string_append_printf(buffer, "%s_bucket{le=\"%ue-06\"} %u\n",
+				       name, (1U << i) - 1, count);
+	}
+	count += buckets[i];
+	g_string_append_printf(buffer, "%s_bucket{le=\"+Inf\"} %u\n", name,
+			       count);
+	g_string_append_printf(buffer,
+			       "%s_sum %" G_GINT64_FORMAT "e-06\n%s_count %u\n",
+			       name, sum, name, count);
+}
+
+static void xfce_usermon_metrics_build(UserMonitorMetrics * metrics,
+				       UserMonitorSessions * sessions)
+{
+	GString *buffer = metrics->buffer;
+
+	g_string_truncate(buffer, 0);
+
+	xfce_usermon_metrics_append_header(buffer, "usermon_sessions", "gauge",
+					   "Sessions currently open.");
+	g_string_append_printf(buffer, "usermon_sessions %u\n",
+			       xfce_usermon_sessions_get_count(sessions));
+
+	xfce_usermon_metrics_append_header(buffer, "usermon_users", "gauge",
+					   "Users with at least one session.");
+	g_string_append_printf(buffer, "usermon_users %u\n",
+			       xfce_usermon_sessions_get_users_count
+			       (sessions));
+
+	xfce_usermon_metrics_append_header(buffer, "usermon_user_sessions",
+					   "gauge",
+					   "Sessions currently open, per user.");
+	xfce_usermon_sessions_foreach_user(sessions,
+					   xfce_usermon_metrics_append_user,
+					   buffer);
+
+	xfce_usermon_metrics_append_header(buffer, "usermon_logins_total",
+					   "counter",
+					   "Sessions that started.");
+	g_string_append_printf(buffer, "usermon_logins_total %u\n",
+			       xfce_usermon_stats_get_count
+			       (USERMON_COUNTER_LOGINS));
+
+	xfce_usermon_metrics_append_header(buffer, "usermon_logouts_total",
+					   "counter", "Sessions that ended.");
+	g_string_append_printf(buffer, "usermon_logouts_total %u\n",
+			       xfce_usermon_stats_get_count
+			       (USERMON_COUNTER_LOGOUTS));
+
+	xfce_usermon_metrics_append_header(buffer,
+					   "usermon_scan_duration_seconds",
+					   "histogram",
+					   "Time taken to find the sessions that changed.");
+	xfce_usermon_metrics_append_histogram(buffer,
+					      "usermon_scan_duration_seconds",
+					      USERMON_HISTOGRAM_SCAN);
+}
+
+static gboolean xfce_usermon_metrics_write(gint fd, const gchar * data,
+					   gsize size)
+{
+	while (size > 0) {
+		ssize_t written = write(fd, data, size);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		data += written;
+		size -= written;
+	}
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_metrics_save(UserMonitorMetrics * metrics)
+{
+	gchar *temp_path;
+	gboolean saved;
+	gint fd;
+
+	/* the collector only reads *.prom files, so it never sees the
+	 * temporary one */
+	temp_path = g_strdup_printf("%s.XXXXXX", metrics->path);
+	fd = g_mkstemp(temp_path);
+	if (fd < 0) {
+		g_debug("Failed to create %s: %s", temp_path, strerror(errno));
+		g_free(temp_path);
+		return FALSE;
+	}
+
+	/* node_exporter usually runs as another user */
+	saved = (fchmod(fd, 0644) == 0) &&
+	    xfce_usermon_metrics_write(fd, metrics->buffer->str,
+				       metrics->buffer->len);
+	if (close(fd) != 0) {
+		saved = FALSE;
+	}
+
+	if ((saved == FALSE) || (g_rename(temp_path, metrics->path) != 0)) {
+		g_debug("Failed to save %s: %s", metrics->path,
+			strerror(errno));
+		g_unlink(temp_path);
+		saved = FALSE;
+	}
+	g_free(temp_path);
+
+	return saved;
+}
+
+UserMonitorMetrics *xfce_usermon_metrics_new(const gchar * path,
+					     guint period)
+{
+	UserMonitorMetrics *metrics = g_slice_new(UserMonitorMetrics);
+
+	metrics->path = g_strdup(path);
+	metrics->period = period;
+	metrics->buffer = g_string_sized_new(USERMON_METRICS_BUFFER_SIZE);
+	metrics->written = g_string_sized_new(USERMON_METRICS_BUFFER_SIZE);
+	metrics->export_time = 0;
+
+	return metrics;
+}
+
+void xfce_usermon_metrics_free(UserMonitorMetrics * metrics)
+{
+	if (metrics == NULL) {
+		return;
+	}
+
+	g_free(metrics->path);
+	g_string_free(metrics->buffer, TRUE);
+	g_string_free(metrics->written, TRUE);
+	g_slice_free(UserMonitorMetrics, metrics);
+}
+
+gboolean xfce_usermon_metrics_export(UserMonitorMetrics * metrics,
+				     UserMonitorSessions * sessions,
+				     gboolean sessions_changed)
+{
+	gint64 now = g_get_monotonic_time();
+	GString *written;
+
+	/* scans alone change the statistics every time */
+	if ((sessions_changed == FALSE) && (metrics->export_time > 0) &&
+	    (now - metrics->export_time <
+	     (gint64) metrics->period * G_USEC_PER_SEC)) {
+		return FALSE;
+	}
+	metrics->export_time = now;
+
+	xfce_usermon_metrics_build(metrics, sessions);
+	if ((metrics->written->len == metrics->buffer->len) &&
+	    (memcmp(metrics->written->str, metrics->buffer->str,
+		    metrics->buffer->len) == 0)) {
+		return FALSE;
+	}
+
+	if (xfce_usermon_metrics_save(metrics) == FALSE) {
+		/* try again next time */
+		g_string_truncate(metrics->written, 0);
+		return FALSE;
+	}
+	g_debug("Exported %" G_GSIZE_FORMAT " bytes of metrics to %s",
+		metrics->buffer->len, metrics->path);
+
+	/* keep what was written to compare with next time */
+	written = metrics->written;
+	metrics->written = metrics->buffer;
+	metrics->buffer = written;
+
+	return TRUE;
+}
@@ -0,0 +1,43 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_METRICS_H__
+#define __USER_MONITOR_METRICS_H__
+
+#include "usermon-sessions.h"
+
+/* exports the sessions and the statistics in the Prometheus text
+ * format, to a file read by node_exporter's textfile collector */
+G_BEGIN_DECLS typedef struct _UserMonitorMetrics UserMonitorMetrics;
+
+/* the file at path is replaced atomically, and only when its content
+ * would change; when only the statistics changed, it's replaced at
+ * most every period seconds */
+UserMonitorMetrics *xfce_usermon_metrics_new(const gchar * path,
+					     guint period);
+
+void xfce_usermon_metrics_free(UserMonitorMetrics * metrics);
+
+/* sessions_changed is TRUE if sessions started or ended since the last
+ * call; returns TRUE if the file was replaced */
+gboolean xfce_usermon_metrics_export(UserMonitorMetrics * metrics,
+				     UserMonitorSessions * sessions,
+				     gboolean sessions_changed);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_METRICS_H__ */
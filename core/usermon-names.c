@@ -0,0 +1,97 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-names.h"
+#include "usermon-stats.h"
+
+struct _UserMonitorNames {
+	/* the arena */
+	GStringChunk *chunk;
+	/* strings in the arena */
+	GHashTable *set;
+};
+
+UserMonitorNames *xfce_usermon_names_new(void)
+{
+	UserMonitorNames *names = g_slice_new0(UserMonitorNames);
+
+	names->chunk = g_string_chunk_new(4096);
+	names->set = g_hash_table_new(g_str_hash, g_str_equal);
+
+	return names;
+}
+
+void xfce_usermon_names_free(UserMonitorNames * names)
+{
+	if (names == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy(names->set);
+	g_string_chunk_free(names->chunk);
+
+	g_slice_free(UserMonitorNames, names);
+}
+
+const gchar *xfce_usermon_names_intern(UserMonitorNames * names,
+				       const gchar * name, gssize length)
+{
+	gchar buffer[USERMON_NAMES_MAX_LENGTH + 1];
+	gchar *interned;
+
+	if (name == NULL) {
+		return NULL;
+	}
+
+	/* terminate the name without allocating */
+	if (length < 0) {
+		g_strlcpy(buffer, name, sizeof(buffer));
+	} else {
+		length = MIN(length, USERMON_NAMES_MAX_LENGTH);
+		memset(buffer, 0, length + 1);
+		strncpy(buffer, name, length);
+	}
+
+	interned = g_hash_table_lookup(names->set, buffer);
+	if (interned == NULL) {
+		interned = g_string_chunk_insert(names->chunk, buffer);
+		g_hash_table_add(names->set, interned);
+		xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 1);
+	}
+
+	return interned;
+}
+
+const gchar *xfce_usermon_names_lookup(UserMonitorNames * names,
+				       const gchar * name)
+{
+	if (name == NULL) {
+		return NULL;
+	}
+
+	return g_hash_table_lookup(names->set, name);
+}
@@ -0,0 +1,43 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_NAMES_H__
+#define __USER_MONITOR_NAMES_H__
+
+/* longer names are truncated */
+#define USERMON_NAMES_MAX_LENGTH	256
+
+/* interned strings live as long as the pool, and can be compared
+ * by pointer; only user names are interned for the whole run, hosts
+ * and logind session ids come and go and are copied instead */
+G_BEGIN_DECLS typedef struct _UserMonitorNames UserMonitorNames;
+
+UserMonitorNames *xfce_usermon_names_new(void);
+
+void xfce_usermon_names_free(UserMonitorNames * names);
+
+/* name doesn't need to be terminated if length isn't -1 */
+const gchar *xfce_usermon_names_intern(UserMonitorNames * names,
+				       const gchar * name, gssize length);
+
+/* returns NULL if name was never interned */
+const gchar *xfce_usermon_names_lookup(UserMonitorNames * names,
+				       const gchar * name);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_NAMES_H__ */
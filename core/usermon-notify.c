@@ -0,0 +1,312 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "usermon-notify.h"
+#include "usermon-stats.h"
+
+#define NOTIFICATIONS_NAME	"org.freedesktop.Notifications"
+#define NOTIFICATIONS_PATH	"/org/freedesktop/Notifications"
+
+typedef struct {
+	UserMonitorUrgency urgency;
+	gchar *summary;
+	gchar *body;
+	gint timeout;
+	gint64 post_time;
+} UserMonitorNotification;
+
+struct _UserMonitorNotifier {
+	gchar *app_name;
+	gchar *icon;
+	guint queue_size;
+	guint call_timeout;
+	/* shared with the worker */
+	GMutex mutex;
+	GQueue queue;
+	guint dropped_count;
+	/* only used by the worker */
+	GThread *thread;
+	GMainContext *context;
+	GMainLoop *loop;
+	GDBusConnection *connection;
+	gboolean in_flight;
+	guint32 last_id;
+	UserMonitorNotification *current;
+};
+
+static void xfce_usermon_notification_free(UserMonitorNotification *
+					   notification)
+{
+	if (notification == NULL) {
+		return;
+	}
+
+	g_free(notification->summary);
+	g_free(notification->body);
+	g_slice_free(UserMonitorNotification, notification);
+}
+
+static gboolean xfce_usermon_notifier_send_next(gpointer user_data);
+
+static void xfce_usermon_notifier_sent(GObject * source,
+				       GAsyncResult * result,
+				       gpointer user_data)
+{
+	UserMonitorNotifier *notifier = (UserMonitorNotifier *) user_data;
+	GError *error = NULL;
+	GVariant *reply;
+	gint64 latency;
+	guint queued_count, dropped_count;
+
+	reply =
+	    g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result,
+					  &error);
+	latency = g_get_monotonic_time() - notifier->current->post_time;
+	xfce_usermon_stats_record(USERMON_HISTOGRAM_NOTIFICATION, latency);
+	latency /= 1000;
+
+	g_mutex_lock(&notifier->mutex);
+	queued_count = notifier->queue.length;
+	dropped_count = notifier->dropped_count;
+	g_mutex_unlock(&notifier->mutex);
+
+	if (reply != NULL) {
+		g_variant_get(reply, "(u)", &notifier->last_id);
+		g_variant_unref(reply);
+		xfce_usermon_stats_count(USERMON_COUNTER_NOTIFICATIONS_SENT, 1);
+
+		g_debug("Delivered notification %u after %ld ms, "
+			"%d queued, %d dropped so far", notifier->last_id,
+			(glong) latency, queued_count, dropped_count);
+	} else {
+		g_debug("Failed to deliver notification after %ld ms, "
+			"%d queued, %d dropped so far: %s", (glong) latency,
+			queued_count, dropped_count, error->message);
+		g_error_free(error);
+		xfce_usermon_stats_count(USERMON_COUNTER_NOTIFICATIONS_DROPPED,
+					 1);
+
+		/* the popup may be gone with the daemon */
+		notifier->last_id = 0;
+	}
+
+	xfce_usermon_notification_free(notifier->current);
+	notifier->current = NULL;
+	notifier->in_flight = FALSE;
+
+	xfce_usermon_notifier_send_next(notifier);
+}
+
+static gboolean xfce_usermon_notifier_send_next(gpointer user_data)
+{
+	UserMonitorNotifier *notifier = (UserMonitorNotifier *) user_data;
+	GVariantBuilder hints;
+	guchar urgency;
+
+	/* one call at a time */
+	if ((notifier->in_flight == TRUE) || (notifier->connection == NULL)) {
+		return G_SOURCE_REMOVE;
+	}
+
+	g_mutex_lock(&notifier->mutex);
+	notifier->current = g_queue_pop_head(&notifier->queue);
+	g_mutex_unlock(&notifier->mutex);
+
+	if (notifier->current == NULL) {
+		return G_SOURCE_REMOVE;
+	}
+
+	switch (notifier->current->urgency) {
+	case USERMON_URGENCY_LOW:
+		urgency = 0;
+		break;
+	case USERMON_URGENCY_CRITICAL:
+		urgency = 2;
+		break;
+	default:
+		urgency = 1;
+		break;
+	}
+	g_variant_builder_init(&hints, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add(&hints, "{sv}", "urgency",
+			      g_variant_new_byte(urgency));
+
+	notifier->in_flight = TRUE;
+	g_dbus_connection_call(notifier->connection,
+			       NOTIFICATIONS_NAME, NOTIFICATIONS_PATH,
+			       NOTIFICATIONS_NAME, "Notify",
+			       g_variant_new("(susssasa{sv}i)",
+					     notifier->app_name,
+					     notifier->last_id,
+					     notifier->icon,
+					     notifier->current->summary,
+					     notifier->current->body,
+					     NULL, &hints,
+					     notifier->current->timeout),
+			       G_VARIANT_TYPE("(u)"),
+			       G_DBUS_CALL_FLAGS_NONE,
+			       notifier->call_timeout, NULL,
+			       xfce_usermon_notifier_sent, notifier);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* always runs func in the worker, even before its loop is started */
+static void xfce_usermon_notifier_invoke(UserMonitorNotifier * notifier,
+					 GSourceFunc func)
+{
+	GSource *source = g_idle_source_new();
+
+	g_source_set_callback(source, func, notifier, NULL);
+	g_source_attach(source, notifier->context);
+	g_source_unref(source);
+}
+
+static gboolean xfce_usermon_notifier_quit(gpointer user_data)
+{
+	UserMonitorNotifier *notifier = (UserMonitorNotifier *) user_data;
+
+	g_main_loop_quit(notifier->loop);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer xfce_usermon_notifier_run(gpointer user_data)
+{
+	UserMonitorNotifier *notifier = (UserMonitorNotifier *) user_data;
+	GError *error = NULL;
+
+	/* replies are dispatched in this thread */
+	g_main_context_push_thread_default(notifier->context);
+
+	notifier->connection =
+	    g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+	if (notifier->connection == NULL) {
+		g_warning("Failed to connect to the session bus: %s",
+			  error->message);
+		g_error_free(error);
+	}
+
+	g_main_loop_run(notifier->loop);
+
+	if (notifier->connection != NULL) {
+		g_object_unref(notifier->connection);
+		notifier->connection = NULL;
+	}
+	g_main_context_pop_thread_default(notifier->context);
+
+	return NULL;
+}
+
+UserMonitorNotifier *xfce_usermon_notifier_new(const gchar * app_name,
+					       const gchar * icon,
+					       guint queue_size,
+					       guint call_timeout)
+{
+	UserMonitorNotifier *notifier = g_slice_new0(UserMonitorNotifier);
+
+	notifier->app_name = g_strdup(app_name);
+	notifier->icon = g_strdup(icon);
+	notifier->queue_size = MAX(queue_size, 1);
+	notifier->call_timeout = call_timeout;
+	g_mutex_init(&notifier->mutex);
+	g_queue_init(&notifier->queue);
+	notifier->dropped_count = 0;
+	notifier->context = g_main_context_new();
+	notifier->loop = g_main_loop_new(notifier->context, FALSE);
+	notifier->connection = NULL;
+	notifier->in_flight = FALSE;
+	notifier->last_id = 0;
+	notifier->current = NULL;
+
+	notifier->thread =
+	    g_thread_new("usermon-notify", xfce_usermon_notifier_run,
+			 notifier);
+
+	return notifier;
+}
+
+void xfce_usermon_notifier_free(UserMonitorNotifier * notifier)
+{
+	if (notifier == NULL) {
+		return;
+	}
+
+	/* stop the worker */
+	xfce_usermon_notifier_invoke(notifier, xfce_usermon_notifier_quit);
+	g_thread_join(notifier->thread);
+
+	xfce_usermon_notification_free(notifier->current);
+	g_queue_clear_full(&notifier->queue,
+			   (GDestroyNotify) xfce_usermon_notification_free);
+	g_mutex_clear(&notifier->mutex);
+	g_main_loop_unref(notifier->loop);
+	g_main_context_unref(notifier->context);
+	g_free(notifier->app_name);
+	g_free(notifier->icon);
+
+	g_slice_free(UserMonitorNotifier, notifier);
+}
+
+gboolean xfce_usermon_notifier_post(UserMonitorNotifier * notifier,
+				    UserMonitorUrgency urgency,
+				    const gchar * summary,
+				    const gchar * body, gint timeout)
+{
+	UserMonitorNotification *notification;
+	gboolean queued = TRUE;
+	guint queued_count;
+
+	notification = g_slice_new0(UserMonitorNotification);
+	notification->urgency = urgency;
+	notification->summary = g_strdup(summary);
+	notification->body = g_strdup(body);
+	notification->timeout = timeout;
+	notification->post_time = g_get_monotonic_time();
+	xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 3);
+
+	g_mutex_lock(&notifier->mutex);
+	/* make room by dropping the oldest notification */
+	if (notifier->queue.length >= notifier->queue_size) {
+		xfce_usermon_notification_free(g_queue_pop_head
+					       (&notifier->queue));
+		++notifier->dropped_count;
+		xfce_usermon_stats_count(USERMON_COUNTER_NOTIFICATIONS_DROPPED,
+					 1);
+		queued = FALSE;
+	}
+	g_queue_push_tail(&notifier->queue, notification);
+	queued_count = notifier->queue.length;
+	g_mutex_unlock(&notifier->mutex);
+
+	g_debug("Posted notification, %d queued%s", queued_count,
+		(queued == TRUE) ? "" : ", dropped the oldest");
+
+	/* wake the worker up */
+	xfce_usermon_notifier_invoke(notifier,
+				     xfce_usermon_notifier_send_next);
+
+	return queued;
+}
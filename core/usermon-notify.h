@@ -0,0 +1,44 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_NOTIFY_H__
+#define __USER_MONITOR_NOTIFY_H__
+
+#include "usermon-dispatch.h"
+
+/* notifications are sent to the notification daemon from a worker
+ * thread, so that a slow or hung daemon never blocks the caller */
+G_BEGIN_DECLS typedef struct _UserMonitorNotifier UserMonitorNotifier;
+
+UserMonitorNotifier *xfce_usermon_notifier_new(const gchar * app_name,
+					       const gchar * icon,
+					       guint queue_size,
+					       guint call_timeout);
+
+void xfce_usermon_notifier_free(UserMonitorNotifier * notifier);
+
+/* the notification replaces the previous one if it's still shown;
+ * returns FALSE if the queue was full and the oldest notification
+ * had to be dropped */
+gboolean xfce_usermon_notifier_post(UserMonitorNotifier * notifier,
+				    UserMonitorUrgency urgency,
+				    const gchar * summary,
+				    const gchar * body, gint timeout);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_NOTIFY_H__ */
@@ -0,0 +1,283 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <glib.h>
+
+#include "usermon-origins.h"
+#include "usermon-stats.h"
+
+typedef struct {
+	gchar *address;
+	/* NULL if the address has no name */
+	gchar *name;
+	/* when it's asked again, if it has no name */
+	gint64 expiry;
+	/* queued or being resolved, not in the LRU list yet */
+	gboolean pending;
+	GList link;
+} UserMonitorOrigin;
+
+struct _UserMonitorOrigins {
+	guint capacity;
+	guint max_threads;
+	gint64 negative_ttl;
+	UserMonitorOriginsFunc func;
+	gpointer user_data;
+	/* UserMonitorOrigin, keyed by address; only used in the main loop */
+	GHashTable *origins;
+	/* resolved origins, most recently used first */
+	GQueue lru;
+	GThreadPool *pool;
+	/* shared with the workers */
+	GMutex mutex;
+	GPtrArray *done;
+	guint done_source_id;
+	gboolean stopping;
+};
+
+typedef struct {
+	gchar *address;
+	gchar *name;
+} UserMonitorOriginsRequest;
+
+static void xfce_usermon_origins_free_origin(gpointer data)
+{
+	UserMonitorOrigin *origin = (UserMonitorOrigin *) data;
+
+	g_free(origin->address);
+	g_free(origin->name);
+	g_slice_free(UserMonitorOrigin, origin);
+}
+
+static void xfce_usermon_origins_free_request(gpointer data)
+{
+	UserMonitorOriginsRequest *request = (UserMonitorOriginsRequest *) data;
+
+	g_free(request->address);
+	g_free(request->name);
+	g_slice_free(UserMonitorOriginsRequest, request);
+}
+
+/* getnameinfo() goes through NSS, so /etc/hosts is enough offline */
+static gchar *xfce_usermon_origins_resolve(const gchar * address)
+{
+	struct addrinfo hints, *info = NULL;
+	gchar name[NI_MAXHOST];
+	gchar *result = NULL;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_flags = AI_NUMERICHOST;
+	if (getaddrinfo(address, NULL, &hints, &info) != 0) {
+		return NULL;
+	}
+	if (getnameinfo(info->ai_addr, info->ai_addrlen, name, sizeof(name),
+			NULL, 0, NI_NAMEREQD) == 0) {
+		result = g_strdup(name);
+	}
+	freeaddrinfo(info);
+
+	return result;
+}
+
+static gboolean xfce_usermon_origins_apply(gpointer user_data)
+{
+	UserMonitorOrigins *origins = (UserMonitorOrigins *) user_data;
+	GPtrArray *done;
+	gint64 now = g_get_monotonic_time();
+	guint i;
+
+	g_mutex_lock(&origins->mutex);
+	done = origins->done;
+	origins->done =
+	    g_ptr_array_new_with_free_func(xfce_usermon_origins_free_request);
+	origins->done_source_id = 0;
+	g_mutex_unlock(&origins->mutex);
+
+	for (i = 0; i < done->len; ++i) {
+		UserMonitorOriginsRequest *request =
+		    g_ptr_array_index(done, i);
+		UserMonitorOrigin *origin =
+		    g_hash_table_lookup(origins->origins, request->address);
+
+		if (origin == NULL) {
+			continue;
+		}
+		origin->name = request->name;
+		request->name = NULL;
+		origin->expiry = now + origins->negative_ttl;
+		origin->pending = FALSE;
+		g_queue_push_head_link(&origins->lru, &origin->link);
+		g_debug("Resolved %s to %s", origin->address,
+			(origin->name != NULL) ? origin->name : "nothing");
+
+		if (origins->func != NULL) {
+			origins->func(origin->address, origin->name,
+				      origins->user_data);
+		}
+	}
+
+	/* only once told, so that answers can't be dropped unseen */
+	while (origins->lru.length > origins->capacity) {
+		UserMonitorOrigin *oldest = g_queue_peek_tail(&origins->lru);
+
+		g_queue_unlink(&origins->lru, &oldest->link);
+		g_hash_table_remove(origins->origins, oldest->address);
+	}
+
+	g_ptr_array_free(done, TRUE);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void xfce_usermon_origins_work(gpointer data, gpointer user_data)
+{
+	UserMonitorOriginsRequest *request = (UserMonitorOriginsRequest *) data;
+	UserMonitorOrigins *origins = (UserMonitorOrigins *) user_data;
+	gboolean stopping;
+
+	g_mutex_lock(&origins->mutex);
+	stopping = origins->stopping;
+	g_mutex_unlock(&origins->mutex);
+
+	if (stopping == FALSE) {
+		request->name = xfce_usermon_origins_resolve(request->address);
+		xfce_usermon_stats_count(USERMON_COUNTER_ORIGIN_LOOKUPS, 1);
+	}
+
+	g_mutex_lock(&origins->mutex);
+	g_ptr_array_add(origins->done, request);
+	if ((origins->done_source_id == 0) && (origins->stopping == FALSE)) {
+		origins->done_source_id =
+		    g_idle_add(xfce_usermon_origins_apply, origins);
+	}
+	g_mutex_unlock(&origins->mutex);
+}
+
+UserMonitorOrigins *xfce_usermon_origins_new(guint capacity,
+					     guint max_threads,
+					     guint negative_ttl,
+					     UserMonitorOriginsFunc func,
+					     gpointer user_data)
+{
+	UserMonitorOrigins *origins = g_slice_new0(UserMonitorOrigins);
+
+	origins->capacity = MAX(capacity, 1);
+	origins->max_threads = MAX(max_threads, 1);
+	origins->negative_ttl = (gint64) negative_ttl * G_USEC_PER_SEC;
+	origins->func = func;
+	origins->user_data = user_data;
+	origins->origins =
+	    g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+				  xfce_usermon_origins_free_origin);
+	g_queue_init(&origins->lru);
+	origins->pool = NULL;
+	g_mutex_init(&origins->mutex);
+	origins->done =
+	    g_ptr_array_new_with_free_func(xfce_usermon_origins_free_request);
+	origins->done_source_id = 0;
+	origins->stopping = FALSE;
+
+	return origins;
+}
+
+void xfce_usermon_origins_free(UserMonitorOrigins * origins)
+{
+	if (origins == NULL) {
+		return;
+	}
+
+	if (origins->pool != NULL) {
+		g_mutex_lock(&origins->mutex);
+		origins->stopping = TRUE;
+		g_mutex_unlock(&origins->mutex);
+
+		/* only lookups already under way are waited for */
+		g_thread_pool_free(origins->pool, FALSE, TRUE);
+	}
+	if (origins->done_source_id > 0) {
+		g_source_remove(origins->done_source_id);
+	}
+	g_ptr_array_free(origins->done, TRUE);
+	g_mutex_clear(&origins->mutex);
+	g_hash_table_destroy(origins->origins);
+
+	g_slice_free(UserMonitorOrigins, origins);
+}
+
+const gchar *xfce_usermon_origins_lookup(UserMonitorOrigins * origins,
+					 const gchar * host)
+{
+	UserMonitorOrigin *origin;
+	UserMonitorOriginsRequest *request;
+
+	/* names, X displays and the like are shown as they are */
+	if ((host == NULL) || (g_hostname_is_ip_address(host) == FALSE)) {
+		return host;
+	}
+
+	origin = g_hash_table_lookup(origins->origins, host);
+	if ((origin != NULL) && (origin->pending == TRUE)) {
+		return host;
+	}
+	if ((origin != NULL) && ((origin->name != NULL) ||
+				 (g_get_monotonic_time() < origin->expiry))) {
+		if (origins->lru.head != &origin->link) {
+			g_queue_unlink(&origins->lru, &origin->link);
+			g_queue_push_head_link(&origins->lru, &origin->link);
+		}
+		return (origin->name != NULL) ? origin->name : host;
+	}
+
+	if (origin == NULL) {
+		/* one request per address, however many sessions come
+		 * from it */
+		origin = g_slice_new0(UserMonitorOrigin);
+		origin->address = g_strdup(host);
+		origin->name = NULL;
+		origin->link.data = origin;
+		g_hash_table_insert(origins->origins, origin->address, origin);
+	} else {
+		/* no name last time, it's asked again; out of the LRU
+		 * list until then, like new ones */
+		g_queue_unlink(&origins->lru, &origin->link);
+	}
+	origin->pending = TRUE;
+
+	request = g_slice_new0(UserMonitorOriginsRequest);
+	request->address = g_strdup(host);
+	request->name = NULL;
+	if (origins->pool == NULL) {
+		origins->pool =
+		    g_thread_pool_new(xfce_usermon_origins_work, origins,
+				      origins->max_threads, FALSE, NULL);
+	}
+	g_thread_pool_push(origins->pool, request, NULL);
+
+	return host;
+}
@@ -0,0 +1,51 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_ORIGINS_H__
+#define __USER_MONITOR_ORIGINS_H__
+
+/* turns the addresses sessions come from into host names; lookups
+ * never block, addresses are resolved by worker threads, each once
+ * however many ask for it, and the answers kept in a bounded cache
+ * where the least recently used are dropped first */
+G_BEGIN_DECLS typedef struct _UserMonitorOrigins UserMonitorOrigins;
+
+/* runs in the main loop once address was resolved; name is NULL if it
+ * has none */
+typedef void (*UserMonitorOriginsFunc) (const gchar * address,
+					const gchar * name,
+					gpointer user_data);
+
+/* keeps up to capacity answers; addresses that have no name are asked
+ * again after negative_ttl seconds */
+UserMonitorOrigins *xfce_usermon_origins_new(guint capacity,
+					     guint max_threads,
+					     guint negative_ttl,
+					     UserMonitorOriginsFunc func,
+					     gpointer user_data);
+
+void xfce_usermon_origins_free(UserMonitorOrigins * origins);
+
+/* returns the name of host if known, or host itself, eg until it's
+ * resolved or if it's a name already; the result is valid until the
+ * main loop runs again */
+const gchar *xfce_usermon_origins_lookup(UserMonitorOrigins * origins,
+					 const gchar * host);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_ORIGINS_H__ */
@@ -0,0 +1,389 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "usermon-procs.h"
+#include "usermon-stats.h"
+
+#if defined(HAVE_OPENAT) && defined(HAVE_FDOPENDIR)
+#define USERMON_PROCS_SUPPORTED 1
+#endif
+
+/* fields after the command name in /proc/PID/stat, state being 0 */
+#define USERMON_PROCS_UTIME_FIELD	11
+#define USERMON_PROCS_STIME_FIELD	12
+#define USERMON_PROCS_STARTTIME_FIELD	19
+#define USERMON_PROCS_RSS_FIELD	21
+
+typedef struct {
+	uid_t uid;
+	/* tells a process from another one that reused its pid */
+	guint64 start_time;
+	/* user and system time, in clock ticks */
+	guint64 cpu_ticks;
+	guint generation;
+} UserMonitorProc;
+
+typedef struct {
+	UserMonitorUsage usage;
+	guint64 cpu_ticks;
+} UserMonitorProcsUser;
+
+struct _UserMonitorProcs {
+	gint proc_fd;
+	DIR *dir;
+	/* UserMonitorProc, keyed by pid */
+	GHashTable *procs;
+	/* UserMonitorProcsUser, keyed by uid */
+	GHashTable *users;
+	guint generation;
+	gint64 last_update;
+	glong clock_ticks;
+	glong page_size;
+};
+
+static void xfce_usermon_procs_free_proc(gpointer data)
+{
+	g_slice_free(UserMonitorProc, data);
+}
+
+static void xfce_usermon_procs_free_user(gpointer data)
+{
+	g_slice_free(UserMonitorProcsUser, data);
+}
+
+#ifdef USERMON_PROCS_SUPPORTED
+static gboolean xfce_usermon_procs_read_stat(UserMonitorProcs * procs,
+					     const gchar * pid_name,
+					     guint64 * start_time,
+					     guint64 * cpu_ticks,
+					     guint64 * rss_pages)
+{
+	gchar path[32];
+	gchar buffer[1024];
+	gchar *ptr;
+	gchar *end;
+	guint64 utime = 0, stime = 0;
+	gssize size;
+	guint field = 0;
+	gint fd;
+
+	/* relative to /proc, no path lookup from the root */
+	g_snprintf(path, sizeof(path), "%s/stat", pid_name);
+	fd = openat(procs->proc_fd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return FALSE;
+	}
+	size = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (size <= 0) {
+		return FALSE;
+	}
+	buffer[size] = '\0';
+	xfce_usermon_stats_count(USERMON_COUNTER_PROC_STATS_READ, 1);
+
+	/* the command name may contain anything, including parentheses */
+	ptr = strrchr(buffer, ')');
+	if ((ptr == NULL) || (ptr[1] != ' ')) {
+		return FALSE;
+	}
+	ptr += 2;
+
+	while ((*ptr != '\0') && (field <= USERMON_PROCS_RSS_FIELD)) {
+		guint64 value = g_ascii_strtoull(ptr, &end, 10);
+
+		switch (field) {
+		case USERMON_PROCS_UTIME_FIELD:
+			utime = value;
+			break;
+		case USERMON_PROCS_STIME_FIELD:
+			stime = value;
+			break;
+		case USERMON_PROCS_STARTTIME_FIELD:
+			*start_time = value;
+			break;
+		case USERMON_PROCS_RSS_FIELD:
+			*rss_pages = value;
+			break;
+		default:
+			break;
+		}
+
+		ptr = strchr(ptr, ' ');
+		if (ptr == NULL) {
+			break;
+		}
+		++ptr;
+		++field;
+	}
+	if (field < USERMON_PROCS_RSS_FIELD) {
+		return FALSE;
+	}
+	*cpu_ticks = utime + stime;
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_procs_read_uid(UserMonitorProcs * procs,
+					    const gchar * pid_name,
+					    uid_t * uid)
+{
+	gchar path[32];
+	gchar buffer[4096];
+	gchar *ptr;
+	gchar *end;
+	gssize size;
+	gint fd;
+
+	/* the owner of /proc/PID turns to root for processes that aren't
+	 * dumpable, eg after a setuid, so the real uid is read instead */
+	g_snprintf(path, sizeof(path), "%s/status", pid_name);
+	fd = openat(procs->proc_fd, path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return FALSE;
+	}
+	size = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (size <= 0) {
+		return FALSE;
+	}
+	buffer[size] = '\0';
+
+	/* Uid: real effective saved filesystem */
+	ptr = strstr(buffer, "\nUid:");
+	if (ptr == NULL) {
+		return FALSE;
+	}
+	ptr += strlen("\nUid:");
+	*uid = (uid_t) g_ascii_strtoull(ptr, &end, 10);
+
+	return (end != ptr);
+}
+
+static UserMonitorProcsUser *xfce_usermon_procs_get_user(UserMonitorProcs *
+							 procs, uid_t uid)
+{
+	UserMonitorProcsUser *user =
+	    g_hash_table_lookup(procs->users, GUINT_TO_POINTER(uid));
+
+	if (user == NULL) {
+		user = g_slice_new0(UserMonitorProcsUser);
+		xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 1);
+		user->usage.uid = uid;
+		g_hash_table_insert(procs->users, GUINT_TO_POINTER(uid), user);
+	}
+
+	return user;
+}
+
+static void xfce_usermon_procs_account(UserMonitorProcs * procs,
+				       const gchar * pid_name)
+{
+	gpointer pid =
+	    GUINT_TO_POINTER((guint) g_ascii_strtoull(pid_name, NULL, 10));
+	UserMonitorProc *proc = g_hash_table_lookup(procs->procs, pid);
+	UserMonitorProcsUser *user;
+	guint64 start_time = 0, cpu_ticks = 0, rss_pages = 0;
+	guint64 delta;
+	uid_t uid;
+
+	if (xfce_usermon_procs_read_stat(procs, pid_name, &start_time,
+					 &cpu_ticks, &rss_pages) == FALSE) {
+		/* exited meanwhile */
+		return;
+	}
+
+	if ((proc != NULL) && (proc->start_time != start_time)) {
+		g_hash_table_remove(procs->procs, pid);
+		proc = NULL;
+	}
+
+	if (proc == NULL) {
+		/* the owner doesn't change, only read it once */
+		if (xfce_usermon_procs_read_uid(procs, pid_name, &uid) ==
+		    FALSE) {
+			return;
+		}
+
+		proc = g_slice_new0(UserMonitorProc);
+		xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 1);
+		proc->uid = uid;
+		proc->start_time = start_time;
+		/* on the first pass, all there is is a baseline */
+		proc->cpu_ticks = (procs->generation > 1) ? 0 : cpu_ticks;
+		g_hash_table_insert(procs->procs, pid, proc);
+	}
+
+	delta = (cpu_ticks > proc->cpu_ticks) ? cpu_ticks - proc->cpu_ticks : 0;
+	proc->cpu_ticks = cpu_ticks;
+	proc->generation = procs->generation;
+
+	user = xfce_usermon_procs_get_user(procs, proc->uid);
+	++user->usage.processes_count;
+	user->cpu_ticks += delta;
+	user->usage.rss += rss_pages * procs->page_size;
+}
+#endif
+
+UserMonitorProcs *xfce_usermon_procs_new(const gchar * proc_path)
+{
+#ifdef USERMON_PROCS_SUPPORTED
+	UserMonitorProcs *procs;
+	gint proc_fd;
+	gint dir_fd;
+	DIR *dir;
+
+	proc_fd = open(proc_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (proc_fd < 0) {
+		g_debug("Can't open %s", proc_path);
+		return NULL;
+	}
+	dir_fd = dup(proc_fd);
+	dir = (dir_fd >= 0) ? fdopendir(dir_fd) : NULL;
+	if (dir == NULL) {
+		if (dir_fd >= 0) {
+			close(dir_fd);
+		}
+		close(proc_fd);
+		return NULL;
+	}
+
+	procs = g_slice_new0(UserMonitorProcs);
+	procs->proc_fd = proc_fd;
+	procs->dir = dir;
+	procs->procs = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					     NULL,
+					     xfce_usermon_procs_free_proc);
+	procs->users = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					     NULL,
+					     xfce_usermon_procs_free_user);
+	procs->generation = 0;
+	procs->last_update = 0;
+	procs->clock_ticks = MAX(sysconf(_SC_CLK_TCK), 1);
+	procs->page_size = MAX(sysconf(_SC_PAGESIZE), 1);
+
+	return procs;
+#else
+	return NULL;
+#endif
+}
+
+void xfce_usermon_procs_free(UserMonitorProcs * procs)
+{
+	if (procs == NULL) {
+		return;
+	}
+
+	closedir(procs->dir);
+	close(procs->proc_fd);
+	g_hash_table_destroy(procs->procs);
+	g_hash_table_destroy(procs->users);
+
+	g_slice_free(UserMonitorProcs, procs);
+}
+
+gboolean xfce_usermon_procs_update(UserMonitorProcs * procs)
+{
+#ifdef USERMON_PROCS_SUPPORTED
+	GHashTableIter iter;
+	gpointer value;
+	struct dirent *entry;
+	gint64 now = g_get_monotonic_time();
+	gdouble elapsed;
+
+	++procs->generation;
+	xfce_usermon_stats_count(USERMON_COUNTER_PROC_PASSES, 1);
+
+	/* totals are made again on each pass */
+	g_hash_table_iter_init(&iter, procs->users);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		UserMonitorProcsUser *user = (UserMonitorProcsUser *) value;
+
+		user->usage.processes_count = 0;
+		user->usage.rss = 0;
+		user->cpu_ticks = 0;
+	}
+
+	/* listing /proc is the only way to find new processes */
+	rewinddir(procs->dir);
+	while ((entry = readdir(procs->dir)) != NULL) {
+		if (g_ascii_isdigit(entry->d_name[0]) == TRUE) {
+			xfce_usermon_procs_account(procs, entry->d_name);
+		}
+	}
+
+	/* forget processes that exited, and users left with none */
+	g_hash_table_iter_init(&iter, procs->procs);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		if (((UserMonitorProc *) value)->generation !=
+		    procs->generation) {
+			g_hash_table_iter_remove(&iter);
+		}
+	}
+
+	elapsed = (procs->last_update > 0) ?
+	    (gdouble) (now - procs->last_update) / G_USEC_PER_SEC : 0.0;
+	procs->last_update = now;
+
+	g_hash_table_iter_init(&iter, procs->users);
+	while (g_hash_table_iter_next(&iter, NULL, &value) == TRUE) {
+		UserMonitorProcsUser *user = (UserMonitorProcsUser *) value;
+
+		if (user->usage.processes_count == 0) {
+			g_hash_table_iter_remove(&iter);
+			continue;
+		}
+		user->usage.cpu_percent = (elapsed > 0.0) ?
+		    100.0 * user->cpu_ticks / (elapsed * procs->clock_ticks) :
+		    0.0;
+	}
+
+	g_debug("Accounted for %d processes of %d users",
+		g_hash_table_size(procs->procs),
+		g_hash_table_size(procs->users));
+
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+const UserMonitorUsage *xfce_usermon_procs_get_usage(UserMonitorProcs *
+						     procs, uid_t uid)
+{
+	UserMonitorProcsUser *user =
+	    g_hash_table_lookup(procs->users, GUINT_TO_POINTER(uid));
+
+	return (user != NULL) ? &user->usage : NULL;
+}
+
+guint xfce_usermon_procs_get_count(UserMonitorProcs * procs)
+{
+	return g_hash_table_size(procs->procs);
+}
@@ -0,0 +1,56 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_PROCS_H__
+#define __USER_MONITOR_PROCS_H__
+
+#include <sys/types.h>
+
+#define USERMON_PROC_PATH	"/proc"
+
+/* what a user's processes used over the last pass */
+G_BEGIN_DECLS typedef struct {
+	uid_t uid;
+	guint processes_count;
+	/* 100 for each busy core */
+	gdouble cpu_percent;
+	/* resident memory, in bytes */
+	guint64 rss;
+} UserMonitorUsage;
+
+/* CPU and memory used by each user, from /proc; processes are
+ * remembered between passes, so that only the stat of those already
+ * known and the status of new ones are read */
+typedef struct _UserMonitorProcs UserMonitorProcs;
+
+/* returns NULL if proc_path can't be read this way */
+UserMonitorProcs *xfce_usermon_procs_new(const gchar * proc_path);
+
+void xfce_usermon_procs_free(UserMonitorProcs * procs);
+
+/* CPU usage is measured from one pass to the next */
+gboolean xfce_usermon_procs_update(UserMonitorProcs * procs);
+
+/* returns NULL if the user has no process */
+const UserMonitorUsage *xfce_usermon_procs_get_usage(UserMonitorProcs *
+						     procs, uid_t uid);
+
+guint xfce_usermon_procs_get_count(UserMonitorProcs * procs);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_PROCS_H__ */
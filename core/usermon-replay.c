@@ -0,0 +1,123 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-journal.h"
+#include "usermon-replay.h"
+
+struct _UserMonitorReplay {
+	UserMonitorJournalReader *reader;
+	gdouble speed;
+	UserMonitorReplayFunc func;
+	UserMonitorReplayDoneFunc done_func;
+	gpointer user_data;
+	/* the record that starts the next batch */
+	UserMonitorJournalRecord next;
+	gboolean has_next;
+	GArray *logins;
+	GArray *logouts;
+	guint source_id;
+};
+
+static gboolean xfce_usermon_replay_play(gpointer user_data)
+{
+	UserMonitorReplay *replay = (UserMonitorReplay *) user_data;
+	gint64 batch_time = replay->next.time;
+	gint64 delay = 0;
+
+	/* records seen at once are reported at once */
+	g_array_set_size(replay->logins, 0);
+	g_array_set_size(replay->logouts, 0);
+	while ((replay->has_next == TRUE) && (replay->next.time == batch_time)) {
+		g_array_append_val((replay->next.event ==
+				    USERMON_JOURNAL_LOGIN) ? replay->logins :
+				   replay->logouts, replay->next.entry);
+		replay->has_next =
+		    xfce_usermon_journal_reader_next(replay->reader,
+						     &replay->next);
+	}
+	replay->func(replay->logins, replay->logouts, replay->user_data);
+
+	if (replay->has_next == FALSE) {
+		replay->source_id = 0;
+		replay->done_func(replay->user_data);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (replay->speed > 0) {
+		delay = (gint64) ((replay->next.time - batch_time) /
+				  (replay->speed * 1000));
+	}
+	replay->source_id =
+	    g_timeout_add((guint) CLAMP(delay, 0, G_MAXUINT),
+			  xfce_usermon_replay_play, replay);
+
+	return G_SOURCE_REMOVE;
+}
+
+UserMonitorReplay *xfce_usermon_replay_new(const gchar * path, gdouble speed,
+					   UserMonitorNames * names,
+					   UserMonitorReplayFunc func,
+					   UserMonitorReplayDoneFunc done_func,
+					   gpointer user_data)
+{
+	UserMonitorJournalReader *reader =
+	    xfce_usermon_journal_reader_new(path, names);
+	UserMonitorReplay *replay;
+
+	if (reader == NULL) {
+		return NULL;
+	}
+
+	replay = g_slice_new0(UserMonitorReplay);
+	replay->reader = reader;
+	replay->speed = speed;
+	replay->func = func;
+	replay->done_func = done_func;
+	replay->user_data = user_data;
+	replay->has_next =
+	    xfce_usermon_journal_reader_next(reader, &replay->next);
+	replay->logins = g_array_new(FALSE, FALSE,
+				     sizeof(UserMonitorScanEntry));
+	replay->logouts = g_array_new(FALSE, FALSE,
+				      sizeof(UserMonitorScanEntry));
+	replay->source_id = g_idle_add(xfce_usermon_replay_play, replay);
+
+	return replay;
+}
+
+void xfce_usermon_replay_free(UserMonitorReplay * replay)
+{
+	if (replay == NULL) {
+		return;
+	}
+
+	if (replay->source_id > 0) {
+		g_source_remove(replay->source_id);
+	}
+	xfce_usermon_journal_reader_free(replay->reader);
+	g_array_free(replay->logins, TRUE);
+	g_array_free(replay->logouts, TRUE);
+
+	g_slice_free(UserMonitorReplay, replay);
+}
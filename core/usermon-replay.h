@@ -0,0 +1,49 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_REPLAY_H__
+#define __USER_MONITOR_REPLAY_H__
+
+#include "usermon-names.h"
+
+/* plays a journal back, reporting its records as they were seen, in
+ * the same batches and at the same pace, or faster */
+G_BEGIN_DECLS typedef struct _UserMonitorReplay UserMonitorReplay;
+
+/* logins and logouts are arrays of UserMonitorScanEntry, only valid
+ * for the duration of the call */
+typedef void (*UserMonitorReplayFunc) (const GArray * logins,
+				       const GArray * logouts,
+				       gpointer user_data);
+
+/* called once after the last record */
+typedef void (*UserMonitorReplayDoneFunc) (gpointer user_data);
+
+/* speed is how many times faster than it was recorded, 0 for as fast
+ * as possible; returns NULL if there's no journal at path, see
+ * usermon-journal.h */
+UserMonitorReplay *xfce_usermon_replay_new(const gchar * path, gdouble speed,
+					   UserMonitorNames * names,
+					   UserMonitorReplayFunc func,
+					   UserMonitorReplayDoneFunc done_func,
+					   gpointer user_data);
+
+void xfce_usermon_replay_free(UserMonitorReplay * replay);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_REPLAY_H__ */
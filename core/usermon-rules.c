@@ -0,0 +1,389 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-names.h"
+#include "usermon-rules.h"
+
+/* what a rule looks at */
+enum {
+	USERMON_RULES_USER = 0,
+	USERMON_RULES_HOST,
+	USERMON_RULES_LINE,
+	USERMON_RULES_FIELDS_COUNT
+};
+
+/* ignore, then watch */
+#define USERMON_RULES_ACTIONS_COUNT	2
+
+typedef struct _UserMonitorRulesNode UserMonitorRulesNode;
+
+/* a trie node; children are chained through their siblings */
+struct _UserMonitorRulesNode {
+	UserMonitorRulesNode *child;
+	UserMonitorRulesNode *sibling;
+	gchar c;
+	/* a pattern ends here */
+	gboolean terminal;
+};
+
+typedef struct {
+	gboolean any;
+	GHashTable *names;
+	/* patterns like "svc-*", and like "*.example.com" reversed */
+	UserMonitorRulesNode *prefixes;
+	UserMonitorRulesNode *suffixes;
+	/* anything else, eg "web?" */
+	GSList *patterns;
+} UserMonitorRulesSet;
+
+struct _UserMonitorRules {
+	UserMonitorRulesSet sets[USERMON_RULES_ACTIONS_COUNT]
+	    [USERMON_RULES_FIELDS_COUNT];
+	gboolean local[USERMON_RULES_ACTIONS_COUNT];
+	gboolean remote[USERMON_RULES_ACTIONS_COUNT];
+	guint count;
+};
+
+static const gchar *rules_fields[USERMON_RULES_FIELDS_COUNT] = {
+	"user",
+	"host",
+	"line"
+};
+
+static void xfce_usermon_rules_free_node(UserMonitorRulesNode * node)
+{
+	while (node != NULL) {
+		UserMonitorRulesNode *sibling = node->sibling;
+
+		xfce_usermon_rules_free_node(node->child);
+		g_slice_free(UserMonitorRulesNode, node);
+		node = sibling;
+	}
+}
+
+static void xfce_usermon_rules_insert(UserMonitorRulesNode ** root,
+				      const gchar * text, gsize length,
+				      gboolean reversed)
+{
+	UserMonitorRulesNode **children = root;
+	UserMonitorRulesNode *node = NULL;
+	gsize i;
+
+	for (i = 0; i < length; ++i) {
+		gchar c = reversed ? text[length - 1 - i] : text[i];
+
+		for (node = *children; node != NULL; node = node->sibling) {
+			if (node->c == c) {
+				break;
+			}
+		}
+		if (node == NULL) {
+			node = g_slice_new0(UserMonitorRulesNode);
+			node->c = c;
+			node->sibling = *children;
+			*children = node;
+		}
+		children = &node->child;
+	}
+
+	if (node != NULL) {
+		node->terminal = TRUE;
+	}
+}
+
+static gboolean xfce_usermon_rules_walk(const UserMonitorRulesNode * node,
+					const gchar * text, gsize length,
+					gboolean reversed)
+{
+	gsize i;
+
+	for (i = 0; (i < length) && (node != NULL); ++i) {
+		gchar c = reversed ? text[length - 1 - i] : text[i];
+
+		while ((node != NULL) && (node->c != c)) {
+			node = node->sibling;
+		}
+		if (node == NULL) {
+			return FALSE;
+		}
+		if (node->terminal == TRUE) {
+			return TRUE;
+		}
+		node = node->child;
+	}
+
+	return FALSE;
+}
+
+static void xfce_usermon_rules_add(UserMonitorRulesSet * set,
+				   const gchar * pattern)
+{
+	gsize length = strlen(pattern);
+	const gchar *wildcard = strpbrk(pattern, "*?");
+
+	if (wildcard == NULL) {
+		g_hash_table_add(set->names, g_strdup(pattern));
+	} else if (strcmp(pattern, "*") == 0) {
+		set->any = TRUE;
+	} else if ((wildcard == pattern + length - 1) && (*wildcard == '*')) {
+		xfce_usermon_rules_insert(&set->prefixes, pattern, length - 1,
+					  FALSE);
+	} else if ((wildcard == pattern) && (*wildcard == '*') &&
+		   (strpbrk(pattern + 1, "*?") == NULL)) {
+		xfce_usermon_rules_insert(&set->suffixes, pattern + 1,
+					  length - 1, TRUE);
+	} else {
+		set->patterns = g_slist_prepend(set->patterns,
+						g_pattern_spec_new(pattern));
+	}
+}
+
+static gboolean xfce_usermon_rules_match(const UserMonitorRulesSet * set,
+					 const gchar * text)
+{
+	gsize length;
+	GSList *item;
+
+	if (set->any == TRUE) {
+		return TRUE;
+	}
+	if (g_hash_table_contains(set->names, text) == TRUE) {
+		return TRUE;
+	}
+
+	length = strlen(text);
+	if ((xfce_usermon_rules_walk(set->prefixes, text, length, FALSE) ==
+	     TRUE) ||
+	    (xfce_usermon_rules_walk(set->suffixes, text, length, TRUE) ==
+	     TRUE)) {
+		return TRUE;
+	}
+
+	for (item = set->patterns; item != NULL; item = item->next) {
+		if (g_pattern_match_string(item->data, text) == TRUE) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean xfce_usermon_rules_parse(UserMonitorRules * rules,
+					 const gchar * rule)
+{
+	gchar **words = g_strsplit_set(rule, " \t", -1);
+	gchar *parts[3];
+	guint action, field;
+	guint count = 0;
+	guint i;
+
+	/* words may be separated by several spaces */
+	for (i = 0; words[i] != NULL; ++i) {
+		if (words[i][0] == '\0') {
+			continue;
+		}
+		if (count == G_N_ELEMENTS(parts)) {
+			g_strfreev(words);
+			return FALSE;
+		}
+		parts[count++] = words[i];
+	}
+
+	if ((count < 2) || ((strcmp(parts[0], "ignore") != 0) &&
+			    (strcmp(parts[0], "watch") != 0))) {
+		g_strfreev(words);
+		return FALSE;
+	}
+	action = (strcmp(parts[0], "watch") == 0) ? 1 : 0;
+
+	if (count == 2) {
+		if (strcmp(parts[1], "local") == 0) {
+			rules->local[action] = TRUE;
+		} else if (strcmp(parts[1], "remote") == 0) {
+			rules->remote[action] = TRUE;
+		} else {
+			g_strfreev(words);
+			return FALSE;
+		}
+		g_strfreev(words);
+		return TRUE;
+	}
+
+	for (field = 0; field < USERMON_RULES_FIELDS_COUNT; ++field) {
+		if (strcmp(parts[1], rules_fields[field]) == 0) {
+			break;
+		}
+	}
+	if (field == USERMON_RULES_FIELDS_COUNT) {
+		g_strfreev(words);
+		return FALSE;
+	}
+
+	/* host names aren't case sensitive */
+	if (field == USERMON_RULES_HOST) {
+		gchar *pattern = g_ascii_strdown(parts[2], -1);
+
+		xfce_usermon_rules_add(&rules->sets[action][field], pattern);
+		g_free(pattern);
+	} else {
+		xfce_usermon_rules_add(&rules->sets[action][field], parts[2]);
+	}
+	g_strfreev(words);
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_rules_check_action(UserMonitorRules * rules,
+						guint action,
+						const gchar * user_name,
+						const gchar * host,
+						const gchar * line)
+{
+	if (xfce_usermon_rules_match(&rules->sets[action][USERMON_RULES_USER],
+				     user_name) == TRUE) {
+		return TRUE;
+	}
+
+	if (host != NULL) {
+		/* X displays are local too */
+		gboolean local = ((host[0] == '\0') || (host[0] == ':'));
+
+		if (((local == TRUE) && (rules->local[action] == TRUE)) ||
+		    ((local == FALSE) && (rules->remote[action] == TRUE)) ||
+		    (xfce_usermon_rules_match(&rules->sets[action]
+					      [USERMON_RULES_HOST],
+					      host) == TRUE)) {
+			return TRUE;
+		}
+	}
+
+	return ((line != NULL) &&
+		(xfce_usermon_rules_match(&rules->sets[action]
+					  [USERMON_RULES_LINE], line) == TRUE));
+}
+
+UserMonitorRules *xfce_usermon_rules_new(const gchar * const *rules_text)
+{
+	UserMonitorRules *rules = g_slice_new0(UserMonitorRules);
+	guint action, field;
+	guint i;
+
+	for (action = 0; action < USERMON_RULES_ACTIONS_COUNT; ++action) {
+		for (field = 0; field < USERMON_RULES_FIELDS_COUNT; ++field) {
+			rules->sets[action][field].names =
+			    g_hash_table_new_full(g_str_hash, g_str_equal,
+						  g_free, NULL);
+		}
+	}
+	rules->count = 0;
+
+	for (i = 0; (rules_text != NULL) && (rules_text[i] != NULL); ++i) {
+		gchar *rule = g_strstrip(g_strdup(rules_text[i]));
+
+		if (rule[0] != '\0') {
+			if (xfce_usermon_rules_parse(rules, rule) == TRUE) {
+				++rules->count;
+			} else {
+				g_debug("Ignoring invalid rule %s", rule);
+			}
+		}
+		g_free(rule);
+	}
+	g_debug("Compiled %d rules", rules->count);
+
+	return rules;
+}
+
+void xfce_usermon_rules_free(UserMonitorRules * rules)
+{
+	guint action, field;
+
+	if (rules == NULL) {
+		return;
+	}
+
+	for (action = 0; action < USERMON_RULES_ACTIONS_COUNT; ++action) {
+		for (field = 0; field < USERMON_RULES_FIELDS_COUNT; ++field) {
+			UserMonitorRulesSet *set = &rules->sets[action][field];
+
+			g_hash_table_destroy(set->names);
+			xfce_usermon_rules_free_node(set->prefixes);
+			xfce_usermon_rules_free_node(set->suffixes);
+			g_slist_free_full(set->patterns,
+					  (GDestroyNotify)
+					  g_pattern_spec_free);
+		}
+	}
+
+	g_slice_free(UserMonitorRules, rules);
+}
+
+guint xfce_usermon_rules_get_count(UserMonitorRules * rules)
+{
+	return rules->count;
+}
+
+UserMonitorRulesVerdict xfce_usermon_rules_check(UserMonitorRules * rules,
+						 const UserMonitorSessionKey *
+						 key, const gchar * user_name,
+						 const gchar * host)
+{
+	gchar line[sizeof(key->line) + 1];
+	gchar lower_host[USERMON_NAMES_MAX_LENGTH];
+	const gchar *line_text = NULL;
+	const gchar *host_text = NULL;
+	gsize i;
+
+	if ((rules == NULL) || (rules->count == 0)) {
+		return USERMON_RULES_NONE;
+	}
+
+	if (key != NULL) {
+		memcpy(line, key->line, sizeof(key->line));
+		line[sizeof(key->line)] = '\0';
+		line_text = line;
+	}
+	if (host != NULL) {
+		for (i = 0; (i < sizeof(lower_host) - 1) && (host[i] != '\0');
+		     ++i) {
+			lower_host[i] = g_ascii_tolower(host[i]);
+		}
+		lower_host[i] = '\0';
+		host_text = lower_host;
+	}
+
+	if (xfce_usermon_rules_check_action(rules, 1, user_name, host_text,
+					    line_text) == TRUE) {
+		return USERMON_RULES_WATCH;
+	}
+	if (xfce_usermon_rules_check_action(rules, 0, user_name, host_text,
+					    line_text) == TRUE) {
+		return USERMON_RULES_IGNORE;
+	}
+
+	return USERMON_RULES_NONE;
+}
@@ -0,0 +1,54 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_RULES_H__
+#define __USER_MONITOR_RULES_H__
+
+#include "usermon-sessions.h"
+
+/* what to do about a session, watching wins over ignoring */
+G_BEGIN_DECLS typedef enum {
+	USERMON_RULES_NONE = 0,
+	USERMON_RULES_IGNORE,
+	USERMON_RULES_WATCH
+} UserMonitorRulesVerdict;
+
+/* rules are compiled once into hash sets and prefix and suffix tries,
+ * so that checking a session doesn't depend on how many there are;
+ * other patterns, eg "web-*-prod", are matched one after the other */
+typedef struct _UserMonitorRules UserMonitorRules;
+
+/* each rule is "ignore" or "watch", followed by "user", "host" or
+ * "line" and a name or a pattern, eg "ignore user svc-*", or by
+ * "local" or "remote" alone; invalid rules are skipped */
+UserMonitorRules *xfce_usermon_rules_new(const gchar * const *rules);
+
+void xfce_usermon_rules_free(UserMonitorRules * rules);
+
+/* number of valid rules */
+guint xfce_usermon_rules_get_count(UserMonitorRules * rules);
+
+/* key and host may be NULL if they aren't known, and then only the
+ * rules about users apply */
+UserMonitorRulesVerdict xfce_usermon_rules_check(UserMonitorRules * rules,
+						 const UserMonitorSessionKey *
+						 key, const gchar * user_name,
+						 const gchar * host);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_RULES_H__ */
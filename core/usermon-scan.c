@@ -0,0 +1,224 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_STRUCT_UTMPX_UT_ADDR_V6
+#include <arpa/inet.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-scan.h"
+#include "usermon-stats.h"
+
+/* enough for most hosts, the arrays grow if necessary */
+#define USERMON_SCAN_PREALLOCATED	64
+
+struct _UserMonitorScan {
+	UserMonitorNames *names;
+	/* the previous and the current snapshots, sorted by slot */
+	GArray *snapshots[2];
+	guint current;
+	guint32 source;
+	GArray *logins;
+	GArray *logouts;
+};
+
+static void xfce_usermon_scan_get_host(const struct utmpx *u, gchar * host)
+{
+#ifdef HAVE_STRUCT_UTMPX_UT_ADDR_V6
+	gchar address[INET6_ADDRSTRLEN];
+
+	/* some write the address alone, to be resolved later */
+	if ((u->ut_host[0] == '\0') &&
+	    ((u->ut_addr_v6[0] != 0) || (u->ut_addr_v6[1] != 0) ||
+	     (u->ut_addr_v6[2] != 0) || (u->ut_addr_v6[3] != 0))) {
+		gboolean is_v4 = (u->ut_addr_v6[1] == 0) &&
+		    (u->ut_addr_v6[2] == 0) && (u->ut_addr_v6[3] == 0);
+
+		if (inet_ntop(is_v4 ? AF_INET : AF_INET6, u->ut_addr_v6,
+			      address, sizeof(address)) != NULL) {
+			g_strlcpy(host, address, sizeof(u->ut_host) + 1);
+			return;
+		}
+	}
+#endif
+
+	memcpy(host, u->ut_host, sizeof(u->ut_host));
+	host[sizeof(u->ut_host)] = '\0';
+}
+
+UserMonitorScan *xfce_usermon_scan_new(UserMonitorNames * names)
+{
+	UserMonitorScan *scan = g_slice_new0(UserMonitorScan);
+	guint i;
+
+	scan->names = names;
+	for (i = 0; i < 2; ++i) {
+		scan->snapshots[i] =
+		    g_array_sized_new(FALSE, FALSE,
+				      sizeof(UserMonitorScanEntry),
+				      USERMON_SCAN_PREALLOCATED);
+	}
+	scan->current = 0;
+	scan->source = 0;
+	scan->logins =
+	    g_array_sized_new(FALSE, FALSE, sizeof(UserMonitorScanEntry),
+			      USERMON_SCAN_PREALLOCATED);
+	scan->logouts =
+	    g_array_sized_new(FALSE, FALSE, sizeof(UserMonitorScanEntry),
+			      USERMON_SCAN_PREALLOCATED);
+
+	return scan;
+}
+
+void xfce_usermon_scan_free(UserMonitorScan * scan)
+{
+	if (scan == NULL) {
+		return;
+	}
+
+	g_array_free(scan->snapshots[0], TRUE);
+	g_array_free(scan->snapshots[1], TRUE);
+	g_array_free(scan->logins, TRUE);
+	g_array_free(scan->logouts, TRUE);
+
+	g_slice_free(UserMonitorScan, scan);
+}
+
+void xfce_usermon_scan_set_source(UserMonitorScan * scan, guint32 source)
+{
+	scan->source = source;
+}
+
+void xfce_usermon_scan_diff(UserMonitorScan * scan,
+			    GArray * slots,
+			    guint slots_count,
+			    UserMonitorScanRecordFunc get_record,
+			    gpointer user_data)
+{
+	GArray *previous = scan->snapshots[scan->current];
+	GArray *current = scan->snapshots[1 - scan->current];
+	guint candidates_count = (slots != NULL) ? slots->len : slots_count;
+	guint records_count = 0, user_process_count = 0;
+	guint i = 0, j = 0;
+
+	/* these keep their allocated size */
+	g_array_set_size(current, 0);
+	g_array_set_size(scan->logins, 0);
+	g_array_set_size(scan->logouts, 0);
+
+	/* merge the previous snapshot with the slots that changed */
+	while ((i < previous->len) || (j < candidates_count)) {
+		UserMonitorScanEntry *old_entry = NULL;
+		UserMonitorScanEntry new_entry;
+		const struct utmpx *u;
+		guint slot;
+
+		if (i < previous->len) {
+			old_entry =
+			    &g_array_index(previous, UserMonitorScanEntry, i);
+		}
+
+		if (j >= candidates_count) {
+			if (slots == NULL) {
+				/* utmp shrank */
+				g_array_append_val(scan->logouts, *old_entry);
+			} else {
+				g_array_append_val(current, *old_entry);
+			}
+			++i;
+			continue;
+		}
+
+		slot = (slots != NULL) ? g_array_index(slots, guint, j) : j;
+
+		/* this slot didn't change */
+		if ((old_entry != NULL) && (old_entry->slot < slot)) {
+			g_array_append_val(current, *old_entry);
+			++i;
+			continue;
+		}
+
+		u = get_record(slot, user_data);
+		++j;
+
+		if (u != NULL) {
+			++records_count;
+		}
+		if ((u != NULL) && (u->ut_type == USER_PROCESS)) {
+			++user_process_count;
+			new_entry.slot = slot;
+			xfce_usermon_sessions_key_from_utmpx(&new_entry.key, u);
+			new_entry.key.source = scan->source;
+			new_entry.user_name =
+			    xfce_usermon_names_intern(scan->names, u->ut_user,
+						      sizeof(u->ut_user));
+			new_entry.login_time = u->ut_tv.tv_sec;
+		}
+
+		if ((old_entry != NULL) && (old_entry->slot == slot)) {
+			++i;
+
+			/* is this still the same session? */
+			if ((u != NULL) && (u->ut_type == USER_PROCESS) &&
+			    (old_entry->user_name == new_entry.user_name) &&
+			    (memcmp(&old_entry->key, &new_entry.key,
+				    sizeof(UserMonitorSessionKey)) == 0)) {
+				g_array_append_val(current, *old_entry);
+				continue;
+			}
+
+			g_array_append_val(scan->logouts, *old_entry);
+		}
+
+		if ((u != NULL) && (u->ut_type == USER_PROCESS)) {
+			xfce_usermon_scan_get_host(u, new_entry.host);
+
+			g_array_append_val(current, new_entry);
+			g_array_append_val(scan->logins, new_entry);
+		}
+	}
+
+	/* swap the snapshots */
+	scan->current = 1 - scan->current;
+
+	xfce_usermon_stats_count(USERMON_COUNTER_RECORDS_READ, records_count);
+	xfce_usermon_stats_count(USERMON_COUNTER_USER_PROCESS_RECORDS,
+				 user_process_count);
+}
+
+const GArray *xfce_usermon_scan_get_logins(UserMonitorScan * scan)
+{
+	return scan->logins;
+}
+
+const GArray *xfce_usermon_scan_get_logouts(UserMonitorScan * scan)
+{
+	return scan->logouts;
+}
+
+const GArray *xfce_usermon_scan_get_snapshot(UserMonitorScan * scan)
+{
+	return scan->snapshots[scan->current];
+}
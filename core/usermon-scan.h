@@ -0,0 +1,68 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SCAN_H__
+#define __USER_MONITOR_SCAN_H__
+
+#include <utmpx.h>
+
+#include "usermon-names.h"
+#include "usermon-sessions.h"
+
+/* a live session, as found in a utmp slot */
+G_BEGIN_DECLS typedef struct {
+	guint slot;
+	UserMonitorSessionKey key;
+	/* interned */
+	const gchar *user_name;
+	/* kept in the entry, so that the snapshots don't allocate */
+	gchar host[sizeof(((struct utmpx *) 0)->ut_host) + 1];
+	gint64 login_time;
+} UserMonitorScanEntry;
+
+typedef struct _UserMonitorScan UserMonitorScan;
+
+typedef const struct utmpx *(*UserMonitorScanRecordFunc) (guint slot,
+							   gpointer
+							   user_data);
+
+UserMonitorScan *xfce_usermon_scan_new(UserMonitorNames * names);
+
+void xfce_usermon_scan_free(UserMonitorScan * scan);
+
+/* tags the keys of the sessions found, 0 by default */
+void xfce_usermon_scan_set_source(UserMonitorScan * scan, guint32 source);
+
+/* slots lists the slots that changed, in increasing order, or is NULL
+ * if all slots_count slots have to be looked at; get_record is called
+ * once for each of those slots, in the same order */
+void xfce_usermon_scan_diff(UserMonitorScan * scan,
+			    GArray * slots,
+			    guint slots_count,
+			    UserMonitorScanRecordFunc get_record,
+			    gpointer user_data);
+
+/* these are valid until the next diff */
+const GArray *xfce_usermon_scan_get_logins(UserMonitorScan * scan);
+
+const GArray *xfce_usermon_scan_get_logouts(UserMonitorScan * scan);
+
+const GArray *xfce_usermon_scan_get_snapshot(UserMonitorScan * scan);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SCAN_H__ */
@@ -0,0 +1,133 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-schedule.h"
+#include "usermon-stats.h"
+
+/* interval after a change, and for how many calls */
+#define USERMON_SCHEDULE_FAST_INTERVAL	1
+#define USERMON_SCHEDULE_FAST_CALLS	10
+/* the interval doubles while nothing changes, up to this many periods */
+#define USERMON_SCHEDULE_MAX_BACKOFF	4
+
+struct _UserMonitorSchedule {
+	guint period;
+	guint interval;
+	guint fast_calls;
+	guint source_id;
+	gint64 last_time;
+	UserMonitorScheduleFunc func;
+	gpointer user_data;
+};
+
+static gboolean xfce_usermon_schedule_call(gpointer user_data);
+
+static void xfce_usermon_schedule_arm(UserMonitorSchedule * schedule)
+{
+	/* in seconds, so that wakeups are grouped with other timers */
+	schedule->source_id =
+	    g_timeout_add_seconds(schedule->interval,
+				  xfce_usermon_schedule_call, schedule);
+}
+
+static gboolean xfce_usermon_schedule_call(gpointer user_data)
+{
+	UserMonitorSchedule *schedule = (UserMonitorSchedule *) user_data;
+	gint64 now = g_get_monotonic_time();
+	guint max_interval = schedule->period * USERMON_SCHEDULE_MAX_BACKOFF;
+
+	/* removed on return, func must not free the schedule */
+	schedule->source_id = 0;
+
+	/* allow for a second of slack, timeouts in seconds are grouped */
+	if (now - schedule->last_time >
+	    (2 * schedule->interval + 1) * G_USEC_PER_SEC) {
+		xfce_usermon_stats_count(USERMON_COUNTER_TIMER_OVERRUNS, 1);
+	}
+
+	if (schedule->func(schedule->user_data) == TRUE) {
+		/* more may follow, eg several users logging in */
+		schedule->fast_calls = USERMON_SCHEDULE_FAST_CALLS;
+		schedule->interval =
+		    MIN(USERMON_SCHEDULE_FAST_INTERVAL, schedule->period);
+	} else if (schedule->fast_calls > 0) {
+		--schedule->fast_calls;
+		if (schedule->fast_calls == 0) {
+			schedule->interval = schedule->period;
+		}
+	} else if (schedule->interval < max_interval) {
+		schedule->interval = MIN(schedule->interval * 2, max_interval);
+		g_debug("Backing off to %d seconds", schedule->interval);
+	}
+
+	schedule->last_time = g_get_monotonic_time();
+	xfce_usermon_schedule_arm(schedule);
+
+	return G_SOURCE_REMOVE;
+}
+
+UserMonitorSchedule *xfce_usermon_schedule_new(guint period,
+					       UserMonitorScheduleFunc func,
+					       gpointer user_data)
+{
+	UserMonitorSchedule *schedule = g_slice_new0(UserMonitorSchedule);
+
+	schedule->func = func;
+	schedule->user_data = user_data;
+	xfce_usermon_schedule_set_period(schedule, period);
+
+	return schedule;
+}
+
+void xfce_usermon_schedule_free(UserMonitorSchedule * schedule)
+{
+	if (schedule == NULL) {
+		return;
+	}
+
+	if (schedule->source_id > 0) {
+		g_source_remove(schedule->source_id);
+	}
+
+	g_slice_free(UserMonitorSchedule, schedule);
+}
+
+void xfce_usermon_schedule_set_period(UserMonitorSchedule * schedule,
+				      guint period)
+{
+	if (schedule->source_id > 0) {
+		g_source_remove(schedule->source_id);
+	}
+
+	schedule->period = MAX(period, 1);
+	schedule->interval = schedule->period;
+	schedule->fast_calls = 0;
+	schedule->last_time = g_get_monotonic_time();
+	xfce_usermon_schedule_arm(schedule);
+}
+
+guint xfce_usermon_schedule_get_interval(UserMonitorSchedule * schedule)
+{
+	return schedule->interval;
+}
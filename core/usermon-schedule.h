@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SCHEDULE_H__
+#define __USER_MONITOR_SCHEDULE_H__
+
+/* calls a function every period seconds, less often while nothing
+ * changes and more often for a while after something did */
+G_BEGIN_DECLS typedef struct _UserMonitorSchedule UserMonitorSchedule;
+
+/* returns TRUE if something changed */
+typedef gboolean(*UserMonitorScheduleFunc) (gpointer user_data);
+
+UserMonitorSchedule *xfce_usermon_schedule_new(guint period,
+					       UserMonitorScheduleFunc func,
+					       gpointer user_data);
+
+void xfce_usermon_schedule_free(UserMonitorSchedule * schedule);
+
+/* takes effect now, starting over from the new period */
+void xfce_usermon_schedule_set_period(UserMonitorSchedule * schedule,
+				      guint period);
+
+guint xfce_usermon_schedule_get_interval(UserMonitorSchedule * schedule);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SCHEDULE_H__ */
@@ -0,0 +1,177 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-series.h"
+
+typedef struct {
+	/* seconds per bucket */
+	guint width;
+	guint length;
+	/* the open bucket, and how many closed ones there are */
+	gint64 number;
+	guint head;
+	guint closed_count;
+	UserMonitorSeriesBucket *buckets;
+} UserMonitorSeriesRing;
+
+struct _UserMonitorSeries {
+	UserMonitorSeriesRing rings[USERMON_SERIES_LEVELS_COUNT];
+	/* carried over to buckets nothing happened in */
+	guint sessions_count;
+};
+
+/* an hour by the minute, six hours by ten minutes, two days by the hour */
+static const guint series_widths[USERMON_SERIES_LEVELS_COUNT] = {
+	60, 600, 3600
+};
+
+static const guint series_lengths[USERMON_SERIES_LEVELS_COUNT] = {
+	60, 36, 48
+};
+
+static gboolean xfce_usermon_series_roll(UserMonitorSeriesRing * ring,
+					 gint64 now, guint sessions_count)
+{
+	gint64 number = now / ring->width;
+	gint64 steps;
+
+	if (number <= ring->number) {
+		return FALSE;
+	}
+
+	/* skip whole rounds, eg after a suspend */
+	steps = MIN(number - ring->number, (gint64) ring->length);
+	while (steps-- > 0) {
+		UserMonitorSeriesBucket *bucket;
+
+		ring->head = (ring->head + 1) % (ring->length + 1);
+		bucket = &ring->buckets[ring->head];
+		bucket->sessions_count = sessions_count;
+		bucket->logins_count = 0;
+		if (ring->closed_count < ring->length) {
+			++ring->closed_count;
+		}
+	}
+	ring->number = number;
+
+	return TRUE;
+}
+
+UserMonitorSeries *xfce_usermon_series_new(void)
+{
+	UserMonitorSeries *series = g_slice_new0(UserMonitorSeries);
+	gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+	guint i;
+
+	for (i = 0; i < USERMON_SERIES_LEVELS_COUNT; ++i) {
+		UserMonitorSeriesRing *ring = &series->rings[i];
+
+		ring->width = series_widths[i];
+		ring->length = series_lengths[i];
+		ring->number = now / ring->width;
+		ring->head = 0;
+		ring->closed_count = 0;
+		/* one more for the open bucket */
+		ring->buckets = g_new0(UserMonitorSeriesBucket,
+				       ring->length + 1);
+	}
+	series->sessions_count = 0;
+
+	return series;
+}
+
+void xfce_usermon_series_free(UserMonitorSeries * series)
+{
+	guint i;
+
+	if (series == NULL) {
+		return;
+	}
+
+	for (i = 0; i < USERMON_SERIES_LEVELS_COUNT; ++i) {
+		g_free(series->rings[i].buckets);
+	}
+
+	g_slice_free(UserMonitorSeries, series);
+}
+
+guint xfce_usermon_series_add(UserMonitorSeries * series, gint64 now,
+			      guint sessions_count, guint logins_count)
+{
+	guint closed = xfce_usermon_series_advance(series, now);
+	guint i;
+
+	series->sessions_count = sessions_count;
+	for (i = 0; i < USERMON_SERIES_LEVELS_COUNT; ++i) {
+		UserMonitorSeriesRing *ring = &series->rings[i];
+		UserMonitorSeriesBucket *bucket = &ring->buckets[ring->head];
+
+		bucket->sessions_count = MAX(bucket->sessions_count,
+					     sessions_count);
+		bucket->logins_count += logins_count;
+	}
+
+	return closed;
+}
+
+guint xfce_usermon_series_advance(UserMonitorSeries * series, gint64 now)
+{
+	guint closed = 0;
+	guint i;
+
+	for (i = 0; i < USERMON_SERIES_LEVELS_COUNT; ++i) {
+		if (xfce_usermon_series_roll(&series->rings[i], now,
+					     series->sessions_count) == TRUE) {
+			closed |= 1 << i;
+		}
+	}
+
+	return closed;
+}
+
+guint xfce_usermon_series_get_length(UserMonitorSeriesLevel level)
+{
+	return series_lengths[level];
+}
+
+guint xfce_usermon_series_get_width(UserMonitorSeriesLevel level)
+{
+	return series_widths[level];
+}
+
+const UserMonitorSeriesBucket *xfce_usermon_series_get(UserMonitorSeries *
+						       series,
+						       UserMonitorSeriesLevel
+						       level, guint age)
+{
+	UserMonitorSeriesRing *ring = &series->rings[level];
+
+	if (age >= ring->closed_count) {
+		return NULL;
+	}
+
+	/* the open bucket is at head */
+	return &ring->buckets[(ring->head + ring->length - age) %
+			      (ring->length + 1)];
+}
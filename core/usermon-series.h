@@ -0,0 +1,65 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SERIES_H__
+#define __USER_MONITOR_SERIES_H__
+
+/* resolutions, from the finest */
+G_BEGIN_DECLS typedef enum {
+	USERMON_SERIES_MINUTES = 0,
+	USERMON_SERIES_TEN_MINUTES,
+	USERMON_SERIES_HOURS,
+	USERMON_SERIES_LEVELS_COUNT
+} UserMonitorSeriesLevel;
+
+typedef struct {
+	/* peak number of concurrent sessions */
+	guint sessions_count;
+	guint logins_count;
+} UserMonitorSeriesBucket;
+
+/* sessions and logins over time, in fixed size ring buffers, one per
+ * resolution; each is fed directly rather than from a finer one, so
+ * that a bucket closes on time whatever happens to the others */
+typedef struct _UserMonitorSeries UserMonitorSeries;
+
+UserMonitorSeries *xfce_usermon_series_new(void);
+
+void xfce_usermon_series_free(UserMonitorSeries * series);
+
+/* now is in seconds since the epoch; both return a mask of the levels
+ * where a bucket closed, 1 << level */
+guint xfce_usermon_series_add(UserMonitorSeries * series, gint64 now,
+			      guint sessions_count, guint logins_count);
+
+guint xfce_usermon_series_advance(UserMonitorSeries * series, gint64 now);
+
+/* number of buckets kept, and seconds each one lasts */
+guint xfce_usermon_series_get_length(UserMonitorSeriesLevel level);
+
+guint xfce_usermon_series_get_width(UserMonitorSeriesLevel level);
+
+/* closed buckets, age 0 being the last one closed; returns NULL past
+ * the oldest */
+const UserMonitorSeriesBucket *xfce_usermon_series_get(UserMonitorSeries *
+						       series,
+						       UserMonitorSeriesLevel
+						       level, guint age);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SERIES_H__ */
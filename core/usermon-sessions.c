@@ -0,0 +1,218 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-sessions.h"
+#include "usermon-stats.h"
+
+struct _UserMonitorSessions {
+	/* sessions, keyed by UserMonitorSessionKey */
+	GHashTable *sessions;
+	/* GPtrArray of each user's sessions, keyed by interned user name */
+	GHashTable *users;
+};
+
+guint xfce_usermon_sessions_key_hash(gconstpointer key)
+{
+	const guchar *ptr = key;
+	guint hash = 2166136261U;
+	gsize i;
+
+	/* FNV-1a, keys are zero-filled */
+	for (i = 0; i < sizeof(UserMonitorSessionKey); ++i) {
+		hash = (hash ^ ptr[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+gboolean xfce_usermon_sessions_key_equal(gconstpointer a, gconstpointer b)
+{
+	return (memcmp(a, b, sizeof(UserMonitorSessionKey)) == 0);
+}
+
+static void xfce_usermon_sessions_free_session(gpointer data)
+{
+	UserMonitorSession *session = (UserMonitorSession *) data;
+
+	g_free(session->host);
+	g_slice_free(UserMonitorSession, session);
+}
+
+UserMonitorSessions *xfce_usermon_sessions_new(void)
+{
+	UserMonitorSessions *sessions = g_slice_new0(UserMonitorSessions);
+
+	sessions->sessions =
+	    g_hash_table_new_full(xfce_usermon_sessions_key_hash,
+				  xfce_usermon_sessions_key_equal, NULL,
+				  xfce_usermon_sessions_free_session);
+	sessions->users = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+						NULL,
+						(GDestroyNotify)
+						g_ptr_array_unref);
+
+	return sessions;
+}
+
+void xfce_usermon_sessions_free(UserMonitorSessions * sessions)
+{
+	if (sessions == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy(sessions->sessions);
+	g_hash_table_destroy(sessions->users);
+
+	g_slice_free(UserMonitorSessions, sessions);
+}
+
+void xfce_usermon_sessions_key_from_utmpx(UserMonitorSessionKey * key,
+					  const struct utmpx *u)
+{
+	memset(key, 0, sizeof(UserMonitorSessionKey));
+	memcpy(key->id, u->ut_id, sizeof(key->id));
+	strncpy(key->line, u->ut_line, sizeof(key->line));
+	key->pid = u->ut_pid;
+}
+
+const UserMonitorSession *xfce_usermon_sessions_add(UserMonitorSessions *
+						    sessions,
+						    const UserMonitorSessionKey
+						    * key,
+						    const gchar * user_name,
+						    const gchar * host,
+						    gint64 login_time)
+{
+	UserMonitorSession *session;
+	GPtrArray *user_sessions;
+
+	if (g_hash_table_contains(sessions->sessions, key) == TRUE) {
+		return NULL;
+	}
+
+	session = g_slice_new0(UserMonitorSession);
+	xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 1);
+	session->key = *key;
+	session->user_name = user_name;
+	session->host = g_strdup(host);
+	session->login_time = login_time;
+	g_hash_table_insert(sessions->sessions, &session->key, session);
+
+	/* one more session for this user */
+	user_sessions = g_hash_table_lookup(sessions->users, user_name);
+	if (user_sessions == NULL) {
+		user_sessions = g_ptr_array_sized_new(1);
+		xfce_usermon_stats_count(USERMON_COUNTER_ALLOCATIONS, 1);
+		g_hash_table_insert(sessions->users, (gpointer) user_name,
+				    user_sessions);
+	}
+	g_ptr_array_add(user_sessions, session);
+
+	g_debug("Session %.*s of %s started, %d sessions",
+		(gint) sizeof(key->line), key->line, user_name,
+		user_sessions->len);
+
+	return session;
+}
+
+gboolean xfce_usermon_sessions_remove(UserMonitorSessions * sessions,
+				      const UserMonitorSessionKey * key)
+{
+	UserMonitorSession *session;
+	GPtrArray *user_sessions;
+
+	session = g_hash_table_lookup(sessions->sessions, key);
+	if (session == NULL) {
+		return FALSE;
+	}
+
+	/* one less session for this user */
+	user_sessions = g_hash_table_lookup(sessions->users,
+					    session->user_name);
+	g_ptr_array_remove_fast(user_sessions, session);
+	g_debug("Session %.*s of %s ended, %d sessions",
+		(gint) sizeof(key->line), key->line, session->user_name,
+		user_sessions->len);
+	if (user_sessions->len == 0) {
+		g_hash_table_remove(sessions->users, session->user_name);
+	}
+
+	g_hash_table_remove(sessions->sessions, key);
+
+	return TRUE;
+}
+
+const UserMonitorSession *xfce_usermon_sessions_lookup(UserMonitorSessions *
+						       sessions,
+						       const
+						       UserMonitorSessionKey *
+						       key)
+{
+	return g_hash_table_lookup(sessions->sessions, key);
+}
+
+guint xfce_usermon_sessions_get_count(UserMonitorSessions * sessions)
+{
+	return g_hash_table_size(sessions->sessions);
+}
+
+guint xfce_usermon_sessions_get_users_count(UserMonitorSessions * sessions)
+{
+	return g_hash_table_size(sessions->users);
+}
+
+guint xfce_usermon_sessions_get_user_count(UserMonitorSessions * sessions,
+					   const gchar * user_name)
+{
+	GPtrArray *user_sessions = g_hash_table_lookup(sessions->users,
+						       user_name);
+
+	return (user_sessions != NULL) ? user_sessions->len : 0;
+}
+
+const GPtrArray *xfce_usermon_sessions_get_user_sessions(UserMonitorSessions *
+							 sessions,
+							 const gchar *
+							 user_name)
+{
+	return g_hash_table_lookup(sessions->users, user_name);
+}
+
+void xfce_usermon_sessions_foreach_user(UserMonitorSessions * sessions,
+					UserMonitorSessionsUserFunc func,
+					gpointer user_data)
+{
+	GHashTableIter iter;
+	gpointer user_name, user_sessions;
+
+	g_hash_table_iter_init(&iter, sessions->users);
+	while (g_hash_table_iter_next(&iter, &user_name, &user_sessions) ==
+	       TRUE) {
+		func((const gchar *) user_name,
+		     (const GPtrArray *) user_sessions, user_data);
+	}
+}
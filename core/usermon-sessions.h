@@ -0,0 +1,102 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SESSIONS_H__
+#define __USER_MONITOR_SESSIONS_H__
+
+#include <sys/types.h>
+#include <utmpx.h>
+
+/* sessions are identified the same way utmp does */
+G_BEGIN_DECLS typedef struct {
+	gchar id[sizeof(((struct utmpx *) 0)->ut_id)];
+	gchar line[sizeof(((struct utmpx *) 0)->ut_line)];
+	pid_t pid;
+	/* which utmp file, 0 for the host's own */
+	guint32 source;
+} UserMonitorSessionKey;
+
+typedef struct {
+	UserMonitorSessionKey key;
+	/* interned, see usermon-names.h */
+	const gchar *user_name;
+	/* a copy */
+	gchar *host;
+	gint64 login_time;
+} UserMonitorSession;
+
+typedef struct _UserMonitorSessions UserMonitorSessions;
+
+/* user_sessions is an array of UserMonitorSession */
+typedef void (*UserMonitorSessionsUserFunc) (const gchar * user_name,
+					     const GPtrArray * user_sessions,
+					     gpointer user_data);
+
+UserMonitorSessions *xfce_usermon_sessions_new(void);
+
+void xfce_usermon_sessions_free(UserMonitorSessions * sessions);
+
+void xfce_usermon_sessions_key_from_utmpx(UserMonitorSessionKey * key,
+					  const struct utmpx *u);
+
+/* for tables keyed by UserMonitorSessionKey */
+guint xfce_usermon_sessions_key_hash(gconstpointer key);
+
+gboolean xfce_usermon_sessions_key_equal(gconstpointer a, gconstpointer b);
+
+/* user_name must be interned, host is copied; returns NULL if the
+ * session is already known */
+const UserMonitorSession *xfce_usermon_sessions_add(UserMonitorSessions *
+						    sessions,
+						    const UserMonitorSessionKey
+						    * key,
+						    const gchar * user_name,
+						    const gchar * host,
+						    gint64 login_time);
+
+/* returns FALSE if the session isn't known */
+gboolean xfce_usermon_sessions_remove(UserMonitorSessions * sessions,
+				      const UserMonitorSessionKey * key);
+
+const UserMonitorSession *xfce_usermon_sessions_lookup(UserMonitorSessions *
+						       sessions,
+						       const
+						       UserMonitorSessionKey *
+						       key);
+
+guint xfce_usermon_sessions_get_count(UserMonitorSessions * sessions);
+
+guint xfce_usermon_sessions_get_users_count(UserMonitorSessions * sessions);
+
+/* user_name must be interned */
+guint xfce_usermon_sessions_get_user_count(UserMonitorSessions * sessions,
+					   const gchar * user_name);
+
+/* user_name must be interned, returns NULL if that user has no session */
+const GPtrArray *xfce_usermon_sessions_get_user_sessions(UserMonitorSessions *
+							 sessions,
+							 const gchar *
+							 user_name);
+
+/* sessions grouped by user */
+void xfce_usermon_sessions_foreach_user(UserMonitorSessions * sessions,
+					UserMonitorSessionsUserFunc func,
+					gpointer user_data);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SESSIONS_H__ */
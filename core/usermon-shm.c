@@ -0,0 +1,383 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utmpx.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_SHM_OPEN)
+#include <sys/file.h>
+#include <sys/mman.h>
+#define USERMON_SHM_SUPPORTED 1
+#endif
+
+#include <glib.h>
+
+#include "usermon-shm.h"
+
+#define USERMON_SHM_MAGIC	0x53534d55
+#define USERMON_SHM_VERSION	2
+/* attempts at copying a consistent snapshot */
+#define USERMON_SHM_RETRIES	8
+/* the segment grows by this many slots at least */
+#define USERMON_SHM_CHUNK	64
+
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	/* odd while the snapshot is being written */
+	volatile guint32 sequence;
+	/* seconds of monotonic time, the same for all processes */
+	volatile gint32 heartbeat;
+	/* grows with utmp, the segment is never truncated */
+	volatile guint32 capacity;
+	/* may exceed capacity, in which case the snapshot is unusable */
+	guint32 slots_count;
+	guint32 padding[2];
+} UserMonitorShmHeader;
+
+struct _UserMonitorShm {
+	gint fd;
+	gboolean producer;
+	gpointer map;
+	gsize map_size;
+	/* slots in the mapping */
+	guint capacity;
+	UserMonitorShmHeader *header;
+	struct utmpx *records;
+};
+
+static gint32 xfce_usermon_shm_now(void)
+{
+	/* CLOCK_MONOTONIC is read without a syscall */
+	return (gint32) (g_get_monotonic_time() / G_USEC_PER_SEC);
+}
+
+#ifdef USERMON_SHM_SUPPORTED
+/* maps the whole segment, at least size bytes of it for the producer;
+ * the previous mapping is kept if that fails */
+static gboolean xfce_usermon_shm_map(UserMonitorShm * shm, gsize size)
+{
+	struct stat fd_stat;
+	gint prot = PROT_READ;
+	gpointer map;
+
+	if (fstat(shm->fd, &fd_stat) != 0) {
+		g_debug("Failed to stat segment: %s", strerror(errno));
+		return FALSE;
+	}
+	/* never shrunk, readers may still be copying from the end */
+	if ((shm->producer == TRUE) && ((gsize) fd_stat.st_size < size)) {
+		if (ftruncate(shm->fd, size) != 0) {
+			g_debug("Failed to size segment: %s", strerror(errno));
+			return FALSE;
+		}
+		fd_stat.st_size = size;
+	}
+	if ((gsize) fd_stat.st_size < sizeof(UserMonitorShmHeader)) {
+		/* the producer may not be done setting it up */
+		g_debug("Segment isn't ready");
+		return FALSE;
+	}
+	if (shm->producer == TRUE) {
+		prot |= PROT_WRITE;
+	}
+
+	map = mmap(NULL, fd_stat.st_size, prot, MAP_SHARED, shm->fd, 0);
+	if (map == MAP_FAILED) {
+		g_debug("Failed to map segment: %s", strerror(errno));
+		return FALSE;
+	}
+	if (shm->map != NULL) {
+		munmap(shm->map, shm->map_size);
+	}
+	shm->map = map;
+	shm->map_size = fd_stat.st_size;
+	shm->header = (UserMonitorShmHeader *) shm->map;
+	shm->records = (struct utmpx *)(shm->header + 1);
+	shm->capacity = (shm->map_size - sizeof(UserMonitorShmHeader)) /
+	    sizeof(struct utmpx);
+
+	return TRUE;
+}
+
+/* only root's segments and the user's own are read, anyone else's
+ * could list sessions that don't exist */
+static gboolean xfce_usermon_shm_is_trusted(UserMonitorShm * shm)
+{
+	struct stat fd_stat;
+
+	if (fstat(shm->fd, &fd_stat) != 0) {
+		return FALSE;
+	}
+	if (((fd_stat.st_uid != 0) && (fd_stat.st_uid != getuid())) ||
+	    ((fd_stat.st_mode & (S_IWGRP | S_IWOTH)) != 0)) {
+		g_debug("Segment belongs to uid %d, mode %o",
+			(gint) fd_stat.st_uid, (guint) fd_stat.st_mode & 0777);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gint xfce_usermon_shm_open_producer(const gchar * name)
+{
+	struct stat fd_stat;
+	gint fd;
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return -1;
+	}
+	/* the lock goes away with the process that holds it */
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+		close(fd);
+		return -1;
+	}
+	if ((fstat(fd, &fd_stat) == 0) && (fd_stat.st_uid == geteuid())) {
+		/* let other users read it, whatever the umask */
+		fchmod(fd, 0644);
+		return fd;
+	}
+
+	/* root took over a user's segment, which that user might still
+	 * write to; readers of the old one notice it's gone */
+	close(fd);
+	shm_unlink(name);
+	fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if ((fd >= 0) && (flock(fd, LOCK_EX | LOCK_NB) != 0)) {
+		close(fd);
+		fd = -1;
+	}
+	if (fd >= 0) {
+		fchmod(fd, 0644);
+	}
+
+	return fd;
+}
+#endif
+
+UserMonitorShm *xfce_usermon_shm_new(const gchar * name)
+{
+#ifdef USERMON_SHM_SUPPORTED
+	UserMonitorShm *shm = g_slice_new0(UserMonitorShm);
+
+	g_debug("xfce_usermon_shm_new %s", name);
+	shm->fd = xfce_usermon_shm_open_producer(name);
+	shm->producer = (shm->fd >= 0) ? TRUE : FALSE;
+
+	if (shm->fd < 0) {
+		/* there's a producer, or the segment belongs to another user */
+		shm->fd = shm_open(name, O_RDONLY | O_CLOEXEC, 0);
+		if (shm->fd < 0) {
+			g_debug("Failed to open %s: %s", name,
+				strerror(errno));
+			xfce_usermon_shm_free(shm);
+			return NULL;
+		}
+		if (xfce_usermon_shm_is_trusted(shm) == FALSE) {
+			xfce_usermon_shm_free(shm);
+			return NULL;
+		}
+	}
+
+	if (xfce_usermon_shm_map(shm, sizeof(UserMonitorShmHeader)) == FALSE) {
+		xfce_usermon_shm_free(shm);
+		return NULL;
+	}
+
+	if (shm->producer == TRUE) {
+		/* start over, whatever a previous producer left */
+		g_atomic_int_set(&shm->header->sequence, 0);
+		shm->header->magic = USERMON_SHM_MAGIC;
+		shm->header->version = USERMON_SHM_VERSION;
+		shm->header->capacity = shm->capacity;
+		shm->header->slots_count = 0;
+		g_atomic_int_set(&shm->header->heartbeat,
+				 xfce_usermon_shm_now());
+		g_atomic_int_set(&shm->header->sequence, 2);
+	} else if ((shm->header->magic != USERMON_SHM_MAGIC) ||
+		   (shm->header->version != USERMON_SHM_VERSION)) {
+		g_debug("Segment has an unknown format");
+		xfce_usermon_shm_free(shm);
+		return NULL;
+	}
+	g_debug("Mapped %s as %s", name,
+		(shm->producer == TRUE) ? "producer" : "reader");
+
+	return shm;
+#else
+	g_debug("No shared memory support");
+	return NULL;
+#endif
+}
+
+void xfce_usermon_shm_free(UserMonitorShm * shm)
+{
+	if (shm == NULL) {
+		return;
+	}
+
+#ifdef USERMON_SHM_SUPPORTED
+	if (shm->map != NULL) {
+		munmap(shm->map, shm->map_size);
+	}
+#endif
+	if (shm->fd >= 0) {
+		close(shm->fd);
+	}
+
+	g_slice_free(UserMonitorShm, shm);
+}
+
+gboolean xfce_usermon_shm_is_producer(UserMonitorShm * shm)
+{
+	return shm->producer;
+}
+
+/* makes room for slots_count slots, as many as utmp has; if that
+ * fails, readers are told the snapshot doesn't fit */
+static void xfce_usermon_shm_grow(UserMonitorShm * shm, guint slots_count)
+{
+#ifdef USERMON_SHM_SUPPORTED
+	guint capacity = (slots_count + USERMON_SHM_CHUNK - 1) /
+	    USERMON_SHM_CHUNK * USERMON_SHM_CHUNK;
+
+	g_debug("Growing segment to %d slots", capacity);
+	xfce_usermon_shm_map(shm, sizeof(UserMonitorShmHeader) +
+			     (gsize) capacity * sizeof(struct utmpx));
+#endif
+}
+
+void xfce_usermon_shm_publish(UserMonitorShm * shm,
+			      guint slots_count,
+			      UserMonitorScanRecordFunc get_record,
+			      gpointer user_data)
+{
+	UserMonitorShmHeader *header;
+	guint32 sequence;
+	guint slot;
+
+	g_return_if_fail(shm->producer == TRUE);
+
+	if (slots_count > shm->capacity) {
+		xfce_usermon_shm_grow(shm, slots_count);
+	}
+	header = shm->header;
+
+	/* readers retry until the sequence is even and didn't change */
+	sequence = header->sequence;
+	g_atomic_int_set(&header->sequence, sequence + 1);
+	__sync_synchronize();
+
+	header->capacity = shm->capacity;
+	for (slot = 0; (slot < slots_count) && (slot < shm->capacity); ++slot) {
+		const struct utmpx *u = get_record(slot, user_data);
+
+		if (u == NULL) {
+			slots_count = slot;
+			break;
+		}
+		shm->records[slot] = *u;
+	}
+	header->slots_count = slots_count;
+	header->heartbeat = xfce_usermon_shm_now();
+
+	__sync_synchronize();
+	g_atomic_int_set(&header->sequence, sequence + 2);
+
+	g_debug("Published %d slots, sequence %u", slots_count, sequence + 2);
+}
+
+void xfce_usermon_shm_beat(UserMonitorShm * shm)
+{
+	g_return_if_fail(shm->producer == TRUE);
+
+	g_atomic_int_set(&shm->header->heartbeat, xfce_usermon_shm_now());
+}
+
+guint32 xfce_usermon_shm_get_sequence(UserMonitorShm * shm)
+{
+	return g_atomic_int_get(&shm->header->sequence);
+}
+
+gboolean xfce_usermon_shm_is_alive(UserMonitorShm * shm, guint timeout)
+{
+	gint32 heartbeat = g_atomic_int_get(&shm->header->heartbeat);
+
+	return (xfce_usermon_shm_now() - heartbeat <= (gint32) timeout) ?
+	    TRUE : FALSE;
+}
+
+gboolean xfce_usermon_shm_read(UserMonitorShm * shm, GArray * records,
+			       guint32 * sequence)
+{
+	guint attempt;
+
+	for (attempt = 0; attempt < USERMON_SHM_RETRIES; ++attempt) {
+		UserMonitorShmHeader *header = shm->header;
+		guint32 before = g_atomic_int_get(&header->sequence);
+		guint slots_count, capacity;
+
+		if ((before & 1) != 0) {
+			/* the producer is writing */
+			g_thread_yield();
+			continue;
+		}
+		__sync_synchronize();
+
+		slots_count = header->slots_count;
+		capacity = header->capacity;
+		if (slots_count > capacity) {
+			g_debug("Snapshot has %d slots, more than %d",
+				slots_count, capacity);
+			return FALSE;
+		}
+#ifdef USERMON_SHM_SUPPORTED
+		/* the producer made room for more slots, start over with
+		 * the new mapping */
+		if (slots_count > shm->capacity) {
+			if (xfce_usermon_shm_map(shm, 0) == FALSE) {
+				return FALSE;
+			}
+			continue;
+		}
+#endif
+		g_array_set_size(records, slots_count);
+		if (slots_count > 0) {
+			memcpy(records->data, shm->records,
+			       slots_count * sizeof(struct utmpx));
+		}
+
+		__sync_synchronize();
+		if (g_atomic_int_get(&header->sequence) == before) {
+			*sequence = before;
+			return TRUE;
+		}
+	}
+	g_debug("Snapshot kept changing");
+
+	return FALSE;
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SHM_H__
+#define __USER_MONITOR_SHM_H__
+
+#include "usermon-scan.h"
+
+/* one segment per host */
+#define USERMON_SHM_NAME	"/xfce4-usermon-sessions"
+
+/* a snapshot of utmp, published by one process and read by all the
+ * others; the producer holds a lock on the segment for as long as it
+ * runs, and readers tell it's gone when its heartbeat stops; the
+ * segment holds as many slots as utmp and grows with it */
+G_BEGIN_DECLS typedef struct _UserMonitorShm UserMonitorShm;
+
+/* becomes the producer if there's none, or maps the segment read-only
+ * if it belongs to root or to the user; returns NULL if neither is
+ * possible */
+UserMonitorShm *xfce_usermon_shm_new(const gchar * name);
+
+void xfce_usermon_shm_free(UserMonitorShm * shm);
+
+gboolean xfce_usermon_shm_is_producer(UserMonitorShm * shm);
+
+/* producer only, get_record is called for slots 0 to slots_count - 1 */
+void xfce_usermon_shm_publish(UserMonitorShm * shm,
+			      guint slots_count,
+			      UserMonitorScanRecordFunc get_record,
+			      gpointer user_data);
+
+/* producer only, to be called more often than readers' timeout */
+void xfce_usermon_shm_beat(UserMonitorShm * shm);
+
+/* changes every time the snapshot is published */
+guint32 xfce_usermon_shm_get_sequence(UserMonitorShm * shm);
+
+/* whether the producer was heard from in the last timeout seconds */
+gboolean xfce_usermon_shm_is_alive(UserMonitorShm * shm, guint timeout);
+
+/* copies the snapshot to records, an array of struct utmpx, and sets
+ * sequence to its own; returns FALSE if it didn't fit in the segment
+ * or kept changing while being copied */
+gboolean xfce_usermon_shm_read(UserMonitorShm * shm, GArray * records,
+			       guint32 * sequence);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SHM_H__ */
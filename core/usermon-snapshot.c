@@ -0,0 +1,328 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-snapshot.h"
+
+#define USERMON_SNAPSHOT_MAGIC	0x53534d55	/* UMSS */
+#define USERMON_SNAPSHOT_VERSION	1
+#define USERMON_SNAPSHOT_BOOT_ID_LENGTH	40
+
+/* the snapshot file is made of this header, followed by
+ * sessions_count UserMonitorSnapshotSession */
+typedef struct {
+	guint32 magic;
+	guint32 version;
+	gchar boot_id[USERMON_SNAPSHOT_BOOT_ID_LENGTH];
+	guint32 backend;
+	guint32 sessions_count;
+	gint64 utmp_mtime;
+} UserMonitorSnapshotHeader;
+
+typedef struct {
+	UserMonitorSessionKey key;
+	gchar user_name[sizeof(((struct utmpx *) 0)->ut_user)];
+	gint64 login_time;
+} UserMonitorSnapshotSession;
+
+struct _UserMonitorSnapshot {
+	gpointer map;
+	gsize map_size;
+	const UserMonitorSnapshotHeader *header;
+	const UserMonitorSnapshotSession *sessions;
+	/* indexes of the sessions, keyed by UserMonitorSessionKey */
+	GHashTable *slots;
+	gboolean *claimed;
+};
+
+/* the sessions table, while it's being written out */
+typedef struct {
+	GArray *sessions;
+} UserMonitorSnapshotState;
+
+static void xfce_usermon_snapshot_get_boot_id(gchar * boot_id)
+{
+	gchar *contents = NULL;
+
+	memset(boot_id, 0, USERMON_SNAPSHOT_BOOT_ID_LENGTH);
+	if (g_file_get_contents(USERMON_BOOT_ID_PATH, &contents, NULL,
+				NULL) == TRUE) {
+		g_strlcpy(boot_id, g_strstrip(contents),
+			  USERMON_SNAPSHOT_BOOT_ID_LENGTH);
+		g_free(contents);
+	}
+}
+
+static void xfce_usermon_snapshot_add_user(const gchar * user_name,
+					   const GPtrArray * user_sessions,
+					   gpointer user_data)
+{
+	UserMonitorSnapshotState *state = (UserMonitorSnapshotState *) user_data;
+	guint i;
+
+	for (i = 0; i < user_sessions->len; ++i) {
+		const UserMonitorSession *session =
+		    g_ptr_array_index(user_sessions, i);
+		UserMonitorSnapshotSession saved;
+
+		/* other utmp files may not be numbered the same next time */
+		if (session->key.source != 0) {
+			continue;
+		}
+
+		memset(&saved, 0, sizeof(saved));
+		saved.key = session->key;
+		g_strlcpy(saved.user_name, user_name, sizeof(saved.user_name));
+		saved.login_time = session->login_time;
+		g_array_append_val(state->sessions, saved);
+	}
+}
+
+static gboolean xfce_usermon_snapshot_write(gint fd, gconstpointer data,
+					    gsize size)
+{
+	const gchar *ptr = (const gchar *)data;
+
+	while (size > 0) {
+		ssize_t written = write(fd, ptr, size);
+
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		ptr += written;
+		size -= written;
+	}
+
+	return TRUE;
+}
+
+UserMonitorSnapshot *xfce_usermon_snapshot_load(const gchar * path,
+						guint32 backend,
+						gint64 utmp_mtime)
+{
+#ifdef HAVE_SYS_MMAN_H
+	UserMonitorSnapshot *snapshot;
+	const UserMonitorSnapshotHeader *header;
+	gchar boot_id[USERMON_SNAPSHOT_BOOT_ID_LENGTH];
+	struct stat snapshot_stat;
+	gpointer map;
+	guint i;
+	gint fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+	if ((fstat(fd, &snapshot_stat) != 0) ||
+	    (snapshot_stat.st_size < (off_t) sizeof(UserMonitorSnapshotHeader))) {
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, snapshot_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		g_debug("Failed to map %s: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	/* sessions of another boot are all gone, and utmp going back in
+	 * time means it was replaced */
+	header = (const UserMonitorSnapshotHeader *)map;
+	xfce_usermon_snapshot_get_boot_id(boot_id);
+	if ((header->magic != USERMON_SNAPSHOT_MAGIC) ||
+	    (header->version != USERMON_SNAPSHOT_VERSION) ||
+	    (sizeof(UserMonitorSnapshotHeader) +
+	     (gsize) header->sessions_count *
+	     sizeof(UserMonitorSnapshotSession) !=
+	     (gsize) snapshot_stat.st_size) ||
+	    (boot_id[0] == '\0') ||
+	    (strncmp(header->boot_id, boot_id,
+		     USERMON_SNAPSHOT_BOOT_ID_LENGTH) != 0) ||
+	    (header->backend != backend) ||
+	    ((utmp_mtime != 0) && (header->utmp_mtime > utmp_mtime))) {
+		g_debug("Ignoring stale snapshot %s", path);
+		munmap(map, snapshot_stat.st_size);
+		return NULL;
+	}
+
+	snapshot = g_slice_new0(UserMonitorSnapshot);
+	snapshot->map = map;
+	snapshot->map_size = snapshot_stat.st_size;
+	snapshot->header = header;
+	snapshot->sessions = (const UserMonitorSnapshotSession *)
+	    ((const gchar *)map + sizeof(UserMonitorSnapshotHeader));
+	snapshot->slots = g_hash_table_new(xfce_usermon_sessions_key_hash,
+					   xfce_usermon_sessions_key_equal);
+	snapshot->claimed = g_new0(gboolean, header->sessions_count);
+	for (i = 0; i < header->sessions_count; ++i) {
+		g_hash_table_insert(snapshot->slots,
+				    (gpointer) & snapshot->sessions[i].key,
+				    GUINT_TO_POINTER(i));
+	}
+
+	g_debug("Mapped %s, %d sessions", path, header->sessions_count);
+
+	return snapshot;
+#else
+	return NULL;
+#endif
+}
+
+void xfce_usermon_snapshot_free(UserMonitorSnapshot * snapshot)
+{
+	if (snapshot == NULL) {
+		return;
+	}
+
+#ifdef HAVE_SYS_MMAN_H
+	munmap(snapshot->map, snapshot->map_size);
+#endif
+	g_hash_table_destroy(snapshot->slots);
+	g_free(snapshot->claimed);
+
+	g_slice_free(UserMonitorSnapshot, snapshot);
+}
+
+gboolean xfce_usermon_snapshot_save(const gchar * path, guint32 backend,
+				    gint64 utmp_mtime,
+				    UserMonitorSessions * sessions)
+{
+	UserMonitorSnapshotHeader header;
+	UserMonitorSnapshotState state;
+	gchar *dir, *temp_path;
+	gboolean saved;
+	gint fd;
+
+	state.sessions = g_array_new(FALSE, FALSE,
+				     sizeof(UserMonitorSnapshotSession));
+	xfce_usermon_sessions_foreach_user(sessions,
+					   xfce_usermon_snapshot_add_user,
+					   &state);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = USERMON_SNAPSHOT_MAGIC;
+	header.version = USERMON_SNAPSHOT_VERSION;
+	xfce_usermon_snapshot_get_boot_id(header.boot_id);
+	header.backend = backend;
+	header.sessions_count = state.sessions->len;
+	header.utmp_mtime = utmp_mtime;
+
+	dir = g_path_get_dirname(path);
+	g_mkdir_with_parents(dir, 0755);
+	g_free(dir);
+
+	/* replace the snapshot atomically */
+	temp_path = g_strdup_printf("%s.XXXXXX", path);
+	fd = g_mkstemp(temp_path);
+	if (fd < 0) {
+		g_debug("Failed to create %s: %s", temp_path, strerror(errno));
+		g_free(temp_path);
+		g_array_free(state.sessions, TRUE);
+		return FALSE;
+	}
+
+	saved = xfce_usermon_snapshot_write(fd, &header, sizeof(header)) &&
+	    xfce_usermon_snapshot_write(fd, state.sessions->data,
+					state.sessions->len *
+					sizeof(UserMonitorSnapshotSession));
+	if (close(fd) != 0) {
+		saved = FALSE;
+	}
+
+	if ((saved == FALSE) || (g_rename(temp_path, path) != 0)) {
+		g_debug("Failed to save %s: %s", path, strerror(errno));
+		g_unlink(temp_path);
+		saved = FALSE;
+	} else {
+		g_debug("Saved %d sessions to %s", state.sessions->len, path);
+	}
+
+	g_free(temp_path);
+	g_array_free(state.sessions, TRUE);
+
+	return saved;
+}
+
+gboolean xfce_usermon_snapshot_claim(UserMonitorSnapshot * snapshot,
+				     const UserMonitorSessionKey * key,
+				     const gchar * user_name,
+				     gint64 login_time)
+{
+	const UserMonitorSnapshotSession *saved;
+	gpointer value;
+	guint slot;
+
+	if (g_hash_table_lookup_extended(snapshot->slots, key, NULL,
+					 &value) == FALSE) {
+		return FALSE;
+	}
+	slot = GPOINTER_TO_UINT(value);
+	saved = &snapshot->sessions[slot];
+
+	/* the same line and pid, but another session */
+	if ((snapshot->claimed[slot] == TRUE) ||
+	    (saved->login_time != login_time) ||
+	    (strncmp(saved->user_name, user_name,
+		     sizeof(saved->user_name)) != 0)) {
+		return FALSE;
+	}
+	snapshot->claimed[slot] = TRUE;
+
+	return TRUE;
+}
+
+void xfce_usermon_snapshot_foreach_unclaimed(UserMonitorSnapshot * snapshot,
+					     UserMonitorSnapshotFunc func,
+					     gpointer user_data)
+{
+	gchar user_name[sizeof(snapshot->sessions->user_name) + 1];
+	guint i;
+
+	for (i = 0; i < snapshot->header->sessions_count; ++i) {
+		if (snapshot->claimed[i] == TRUE) {
+			continue;
+		}
+
+		/* not necessarily terminated */
+		memcpy(user_name, snapshot->sessions[i].user_name,
+		       sizeof(snapshot->sessions[i].user_name));
+		user_name[sizeof(snapshot->sessions[i].user_name)] = '\0';
+		func(user_name, user_data);
+	}
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SNAPSHOT_H__
+#define __USER_MONITOR_SNAPSHOT_H__
+
+#include "usermon-sessions.h"
+
+/* changes on every boot */
+#define USERMON_BOOT_ID_PATH	"/proc/sys/kernel/random/boot_id"
+
+/* the sessions known when a process stopped, so that the next one
+ * only notifies about what changed in between; only the sessions of
+ * the host's own utmp, or of logind, are kept */
+G_BEGIN_DECLS typedef struct _UserMonitorSnapshot UserMonitorSnapshot;
+
+/* called with the user name of each session that wasn't claimed */
+typedef void (*UserMonitorSnapshotFunc) (const gchar * user_name,
+					 gpointer user_data);
+
+/* returns NULL if there's no snapshot, or if it was saved during
+ * another boot, for another backend, or before utmp was last replaced;
+ * utmp_mtime is that of utmp now, or 0 if it doesn't matter */
+UserMonitorSnapshot *xfce_usermon_snapshot_load(const gchar * path,
+						guint32 backend,
+						gint64 utmp_mtime);
+
+void xfce_usermon_snapshot_free(UserMonitorSnapshot * snapshot);
+
+gboolean xfce_usermon_snapshot_save(const gchar * path, guint32 backend,
+				    gint64 utmp_mtime,
+				    UserMonitorSessions * sessions);
+
+/* returns TRUE if that session was in the snapshot, once */
+gboolean xfce_usermon_snapshot_claim(UserMonitorSnapshot * snapshot,
+				     const UserMonitorSessionKey * key,
+				     const gchar * user_name,
+				     gint64 login_time);
+
+/* sessions that ended while no process was watching */
+void xfce_usermon_snapshot_foreach_unclaimed(UserMonitorSnapshot * snapshot,
+					     UserMonitorSnapshotFunc func,
+					     gpointer user_data);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SNAPSHOT_H__ */
@@ -0,0 +1,430 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#ifdef HAVE_GLOB_H
+#include <glob.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-sources.h"
+#include "usermon-utmp.h"
+#include "usermon-watch.h"
+
+/* passes in a row a file can't be read in before its sessions end, eg
+ * while a container restarts */
+#define USERMON_SOURCES_MAX_MISSED	3
+
+typedef struct {
+	gchar *path;
+	UserMonitorUtmp *reader;
+	UserMonitorScan *scan;
+	GArray *changed_slots;
+	/* part of the running pass */
+	gboolean queued;
+	/* set by the worker */
+	gboolean scanned;
+	guint missed;
+	/* no longer matches any pattern, or missing for too long */
+	gboolean gone;
+} UserMonitorSource;
+
+struct _UserMonitorSources {
+	UserMonitorNames *names;
+	gchar **patterns;
+	GPtrArray *sources;
+	/* path to tag, so that a file that comes back keeps its own */
+	GHashTable *tags;
+	guint32 next_tag;
+	UserMonitorSourcesFunc func;
+	gpointer user_data;
+	/* workers */
+	GThreadPool *pool;
+	guint max_threads;
+	GMutex mutex;
+	guint pending_count;
+	guint merge_source_id;
+	/* found since the last scan was started */
+	gboolean changed;
+	GArray *logins;
+	GArray *logouts;
+};
+
+static void xfce_usermon_source_free(gpointer data)
+{
+	UserMonitorSource *source = (UserMonitorSource *) data;
+
+	xfce_usermon_utmp_free(source->reader);
+	xfce_usermon_scan_free(source->scan);
+	g_array_free(source->changed_slots, TRUE);
+	g_free(source->path);
+	g_slice_free(UserMonitorSource, source);
+}
+
+static const struct utmpx *xfce_usermon_source_get_record(guint slot,
+							  gpointer user_data)
+{
+	UserMonitorSource *source = (UserMonitorSource *) user_data;
+
+	return xfce_usermon_utmp_get_record(source->reader, slot);
+}
+
+static void xfce_usermon_source_scan(UserMonitorSource * source)
+{
+	/* a file whose stat didn't change isn't read */
+	g_array_set_size(source->changed_slots, 0);
+	source->scanned =
+	    xfce_usermon_utmp_scan(source->reader, source->changed_slots);
+}
+
+/* the sessions of the files scanned in the pass are diffed, and names
+ * interned, on the main thread */
+static void xfce_usermon_sources_merge(UserMonitorSources * sources)
+{
+	guint i = 0;
+
+	g_array_set_size(sources->logins, 0);
+	g_array_set_size(sources->logouts, 0);
+
+	while (i < sources->sources->len) {
+		UserMonitorSource *source =
+		    g_ptr_array_index(sources->sources, i);
+		gboolean queued = source->queued;
+		const GArray *logins, *logouts;
+
+		source->queued = FALSE;
+		if ((queued == TRUE) && (source->scanned == FALSE)) {
+			if (++source->missed >= USERMON_SOURCES_MAX_MISSED) {
+				/* the file went away, eg the container
+				 * stopped; it keeps its tag if it's back */
+				source->gone = TRUE;
+			}
+		} else if (queued == TRUE) {
+			source->missed = 0;
+		}
+
+		if (source->gone == TRUE) {
+			/* all its sessions ended */
+			xfce_usermon_scan_diff(source->scan, NULL, 0,
+					       xfce_usermon_source_get_record,
+					       source);
+		} else if ((queued == TRUE) && (source->scanned == TRUE) &&
+			   (source->changed_slots->len > 0)) {
+			xfce_usermon_scan_diff(source->scan,
+					       source->changed_slots, 0,
+					       xfce_usermon_source_get_record,
+					       source);
+		} else {
+			++i;
+			continue;
+		}
+
+		logins = xfce_usermon_scan_get_logins(source->scan);
+		logouts = xfce_usermon_scan_get_logouts(source->scan);
+		g_array_append_vals(sources->logins, logins->data,
+				    logins->len);
+		g_array_append_vals(sources->logouts, logouts->data,
+				    logouts->len);
+
+		if (source->gone == TRUE) {
+			g_debug("Removed source %s", source->path);
+			g_ptr_array_remove_index_fast(sources->sources, i);
+			continue;
+		}
+		++i;
+	}
+
+	if ((sources->logins->len > 0) || (sources->logouts->len > 0)) {
+		sources->changed = TRUE;
+		sources->func(sources->logins, sources->logouts,
+			      sources->user_data);
+	}
+}
+
+static gboolean xfce_usermon_sources_merge_later(gpointer user_data)
+{
+	UserMonitorSources *sources = (UserMonitorSources *) user_data;
+
+	sources->merge_source_id = 0;
+	xfce_usermon_sources_merge(sources);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void xfce_usermon_sources_work(gpointer data, gpointer user_data)
+{
+	UserMonitorSources *sources = (UserMonitorSources *) user_data;
+
+	xfce_usermon_source_scan((UserMonitorSource *) data);
+
+	/* the last worker of the pass hands it to the main loop */
+	g_mutex_lock(&sources->mutex);
+	if (--sources->pending_count == 0) {
+		sources->merge_source_id =
+		    g_idle_add(xfce_usermon_sources_merge_later, sources);
+	}
+	g_mutex_unlock(&sources->mutex);
+}
+
+static void xfce_usermon_sources_match(UserMonitorSources * sources,
+				       const gchar * pattern,
+				       GHashTable * paths)
+{
+#ifdef HAVE_GLOB_H
+	glob_t matches;
+	gsize i;
+
+	if (strpbrk(pattern, "*?[") != NULL) {
+		if (glob(pattern, 0, NULL, &matches) == 0) {
+			for (i = 0; i < matches.gl_pathc; ++i) {
+				g_hash_table_add(paths,
+						 g_strdup(matches.gl_pathv[i]));
+			}
+		}
+		globfree(&matches);
+		return;
+	}
+#endif
+	g_hash_table_add(paths, g_strdup(pattern));
+}
+
+/* the files that match the patterns now */
+static GHashTable *xfce_usermon_sources_find(UserMonitorSources * sources)
+{
+	GHashTable *paths = g_hash_table_new_full(g_str_hash, g_str_equal,
+						  g_free, NULL);
+	guint i;
+
+	for (i = 0;
+	     (sources->patterns != NULL) && (sources->patterns[i] != NULL);
+	     ++i) {
+		if (sources->patterns[i][0] != '\0') {
+			xfce_usermon_sources_match(sources,
+						   sources->patterns[i],
+						   paths);
+		}
+	}
+	/* the host's utmp is always looked at */
+	g_hash_table_remove(paths, USERMON_UTMP_PATH);
+
+	return paths;
+}
+
+UserMonitorSources *xfce_usermon_sources_new(UserMonitorNames * names,
+					     guint max_threads,
+					     UserMonitorSourcesFunc func,
+					     gpointer user_data)
+{
+	UserMonitorSources *sources = g_slice_new0(UserMonitorSources);
+
+	sources->names = names;
+	sources->patterns = NULL;
+	sources->sources =
+	    g_ptr_array_new_with_free_func(xfce_usermon_source_free);
+	sources->tags = g_hash_table_new_full(g_str_hash, g_str_equal,
+					      g_free, NULL);
+	/* 0 is the host's utmp */
+	sources->next_tag = 1;
+	sources->func = func;
+	sources->user_data = user_data;
+	sources->pool = NULL;
+	sources->max_threads = MAX(max_threads, 1);
+	g_mutex_init(&sources->mutex);
+	sources->pending_count = 0;
+	sources->merge_source_id = 0;
+	sources->changed = FALSE;
+	sources->logins = g_array_new(FALSE, FALSE,
+				      sizeof(UserMonitorScanEntry));
+	sources->logouts = g_array_new(FALSE, FALSE,
+				       sizeof(UserMonitorScanEntry));
+
+	return sources;
+}
+
+void xfce_usermon_sources_free(UserMonitorSources * sources)
+{
+	if (sources == NULL) {
+		return;
+	}
+
+	/* a running pass is given up */
+	if (sources->pool != NULL) {
+		g_thread_pool_free(sources->pool, FALSE, TRUE);
+	}
+	if (sources->merge_source_id > 0) {
+		g_source_remove(sources->merge_source_id);
+	}
+	g_ptr_array_free(sources->sources, TRUE);
+	g_hash_table_destroy(sources->tags);
+	g_strfreev(sources->patterns);
+	g_mutex_clear(&sources->mutex);
+	g_array_free(sources->logins, TRUE);
+	g_array_free(sources->logouts, TRUE);
+
+	g_slice_free(UserMonitorSources, sources);
+}
+
+void xfce_usermon_sources_set_patterns(UserMonitorSources * sources,
+				       const gchar * const *patterns)
+{
+	GHashTable *paths;
+	guint i;
+
+	g_strfreev(sources->patterns);
+	sources->patterns = g_strdupv((gchar **) patterns);
+
+	/* files that no longer match end with the next scan */
+	paths = xfce_usermon_sources_find(sources);
+	for (i = 0; i < sources->sources->len; ++i) {
+		UserMonitorSource *source =
+		    g_ptr_array_index(sources->sources, i);
+
+		if (g_hash_table_contains(paths, source->path) == FALSE) {
+			source->gone = TRUE;
+		}
+	}
+	g_hash_table_destroy(paths);
+
+	xfce_usermon_sources_refresh(sources);
+}
+
+void xfce_usermon_sources_refresh(UserMonitorSources * sources)
+{
+	GHashTable *paths = xfce_usermon_sources_find(sources);
+	GHashTableIter iter;
+	gpointer path, tag;
+	guint i;
+
+	/* files that still match are kept as they are; those that don't
+	 * are gone, and dropped once they've been missed a few times */
+	for (i = 0; i < sources->sources->len; ++i) {
+		UserMonitorSource *source =
+		    g_ptr_array_index(sources->sources, i);
+
+		if (source->gone == FALSE) {
+			g_hash_table_remove(paths, source->path);
+		}
+	}
+
+	g_hash_table_iter_init(&iter, paths);
+	while (g_hash_table_iter_next(&iter, &path, NULL) == TRUE) {
+		UserMonitorUtmp *reader = xfce_usermon_utmp_new(path);
+		UserMonitorSource *source;
+
+		if (reader == NULL) {
+			continue;
+		}
+
+		if (g_hash_table_lookup_extended(sources->tags, path, NULL,
+						 &tag) == FALSE) {
+			tag = GUINT_TO_POINTER(sources->next_tag++);
+			g_hash_table_insert(sources->tags, g_strdup(path),
+					    tag);
+		}
+
+		source = g_slice_new0(UserMonitorSource);
+		source->path = g_strdup(path);
+		source->reader = reader;
+		source->scan = xfce_usermon_scan_new(sources->names);
+		xfce_usermon_scan_set_source(source->scan,
+					     GPOINTER_TO_UINT(tag));
+		source->changed_slots =
+		    g_array_new(FALSE, FALSE, sizeof(guint));
+		source->queued = FALSE;
+		source->scanned = FALSE;
+		source->missed = 0;
+		source->gone = FALSE;
+		g_ptr_array_add(sources->sources, source);
+		g_debug("Added source %s", source->path);
+	}
+	g_hash_table_destroy(paths);
+}
+
+guint xfce_usermon_sources_get_count(UserMonitorSources * sources)
+{
+	return sources->sources->len;
+}
+
+gboolean xfce_usermon_sources_scan(UserMonitorSources * sources)
+{
+	gboolean changed = sources->changed;
+	guint pending_count, count = 0;
+	guint i;
+
+	sources->changed = FALSE;
+
+	/* the last pass isn't over, the files are slow */
+	g_mutex_lock(&sources->mutex);
+	pending_count = sources->pending_count;
+	g_mutex_unlock(&sources->mutex);
+	if ((pending_count > 0) || (sources->merge_source_id > 0)) {
+		return changed;
+	}
+
+	for (i = 0; i < sources->sources->len; ++i) {
+		UserMonitorSource *source =
+		    g_ptr_array_index(sources->sources, i);
+
+		source->queued = (source->gone == FALSE) ? TRUE : FALSE;
+		if (source->queued == TRUE) {
+			++count;
+		}
+	}
+
+	/* a single file is read right away */
+	if ((count <= 1) || (sources->max_threads == 1)) {
+		for (i = 0; i < sources->sources->len; ++i) {
+			UserMonitorSource *source =
+			    g_ptr_array_index(sources->sources, i);
+
+			if (source->queued == TRUE) {
+				xfce_usermon_source_scan(source);
+			}
+		}
+		xfce_usermon_sources_merge(sources);
+		changed |= sources->changed;
+		sources->changed = FALSE;
+		return changed;
+	}
+
+	if (sources->pool == NULL) {
+		sources->pool =
+		    g_thread_pool_new(xfce_usermon_sources_work, sources,
+				      sources->max_threads, FALSE, NULL);
+	}
+
+	/* stat and compare all files at once, without waiting */
+	g_mutex_lock(&sources->mutex);
+	sources->pending_count = count;
+	g_mutex_unlock(&sources->mutex);
+	for (i = 0; i < sources->sources->len; ++i) {
+		UserMonitorSource *source =
+		    g_ptr_array_index(sources->sources, i);
+
+		if (source->queued == TRUE) {
+			g_thread_pool_push(sources->pool, source, NULL);
+		}
+	}
+
+	return changed;
+}
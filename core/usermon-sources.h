@@ -0,0 +1,64 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SOURCES_H__
+#define __USER_MONITOR_SOURCES_H__
+
+#include "usermon-names.h"
+#include "usermon-scan.h"
+
+/* utmp files other than the host's, eg those of containers, scanned
+ * in parallel; sessions are tagged with their file's source number,
+ * which stays the same for a path */
+G_BEGIN_DECLS typedef struct _UserMonitorSources UserMonitorSources;
+
+/* logins and logouts are arrays of UserMonitorScanEntry, only valid
+ * for the duration of the call */
+typedef void (*UserMonitorSourcesFunc) (const GArray * logins,
+					const GArray * logouts,
+					gpointer user_data);
+
+/* func is called from the main loop when a scan finds logins or
+ * logouts */
+UserMonitorSources *xfce_usermon_sources_new(UserMonitorNames * names,
+					     guint max_threads,
+					     UserMonitorSourcesFunc func,
+					     gpointer user_data);
+
+void xfce_usermon_sources_free(UserMonitorSources * sources);
+
+/* patterns are paths, or glob patterns matching the utmp files of
+ * eg all the machines in /var/lib/machines; NULL terminated */
+void xfce_usermon_sources_set_patterns(UserMonitorSources * sources,
+				       const gchar * const *patterns);
+
+/* looks for files matching the patterns again; sessions of files
+ * that can't be read end after a few scans in a row */
+void xfce_usermon_sources_refresh(UserMonitorSources * sources);
+
+guint xfce_usermon_sources_get_count(UserMonitorSources * sources);
+
+/* starts a scan, unless the last one isn't over; with several files,
+ * they're read on worker threads and the results are merged from an
+ * idle callback; files that didn't change since the last scan are
+ * skipped; returns TRUE if logins or logouts were found since the
+ * last call */
+gboolean xfce_usermon_sources_scan(UserMonitorSources * sources);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SOURCES_H__ */
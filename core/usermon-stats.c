@@ -0,0 +1,203 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "usermon-stats.h"
+
+typedef struct {
+	volatile gint count;
+	volatile gint max;
+	volatile gssize sum;
+	volatile gint buckets[USERMON_STATS_BUCKETS];
+} UserMonitorStatsHistogram;
+
+static const gchar *counter_names[USERMON_COUNTERS_COUNT] = {
+	"scans",
+	"records_read",
+	"user_process_records",
+	"allocations",
+	"label_rebuilds",
+	"notifications_sent",
+	"notifications_dropped",
+	"timer_overruns",
+	"log_messages_dropped",
+	"proc_stats_read",
+	"proc_passes",
+	"tty_stats",
+	"sparkline_renders",
+	"group_lookups",
+	"origin_lookups",
+	"journal_records",
+	"logins",
+	"logouts"
+};
+
+static const gchar *histogram_names[USERMON_HISTOGRAMS_COUNT] = {
+	"scan_us",
+	"notification_us"
+};
+
+/* counters wrap around at 2^32 */
+static volatile gint counters[USERMON_COUNTERS_COUNT];
+static UserMonitorStatsHistogram histograms[USERMON_HISTOGRAMS_COUNT];
+
+static guint xfce_usermon_stats_get_bucket(gint64 elapsed)
+{
+	if (elapsed <= 0) {
+		return 0;
+	}
+
+	return MIN(g_bit_storage((gulong) elapsed), USERMON_STATS_BUCKETS - 1);
+}
+
+static guint xfce_usermon_stats_get_percentile(const guint * buckets,
+					       guint count, guint percent)
+{
+	guint rank = (count * percent + 99) / 100;
+	guint total = 0;
+	guint i;
+
+	/* the upper bound of the bucket the rank falls in */
+	for (i = 0; i < USERMON_STATS_BUCKETS; ++i) {
+		total += buckets[i];
+		if (total >= rank) {
+			return (1U << i) - 1;
+		}
+	}
+
+	return (1U << (USERMON_STATS_BUCKETS - 1)) - 1;
+}
+
+void xfce_usermon_stats_count(UserMonitorCounter counter, guint value)
+{
+	g_atomic_int_add(&counters[counter], (gint) value);
+}
+
+void xfce_usermon_stats_record(UserMonitorHistogram histogram,
+			       gint64 elapsed)
+{
+	UserMonitorStatsHistogram *h = &histograms[histogram];
+	gint value = (gint) MIN(elapsed, G_MAXINT);
+	gint max;
+
+	g_atomic_int_inc(&h->buckets[xfce_usermon_stats_get_bucket(elapsed)]);
+	g_atomic_int_inc(&h->count);
+	g_atomic_pointer_add(&h->sum, (gssize) value);
+
+	/* another thread may raise it in the meantime */
+	do {
+		max = g_atomic_int_get(&h->max);
+	} while ((value > max) &&
+		 (g_atomic_int_compare_and_exchange(&h->max, max, value) ==
+		  FALSE));
+}
+
+guint xfce_usermon_stats_get_count(UserMonitorCounter counter)
+{
+	return (guint) g_atomic_int_get(&counters[counter]);
+}
+
+gint64 xfce_usermon_stats_get_histogram(UserMonitorHistogram histogram,
+					guint * buckets)
+{
+	UserMonitorStatsHistogram *h = &histograms[histogram];
+	guint i;
+
+	/* each bucket is consistent, but not the set of them */
+	for (i = 0; i < USERMON_STATS_BUCKETS; ++i) {
+		buckets[i] = g_atomic_int_get(&h->buckets[i]);
+	}
+
+	return (gint64) (gssize) g_atomic_pointer_get(&h->sum);
+}
+
+gchar *xfce_usermon_stats_dump(void)
+{
+	GString *report = g_string_sized_new(1024);
+	guint i, j;
+
+	for (i = 0; i < USERMON_COUNTERS_COUNT; ++i) {
+		g_string_append_printf(report, "%s %u\n", counter_names[i],
+				       (guint) g_atomic_int_get(&counters[i]));
+	}
+
+	for (i = 0; i < USERMON_HISTOGRAMS_COUNT; ++i) {
+		UserMonitorStatsHistogram *h = &histograms[i];
+		guint buckets[USERMON_STATS_BUCKETS];
+		guint count = 0;
+
+		xfce_usermon_stats_get_histogram(i, buckets);
+		for (j = 0; j < USERMON_STATS_BUCKETS; ++j) {
+			count += buckets[j];
+		}
+
+		g_string_append_printf(report,
+				       "%s count %u max %d p50 %u p90 %u p99 %u\n",
+				       histogram_names[i], count,
+				       g_atomic_int_get(&h->max),
+				       xfce_usermon_stats_get_percentile
+				       (buckets, count, 50),
+				       xfce_usermon_stats_get_percentile
+				       (buckets, count, 90),
+				       xfce_usermon_stats_get_percentile
+				       (buckets, count, 99));
+
+		/* non-empty buckets, by upper bound */
+		g_string_append_printf(report, "%s buckets", histogram_names[i]);
+		for (j = 0; j < USERMON_STATS_BUCKETS; ++j) {
+			if (buckets[j] == 0) {
+				continue;
+			}
+			if (j < USERMON_STATS_BUCKETS - 1) {
+				g_string_append_printf(report, " <%u:%u",
+						       1U << j, buckets[j]);
+			} else {
+				g_string_append_printf(report, " >=%u:%u",
+						       1U << (j - 1),
+						       buckets[j]);
+			}
+		}
+		g_string_append_c(report, '\n');
+	}
+
+	return g_string_free(report, FALSE);
+}
+
+gboolean xfce_usermon_stats_save(const gchar * path)
+{
+	gchar *report = xfce_usermon_stats_dump();
+	GError *error = NULL;
+	gboolean saved;
+
+	/* g_file_set_contents() writes a temporary file and renames it */
+	saved = g_file_set_contents(path, report, -1, &error);
+	if (saved == FALSE) {
+		g_debug("Failed to save statistics: %s", error->message);
+		g_error_free(error);
+	} else {
+		g_debug("Saved statistics to %s", path);
+	}
+	g_free(report);
+
+	return saved;
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_STATS_H__
+#define __USER_MONITOR_STATS_H__
+
+/* bucket 0 counts values under 1 us, bucket i values from 2^(i-1)
+ * to 2^i - 1 us, and the last one everything from about 4 s */
+#define USERMON_STATS_BUCKETS	24
+
+/* process-wide counters and latency histograms, updated with atomic
+ * operations from any thread and read without stopping anything */
+G_BEGIN_DECLS typedef enum {
+	USERMON_COUNTER_SCANS = 0,
+	USERMON_COUNTER_RECORDS_READ,
+	USERMON_COUNTER_USER_PROCESS_RECORDS,
+	USERMON_COUNTER_ALLOCATIONS,
+	USERMON_COUNTER_LABEL_REBUILDS,
+	USERMON_COUNTER_NOTIFICATIONS_SENT,
+	USERMON_COUNTER_NOTIFICATIONS_DROPPED,
+	USERMON_COUNTER_TIMER_OVERRUNS,
+	USERMON_COUNTER_LOG_MESSAGES_DROPPED,
+	USERMON_COUNTER_PROC_STATS_READ,
+	USERMON_COUNTER_PROC_PASSES,
+	USERMON_COUNTER_TTY_STATS,
+	USERMON_COUNTER_SPARKLINE_RENDERS,
+	USERMON_COUNTER_GROUP_LOOKUPS,
+	USERMON_COUNTER_ORIGIN_LOOKUPS,
+	USERMON_COUNTER_JOURNAL_RECORDS,
+	USERMON_COUNTER_LOGINS,
+	USERMON_COUNTER_LOGOUTS,
+	USERMON_COUNTERS_COUNT
+} UserMonitorCounter;
+
+typedef enum {
+	USERMON_HISTOGRAM_SCAN = 0,
+	USERMON_HISTOGRAM_NOTIFICATION,
+	USERMON_HISTOGRAMS_COUNT
+} UserMonitorHistogram;
+
+void xfce_usermon_stats_count(UserMonitorCounter counter, guint value);
+
+/* elapsed is in microseconds */
+void xfce_usermon_stats_record(UserMonitorHistogram histogram,
+			       gint64 elapsed);
+
+guint xfce_usermon_stats_get_count(UserMonitorCounter counter);
+
+/* fills buckets, USERMON_STATS_BUCKETS of them, and returns the sum of
+ * the values recorded, in microseconds; it wraps around at 2^31 on 32
+ * bit hosts */
+gint64 xfce_usermon_stats_get_histogram(UserMonitorHistogram histogram,
+					guint * buckets);
+
+/* returns a newly allocated text report */
+gchar *xfce_usermon_stats_dump(void);
+
+/* writes the report to path, replacing it atomically */
+gboolean xfce_usermon_stats_save(const gchar * path);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_STATS_H__ */
@@ -0,0 +1,1625 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <utmpx.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "usermon-groups.h"
+#include "usermon-idle.h"
+#include "usermon-journal.h"
+#include "usermon-logind.h"
+#include "usermon-metrics.h"
+#include "usermon-names.h"
+#include "usermon-origins.h"
+#include "usermon-procs.h"
+#include "usermon-replay.h"
+#include "usermon-rules.h"
+#include "usermon-schedule.h"
+#include "usermon-shm.h"
+#include "usermon-snapshot.h"
+#include "usermon-sources.h"
+#include "usermon-stats.h"
+#include "usermon-tracker.h"
+#include "usermon-utmp.h"
+#include "usermon-watch.h"
+
+/* default settings */
+#define DEFAULT_MAX_USERS_COUNT	2
+#define DEFAULT_POLL_PERIOD	5
+#define DEFAULT_SHM_POLL_PERIOD	1
+#define DEFAULT_SHM_TIMEOUT	(3 * DEFAULT_POLL_PERIOD)
+#define DEFAULT_WATCH_DELAY	250
+#define DEFAULT_SOURCES_THREADS	4
+#define DEFAULT_SOURCES_REFRESH_PERIOD	30
+#define DEFAULT_PROCS_PERIOD	5
+#define DEFAULT_IDLE_PERIOD	60
+#define DEFAULT_IDLE_THREADS	4
+#define DEFAULT_GROUPS_TTL	600
+#define DEFAULT_GROUPS_NEGATIVE_TTL	60
+#define DEFAULT_ORIGINS_CAPACITY	256
+#define DEFAULT_ORIGINS_THREADS	4
+#define DEFAULT_ORIGINS_NEGATIVE_TTL	300
+#define DEFAULT_JOURNAL_SEGMENT_SIZE	(1024 * 1024)
+#define DEFAULT_JOURNAL_SEGMENTS	8
+#define DEFAULT_METRICS_PERIOD	60
+#define DEFAULT_NOTIFICATIONS_BURST	3
+#define DEFAULT_NOTIFICATIONS_PERIOD	10
+
+typedef struct {
+	gchar *group_name;
+	/* logins are critical beyond that many users of the group */
+	guint max_users_count;
+} UserMonitorTrackerGroupLimit;
+
+struct _UserMonitorTracker {
+	UserMonitorBackend backend;
+	gboolean started;
+	/* utmp backend */
+	UserMonitorWatch *watch;
+	UserMonitorSchedule *poll_schedule;
+	guint initial_source_id;
+	UserMonitorUtmp *utmp_reader;
+	GArray *changed_slots;
+	/* utmp records when they can't be mapped */
+	GArray *records;
+	/* utmp snapshot shared with other processes */
+	gboolean shared;
+	UserMonitorShm *shm;
+	guint32 shm_sequence;
+	guint beat_source_id;
+	guint restart_source_id;
+	/* readers look for a new snapshot until then, after utmp changed */
+	guint shm_wait_source_id;
+	gint64 shm_wait_end;
+	/* other utmp files, eg those of containers */
+	gchar **source_patterns;
+	UserMonitorSources *sources;
+	UserMonitorSchedule *sources_schedule;
+	guint sources_refresh_id;
+	guint sources_initial_id;
+	/* when utmp can't be watched, how often it's polled at least */
+	guint poll_period;
+	/* what the users' processes use */
+	UserMonitorProcs *procs;
+	guint procs_source_id;
+	guint max_user_cpu;
+	guint64 max_user_rss;
+	/* interned names of the users over a limit */
+	GHashTable *overloaded;
+	GHashTable *still_overloaded;
+	/* sessions whose tty wasn't used for a while */
+	UserMonitorIdle *idle;
+	guint idle_threshold;
+	guint idle_source_id;
+	/* sessions known when the last process stopped, until the
+	 * backend reports the current ones */
+	gchar *snapshot_path;
+	UserMonitorSnapshot *snapshot;
+	/* uids and groups of users, resolved away from the main loop */
+	UserMonitorGroups *groups;
+	/* UserMonitorTrackerGroupLimit */
+	GArray *group_limits;
+	/* keys of logins waiting for the groups of their user */
+	GArray *deferred_logins;
+	/* names of the hosts sessions come from */
+	UserMonitorOrigins *origins;
+	UserMonitorOriginsFunc origin_func;
+	gpointer origin_data;
+	/* what was seen, and a journal played back instead of a backend */
+	UserMonitorJournal *journal;
+	UserMonitorReplay *replay;
+	UserMonitorReplayDoneFunc replay_done_func;
+	gpointer replay_data;
+	/* exported for node_exporter */
+	UserMonitorMetrics *metrics;
+	/* logind backend */
+	UserMonitorLogind *logind;
+	/* scan engine and sessions table */
+	UserMonitorNames *names;
+	UserMonitorScan *scan;
+	UserMonitorSessions *sessions;
+	/* notifications */
+	UserMonitorDispatcher *dispatcher;
+	UserMonitorRules *rules;
+	gchar *user_name;
+	guint max_users_count;
+	UserMonitorTrackerFunc func;
+	gpointer user_data;
+};
+
+/* prototypes */
+static void xfce_usermon_tracker_stop(UserMonitorTracker * tracker);
+
+static gboolean xfce_usermon_tracker_is_active(UserMonitorTracker * tracker,
+					       const GPtrArray * user_sessions)
+{
+	gboolean any_idle = ((tracker->idle != NULL) &&
+			     (xfce_usermon_idle_get_count(tracker->idle) > 0));
+	guint i;
+
+	for (i = 0; i < user_sessions->len; ++i) {
+		const UserMonitorSession *session =
+		    g_ptr_array_index(user_sessions, i);
+
+		/* sessions the rules ignore don't count either */
+		if (xfce_usermon_rules_check(tracker->rules, &session->key,
+					     session->user_name,
+					     session->host) ==
+		    USERMON_RULES_IGNORE) {
+			continue;
+		}
+		if ((any_idle == FALSE) ||
+		    (xfce_usermon_idle_is_idle(tracker->idle, &session->key) ==
+		     FALSE)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void xfce_usermon_tracker_count_members(const gchar * user_name,
+					       const GPtrArray * user_sessions,
+					       gpointer user_data)
+{
+	gpointer *data = (gpointer *) user_data;
+	UserMonitorTracker *tracker = (UserMonitorTracker *) data[0];
+	const gchar *group_name = (const gchar *)data[1];
+	guint *count = (guint *) data[2];
+
+	/* users not resolved yet will be next time */
+	if ((xfce_usermon_groups_is_member(tracker->groups, user_name,
+					   group_name) ==
+	     USERMON_MEMBERSHIP_MEMBER) &&
+	    (xfce_usermon_tracker_is_active(tracker, user_sessions) == TRUE)) {
+		++*count;
+	}
+}
+
+/* returns FALSE if the groups of user_name aren't known yet */
+static gboolean xfce_usermon_tracker_check_groups(UserMonitorTracker *
+						  tracker,
+						  const gchar * user_name,
+						  gboolean * over_limit)
+{
+	guint i;
+
+	*over_limit = FALSE;
+	for (i = 0; i < tracker->group_limits->len; ++i) {
+		UserMonitorTrackerGroupLimit *limit =
+		    &g_array_index(tracker->group_limits,
+				   UserMonitorTrackerGroupLimit, i);
+		UserMonitorMembership membership;
+		guint count = 0;
+		gpointer data[3] = { tracker, limit->group_name, &count };
+
+		membership =
+		    xfce_usermon_groups_is_member(tracker->groups, user_name,
+						  limit->group_name);
+		if (membership == USERMON_MEMBERSHIP_UNKNOWN) {
+			return FALSE;
+		}
+		if ((membership == USERMON_MEMBERSHIP_NONE) ||
+		    (*over_limit == TRUE)) {
+			continue;
+		}
+
+		xfce_usermon_sessions_foreach_user(tracker->sessions,
+						   xfce_usermon_tracker_count_members,
+						   data);
+		if (count > limit->max_users_count) {
+			*over_limit = TRUE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void xfce_usermon_tracker_notify_for_login(UserMonitorTracker *
+						  tracker,
+						  const UserMonitorSession *
+						  session)
+{
+	UserMonitorUrgency urgency = USERMON_URGENCY_NORMAL;
+	UserMonitorRulesVerdict verdict;
+	gboolean over_limit = FALSE;
+
+	if ((tracker->dispatcher == NULL) ||
+	    (g_strcmp0(tracker->user_name, session->user_name) == 0)) {
+		return;
+	}
+
+	verdict = xfce_usermon_rules_check(tracker->rules, &session->key,
+					   session->user_name, session->host);
+	if (verdict == USERMON_RULES_IGNORE) {
+		return;
+	}
+	if ((tracker->group_limits->len > 0) &&
+	    (xfce_usermon_tracker_check_groups(tracker, session->user_name,
+					       &over_limit) == FALSE)) {
+		/* rather than block on NSS, notify once they're known */
+		g_array_append_val(tracker->deferred_logins, session->key);
+		return;
+	}
+	if ((verdict == USERMON_RULES_WATCH) || (over_limit == TRUE) ||
+	    (xfce_usermon_tracker_get_active_users_count(tracker) >
+	     tracker->max_users_count)) {
+		urgency = USERMON_URGENCY_CRITICAL;
+	}
+
+	xfce_usermon_dispatcher_add_login(tracker->dispatcher,
+					  session->user_name, session->host,
+					  xfce_usermon_sessions_get_user_count
+					  (tracker->sessions,
+					   session->user_name), urgency);
+}
+
+/* returns TRUE if the login of key was waiting for its user's groups */
+static gboolean xfce_usermon_tracker_forget_deferred(UserMonitorTracker *
+						     tracker,
+						     const UserMonitorSessionKey
+						     * key)
+{
+	guint i;
+
+	for (i = 0; i < tracker->deferred_logins->len; ++i) {
+		if (xfce_usermon_sessions_key_equal
+		    (&g_array_index(tracker->deferred_logins,
+				    UserMonitorSessionKey, i), key) == TRUE) {
+			g_array_remove_index(tracker->deferred_logins, i);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* key and host are NULL if not known */
+static void xfce_usermon_tracker_notify_for_logout(UserMonitorTracker *
+						   tracker,
+						   const UserMonitorSessionKey *
+						   key,
+						   const gchar * user_name,
+						   const gchar * host)
+{
+	g_debug("xfce_usermon_tracker_notify_for_logout %s", user_name);
+	/* a session whose login wasn't notified ends quietly too */
+	if ((key != NULL) &&
+	    (xfce_usermon_tracker_forget_deferred(tracker, key) == TRUE)) {
+		return;
+	}
+	if ((tracker->dispatcher == NULL) ||
+	    (g_strcmp0(tracker->user_name, user_name) == 0) ||
+	    (xfce_usermon_rules_check(tracker->rules, key, user_name, host) ==
+	     USERMON_RULES_IGNORE)) {
+		return;
+	}
+
+	xfce_usermon_dispatcher_add_logout(tracker->dispatcher,
+					   user_name,
+					   xfce_usermon_sessions_get_user_count
+					   (tracker->sessions,
+					    user_name),
+					   USERMON_URGENCY_NORMAL);
+}
+
+static void xfce_usermon_tracker_groups_resolved(const gchar * user_name,
+						 gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+	guint i = 0, count = 0;
+
+	user_name = xfce_usermon_names_intern(tracker->names, user_name, -1);
+	while (i < tracker->deferred_logins->len) {
+		const UserMonitorSession *session =
+		    xfce_usermon_sessions_lookup(tracker->sessions,
+						 &g_array_index
+						 (tracker->deferred_logins,
+						  UserMonitorSessionKey, i));
+
+		/* those that ended meanwhile were dropped then */
+		if ((session != NULL) && (session->user_name != user_name)) {
+			++i;
+			continue;
+		}
+		g_array_remove_index(tracker->deferred_logins, i);
+		if (session != NULL) {
+			xfce_usermon_tracker_notify_for_login(tracker,
+							      session);
+			++count;
+		}
+	}
+
+	if ((count > 0) && (tracker->dispatcher != NULL)) {
+		xfce_usermon_dispatcher_flush(tracker->dispatcher);
+	}
+}
+
+static const gchar *xfce_usermon_tracker_get_host(const gchar * host,
+						  gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	return xfce_usermon_origins_lookup(tracker->origins, host);
+}
+
+static void xfce_usermon_tracker_origin_resolved(const gchar * address,
+						 const gchar * name,
+						 gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	/* the notification first showed the address */
+	if ((name != NULL) && (tracker->dispatcher != NULL)) {
+		xfce_usermon_dispatcher_refresh_host(tracker->dispatcher,
+						     address);
+	}
+	if (tracker->origin_func != NULL) {
+		tracker->origin_func(address, name, tracker->origin_data);
+	}
+}
+
+static void xfce_usermon_tracker_write_journal(UserMonitorTracker * tracker,
+					       const GArray * logins,
+					       const GArray * logouts)
+{
+	gint64 now = g_get_real_time();
+	guint i;
+
+	/* in the order they're applied */
+	for (i = 0; i < logouts->len; ++i) {
+		xfce_usermon_journal_append(tracker->journal,
+					    USERMON_JOURNAL_LOGOUT, now,
+					    &g_array_index(logouts,
+							   UserMonitorScanEntry,
+							   i));
+	}
+	for (i = 0; i < logins->len; ++i) {
+		xfce_usermon_journal_append(tracker->journal,
+					    USERMON_JOURNAL_LOGIN, now,
+					    &g_array_index(logins,
+							   UserMonitorScanEntry,
+							   i));
+	}
+}
+
+static void xfce_usermon_tracker_apply_changes(UserMonitorTracker * tracker,
+					       const GArray * logins,
+					       const GArray * logouts)
+{
+	guint i;
+
+	/* a replay would journal the journal it replays */
+	if ((tracker->journal != NULL) && (tracker->replay == NULL)) {
+		xfce_usermon_tracker_write_journal(tracker, logins, logouts);
+	}
+
+	/* sessions that ended */
+	for (i = 0; i < logouts->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(logouts, UserMonitorScanEntry, i);
+
+		if (xfce_usermon_sessions_remove(tracker->sessions,
+						 &entry->key) == TRUE) {
+			xfce_usermon_stats_count(USERMON_COUNTER_LOGOUTS, 1);
+			if (tracker->idle != NULL) {
+				xfce_usermon_idle_remove(tracker->idle,
+							 &entry->key);
+			}
+		}
+		xfce_usermon_tracker_notify_for_logout(tracker, &entry->key,
+						       entry->user_name,
+						       entry->host);
+	}
+
+	/* sessions that started */
+	for (i = 0; i < logins->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(logins, UserMonitorScanEntry, i);
+		const UserMonitorSession *session;
+
+		session =
+		    xfce_usermon_sessions_add(tracker->sessions,
+					      &entry->key, entry->user_name,
+					      entry->host, entry->login_time);
+		if (session == NULL) {
+			continue;
+		}
+		xfce_usermon_stats_count(USERMON_COUNTER_LOGINS, 1);
+		if (tracker->idle != NULL) {
+			xfce_usermon_idle_add(tracker->idle, &entry->key);
+		}
+
+		/* already notified before a restart */
+		if ((tracker->snapshot == NULL) ||
+		    (xfce_usermon_snapshot_claim(tracker->snapshot,
+						 &entry->key,
+						 entry->user_name,
+						 entry->login_time) == FALSE)) {
+			xfce_usermon_tracker_notify_for_login(tracker,
+							      session);
+		}
+	}
+
+	/* notify for this batch of changes */
+	if (tracker->dispatcher != NULL) {
+		xfce_usermon_dispatcher_flush(tracker->dispatcher);
+	}
+
+	g_debug("Found %d users, %d sessions in total, max is %d",
+		xfce_usermon_sessions_get_users_count(tracker->sessions),
+		xfce_usermon_sessions_get_count(tracker->sessions),
+		tracker->max_users_count);
+
+	tracker->func(tracker, logins, logouts, tracker->user_data);
+}
+
+static void xfce_usermon_tracker_notify_for_gone(const gchar * user_name,
+						 gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	xfce_usermon_tracker_notify_for_logout(tracker, NULL,
+					       xfce_usermon_names_intern
+					       (tracker->names, user_name,
+						-1), NULL);
+}
+
+static void xfce_usermon_tracker_end_warm_start(UserMonitorTracker * tracker)
+{
+	if (tracker->snapshot == NULL) {
+		return;
+	}
+
+	/* sessions that ended while nobody was watching */
+	xfce_usermon_snapshot_foreach_unclaimed(tracker->snapshot,
+						xfce_usermon_tracker_notify_for_gone,
+						tracker);
+	if (tracker->dispatcher != NULL) {
+		xfce_usermon_dispatcher_flush(tracker->dispatcher);
+	}
+
+	xfce_usermon_snapshot_free(tracker->snapshot);
+	tracker->snapshot = NULL;
+}
+
+static gint64 xfce_usermon_tracker_get_utmp_mtime(UserMonitorTracker *
+						  tracker)
+{
+	struct stat utmp_stat;
+
+	if ((tracker->backend == USERMON_BACKEND_LOGIND) ||
+	    (g_stat(USERMON_UTMP_PATH, &utmp_stat) != 0)) {
+		return 0;
+	}
+
+	return utmp_stat.st_mtime;
+}
+
+static const struct utmpx *xfce_usermon_tracker_get_mapped_record(guint slot,
+								  gpointer
+								  user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	return xfce_usermon_utmp_get_record(tracker->utmp_reader, slot);
+}
+
+static const struct utmpx *xfce_usermon_tracker_get_copied_record(guint slot,
+								  gpointer
+								  user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	return &g_array_index(tracker->records, struct utmpx, slot);
+}
+
+static void xfce_usermon_tracker_read_utmp(UserMonitorTracker * tracker)
+{
+	struct utmpx *u = NULL;
+
+	g_array_set_size(tracker->records, 0);
+
+	/* rewind to the beginning of utmpx */
+	setutxent();
+	/* read utmp */
+	while ((u = getutxent())) {
+		g_array_append_vals(tracker->records, u, 1);
+	}
+	/* close utmpx */
+	endutxent();
+}
+
+static gboolean xfce_usermon_tracker_restart(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	tracker->restart_source_id = 0;
+	xfce_usermon_tracker_stop(tracker);
+	xfce_usermon_tracker_start(tracker);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean xfce_usermon_tracker_has_changes(const GArray * logins,
+						 const GArray * logouts)
+{
+	return ((logins->len > 0) || (logouts->len > 0)) ? TRUE : FALSE;
+}
+
+static gboolean xfce_usermon_tracker_update_shared(UserMonitorTracker *
+						   tracker)
+{
+	guint32 sequence = xfce_usermon_shm_get_sequence(tracker->shm);
+
+	/* this is all it takes when nothing changed */
+	if (sequence == tracker->shm_sequence) {
+		if ((xfce_usermon_shm_is_alive(tracker->shm,
+					       DEFAULT_SHM_TIMEOUT) == FALSE) &&
+		    (tracker->restart_source_id == 0)) {
+			g_debug("Producer went away");
+			/* not from the poll callback, that frees its schedule */
+			tracker->restart_source_id =
+			    g_idle_add(xfce_usermon_tracker_restart, tracker);
+		}
+		return FALSE;
+	}
+
+	if (xfce_usermon_shm_read(tracker->shm, tracker->records,
+				  &tracker->shm_sequence) == FALSE) {
+		/* don't retry until the snapshot changes again */
+		tracker->shm_sequence = sequence;
+		xfce_usermon_tracker_read_utmp(tracker);
+	}
+	g_debug("Read %d slots, sequence %u", tracker->records->len,
+		tracker->shm_sequence);
+
+	/* look at all slots */
+	xfce_usermon_scan_diff(tracker->scan, NULL, tracker->records->len,
+			       xfce_usermon_tracker_get_copied_record,
+			       tracker);
+
+	xfce_usermon_tracker_apply_changes(tracker,
+					   xfce_usermon_scan_get_logins
+					   (tracker->scan),
+					   xfce_usermon_scan_get_logouts
+					   (tracker->scan));
+	xfce_usermon_tracker_end_warm_start(tracker);
+
+	return xfce_usermon_tracker_has_changes(xfce_usermon_scan_get_logins
+						(tracker->scan),
+						xfce_usermon_scan_get_logouts
+						(tracker->scan));
+}
+
+static gboolean xfce_usermon_tracker_scan(UserMonitorTracker * tracker)
+{
+	gboolean scanned = FALSE;
+
+	g_debug("xfce_usermon_tracker_scan");
+
+	/* another process does the scanning */
+	if ((tracker->shm != NULL) &&
+	    (xfce_usermon_shm_is_producer(tracker->shm) == FALSE)) {
+		return xfce_usermon_tracker_update_shared(tracker);
+	}
+
+	/* find out which utmp slots changed since the last time */
+	if (tracker->utmp_reader != NULL) {
+		g_array_set_size(tracker->changed_slots, 0);
+		scanned = xfce_usermon_utmp_scan(tracker->utmp_reader,
+						 tracker->changed_slots);
+		if ((scanned == TRUE) && (tracker->changed_slots->len == 0)) {
+			return FALSE;
+		}
+	}
+
+	if (scanned == TRUE) {
+		g_debug("%d slots changed", tracker->changed_slots->len);
+
+		/* only look at the slots that changed */
+		xfce_usermon_scan_diff(tracker->scan, tracker->changed_slots,
+				       0,
+				       xfce_usermon_tracker_get_mapped_record,
+				       tracker);
+
+		if (tracker->shm != NULL) {
+			xfce_usermon_shm_publish(tracker->shm,
+						 xfce_usermon_utmp_get_slots_count
+						 (tracker->utmp_reader),
+						 xfce_usermon_tracker_get_mapped_record,
+						 tracker);
+		}
+	} else {
+		xfce_usermon_tracker_read_utmp(tracker);
+
+		/* look at all slots */
+		xfce_usermon_scan_diff(tracker->scan, NULL,
+				       tracker->records->len,
+				       xfce_usermon_tracker_get_copied_record,
+				       tracker);
+
+		if (tracker->shm != NULL) {
+			xfce_usermon_shm_publish(tracker->shm,
+						 tracker->records->len,
+						 xfce_usermon_tracker_get_copied_record,
+						 tracker);
+		}
+	}
+
+	xfce_usermon_tracker_apply_changes(tracker,
+					   xfce_usermon_scan_get_logins
+					   (tracker->scan),
+					   xfce_usermon_scan_get_logouts
+					   (tracker->scan));
+	xfce_usermon_tracker_end_warm_start(tracker);
+
+	return xfce_usermon_tracker_has_changes(xfce_usermon_scan_get_logins
+						(tracker->scan),
+						xfce_usermon_scan_get_logouts
+						(tracker->scan));
+}
+
+static void xfce_usermon_tracker_export_metrics(UserMonitorTracker * tracker,
+						gboolean changed)
+{
+	if (tracker->metrics != NULL) {
+		xfce_usermon_metrics_export(tracker->metrics,
+					    tracker->sessions, changed);
+	}
+}
+
+static gboolean xfce_usermon_tracker_update(UserMonitorTracker * tracker)
+{
+	gint64 start_time = g_get_monotonic_time();
+	gboolean changed = xfce_usermon_tracker_scan(tracker);
+
+	xfce_usermon_stats_count(USERMON_COUNTER_SCANS, 1);
+	xfce_usermon_stats_record(USERMON_HISTOGRAM_SCAN,
+				  g_get_monotonic_time() - start_time);
+	xfce_usermon_tracker_export_metrics(tracker, changed);
+
+	return changed;
+}
+
+static void xfce_usermon_tracker_logind_changed(const GArray * logins,
+						const GArray * logouts,
+						gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	g_debug("xfce_usermon_tracker_logind_changed");
+	xfce_usermon_tracker_apply_changes(tracker, logins, logouts);
+	xfce_usermon_tracker_end_warm_start(tracker);
+	xfce_usermon_tracker_export_metrics(tracker, TRUE);
+}
+
+static void xfce_usermon_tracker_utmp_changed(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	g_debug("xfce_usermon_tracker_utmp_changed");
+	xfce_usermon_tracker_update(tracker);
+}
+
+static gboolean xfce_usermon_tracker_poll(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	return xfce_usermon_tracker_update(tracker);
+}
+
+static gboolean xfce_usermon_tracker_wait_shared(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+	guint32 sequence = tracker->shm_sequence;
+
+	xfce_usermon_tracker_update(tracker);
+
+	/* until the snapshot changes or the producer is found gone */
+	if ((tracker->shm_sequence == sequence) &&
+	    (tracker->restart_source_id == 0) &&
+	    (g_get_monotonic_time() < tracker->shm_wait_end)) {
+		return G_SOURCE_CONTINUE;
+	}
+	tracker->shm_wait_source_id = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+/* the producer publishes what changed a little after, readers look
+ * for it then rather than polling all the time */
+static void xfce_usermon_tracker_shared_changed(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	g_debug("xfce_usermon_tracker_shared_changed");
+	tracker->shm_wait_end = g_get_monotonic_time() +
+	    (DEFAULT_SHM_TIMEOUT + 1) * G_USEC_PER_SEC;
+	if (tracker->shm_wait_source_id == 0) {
+		tracker->shm_wait_source_id =
+		    g_timeout_add(DEFAULT_WATCH_DELAY,
+				  xfce_usermon_tracker_wait_shared, tracker);
+	}
+}
+
+static void xfce_usermon_tracker_sources_changed(const GArray * logins,
+						 const GArray * logouts,
+						 gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	g_debug("xfce_usermon_tracker_sources_changed");
+	xfce_usermon_tracker_apply_changes(tracker, logins, logouts);
+	xfce_usermon_tracker_export_metrics(tracker, TRUE);
+}
+
+/* the changes are applied when the scan is over, which may be after
+ * this returns; returns TRUE if the previous scans found some */
+static gboolean xfce_usermon_tracker_update_sources(UserMonitorTracker *
+						    tracker)
+{
+	gint64 start_time = g_get_monotonic_time();
+	gboolean changed = xfce_usermon_sources_scan(tracker->sources);
+
+	xfce_usermon_stats_count(USERMON_COUNTER_SCANS, 1);
+	xfce_usermon_stats_record(USERMON_HISTOGRAM_SCAN,
+				  g_get_monotonic_time() - start_time);
+	xfce_usermon_tracker_export_metrics(tracker, FALSE);
+
+	return changed;
+}
+
+static gboolean xfce_usermon_tracker_poll_sources(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	return xfce_usermon_tracker_update_sources(tracker);
+}
+
+static gboolean xfce_usermon_tracker_refresh_sources(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	/* containers come and go */
+	xfce_usermon_sources_refresh(tracker->sources);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean xfce_usermon_tracker_initial_sources(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	tracker->sources_initial_id = 0;
+	xfce_usermon_tracker_update_sources(tracker);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void xfce_usermon_tracker_stop_sources(UserMonitorTracker * tracker)
+{
+	xfce_usermon_schedule_free(tracker->sources_schedule);
+	tracker->sources_schedule = NULL;
+	if (tracker->sources_refresh_id > 0) {
+		g_source_remove(tracker->sources_refresh_id);
+		tracker->sources_refresh_id = 0;
+	}
+	if (tracker->sources_initial_id > 0) {
+		g_source_remove(tracker->sources_initial_id);
+		tracker->sources_initial_id = 0;
+	}
+}
+
+static void xfce_usermon_tracker_start_sources(UserMonitorTracker * tracker)
+{
+	if ((tracker->source_patterns == NULL) ||
+	    (tracker->source_patterns[0] == NULL)) {
+		return;
+	}
+
+	/* kept across restarts, so that sessions aren't found again */
+	if (tracker->sources == NULL) {
+		tracker->sources =
+		    xfce_usermon_sources_new(tracker->names,
+					     DEFAULT_SOURCES_THREADS,
+					     xfce_usermon_tracker_sources_changed,
+					     tracker);
+		xfce_usermon_sources_set_patterns(tracker->sources,
+						  (const gchar * const *)
+						  tracker->source_patterns);
+	}
+
+	/* these files aren't watched, there may be many of them */
+	if (tracker->sources_schedule == NULL) {
+		tracker->sources_schedule =
+		    xfce_usermon_schedule_new(tracker->poll_period,
+					      xfce_usermon_tracker_poll_sources,
+					      tracker);
+	}
+	if (tracker->sources_refresh_id == 0) {
+		tracker->sources_refresh_id =
+		    g_timeout_add_seconds(DEFAULT_SOURCES_REFRESH_PERIOD,
+					  xfce_usermon_tracker_refresh_sources,
+					  tracker);
+	}
+	if (tracker->sources_initial_id == 0) {
+		tracker->sources_initial_id =
+		    g_idle_add(xfce_usermon_tracker_initial_sources, tracker);
+	}
+}
+
+static void xfce_usermon_tracker_check_user(const gchar * user_name,
+					    const GPtrArray * user_sessions,
+					    gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+	const UserMonitorUsage *usage;
+	uid_t uid;
+
+	/* users not resolved yet are looked at on the next pass */
+	if (xfce_usermon_groups_get_uid(tracker->groups, user_name, &uid) ==
+	    FALSE) {
+		return;
+	}
+	usage = xfce_usermon_procs_get_usage(tracker->procs, uid);
+	if ((usage == NULL) ||
+	    (((tracker->max_user_cpu == 0) ||
+	      (usage->cpu_percent <= tracker->max_user_cpu)) &&
+	     ((tracker->max_user_rss == 0) ||
+	      (usage->rss <= tracker->max_user_rss)))) {
+		return;
+	}
+
+	/* only notify when the user goes over */
+	g_hash_table_add(tracker->still_overloaded, (gpointer) user_name);
+	if ((g_hash_table_contains(tracker->overloaded, user_name) == TRUE) ||
+	    (tracker->dispatcher == NULL) ||
+	    (g_strcmp0(tracker->user_name, user_name) == 0) ||
+	    (xfce_usermon_rules_check(tracker->rules, NULL, user_name, NULL) ==
+	     USERMON_RULES_IGNORE)) {
+		return;
+	}
+	g_debug("%s is using %.0f%% CPU, %" G_GUINT64_FORMAT " bytes",
+		user_name, usage->cpu_percent, usage->rss);
+	xfce_usermon_dispatcher_add_usage(tracker->dispatcher, user_name,
+					  usage->cpu_percent, usage->rss,
+					  USERMON_URGENCY_CRITICAL);
+}
+
+static gboolean xfce_usermon_tracker_account(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+	GHashTable *overloaded;
+
+	if (xfce_usermon_procs_update(tracker->procs) == FALSE) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	/* only logged in users are looked at */
+	xfce_usermon_sessions_foreach_user(tracker->sessions,
+					   xfce_usermon_tracker_check_user,
+					   tracker);
+	overloaded = tracker->overloaded;
+	tracker->overloaded = tracker->still_overloaded;
+	tracker->still_overloaded = overloaded;
+	g_hash_table_remove_all(tracker->still_overloaded);
+
+	if (tracker->dispatcher != NULL) {
+		xfce_usermon_dispatcher_flush(tracker->dispatcher);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void xfce_usermon_tracker_stop_procs(UserMonitorTracker * tracker)
+{
+	if (tracker->procs_source_id > 0) {
+		g_source_remove(tracker->procs_source_id);
+		tracker->procs_source_id = 0;
+	}
+}
+
+static void xfce_usermon_tracker_start_procs(UserMonitorTracker * tracker)
+{
+	if (((tracker->max_user_cpu == 0) && (tracker->max_user_rss == 0)) ||
+	    (tracker->procs_source_id > 0)) {
+		return;
+	}
+
+	/* kept across restarts, processes are known already */
+	if (tracker->procs == NULL) {
+		tracker->procs = xfce_usermon_procs_new(USERMON_PROC_PATH);
+		if (tracker->procs == NULL) {
+			return;
+		}
+		/* a baseline for CPU usage */
+		xfce_usermon_procs_update(tracker->procs);
+	}
+
+	tracker->procs_source_id =
+	    g_timeout_add_seconds(DEFAULT_PROCS_PERIOD,
+				  xfce_usermon_tracker_account, tracker);
+}
+
+static void xfce_usermon_tracker_add_idle(const gchar * user_name,
+					  const GPtrArray * user_sessions,
+					  gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+	guint i;
+
+	for (i = 0; i < user_sessions->len; ++i) {
+		const UserMonitorSession *session =
+		    g_ptr_array_index(user_sessions, i);
+
+		xfce_usermon_idle_add(tracker->idle, &session->key);
+	}
+}
+
+static void xfce_usermon_tracker_reset_idle(UserMonitorTracker * tracker)
+{
+	xfce_usermon_idle_free(tracker->idle);
+	tracker->idle = NULL;
+	if (tracker->idle_threshold == 0) {
+		return;
+	}
+
+	tracker->idle = xfce_usermon_idle_new(tracker->idle_threshold,
+					      DEFAULT_IDLE_THREADS);
+	xfce_usermon_sessions_foreach_user(tracker->sessions,
+					   xfce_usermon_tracker_add_idle,
+					   tracker);
+}
+
+static gboolean xfce_usermon_tracker_check_idle(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+	GArray *none;
+
+	if (xfce_usermon_idle_update(tracker->idle) == FALSE) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	/* no session came or went, but the counts changed */
+	none = g_array_new(FALSE, FALSE, sizeof(UserMonitorScanEntry));
+	tracker->func(tracker, none, none, tracker->user_data);
+	g_array_free(none, TRUE);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void xfce_usermon_tracker_stop_idle(UserMonitorTracker * tracker)
+{
+	if (tracker->idle_source_id > 0) {
+		g_source_remove(tracker->idle_source_id);
+		tracker->idle_source_id = 0;
+	}
+}
+
+static void xfce_usermon_tracker_start_idle(UserMonitorTracker * tracker)
+{
+	if ((tracker->idle == NULL) || (tracker->idle_source_id > 0)) {
+		return;
+	}
+
+	tracker->idle_source_id =
+	    g_timeout_add_seconds(DEFAULT_IDLE_PERIOD,
+				  xfce_usermon_tracker_check_idle, tracker);
+}
+
+static gboolean xfce_usermon_tracker_beat(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	xfce_usermon_shm_beat(tracker->shm);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean xfce_usermon_tracker_initial_update(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	g_debug("xfce_usermon_tracker_initial_update");
+	tracker->initial_source_id = 0;
+	xfce_usermon_tracker_update(tracker);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void xfce_usermon_tracker_stop(UserMonitorTracker * tracker)
+{
+	xfce_usermon_replay_free(tracker->replay);
+	tracker->replay = NULL;
+	xfce_usermon_logind_free(tracker->logind);
+	tracker->logind = NULL;
+
+	xfce_usermon_tracker_stop_sources(tracker);
+	xfce_usermon_tracker_stop_procs(tracker);
+	xfce_usermon_tracker_stop_idle(tracker);
+	xfce_usermon_snapshot_free(tracker->snapshot);
+	tracker->snapshot = NULL;
+
+	xfce_usermon_watch_free(tracker->watch);
+	tracker->watch = NULL;
+	xfce_usermon_schedule_free(tracker->poll_schedule);
+	tracker->poll_schedule = NULL;
+	if (tracker->initial_source_id > 0) {
+		g_source_remove(tracker->initial_source_id);
+		tracker->initial_source_id = 0;
+	}
+	if (tracker->beat_source_id > 0) {
+		g_source_remove(tracker->beat_source_id);
+		tracker->beat_source_id = 0;
+	}
+	if (tracker->restart_source_id > 0) {
+		g_source_remove(tracker->restart_source_id);
+		tracker->restart_source_id = 0;
+	}
+	if (tracker->shm_wait_source_id > 0) {
+		g_source_remove(tracker->shm_wait_source_id);
+		tracker->shm_wait_source_id = 0;
+	}
+
+	/* let another process take over */
+	xfce_usermon_shm_free(tracker->shm);
+	tracker->shm = NULL;
+
+	/* unmap utmp */
+	xfce_usermon_utmp_free(tracker->utmp_reader);
+	tracker->utmp_reader = NULL;
+
+	tracker->started = FALSE;
+}
+
+static void xfce_usermon_tracker_clear_group_limits(UserMonitorTracker *
+						    tracker)
+{
+	guint i;
+
+	for (i = 0; i < tracker->group_limits->len; ++i) {
+		g_free(g_array_index(tracker->group_limits,
+				     UserMonitorTrackerGroupLimit,
+				     i).group_name);
+	}
+	g_array_set_size(tracker->group_limits, 0);
+}
+
+UserMonitorTracker *xfce_usermon_tracker_new(UserMonitorTrackerFunc func,
+					     UserMonitorDeliverFunc
+					     deliver_func, gpointer user_data)
+{
+	UserMonitorTracker *tracker = g_slice_new0(UserMonitorTracker);
+
+	tracker->backend = USERMON_BACKEND_UTMP;
+	tracker->started = FALSE;
+	tracker->changed_slots = g_array_new(FALSE, FALSE, sizeof(guint));
+	tracker->records = g_array_new(FALSE, FALSE, sizeof(struct utmpx));
+	tracker->shared = FALSE;
+	tracker->poll_period = DEFAULT_POLL_PERIOD;
+	tracker->source_patterns = NULL;
+	tracker->sources = NULL;
+	tracker->procs = NULL;
+	tracker->max_user_cpu = 0;
+	tracker->max_user_rss = 0;
+	tracker->overloaded = g_hash_table_new(g_direct_hash, g_direct_equal);
+	tracker->still_overloaded =
+	    g_hash_table_new(g_direct_hash, g_direct_equal);
+	tracker->idle = NULL;
+	tracker->idle_threshold = 0;
+	tracker->snapshot_path = NULL;
+	tracker->snapshot = NULL;
+	tracker->groups =
+	    xfce_usermon_groups_new(DEFAULT_GROUPS_TTL,
+				    DEFAULT_GROUPS_NEGATIVE_TTL, NULL,
+				    xfce_usermon_tracker_groups_resolved,
+				    tracker);
+	tracker->group_limits =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorTrackerGroupLimit));
+	tracker->deferred_logins =
+	    g_array_new(FALSE, FALSE, sizeof(UserMonitorSessionKey));
+	tracker->origins =
+	    xfce_usermon_origins_new(DEFAULT_ORIGINS_CAPACITY,
+				     DEFAULT_ORIGINS_THREADS,
+				     DEFAULT_ORIGINS_NEGATIVE_TTL,
+				     xfce_usermon_tracker_origin_resolved,
+				     tracker);
+	tracker->origin_func = NULL;
+	tracker->origin_data = NULL;
+	tracker->journal = NULL;
+	tracker->replay = NULL;
+	tracker->metrics = NULL;
+	tracker->names = xfce_usermon_names_new();
+	tracker->scan = xfce_usermon_scan_new(tracker->names);
+	tracker->sessions = xfce_usermon_sessions_new();
+
+	/* notifications are batched and rate limited */
+	if (deliver_func != NULL) {
+		tracker->dispatcher =
+		    xfce_usermon_dispatcher_new(DEFAULT_NOTIFICATIONS_BURST,
+						DEFAULT_NOTIFICATIONS_PERIOD,
+						deliver_func, user_data);
+		xfce_usermon_dispatcher_set_host_func(tracker->dispatcher,
+						      xfce_usermon_tracker_get_host,
+						      tracker);
+	}
+	tracker->rules = NULL;
+	tracker->user_name = NULL;
+	tracker->max_users_count = DEFAULT_MAX_USERS_COUNT;
+	tracker->func = func;
+	tracker->user_data = user_data;
+
+	return tracker;
+}
+
+void xfce_usermon_tracker_free(UserMonitorTracker * tracker)
+{
+	if (tracker == NULL) {
+		return;
+	}
+
+	xfce_usermon_tracker_stop(tracker);
+
+	xfce_usermon_sources_free(tracker->sources);
+	g_strfreev(tracker->source_patterns);
+	xfce_usermon_procs_free(tracker->procs);
+	g_hash_table_destroy(tracker->overloaded);
+	g_hash_table_destroy(tracker->still_overloaded);
+	xfce_usermon_idle_free(tracker->idle);
+	/* before the sessions its results would be applied to */
+	xfce_usermon_groups_free(tracker->groups);
+	xfce_usermon_tracker_clear_group_limits(tracker);
+	g_array_free(tracker->group_limits, TRUE);
+	g_array_free(tracker->deferred_logins, TRUE);
+	xfce_usermon_origins_free(tracker->origins);
+	xfce_usermon_journal_free(tracker->journal);
+	xfce_usermon_metrics_free(tracker->metrics);
+	xfce_usermon_dispatcher_free(tracker->dispatcher);
+	xfce_usermon_rules_free(tracker->rules);
+	xfce_usermon_sessions_free(tracker->sessions);
+	xfce_usermon_scan_free(tracker->scan);
+	xfce_usermon_names_free(tracker->names);
+	g_array_free(tracker->records, TRUE);
+	g_array_free(tracker->changed_slots, TRUE);
+	g_free(tracker->user_name);
+	g_free(tracker->snapshot_path);
+
+	g_slice_free(UserMonitorTracker, tracker);
+}
+
+void xfce_usermon_tracker_set_user_name(UserMonitorTracker * tracker,
+					const gchar * user_name)
+{
+	g_free(tracker->user_name);
+	tracker->user_name = g_strdup(user_name);
+}
+
+void xfce_usermon_tracker_set_rules(UserMonitorTracker * tracker,
+				    const gchar * const *rules)
+{
+	/* compiled once, checked for each notification */
+	xfce_usermon_rules_free(tracker->rules);
+	tracker->rules = xfce_usermon_rules_new(rules);
+}
+
+void xfce_usermon_tracker_set_max_users_count(UserMonitorTracker * tracker,
+					      guint max_users_count)
+{
+	tracker->max_users_count = max_users_count;
+}
+
+void xfce_usermon_tracker_set_group_limits(UserMonitorTracker * tracker,
+					   const gchar * const *limits)
+{
+	guint i;
+
+	xfce_usermon_tracker_clear_group_limits(tracker);
+	for (i = 0; (limits != NULL) && (limits[i] != NULL); ++i) {
+		UserMonitorTrackerGroupLimit limit;
+		const gchar *separator = strrchr(limits[i], ':');
+		gchar *end = NULL;
+		guint64 max_users_count;
+
+		if ((separator == NULL) || (separator == limits[i])) {
+			g_debug("Skipping group limit %s", limits[i]);
+			continue;
+		}
+		max_users_count =
+		    g_ascii_strtoull(separator + 1, &end, 10);
+		if ((end == separator + 1) || (*end != '\0') ||
+		    (max_users_count > G_MAXUINT)) {
+			g_debug("Skipping group limit %s", limits[i]);
+			continue;
+		}
+
+		limit.group_name = g_strndup(limits[i], separator - limits[i]);
+		limit.max_users_count = (guint) max_users_count;
+		g_array_append_val(tracker->group_limits, limit);
+	}
+}
+
+void xfce_usermon_tracker_set_shared(UserMonitorTracker * tracker,
+				     gboolean shared)
+{
+	tracker->shared = shared;
+}
+
+void xfce_usermon_tracker_set_poll_period(UserMonitorTracker * tracker,
+					  guint poll_period)
+{
+	tracker->poll_period = MAX(poll_period, 1);
+
+	/* shared memory readers keep their own, shorter period */
+	if ((tracker->poll_schedule != NULL) && (tracker->shm == NULL)) {
+		xfce_usermon_schedule_set_period(tracker->poll_schedule,
+						 tracker->poll_period);
+	}
+	if (tracker->sources_schedule != NULL) {
+		xfce_usermon_schedule_set_period(tracker->sources_schedule,
+						 tracker->poll_period);
+	}
+}
+
+void xfce_usermon_tracker_set_user_limits(UserMonitorTracker * tracker,
+					  guint max_cpu, guint64 max_rss)
+{
+	tracker->max_user_cpu = max_cpu;
+	tracker->max_user_rss = max_rss;
+
+	if ((max_cpu == 0) && (max_rss == 0)) {
+		xfce_usermon_tracker_stop_procs(tracker);
+		g_hash_table_remove_all(tracker->overloaded);
+	} else if (tracker->started == TRUE) {
+		xfce_usermon_tracker_start_procs(tracker);
+	}
+}
+
+void xfce_usermon_tracker_set_idle_threshold(UserMonitorTracker * tracker,
+					     guint idle_threshold)
+{
+	if (tracker->idle_threshold == idle_threshold) {
+		return;
+	}
+	tracker->idle_threshold = idle_threshold;
+
+	xfce_usermon_tracker_stop_idle(tracker);
+	xfce_usermon_tracker_reset_idle(tracker);
+	if (tracker->idle != NULL) {
+		/* sessions known already are looked at right away */
+		xfce_usermon_idle_update(tracker->idle);
+		if (tracker->started == TRUE) {
+			xfce_usermon_tracker_start_idle(tracker);
+		}
+	}
+}
+
+guint xfce_usermon_tracker_get_idle_count(UserMonitorTracker * tracker)
+{
+	return (tracker->idle != NULL) ?
+	    xfce_usermon_idle_get_count(tracker->idle) : 0;
+}
+
+static void xfce_usermon_tracker_count_active(const gchar * user_name,
+					      const GPtrArray * user_sessions,
+					      gpointer user_data)
+{
+	gpointer *data = (gpointer *) user_data;
+	UserMonitorTracker *tracker = (UserMonitorTracker *) data[0];
+	guint *count = (guint *) data[1];
+
+	if (xfce_usermon_tracker_is_active(tracker, user_sessions) == TRUE) {
+		++*count;
+	}
+}
+
+guint xfce_usermon_tracker_get_active_users_count(UserMonitorTracker *
+						  tracker)
+{
+	guint count = 0;
+	gpointer data[2] = { tracker, &count };
+
+	if (((tracker->idle == NULL) ||
+	     (xfce_usermon_idle_get_count(tracker->idle) == 0)) &&
+	    ((tracker->rules == NULL) ||
+	     (xfce_usermon_rules_get_count(tracker->rules) == 0))) {
+		return xfce_usermon_sessions_get_users_count(tracker->sessions);
+	}
+
+	xfce_usermon_sessions_foreach_user(tracker->sessions,
+					   xfce_usermon_tracker_count_active,
+					   data);
+
+	return count;
+}
+
+void xfce_usermon_tracker_set_sources(UserMonitorTracker * tracker,
+				      const gchar * const *patterns)
+{
+	g_strfreev(tracker->source_patterns);
+	tracker->source_patterns = g_strdupv((gchar **) patterns);
+
+	if (tracker->sources != NULL) {
+		/* end the sessions of files that no longer match now */
+		xfce_usermon_sources_set_patterns(tracker->sources, patterns);
+		if (tracker->started == TRUE) {
+			xfce_usermon_tracker_update_sources(tracker);
+		}
+	}
+
+	if ((tracker->source_patterns == NULL) ||
+	    (tracker->source_patterns[0] == NULL)) {
+		xfce_usermon_tracker_stop_sources(tracker);
+	} else if (tracker->started == TRUE) {
+		xfce_usermon_tracker_start_sources(tracker);
+	}
+}
+
+void xfce_usermon_tracker_set_snapshot_path(UserMonitorTracker * tracker,
+					    const gchar * snapshot_path)
+{
+	g_free(tracker->snapshot_path);
+	tracker->snapshot_path = g_strdup(snapshot_path);
+}
+
+gboolean xfce_usermon_tracker_save_snapshot(UserMonitorTracker * tracker)
+{
+	/* until then, the sessions table isn't complete; those of a
+	 * replay aren't this host's */
+	if ((tracker->snapshot_path == NULL) || (tracker->started == FALSE) ||
+	    (tracker->snapshot != NULL) || (tracker->replay != NULL)) {
+		return FALSE;
+	}
+
+	return xfce_usermon_snapshot_save(tracker->snapshot_path,
+					  tracker->backend,
+					  xfce_usermon_tracker_get_utmp_mtime
+					  (tracker), tracker->sessions);
+}
+
+void xfce_usermon_tracker_set_journal_path(UserMonitorTracker * tracker,
+					   const gchar * journal_path)
+{
+	xfce_usermon_journal_free(tracker->journal);
+	tracker->journal = NULL;
+	if (journal_path != NULL) {
+		tracker->journal =
+		    xfce_usermon_journal_new(journal_path,
+					     DEFAULT_JOURNAL_SEGMENT_SIZE,
+					     DEFAULT_JOURNAL_SEGMENTS);
+	}
+}
+
+void xfce_usermon_tracker_set_metrics_path(UserMonitorTracker * tracker,
+					   const gchar * metrics_path)
+{
+	xfce_usermon_metrics_free(tracker->metrics);
+	tracker->metrics = NULL;
+	if (metrics_path != NULL) {
+		tracker->metrics =
+		    xfce_usermon_metrics_new(metrics_path,
+					     DEFAULT_METRICS_PERIOD);
+		if (tracker->started == TRUE) {
+			xfce_usermon_tracker_export_metrics(tracker, TRUE);
+		}
+	}
+}
+
+static void xfce_usermon_tracker_replay_changed(const GArray * logins,
+						const GArray * logouts,
+						gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	xfce_usermon_tracker_apply_changes(tracker, logins, logouts);
+	xfce_usermon_tracker_export_metrics(tracker, TRUE);
+}
+
+static void xfce_usermon_tracker_replay_done(gpointer user_data)
+{
+	UserMonitorTracker *tracker = (UserMonitorTracker *) user_data;
+
+	if (tracker->replay_done_func != NULL) {
+		tracker->replay_done_func(tracker->replay_data);
+	}
+}
+
+gboolean xfce_usermon_tracker_start_replay(UserMonitorTracker * tracker,
+					   const gchar * path, gdouble speed,
+					   UserMonitorReplayDoneFunc done_func,
+					   gpointer user_data)
+{
+	if (tracker->started == TRUE) {
+		return FALSE;
+	}
+
+	tracker->replay_done_func = done_func;
+	tracker->replay_data = user_data;
+	tracker->replay =
+	    xfce_usermon_replay_new(path, speed, tracker->names,
+				    xfce_usermon_tracker_replay_changed,
+				    xfce_usermon_tracker_replay_done, tracker);
+	if (tracker->replay == NULL) {
+		return FALSE;
+	}
+	tracker->started = TRUE;
+
+	return TRUE;
+}
+
+void xfce_usermon_tracker_set_backend(UserMonitorTracker * tracker,
+				      UserMonitorBackend backend)
+{
+	gboolean started = tracker->started;
+
+	g_debug("xfce_usermon_tracker_set_backend %d", backend);
+	if (tracker->backend == backend) {
+		return;
+	}
+
+	xfce_usermon_tracker_stop(tracker);
+	tracker->backend = backend;
+
+	/* start over, keys from one backend mean nothing to the other */
+	xfce_usermon_sessions_free(tracker->sessions);
+	tracker->sessions = xfce_usermon_sessions_new();
+	xfce_usermon_scan_free(tracker->scan);
+	tracker->scan = xfce_usermon_scan_new(tracker->names);
+	xfce_usermon_sources_free(tracker->sources);
+	tracker->sources = NULL;
+	xfce_usermon_tracker_reset_idle(tracker);
+	g_array_set_size(tracker->deferred_logins, 0);
+
+	if (started == TRUE) {
+		xfce_usermon_tracker_start(tracker);
+	}
+}
+
+UserMonitorBackend xfce_usermon_tracker_get_backend(UserMonitorTracker *
+						    tracker)
+{
+	return tracker->backend;
+}
+
+void xfce_usermon_tracker_start(UserMonitorTracker * tracker)
+{
+	if (tracker->started == TRUE) {
+		return;
+	}
+	tracker->started = TRUE;
+
+	/* whatever the backend */
+	xfce_usermon_tracker_start_sources(tracker);
+	xfce_usermon_tracker_start_procs(tracker);
+	xfce_usermon_tracker_start_idle(tracker);
+
+	/* pick up where the last process left off */
+	if ((tracker->snapshot_path != NULL) &&
+	    (xfce_usermon_sessions_get_count(tracker->sessions) == 0)) {
+		tracker->snapshot =
+		    xfce_usermon_snapshot_load(tracker->snapshot_path,
+					       tracker->backend,
+					       xfce_usermon_tracker_get_utmp_mtime
+					       (tracker));
+	}
+
+	/* logind tells about sessions as they come and go */
+	if (tracker->backend == USERMON_BACKEND_LOGIND) {
+		tracker->logind =
+		    xfce_usermon_logind_new(g_getenv("USERMON_LOGIND_ADDRESS"),
+					    tracker->names,
+					    xfce_usermon_tracker_logind_changed,
+					    tracker);
+		if (tracker->logind != NULL) {
+			return;
+		}
+		g_debug("Falling back to utmp");
+	}
+
+	/* one process scans utmp for all */
+	if (tracker->shared == TRUE) {
+		tracker->shm = xfce_usermon_shm_new(USERMON_SHM_NAME);
+	}
+	if ((tracker->shm != NULL) &&
+	    (xfce_usermon_shm_is_producer(tracker->shm) == FALSE)) {
+		if (xfce_usermon_shm_is_alive(tracker->shm,
+					      DEFAULT_SHM_TIMEOUT) == TRUE) {
+			/* odd, so that the first snapshot is read */
+			tracker->shm_sequence = 1;
+			/* sessions only change along with utmp */
+			tracker->watch =
+			    xfce_usermon_watch_new(USERMON_UTMP_PATH,
+						   DEFAULT_WATCH_DELAY,
+						   xfce_usermon_tracker_shared_changed,
+						   tracker);
+			/* cheap, as long as the sequence doesn't change */
+			if (tracker->watch == NULL) {
+				tracker->poll_schedule =
+				    xfce_usermon_schedule_new
+				    (DEFAULT_SHM_POLL_PERIOD,
+				     xfce_usermon_tracker_poll, tracker);
+			}
+			tracker->initial_source_id =
+			    g_idle_add(xfce_usermon_tracker_initial_update,
+				       tracker);
+			return;
+		}
+
+		/* left behind by a producer that can't be replaced */
+		g_debug("Segment is stale");
+		xfce_usermon_shm_free(tracker->shm);
+		tracker->shm = NULL;
+	}
+
+	/* map utmp, fall back to getutxent() if that's not possible */
+	tracker->utmp_reader = xfce_usermon_utmp_new(USERMON_UTMP_PATH);
+
+	/* watch utmp for changes, poll if that's not possible */
+	tracker->watch = xfce_usermon_watch_new(USERMON_UTMP_PATH,
+						DEFAULT_WATCH_DELAY,
+						xfce_usermon_tracker_utmp_changed,
+						tracker);
+	if (tracker->watch == NULL) {
+		g_debug("Falling back to polling");
+		tracker->poll_schedule =
+		    xfce_usermon_schedule_new(tracker->poll_period,
+					      xfce_usermon_tracker_poll,
+					      tracker);
+	}
+
+	/* tell readers this process is still there */
+	if (tracker->shm != NULL) {
+		tracker->beat_source_id =
+		    g_timeout_add_seconds(DEFAULT_POLL_PERIOD,
+					  xfce_usermon_tracker_beat, tracker);
+	}
+
+	/* don't wait for the first change */
+	tracker->initial_source_id =
+	    g_idle_add(xfce_usermon_tracker_initial_update, tracker);
+}
+
+UserMonitorSessions *xfce_usermon_tracker_get_sessions(UserMonitorTracker *
+						       tracker)
+{
+	return tracker->sessions;
+}
+
+void xfce_usermon_tracker_set_origin_func(UserMonitorTracker * tracker,
+					  UserMonitorOriginsFunc func,
+					  gpointer user_data)
+{
+	tracker->origin_func = func;
+	tracker->origin_data = user_data;
+}
+
+const gchar *xfce_usermon_tracker_lookup_origin(UserMonitorTracker * tracker,
+						const gchar * host)
+{
+	return xfce_usermon_origins_lookup(tracker->origins, host);
+}
@@ -0,0 +1,159 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_TRACKER_H__
+#define __USER_MONITOR_TRACKER_H__
+
+#include "usermon-dispatch.h"
+#include "usermon-origins.h"
+#include "usermon-replay.h"
+#include "usermon-scan.h"
+#include "usermon-sessions.h"
+
+/* where sessions are found */
+G_BEGIN_DECLS typedef enum {
+	USERMON_BACKEND_UTMP = 0,
+	USERMON_BACKEND_LOGIND
+} UserMonitorBackend;
+
+/* keeps the sessions table up to date from the selected backend, and
+ * decides what deserves a notification */
+typedef struct _UserMonitorTracker UserMonitorTracker;
+
+/* logins and logouts are arrays of UserMonitorScanEntry, only valid
+ * for the duration of the call */
+typedef void (*UserMonitorTrackerFunc) (UserMonitorTracker * tracker,
+					const GArray * logins,
+					const GArray * logouts,
+					gpointer user_data);
+
+/* deliver_func may be NULL if notifications aren't wanted */
+UserMonitorTracker *xfce_usermon_tracker_new(UserMonitorTrackerFunc func,
+					     UserMonitorDeliverFunc
+					     deliver_func, gpointer user_data);
+
+void xfce_usermon_tracker_free(UserMonitorTracker * tracker);
+
+/* sessions of that user aren't notified */
+void xfce_usermon_tracker_set_user_name(UserMonitorTracker * tracker,
+					const gchar * user_name);
+
+/* ignore and watch rules, NULL terminated, see usermon-rules.h; the
+ * sessions they ignore aren't notified, and those they watch are
+ * notified as critical */
+void xfce_usermon_tracker_set_rules(UserMonitorTracker * tracker,
+				    const gchar * const *rules);
+
+/* logins are critical beyond that many users */
+void xfce_usermon_tracker_set_max_users_count(UserMonitorTracker * tracker,
+					      guint max_users_count);
+
+/* per group thresholds, NULL terminated, each "GROUP:MAX" where
+ * logins of members are critical beyond MAX users of that group, eg
+ * "contractors:0" for any of them; groups are resolved in the
+ * background, and logins notified once those of their user are known */
+void xfce_usermon_tracker_set_group_limits(UserMonitorTracker * tracker,
+					   const gchar * const *limits);
+
+/* with the utmp backend, whether to scan utmp for all processes that
+ * share it, or use what another one found; takes effect on start */
+void xfce_usermon_tracker_set_shared(UserMonitorTracker * tracker,
+				     gboolean shared);
+
+/* logged in users whose processes use more than max_cpu percent of a
+ * core, or more than max_rss bytes of memory, are notified as critical;
+ * 0 means no limit */
+void xfce_usermon_tracker_set_user_limits(UserMonitorTracker * tracker,
+					  guint max_cpu, guint64 max_rss);
+
+/* sessions whose tty wasn't used for idle_threshold seconds are idle,
+ * and users with only idle sessions don't count towards the maximum;
+ * 0 means sessions are never idle */
+void xfce_usermon_tracker_set_idle_threshold(UserMonitorTracker * tracker,
+					     guint idle_threshold);
+
+guint xfce_usermon_tracker_get_idle_count(UserMonitorTracker * tracker);
+
+/* users with at least one session that is neither idle nor ignored */
+guint xfce_usermon_tracker_get_active_users_count(UserMonitorTracker *
+						  tracker);
+
+/* when utmp can't be watched, it's polled that often, less often
+ * while nothing changes and more often after something did */
+void xfce_usermon_tracker_set_poll_period(UserMonitorTracker * tracker,
+					  guint poll_period);
+
+/* more utmp files to scan, paths or glob patterns, NULL terminated;
+ * their sessions are added to those of the backend */
+void xfce_usermon_tracker_set_sources(UserMonitorTracker * tracker,
+				      const gchar * const *patterns);
+
+/* where the sessions are saved, so that after a restart only the
+ * sessions that started or ended in between are notified; takes effect
+ * on start */
+void xfce_usermon_tracker_set_snapshot_path(UserMonitorTracker * tracker,
+					    const gchar * snapshot_path);
+
+/* returns FALSE if there's no path, or if the backend didn't report
+ * the current sessions yet */
+gboolean xfce_usermon_tracker_save_snapshot(UserMonitorTracker * tracker);
+
+/* where the logins and logouts seen are recorded, see
+ * usermon-journal.h; NULL for nowhere */
+void xfce_usermon_tracker_set_journal_path(UserMonitorTracker * tracker,
+					   const gchar * journal_path);
+
+/* where the sessions and statistics are exported for node_exporter's
+ * textfile collector, see usermon-metrics.h; NULL for nowhere */
+void xfce_usermon_tracker_set_metrics_path(UserMonitorTracker * tracker,
+					   const gchar * metrics_path);
+
+/* plays the journal at path back through the same rules, thresholds
+ * and notifications, instead of starting the backend; speed is how
+ * many times faster, 0 for as fast as possible; returns FALSE if
+ * already started or if there's no journal at path */
+gboolean xfce_usermon_tracker_start_replay(UserMonitorTracker * tracker,
+					   const gchar * path, gdouble speed,
+					   UserMonitorReplayDoneFunc done_func,
+					   gpointer user_data);
+
+/* starts over with the new backend if already started */
+void xfce_usermon_tracker_set_backend(UserMonitorTracker * tracker,
+				      UserMonitorBackend backend);
+
+UserMonitorBackend xfce_usermon_tracker_get_backend(UserMonitorTracker *
+						    tracker);
+
+void xfce_usermon_tracker_start(UserMonitorTracker * tracker);
+
+UserMonitorSessions *xfce_usermon_tracker_get_sessions(UserMonitorTracker *
+						       tracker);
+
+/* func is called when the name of a host sessions come from is found,
+ * after the notification that showed its address was updated */
+void xfce_usermon_tracker_set_origin_func(UserMonitorTracker * tracker,
+					  UserMonitorOriginsFunc func,
+					  gpointer user_data);
+
+/* returns the name of host if already known, or host itself until then;
+ * see usermon-origins.h */
+const gchar *xfce_usermon_tracker_lookup_origin(UserMonitorTracker * tracker,
+						const gchar * host);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_TRACKER_H__ */
@@ -0,0 +1,267 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+
+#include "usermon-utmp.h"
+
+/* records read and compared at once */
+#define USERMON_UTMP_CHUNK	64
+
+/* what's compared between two scans */
+typedef struct {
+	gint32 type;
+	pid_t pid;
+	gint64 tv_sec;
+	gint64 tv_usec;
+	gchar user[sizeof(((struct utmpx *) 0)->ut_user)];
+} UserMonitorUtmpPrint;
+
+/* the file is copied with pread() rather than mapped: a mapping of a
+ * file truncated in place, eg by a container's boot, raises SIGBUS */
+struct _UserMonitorUtmp {
+	gchar *path;
+	gint fd;
+	struct stat last_stat;
+	/* the copy, struct utmpx, and where each chunk is read first */
+	GArray *records;
+	struct utmpx chunk[USERMON_UTMP_CHUNK];
+	guint slots_count;
+	GArray *prints;
+};
+
+static gboolean xfce_usermon_utmp_open(UserMonitorUtmp * reader)
+{
+	if (reader->fd >= 0) {
+		close(reader->fd);
+	}
+
+	reader->fd = open(reader->path, O_RDONLY | O_CLOEXEC);
+	if (reader->fd < 0) {
+		g_debug("Failed to open %s: %s", reader->path,
+			strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* returns the number of complete records read, fewer if the file was
+ * truncated meanwhile, or -1 */
+static gint xfce_usermon_utmp_read_chunk(UserMonitorUtmp * reader,
+					 guint slot, guint count)
+{
+	gsize size = count * sizeof(struct utmpx);
+	gsize done = 0;
+
+	while (done < size) {
+		ssize_t len = pread(reader->fd, (gchar *) reader->chunk + done,
+				    size - done,
+				    (off_t) slot * sizeof(struct utmpx) +
+				    done);
+
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			g_debug("Failed to read %s: %s", reader->path,
+				strerror(errno));
+			return -1;
+		}
+		if (len == 0) {
+			break;
+		}
+		done += len;
+	}
+
+	/* ignore a partially written record at the end */
+	return done / sizeof(struct utmpx);
+}
+
+static void xfce_usermon_utmp_compare(UserMonitorUtmp * reader, guint slot,
+				      GArray * changed_slots)
+{
+	UserMonitorUtmpPrint *print =
+	    &g_array_index(reader->prints, UserMonitorUtmpPrint, slot);
+	const struct utmpx *u =
+	    &g_array_index(reader->records, struct utmpx, slot);
+
+	if ((print->type == u->ut_type) &&
+	    (print->pid == u->ut_pid) &&
+	    (print->tv_sec == u->ut_tv.tv_sec) &&
+	    (print->tv_usec == u->ut_tv.tv_usec) &&
+	    (strncmp(print->user, u->ut_user, sizeof(print->user)) == 0)) {
+		return;
+	}
+
+	print->type = u->ut_type;
+	print->pid = u->ut_pid;
+	print->tv_sec = u->ut_tv.tv_sec;
+	print->tv_usec = u->ut_tv.tv_usec;
+	strncpy(print->user, u->ut_user, sizeof(print->user));
+	g_array_append_val(changed_slots, slot);
+}
+
+UserMonitorUtmp *xfce_usermon_utmp_new(const gchar * path)
+{
+	UserMonitorUtmp *reader = g_slice_new0(UserMonitorUtmp);
+
+	g_debug("xfce_usermon_utmp_new %s", path);
+	reader->path = g_strdup(path);
+	reader->fd = -1;
+	reader->records = g_array_new(FALSE, TRUE, sizeof(struct utmpx));
+	reader->prints = g_array_new(FALSE, TRUE, sizeof(UserMonitorUtmpPrint));
+
+	if (xfce_usermon_utmp_open(reader) == FALSE) {
+		xfce_usermon_utmp_free(reader);
+		return NULL;
+	}
+
+	return reader;
+}
+
+void xfce_usermon_utmp_free(UserMonitorUtmp * reader)
+{
+	if (reader == NULL) {
+		return;
+	}
+
+	if (reader->fd >= 0) {
+		close(reader->fd);
+	}
+	g_array_free(reader->records, TRUE);
+	g_array_free(reader->prints, TRUE);
+	g_free(reader->path);
+
+	g_slice_free(UserMonitorUtmp, reader);
+}
+
+gboolean xfce_usermon_utmp_scan(UserMonitorUtmp * reader,
+				GArray * changed_slots)
+{
+	struct stat new_stat;
+	guint slots_count;
+	guint slot;
+
+	if (stat(reader->path, &new_stat) != 0) {
+		g_debug("Failed to stat %s", reader->path);
+		return FALSE;
+	}
+
+	/* nothing to do if the file wasn't touched */
+	if ((new_stat.st_ino == reader->last_stat.st_ino) &&
+	    (new_stat.st_size == reader->last_stat.st_size) &&
+	    (new_stat.st_mtim.tv_sec == reader->last_stat.st_mtim.tv_sec) &&
+	    (new_stat.st_mtim.tv_nsec == reader->last_stat.st_mtim.tv_nsec)) {
+		return TRUE;
+	}
+
+	/* was the file replaced? */
+	if ((reader->last_stat.st_ino != 0) &&
+	    (new_stat.st_ino != reader->last_stat.st_ino)) {
+		g_debug("%s was replaced", reader->path);
+		if (xfce_usermon_utmp_open(reader) == FALSE) {
+			return FALSE;
+		}
+	}
+	reader->last_stat = new_stat;
+
+	slots_count = new_stat.st_size / sizeof(struct utmpx);
+	if (reader->records->len < slots_count) {
+		g_array_set_size(reader->records, slots_count);
+	}
+	if (reader->prints->len < slots_count) {
+		g_array_set_size(reader->prints, slots_count);
+	}
+
+	/* chunks identical to the copy are skipped without looking at
+	 * their slots, so the cost is mostly one read of the file */
+	for (slot = 0; slot < slots_count; slot += USERMON_UTMP_CHUNK) {
+		guint count = MIN(slots_count - slot, USERMON_UTMP_CHUNK);
+		struct utmpx *copy =
+		    &g_array_index(reader->records, struct utmpx, slot);
+		gint read_count = xfce_usermon_utmp_read_chunk(reader, slot,
+							       count);
+		guint i;
+
+		if (read_count < 0) {
+			return FALSE;
+		}
+
+		if ((guint) read_count < count) {
+			/* truncated since the stat, the rest is gone */
+			slots_count = slot + read_count;
+			count = read_count;
+		}
+		if (memcmp(copy, reader->chunk,
+			   count * sizeof(struct utmpx)) != 0) {
+			memcpy(copy, reader->chunk,
+			       count * sizeof(struct utmpx));
+			for (i = 0; i < count; ++i) {
+				xfce_usermon_utmp_compare(reader, slot + i,
+							  changed_slots);
+			}
+		}
+		if (count < USERMON_UTMP_CHUNK) {
+			break;
+		}
+	}
+	reader->slots_count = slots_count;
+
+	/* the file shrank */
+	for (slot = slots_count; slot < reader->prints->len; ++slot) {
+		UserMonitorUtmpPrint *print =
+		    &g_array_index(reader->prints, UserMonitorUtmpPrint, slot);
+
+		if (print->type != EMPTY) {
+			g_array_append_val(changed_slots, slot);
+		}
+		memset(print, 0, sizeof(UserMonitorUtmpPrint));
+		memset(&g_array_index(reader->records, struct utmpx, slot), 0,
+		       sizeof(struct utmpx));
+	}
+
+	return TRUE;
+}
+
+guint xfce_usermon_utmp_get_slots_count(UserMonitorUtmp * reader)
+{
+	return reader->slots_count;
+}
+
+const struct utmpx *xfce_usermon_utmp_get_record(UserMonitorUtmp * reader,
+						 guint slot)
+{
+	if (slot >= reader->slots_count) {
+		return NULL;
+	}
+
+	return &g_array_index(reader->records, struct utmpx, slot);
+}
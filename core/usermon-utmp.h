@@ -0,0 +1,43 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_UTMP_H__
+#define __USER_MONITOR_UTMP_H__
+
+#include <utmpx.h>
+
+G_BEGIN_DECLS typedef struct _UserMonitorUtmp UserMonitorUtmp;
+
+/* returns NULL if the file can't be opened */
+UserMonitorUtmp *xfce_usermon_utmp_new(const gchar * path);
+
+void xfce_usermon_utmp_free(UserMonitorUtmp * reader);
+
+/* appends the index of each slot that changed since the last scan
+ * to changed_slots, an array of guint */
+gboolean xfce_usermon_utmp_scan(UserMonitorUtmp * reader,
+				GArray * changed_slots);
+
+guint xfce_usermon_utmp_get_slots_count(UserMonitorUtmp * reader);
+
+/* returns NULL if the slot no longer exists */
+const struct utmpx *xfce_usermon_utmp_get_record(UserMonitorUtmp * reader,
+						 guint slot);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_UTMP_H__ */
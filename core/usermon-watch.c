@@ -0,0 +1,229 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "usermon-watch.h"
+
+#define USERMON_WATCH_EVENTS	(IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+				 IN_DELETE_SELF | IN_MOVE_SELF)
+/* the file being created, replaced or removed, seen from its directory */
+#define USERMON_WATCH_DIR_EVENTS	(IN_CREATE | IN_MOVED_TO | IN_DELETE | \
+					 IN_MOVED_FROM | IN_ONLYDIR)
+
+struct _UserMonitorWatch {
+	gchar *path;
+	gint fd;
+	gint wd;
+	/* the directory's, filtered on the file's name */
+	gint dir_wd;
+	gchar *name;
+	/* the file watched isn't the one at path anymore */
+	gboolean replaced;
+	guint fd_source_id;
+	guint delay_source_id;
+	guint delay;
+	struct stat last_stat;
+	UserMonitorWatchFunc func;
+	gpointer user_data;
+};
+
+#ifdef HAVE_SYS_INOTIFY_H
+static gboolean xfce_usermon_watch_has_changed(UserMonitorWatch * watch)
+{
+	struct stat new_stat;
+
+	if (stat(watch->path, &new_stat) != 0) {
+		g_debug("Failed to stat %s", watch->path);
+		return FALSE;
+	}
+
+	/* utmp is rewritten in place, but it may also be replaced */
+	if ((new_stat.st_ino == watch->last_stat.st_ino) &&
+	    (new_stat.st_size == watch->last_stat.st_size) &&
+	    (new_stat.st_mtim.tv_sec == watch->last_stat.st_mtim.tv_sec) &&
+	    (new_stat.st_mtim.tv_nsec == watch->last_stat.st_mtim.tv_nsec)) {
+		return FALSE;
+	}
+	watch->last_stat = new_stat;
+
+	return TRUE;
+}
+
+static gboolean xfce_usermon_watch_delay_expired(gpointer user_data)
+{
+	UserMonitorWatch *watch = (UserMonitorWatch *) user_data;
+
+	watch->delay_source_id = 0;
+
+	/* the file was replaced, watch the new one; if it isn't there
+	 * yet, the directory's watch tells when it is */
+	if ((watch->replaced == TRUE) || (watch->wd < 0)) {
+		if (watch->wd >= 0) {
+			inotify_rm_watch(watch->fd, watch->wd);
+		}
+		watch->replaced = FALSE;
+		watch->wd = inotify_add_watch(watch->fd, watch->path,
+					      USERMON_WATCH_EVENTS);
+		if (watch->wd < 0) {
+			g_debug("Failed to watch %s again, waiting for it",
+				watch->path);
+		}
+	}
+
+	if (xfce_usermon_watch_has_changed(watch) == TRUE) {
+		g_debug("%s changed", watch->path);
+		watch->func(watch->user_data);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean xfce_usermon_watch_read_events(gint fd,
+					       GIOCondition condition,
+					       gpointer user_data)
+{
+	UserMonitorWatch *watch = (UserMonitorWatch *) user_data;
+	gchar buffer[4096]
+	    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	gboolean changed = FALSE;
+	ssize_t len;
+
+	/* drain all pending events */
+	while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+		gchar *ptr = buffer;
+
+		while (ptr < buffer + len) {
+			struct inotify_event *event =
+			    (struct inotify_event *)ptr;
+
+			if (event->wd == watch->dir_wd) {
+				/* other files in the same directory */
+				if ((event->len > 0) &&
+				    (strcmp(event->name, watch->name) == 0)) {
+					watch->replaced = TRUE;
+					changed = TRUE;
+				}
+			} else if (event->wd == watch->wd) {
+				if (event->mask & IN_IGNORED) {
+					watch->wd = -1;
+				} else if (event->mask &
+					   (IN_MOVE_SELF | IN_DELETE_SELF)) {
+					/* it would follow the old inode */
+					watch->replaced = TRUE;
+				}
+				changed = TRUE;
+			}
+
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
+	}
+
+	/* coalesce bursts of writes into a single update */
+	if ((changed == TRUE) && (watch->delay_source_id == 0)) {
+		watch->delay_source_id =
+		    g_timeout_add(watch->delay,
+				  xfce_usermon_watch_delay_expired, watch);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+#endif
+
+UserMonitorWatch *xfce_usermon_watch_new(const gchar * path,
+					 guint delay,
+					 UserMonitorWatchFunc func,
+					 gpointer user_data)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	UserMonitorWatch *watch = NULL;
+	gint fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	gchar *dir;
+
+	g_debug("xfce_usermon_watch_new %s", path);
+	if (fd < 0) {
+		g_debug("Failed to initialize inotify: %s", strerror(errno));
+		return NULL;
+	}
+
+	watch = g_slice_new0(UserMonitorWatch);
+	watch->path = g_strdup(path);
+	watch->fd = fd;
+	watch->delay = delay;
+	watch->func = func;
+	watch->user_data = user_data;
+
+	watch->name = g_path_get_basename(path);
+
+	dir = g_path_get_dirname(path);
+	watch->dir_wd = inotify_add_watch(fd, dir, USERMON_WATCH_DIR_EVENTS);
+	g_free(dir);
+	watch->wd = inotify_add_watch(fd, path, USERMON_WATCH_EVENTS);
+	if ((watch->dir_wd < 0) || (watch->wd < 0)) {
+		g_debug("Failed to watch %s: %s", path, strerror(errno));
+		xfce_usermon_watch_free(watch);
+		return NULL;
+	}
+	stat(path, &watch->last_stat);
+
+	watch->fd_source_id = g_unix_fd_add(fd, G_IO_IN,
+					    xfce_usermon_watch_read_events,
+					    watch);
+
+	return watch;
+#else
+	g_debug("No inotify support");
+	return NULL;
+#endif
+}
+
+void xfce_usermon_watch_free(UserMonitorWatch * watch)
+{
+	if (watch == NULL) {
+		return;
+	}
+
+	if (watch->delay_source_id > 0) {
+		g_source_remove(watch->delay_source_id);
+	}
+	if (watch->fd_source_id > 0) {
+		g_source_remove(watch->fd_source_id);
+	}
+	if (watch->fd >= 0) {
+		close(watch->fd);
+	}
+	g_free(watch->path);
+	g_free(watch->name);
+
+	g_slice_free(UserMonitorWatch, watch);
+}
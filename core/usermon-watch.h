@@ -0,0 +1,44 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_WATCH_H__
+#define __USER_MONITOR_WATCH_H__
+
+#include <utmpx.h>
+
+/* where utmp lives */
+#ifdef _PATH_UTMPX
+#define USERMON_UTMP_PATH	_PATH_UTMPX
+#else
+#define USERMON_UTMP_PATH	"/run/utmp"
+#endif
+
+G_BEGIN_DECLS typedef struct _UserMonitorWatch UserMonitorWatch;
+
+typedef void (*UserMonitorWatchFunc) (gpointer user_data);
+
+/* returns NULL if the file can't be watched, eg no inotify support */
+UserMonitorWatch *xfce_usermon_watch_new(const gchar * path,
+					 guint delay,
+					 UserMonitorWatchFunc func,
+					 gpointer user_data);
+
+void xfce_usermon_watch_free(UserMonitorWatch * watch);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_WATCH_H__ */
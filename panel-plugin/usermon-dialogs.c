@@ -31,6 +31,21 @@
 /* the website url */
 #define PLUGIN_WEBSITE "https://github.com/FabriceColin/usermon"
 
+/* history columns */
+enum {
+	HISTORY_USER_COLUMN = 0,
+	HISTORY_LINE_COLUMN,
+	HISTORY_HOST_COLUMN,
+	HISTORY_LOGIN_COLUMN,
+	HISTORY_LOGOUT_COLUMN,
+	HISTORY_COLUMNS_COUNT
+};
+
+/* history periods, in the order they are listed */
+static const gint64 history_periods[] = { 3600, 86400, 7 * 86400,
+	30 * 86400
+};
+
 static void xfce_usermon_configure_response(GtkWidget * dialog,
 					    gint response,
 					    UserMonitorPlugin * usermon_plugin)
@@ -48,6 +63,30 @@ static void xfce_usermon_configure_response(GtkWidget * dialog,
 				  PLUGIN_WEBSITE);
 		}
 	} else {
+		/* apply the sources, they aren't as cheap to change */
+		xfce_usermon_set_sources(usermon_plugin,
+					 gtk_entry_get_text(GTK_ENTRY
+							    (g_object_get_data
+							     (G_OBJECT(dialog),
+							      "sources-entry"))));
+		xfce_usermon_set_rules(usermon_plugin,
+				       gtk_entry_get_text(GTK_ENTRY
+							  (g_object_get_data
+							   (G_OBJECT(dialog),
+							    "rules-entry"))));
+		xfce_usermon_set_group_limits(usermon_plugin,
+					      gtk_entry_get_text(GTK_ENTRY
+								 (g_object_get_data
+								  (G_OBJECT
+								   (dialog),
+								   "group-limits-entry"))));
+		xfce_usermon_set_metrics_file(usermon_plugin,
+					      gtk_entry_get_text(GTK_ENTRY
+								 (g_object_get_data
+								  (G_OBJECT
+								   (dialog),
+								   "metrics-file-entry"))));
+
 		/* remove the dialog data from the plugin */
 		g_object_set_data(G_OBJECT(usermon_plugin), "dialog", NULL);
 
@@ -67,19 +106,97 @@ static void xfce_usermon_max_users_count_changed(GtkSpinButton * spin_button,
 						 UserMonitorPlugin *
 						 usermon_plugin)
 {
-	usermon_plugin->max_users_count =
-	    gtk_spin_button_get_value_as_int(spin_button);
+	xfce_usermon_set_max_users_count(usermon_plugin,
+					 gtk_spin_button_get_value_as_int
+					 (spin_button));
+}
+
+static void xfce_usermon_max_user_cpu_changed(GtkSpinButton * spin_button,
+					      UserMonitorPlugin *
+					      usermon_plugin)
+{
+	xfce_usermon_set_user_limits(usermon_plugin,
+				     gtk_spin_button_get_value_as_int
+				     (spin_button),
+				     usermon_plugin->max_user_rss);
+}
+
+static void xfce_usermon_max_user_rss_changed(GtkSpinButton * spin_button,
+					      UserMonitorPlugin *
+					      usermon_plugin)
+{
+	xfce_usermon_set_user_limits(usermon_plugin,
+				     usermon_plugin->max_user_cpu,
+				     gtk_spin_button_get_value_as_int
+				     (spin_button));
+}
+
+static void xfce_usermon_idle_threshold_changed(GtkSpinButton * spin_button,
+						UserMonitorPlugin *
+						usermon_plugin)
+{
+	xfce_usermon_set_idle_threshold(usermon_plugin,
+					gtk_spin_button_get_value_as_int
+					(spin_button));
 }
 
 static void xfce_usermon_alarm_period_spin_changed(GtkSpinButton * spin_button,
 						   UserMonitorPlugin *
 						   usermon_plugin)
 {
-	usermon_plugin->alarm_period =
-	    gtk_spin_button_get_value_as_int(spin_button);
+	xfce_usermon_set_alarm_period(usermon_plugin,
+				      gtk_spin_button_get_value_as_int
+				      (spin_button));
 }
 
-static GtkWidget *xfce_usermon_create_layout(UserMonitorPlugin * usermon_plugin)
+static void xfce_usermon_trend_changed(GtkComboBox * combo_box,
+				       UserMonitorPlugin * usermon_plugin)
+{
+	xfce_usermon_set_trend(usermon_plugin,
+			       (guint) gtk_combo_box_get_active(combo_box));
+}
+
+static void xfce_usermon_backend_changed(GtkComboBox * combo_box,
+					 UserMonitorPlugin * usermon_plugin)
+{
+	xfce_usermon_set_backend(usermon_plugin,
+				 (UserMonitorBackend)
+				 gtk_combo_box_get_active(combo_box));
+}
+
+static void xfce_usermon_sources_activated(GtkEntry * entry,
+					   UserMonitorPlugin * usermon_plugin)
+{
+	xfce_usermon_set_sources(usermon_plugin, gtk_entry_get_text(entry));
+}
+
+static void xfce_usermon_rules_activated(GtkEntry * entry,
+					 UserMonitorPlugin * usermon_plugin)
+{
+	xfce_usermon_set_rules(usermon_plugin, gtk_entry_get_text(entry));
+}
+
+static void xfce_usermon_group_limits_activated(GtkEntry * entry,
+						UserMonitorPlugin *
+						usermon_plugin)
+{
+	xfce_usermon_set_group_limits(usermon_plugin,
+				      gtk_entry_get_text(entry));
+}
+
+static void xfce_usermon_metrics_file_activated(GtkEntry * entry,
+						UserMonitorPlugin *
+						usermon_plugin)
+{
+	xfce_usermon_set_metrics_file(usermon_plugin,
+				      gtk_entry_get_text(entry));
+}
+
+static GtkWidget *xfce_usermon_create_layout(UserMonitorPlugin * usermon_plugin,
+					     GtkWidget ** sources_entry,
+					     GtkWidget ** rules_entry,
+					     GtkWidget ** group_limits_entry,
+					     GtkWidget ** metrics_file_entry)
 {
 	GtkWidget *vbox =
 	    gtk_box_new(GTK_ORIENTATION_VERTICAL, DEFAULT_USERMON_PADDING);
@@ -91,10 +208,60 @@ static GtkWidget *xfce_usermon_create_layout(UserMonitorPlugin * usermon_plugin)
 	    gtk_label_new(_("Critical number of users"));
 	GtkWidget *max_users_count_spin =
 	    gtk_spin_button_new_with_range(1, 100, 1);
+	GtkWidget *row5 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *max_user_cpu_label =
+	    gtk_label_new(_("Critical CPU usage per user"));
+	GtkWidget *max_user_cpu_spin =
+	    gtk_spin_button_new_with_range(0, 10000, 10);
+	GtkWidget *max_user_cpu_label_post = gtk_label_new("%");
+	GtkWidget *row6 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *max_user_rss_label =
+	    gtk_label_new(_("Critical memory usage per user"));
+	GtkWidget *max_user_rss_spin =
+	    gtk_spin_button_new_with_range(0, 1048576, 256);
+	GtkWidget *max_user_rss_label_post = gtk_label_new(_("MB"));
+	GtkWidget *row7 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *idle_threshold_label =
+	    gtk_label_new(_("Sessions are idle after"));
+	GtkWidget *idle_threshold_spin =
+	    gtk_spin_button_new_with_range(0, 1440, 5);
+	GtkWidget *idle_threshold_label_post = gtk_label_new(_("minutes"));
 	GtkWidget *alarm_period_label = gtk_label_new(_("Alarm period"));
 	GtkWidget *alarm_period_spin =
 	    gtk_spin_button_new_with_range(5, 3600, 5);
 	GtkWidget *alarm_period_label_post = gtk_label_new(_("seconds"));
+	GtkWidget *row8 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *trend_label = gtk_label_new(_("Trend"));
+	GtkWidget *trend_combo = gtk_combo_box_text_new();
+	GtkWidget *row3 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *backend_label = gtk_label_new(_("Sessions source"));
+	GtkWidget *backend_combo = gtk_combo_box_text_new();
+	GtkWidget *row4 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *sources_label = gtk_label_new(_("Other utmp files"));
+	GtkWidget *row9 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *rules_label = gtk_label_new(_("Rules"));
+	GtkWidget *row10 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *group_limits_label =
+	    gtk_label_new(_("Critical number of users per group"));
+	GtkWidget *row11 =
+	    gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	GtkWidget *metrics_file_label = gtk_label_new(_("Metrics file"));
+	gchar *sources = NULL;
+	gchar *rules = NULL;
+	gchar *group_limits = NULL;
+
+	*sources_entry = gtk_entry_new();
+	*rules_entry = gtk_entry_new();
+	*group_limits_entry = gtk_entry_new();
+	*metrics_file_entry = gtk_entry_new();
 
 	gtk_box_pack_start(GTK_BOX(row1), max_users_count_label,
 			TRUE, FALSE, 0);
@@ -103,6 +270,35 @@ static GtkWidget *xfce_usermon_create_layout(UserMonitorPlugin * usermon_plugin)
 	gtk_box_pack_start(GTK_BOX(vbox), row1,
 			FALSE, FALSE, 0);
 
+	/* 0 for no limit */
+	gtk_box_pack_start(GTK_BOX(row5), max_user_cpu_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row5), GTK_WIDGET(max_user_cpu_spin),
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row5), max_user_cpu_label_post,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row5,
+			FALSE, FALSE, 0);
+
+	gtk_box_pack_start(GTK_BOX(row6), max_user_rss_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row6), GTK_WIDGET(max_user_rss_spin),
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row6), max_user_rss_label_post,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row6,
+			FALSE, FALSE, 0);
+
+	/* 0 for never */
+	gtk_box_pack_start(GTK_BOX(row7), idle_threshold_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row7), GTK_WIDGET(idle_threshold_spin),
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row7), idle_threshold_label_post,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row7,
+			FALSE, FALSE, 0);
+
 	gtk_box_pack_start(GTK_BOX(row2), alarm_period_label,
 			TRUE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(row2), GTK_WIDGET(alarm_period_spin),
@@ -112,25 +308,195 @@ static GtkWidget *xfce_usermon_create_layout(UserMonitorPlugin * usermon_plugin)
 	gtk_box_pack_start(GTK_BOX(vbox), row2,
 			FALSE, FALSE, 0);
 
+	/* none, then in the same order as UserMonitorSeriesLevel */
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(trend_combo),
+				       _("None"));
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(trend_combo),
+				       _("Last hour"));
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(trend_combo),
+				       _("Last 6 hours"));
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(trend_combo),
+				       _("Last 2 days"));
+	gtk_box_pack_start(GTK_BOX(row8), trend_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row8), trend_combo,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row8,
+			FALSE, FALSE, 0);
+
+	/* in the same order as UserMonitorBackend */
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(backend_combo),
+				       "utmp");
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(backend_combo),
+				       "systemd-logind");
+	gtk_box_pack_start(GTK_BOX(row3), backend_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row3), backend_combo,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row3,
+			FALSE, FALSE, 0);
+
+	/* eg the utmp files of all the machines in /var/lib/machines */
+	gtk_widget_set_tooltip_text(*sources_entry,
+				    _("Paths or patterns, separated by ';'"));
+	gtk_box_pack_start(GTK_BOX(row4), sources_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row4), *sources_entry,
+			TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row4,
+			FALSE, FALSE, 0);
+
+	/* eg "ignore user svc-*;watch remote" */
+	gtk_widget_set_tooltip_text(*rules_entry,
+				    _("\"ignore\" or \"watch\", then \"user\", "
+				      "\"host\" or \"line\" and a pattern, or "
+				      "\"local\" or \"remote\"; separated by ';'"));
+	gtk_box_pack_start(GTK_BOX(row9), rules_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row9), *rules_entry,
+			TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row9,
+			FALSE, FALSE, 0);
+
+	/* eg "contractors:0;students:3" */
+	gtk_widget_set_tooltip_text(*group_limits_entry,
+				    _("Group and number of users, eg "
+				      "\"students:3\"; separated by ';'"));
+	gtk_box_pack_start(GTK_BOX(row10), group_limits_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row10), *group_limits_entry,
+			TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row10,
+			FALSE, FALSE, 0);
+
+	/* eg "/var/lib/node_exporter/textfile/usermon.prom" */
+	gtk_widget_set_tooltip_text(*metrics_file_entry,
+				    _("File in node_exporter's textfile "
+				      "directory, ending in .prom; empty for "
+				      "none"));
+	gtk_box_pack_start(GTK_BOX(row11), metrics_file_label,
+			TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row11), *metrics_file_entry,
+			TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row11,
+			FALSE, FALSE, 0);
+
 	gtk_spin_button_set_value(GTK_SPIN_BUTTON(max_users_count_spin),
 				  (gdouble) usermon_plugin->max_users_count);
 	g_signal_connect(G_OBJECT(max_users_count_spin), "value-changed",
 			 G_CALLBACK(xfce_usermon_max_users_count_changed),
 			 usermon_plugin);
 
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(max_user_cpu_spin),
+				  (gdouble) usermon_plugin->max_user_cpu);
+	g_signal_connect(G_OBJECT(max_user_cpu_spin), "value-changed",
+			 G_CALLBACK(xfce_usermon_max_user_cpu_changed),
+			 usermon_plugin);
+
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(max_user_rss_spin),
+				  (gdouble) usermon_plugin->max_user_rss);
+	g_signal_connect(G_OBJECT(max_user_rss_spin), "value-changed",
+			 G_CALLBACK(xfce_usermon_max_user_rss_changed),
+			 usermon_plugin);
+
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(idle_threshold_spin),
+				  (gdouble) usermon_plugin->idle_threshold);
+	g_signal_connect(G_OBJECT(idle_threshold_spin), "value-changed",
+			 G_CALLBACK(xfce_usermon_idle_threshold_changed),
+			 usermon_plugin);
+
 	gtk_spin_button_set_value(GTK_SPIN_BUTTON(alarm_period_spin),
 				  (gdouble) usermon_plugin->alarm_period);
 	g_signal_connect(G_OBJECT(alarm_period_spin), "value-changed",
 			 G_CALLBACK(xfce_usermon_alarm_period_spin_changed),
 			 usermon_plugin);
 
+	gtk_combo_box_set_active(GTK_COMBO_BOX(trend_combo),
+				 (gint) usermon_plugin->trend);
+	g_signal_connect(G_OBJECT(trend_combo), "changed",
+			 G_CALLBACK(xfce_usermon_trend_changed),
+			 usermon_plugin);
+
+	gtk_combo_box_set_active(GTK_COMBO_BOX(backend_combo),
+				 (gint) usermon_plugin->backend);
+	g_signal_connect(G_OBJECT(backend_combo), "changed",
+			 G_CALLBACK(xfce_usermon_backend_changed),
+			 usermon_plugin);
+
+	if (usermon_plugin->sources != NULL) {
+		sources = g_strjoinv(";", usermon_plugin->sources);
+	}
+	gtk_entry_set_text(GTK_ENTRY(*sources_entry),
+			   (sources != NULL) ? sources : "");
+	g_free(sources);
+	g_signal_connect(G_OBJECT(*sources_entry), "activate",
+			 G_CALLBACK(xfce_usermon_sources_activated),
+			 usermon_plugin);
+
+	if (usermon_plugin->rules != NULL) {
+		rules = g_strjoinv(";", usermon_plugin->rules);
+	}
+	gtk_entry_set_text(GTK_ENTRY(*rules_entry),
+			   (rules != NULL) ? rules : "");
+	g_free(rules);
+	g_signal_connect(G_OBJECT(*rules_entry), "activate",
+			 G_CALLBACK(xfce_usermon_rules_activated),
+			 usermon_plugin);
+
+	if (usermon_plugin->group_limits != NULL) {
+		group_limits = g_strjoinv(";", usermon_plugin->group_limits);
+	}
+	gtk_entry_set_text(GTK_ENTRY(*group_limits_entry),
+			   (group_limits != NULL) ? group_limits : "");
+	g_free(group_limits);
+	g_signal_connect(G_OBJECT(*group_limits_entry), "activate",
+			 G_CALLBACK(xfce_usermon_group_limits_activated),
+			 usermon_plugin);
+
+	gtk_entry_set_text(GTK_ENTRY(*metrics_file_entry),
+			   (usermon_plugin->metrics_file != NULL) ?
+			   usermon_plugin->metrics_file : "");
+	g_signal_connect(G_OBJECT(*metrics_file_entry), "activate",
+			 G_CALLBACK(xfce_usermon_metrics_file_activated),
+			 usermon_plugin);
+
 	gtk_widget_show(max_users_count_label);
 	gtk_widget_show(max_users_count_spin);
 	gtk_widget_show(row1);
+	gtk_widget_show(max_user_cpu_label);
+	gtk_widget_show(max_user_cpu_spin);
+	gtk_widget_show(max_user_cpu_label_post);
+	gtk_widget_show(row5);
+	gtk_widget_show(max_user_rss_label);
+	gtk_widget_show(max_user_rss_spin);
+	gtk_widget_show(max_user_rss_label_post);
+	gtk_widget_show(row6);
+	gtk_widget_show(idle_threshold_label);
+	gtk_widget_show(idle_threshold_spin);
+	gtk_widget_show(idle_threshold_label_post);
+	gtk_widget_show(row7);
 	gtk_widget_show(alarm_period_label);
 	gtk_widget_show(alarm_period_spin);
 	gtk_widget_show(alarm_period_label_post);
 	gtk_widget_show(row2);
+	gtk_widget_show(trend_label);
+	gtk_widget_show(trend_combo);
+	gtk_widget_show(row8);
+	gtk_widget_show(backend_label);
+	gtk_widget_show(backend_combo);
+	gtk_widget_show(row3);
+	gtk_widget_show(sources_label);
+	gtk_widget_show(*sources_entry);
+	gtk_widget_show(row4);
+	gtk_widget_show(rules_label);
+	gtk_widget_show(*rules_entry);
+	gtk_widget_show(row9);
+	gtk_widget_show(group_limits_label);
+	gtk_widget_show(*group_limits_entry);
+	gtk_widget_show(row10);
+	gtk_widget_show(metrics_file_label);
+	gtk_widget_show(*metrics_file_entry);
+	gtk_widget_show(row11);
 
 	return vbox;
 }
@@ -141,6 +507,10 @@ void xfce_usermon_configure_plugin(XfcePanelPlugin * plugin)
 	GtkWidget *dialog;
 	GtkWidget *vbox;
 	GtkWidget *content;
+	GtkWidget *sources_entry;
+	GtkWidget *rules_entry;
+	GtkWidget *group_limits_entry;
+	GtkWidget *metrics_file_entry;
 
 	usermon_plugin = XFCE_USERMON_PLUGIN(plugin);
 
@@ -169,7 +539,15 @@ void xfce_usermon_configure_plugin(XfcePanelPlugin * plugin)
 
 	/* populate the dialog */
 	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
-	content = xfce_usermon_create_layout(usermon_plugin);
+	content = xfce_usermon_create_layout(usermon_plugin, &sources_entry,
+					     &rules_entry, &group_limits_entry,
+					     &metrics_file_entry);
+	g_object_set_data(G_OBJECT(dialog), "sources-entry", sources_entry);
+	g_object_set_data(G_OBJECT(dialog), "rules-entry", rules_entry);
+	g_object_set_data(G_OBJECT(dialog), "group-limits-entry",
+			  group_limits_entry);
+	g_object_set_data(G_OBJECT(dialog), "metrics-file-entry",
+			  metrics_file_entry);
 	gtk_box_pack_start(GTK_BOX(vbox), content,
 			TRUE, FALSE, DEFAULT_USERMON_PADDING);
 
@@ -194,6 +572,310 @@ void xfce_usermon_configure_plugin(XfcePanelPlugin * plugin)
 	gtk_widget_show(dialog);
 }
 
+gchar *xfce_usermon_format_time(gint64 time)
+{
+	GDateTime *date_time = g_date_time_new_from_unix_local(time);
+	gchar *text;
+
+	if (date_time == NULL) {
+		return g_strdup("");
+	}
+
+	text = g_date_time_format(date_time, "%x %X");
+	g_date_time_unref(date_time);
+
+	return text;
+}
+
+static void xfce_usermon_history_response(GtkWidget * dialog,
+					  gint response,
+					  UserMonitorPlugin * usermon_plugin)
+{
+	g_object_set_data(G_OBJECT(usermon_plugin), "history-dialog", NULL);
+	gtk_widget_destroy(dialog);
+}
+
+static void xfce_usermon_history_period_changed(GtkComboBox * combo_box,
+						UserMonitorPlugin *
+						usermon_plugin)
+{
+	xfce_usermon_refresh_history(XFCE_PANEL_PLUGIN(usermon_plugin));
+}
+
+void xfce_usermon_refresh_history(XfcePanelPlugin * plugin)
+{
+	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(plugin);
+	GtkWidget *dialog;
+	GtkComboBox *period_combo;
+	GtkListStore *store;
+	GtkLabel *peak_label;
+	GArray *sessions;
+	gchar *peak_text;
+	gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+	gint64 from;
+	guint peak = 0;
+	gint period;
+	guint i;
+
+	dialog = g_object_get_data(G_OBJECT(plugin), "history-dialog");
+	if (dialog == NULL) {
+		return;
+	}
+	period_combo = g_object_get_data(G_OBJECT(dialog), "period-combo");
+	store = g_object_get_data(G_OBJECT(dialog), "sessions-store");
+	peak_label = g_object_get_data(G_OBJECT(dialog), "peak-label");
+
+	/* the index can't be queried while it's being updated */
+	if (usermon_plugin->history_thread != NULL) {
+		gtk_label_set_text(peak_label, _("Indexing wtmp..."));
+		return;
+	}
+
+	period = gtk_combo_box_get_active(period_combo);
+	if ((period < 0) || (period >= (gint) G_N_ELEMENTS(history_periods))) {
+		period = 0;
+	}
+	from = now - history_periods[period];
+
+	/* list the sessions of that period */
+	gtk_list_store_clear(store);
+	sessions = g_array_new(FALSE, FALSE,
+			       sizeof(UserMonitorHistorySession));
+	if (usermon_plugin->history != NULL) {
+		xfce_usermon_history_get_sessions(usermon_plugin->history,
+						  from, now + 1, sessions);
+		peak = xfce_usermon_history_get_peak(usermon_plugin->history,
+						     from, now + 1);
+	}
+	for (i = 0; i < sessions->len; ++i) {
+		const UserMonitorHistorySession *session =
+		    &g_array_index(sessions, UserMonitorHistorySession, i);
+		gchar *login_text =
+		    xfce_usermon_format_time(session->login_time);
+		gchar *logout_text;
+		GtkTreeIter iter;
+
+		if (session->logout_time == 0) {
+			logout_text = g_strdup(_("still logged in"));
+		} else {
+			logout_text =
+			    xfce_usermon_format_time(session->logout_time);
+		}
+
+		gtk_list_store_insert_with_values(store, &iter, 0,
+						  HISTORY_USER_COLUMN,
+						  session->user_name,
+						  HISTORY_LINE_COLUMN,
+						  session->line,
+						  HISTORY_HOST_COLUMN,
+						  session->host,
+						  HISTORY_LOGIN_COLUMN,
+						  login_text,
+						  HISTORY_LOGOUT_COLUMN,
+						  logout_text, -1);
+		g_free(login_text);
+		g_free(logout_text);
+	}
+	g_array_free(sessions, TRUE);
+
+	peak_text = g_strdup_printf(ngettext("Peak: %d session",
+					     "Peak: %d sessions", peak), peak);
+	gtk_label_set_text(peak_label, peak_text);
+	g_free(peak_text);
+}
+
+void xfce_usermon_show_history(XfcePanelPlugin * plugin)
+{
+	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(plugin);
+	GtkWidget *dialog;
+	GtkWidget *vbox;
+	GtkWidget *row;
+	GtkWidget *period_combo;
+	GtkWidget *peak_label;
+	GtkWidget *scrolled_window;
+	GtkWidget *tree_view;
+	GtkListStore *store;
+	const gchar *titles[HISTORY_COLUMNS_COUNT] = {
+		_("User"), _("Line"), _("Host"), _("Login"), _("Logout")
+	};
+	gint column;
+
+	/* only one history dialog at a time */
+	dialog = g_object_get_data(G_OBJECT(plugin), "history-dialog");
+	if (dialog != NULL) {
+		gtk_window_present(GTK_WINDOW(dialog));
+		return;
+	}
+
+#if LIBXFCE4UI_CHECK_VERSION(4,14,0)
+	dialog = xfce_titled_dialog_new_with_mixed_buttons(_("User Monitor"),
+				GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(plugin))),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				"window-close", _("_Close"), GTK_RESPONSE_OK,
+				NULL);
+#else
+	dialog = xfce_titled_dialog_new_with_buttons(_("User Monitor"),
+				GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(plugin))),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				"gtk-close", GTK_RESPONSE_OK,
+				NULL);
+#endif
+	xfce_titled_dialog_set_subtitle(XFCE_TITLED_DIALOG(dialog), _("History"));
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 600, 400);
+
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+
+	row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, DEFAULT_USERMON_PADDING);
+	period_combo = gtk_combo_box_text_new();
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(period_combo),
+				       _("Last hour"));
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(period_combo),
+				       _("Last 24 hours"));
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(period_combo),
+				       _("Last 7 days"));
+	gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(period_combo),
+				       _("Last 30 days"));
+	gtk_combo_box_set_active(GTK_COMBO_BOX(period_combo), 1);
+	peak_label = gtk_label_new(NULL);
+	gtk_box_pack_start(GTK_BOX(row), period_combo, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(row), peak_label, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), row,
+			FALSE, FALSE, DEFAULT_USERMON_PADDING);
+
+	store = gtk_list_store_new(HISTORY_COLUMNS_COUNT, G_TYPE_STRING,
+				   G_TYPE_STRING, G_TYPE_STRING,
+				   G_TYPE_STRING, G_TYPE_STRING);
+	tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+	/* the view holds the only reference */
+	g_object_unref(G_OBJECT(store));
+	for (column = 0; column < HISTORY_COLUMNS_COUNT; ++column) {
+		gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW
+							    (tree_view), -1,
+							    titles[column],
+							    gtk_cell_renderer_text_new
+							    (), "text",
+							    column, NULL);
+	}
+	scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+				       GTK_POLICY_AUTOMATIC,
+				       GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled_window), tree_view);
+	gtk_box_pack_start(GTK_BOX(vbox), scrolled_window,
+			TRUE, TRUE, 0);
+
+	g_object_set_data(G_OBJECT(dialog), "period-combo", period_combo);
+	g_object_set_data(G_OBJECT(dialog), "sessions-store", store);
+	g_object_set_data(G_OBJECT(dialog), "peak-label", peak_label);
+	g_object_set_data(G_OBJECT(plugin), "history-dialog", dialog);
+
+	g_signal_connect(G_OBJECT(period_combo), "changed",
+			G_CALLBACK(xfce_usermon_history_period_changed),
+			usermon_plugin);
+	g_signal_connect(G_OBJECT(dialog), "response",
+			G_CALLBACK(xfce_usermon_history_response),
+			usermon_plugin);
+
+	/* show what's indexed already, then catch up with wtmp */
+	xfce_usermon_refresh_history(plugin);
+	xfce_usermon_update_history(usermon_plugin);
+
+	gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER);
+	gtk_window_set_icon_name(GTK_WINDOW(dialog), "usermon");
+	gtk_widget_show_all(dialog);
+}
+
+static void xfce_usermon_stats_refresh(GtkWidget * dialog)
+{
+	GtkWidget *text_view = g_object_get_data(G_OBJECT(dialog), "text-view");
+	gchar *report = xfce_usermon_stats_dump();
+	gchar *path;
+
+	gtk_text_buffer_set_text(gtk_text_view_get_buffer
+				 (GTK_TEXT_VIEW(text_view)), report, -1);
+	g_free(report);
+
+	/* keep a copy that can be attached to a bug report */
+	path = g_build_filename(g_get_user_cache_dir(), DEFAULT_STATS_FILE,
+				NULL);
+	xfce_usermon_stats_save(path);
+	g_free(path);
+}
+
+static void xfce_usermon_stats_response(GtkWidget * dialog,
+					gint response,
+					UserMonitorPlugin * usermon_plugin)
+{
+	if (response == GTK_RESPONSE_APPLY) {
+		xfce_usermon_stats_refresh(dialog);
+		return;
+	}
+
+	g_object_set_data(G_OBJECT(usermon_plugin), "stats-dialog", NULL);
+	gtk_widget_destroy(dialog);
+}
+
+void xfce_usermon_show_stats(XfcePanelPlugin * plugin)
+{
+	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(plugin);
+	GtkWidget *dialog;
+	GtkWidget *vbox;
+	GtkWidget *scrolled_window;
+	GtkWidget *text_view;
+
+	/* only one statistics dialog at a time */
+	dialog = g_object_get_data(G_OBJECT(plugin), "stats-dialog");
+	if (dialog != NULL) {
+		xfce_usermon_stats_refresh(dialog);
+		gtk_window_present(GTK_WINDOW(dialog));
+		return;
+	}
+
+#if LIBXFCE4UI_CHECK_VERSION(4,14,0)
+	dialog = xfce_titled_dialog_new_with_mixed_buttons(_("User Monitor"),
+				GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(plugin))),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				"view-refresh", _("_Refresh"), GTK_RESPONSE_APPLY,
+				"window-close", _("_Close"), GTK_RESPONSE_OK,
+				NULL);
+#else
+	dialog = xfce_titled_dialog_new_with_buttons(_("User Monitor"),
+				GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(plugin))),
+				GTK_DIALOG_DESTROY_WITH_PARENT,
+				"gtk-refresh", GTK_RESPONSE_APPLY,
+				"gtk-close", GTK_RESPONSE_OK,
+				NULL);
+#endif
+	xfce_titled_dialog_set_subtitle(XFCE_TITLED_DIALOG(dialog), _("Statistics"));
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 500, 400);
+
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+
+	text_view = gtk_text_view_new();
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(text_view), FALSE);
+	gtk_text_view_set_monospace(GTK_TEXT_VIEW(text_view), TRUE);
+	scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+				       GTK_POLICY_AUTOMATIC,
+				       GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled_window), text_view);
+	gtk_box_pack_start(GTK_BOX(vbox), scrolled_window,
+			TRUE, TRUE, 0);
+
+	g_object_set_data(G_OBJECT(dialog), "text-view", text_view);
+	g_object_set_data(G_OBJECT(plugin), "stats-dialog", dialog);
+
+	g_signal_connect(G_OBJECT(dialog), "response",
+			G_CALLBACK(xfce_usermon_stats_response),
+			usermon_plugin);
+
+	xfce_usermon_stats_refresh(dialog);
+
+	gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER);
+	gtk_window_set_icon_name(GTK_WINDOW(dialog), "usermon");
+	gtk_widget_show_all(dialog);
+}
+
 void xfce_usermon_show_about(XfcePanelPlugin * plugin)
 {
 	/* about dialog code. you can use the GtkAboutDialog
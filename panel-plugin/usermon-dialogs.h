@@ -20,10 +20,20 @@
 #define __USER_MONITOR_DIALOGS_H__
 
 #define DEFAULT_USERMON_PADDING	10
+#define DEFAULT_STATS_FILE	"xfce4-usermon-plugin-stats.txt"
 
 G_BEGIN_DECLS void xfce_usermon_configure_plugin(XfcePanelPlugin * plugin);
 
 void xfce_usermon_show_about(XfcePanelPlugin * plugin);
 
+void xfce_usermon_show_history(XfcePanelPlugin * plugin);
+
+void xfce_usermon_refresh_history(XfcePanelPlugin * plugin);
+
+void xfce_usermon_show_stats(XfcePanelPlugin * plugin);
+
+/* in the locale's format, to be freed with g_free() */
+gchar *xfce_usermon_format_time(gint64 time);
+
 G_END_DECLS
 #endif
@@ -0,0 +1,436 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <libxfce4ui/libxfce4ui.h>
+#include <libxfce4panel/libxfce4panel.h>
+
+#include "usermon-dialogs.h"
+#include "usermon-popup.h"
+#include "usermon-scan.h"
+#include "usermon-tracker.h"
+
+/* clicks on the panel that close the popup don't open it again */
+#define POPUP_REOPEN_DELAY	(G_USEC_PER_SEC / 4)
+
+/* popup columns; users are parent rows, their sessions children */
+enum {
+	POPUP_NAME_COLUMN = 0,
+	POPUP_HOST_COLUMN,
+	POPUP_LOGIN_COLUMN,
+	POPUP_SHOWN_COLUMNS_COUNT,
+	/* the host as found, until its name is known */
+	POPUP_ADDRESS_COLUMN = POPUP_SHOWN_COLUMNS_COUNT,
+	POPUP_COLUMNS_COUNT
+};
+
+struct _UserMonitorPopup {
+	XfcePanelPlugin *plugin;
+	UserMonitorTracker *tracker;
+	GtkTreeStore *store;
+	/* rows, keyed by interned user name and by UserMonitorSessionKey;
+	 * tree store iters stay valid as long as their row exists */
+	GHashTable *user_rows;
+	GHashTable *session_rows;
+	/* keys of the session rows, by the host they came from, so that
+	 * a resolved address only touches its own rows */
+	GHashTable *address_rows;
+	GtkWidget *window;
+	GtkWidget *tree_view;
+	gint64 hide_time;
+};
+
+static GtkTreeIter *xfce_usermon_popup_iter_copy(const GtkTreeIter * iter)
+{
+	return g_slice_dup(GtkTreeIter, iter);
+}
+
+static void xfce_usermon_popup_iter_free(gpointer data)
+{
+	g_slice_free(GtkTreeIter, data);
+}
+
+static void xfce_usermon_popup_key_free(gpointer data)
+{
+	g_slice_free(UserMonitorSessionKey, data);
+}
+
+static void xfce_usermon_popup_index(UserMonitorPopup * popup,
+				     const UserMonitorSessionKey * key,
+				     const gchar * host)
+{
+	GPtrArray *keys;
+
+	if ((host == NULL) || (*host == '\0')) {
+		return;
+	}
+
+	keys = g_hash_table_lookup(popup->address_rows, host);
+	if (keys == NULL) {
+		keys = g_ptr_array_new_with_free_func
+		    (xfce_usermon_popup_key_free);
+		g_hash_table_insert(popup->address_rows, g_strdup(host),
+				    keys);
+	}
+	g_ptr_array_add(keys, g_slice_dup(UserMonitorSessionKey, key));
+}
+
+static void xfce_usermon_popup_unindex(UserMonitorPopup * popup,
+				       const UserMonitorSessionKey * key,
+				       const gchar * host)
+{
+	GPtrArray *keys;
+	guint i;
+
+	if (host == NULL) {
+		return;
+	}
+
+	keys = g_hash_table_lookup(popup->address_rows, host);
+	if (keys == NULL) {
+		return;
+	}
+	for (i = 0; i < keys->len; ++i) {
+		if (xfce_usermon_sessions_key_equal
+		    (g_ptr_array_index(keys, i), key) == TRUE) {
+			g_ptr_array_remove_index_fast(keys, i);
+			break;
+		}
+	}
+	if (keys->len == 0) {
+		g_hash_table_remove(popup->address_rows, host);
+	}
+}
+
+static void xfce_usermon_popup_set_count(UserMonitorPopup * popup,
+					 GtkTreeIter * user_iter)
+{
+	gint count = gtk_tree_model_iter_n_children(GTK_TREE_MODEL
+						    (popup->store),
+						    user_iter);
+	gchar *count_text = g_strdup_printf(ngettext("%d session",
+						     "%d sessions", count),
+					    count);
+
+	gtk_tree_store_set(popup->store, user_iter,
+			   POPUP_HOST_COLUMN, count_text, -1);
+	g_free(count_text);
+}
+
+static void xfce_usermon_popup_add(UserMonitorPopup * popup,
+				   const UserMonitorSessionKey * key,
+				   const gchar * user_name,
+				   const gchar * host, gint64 login_time)
+{
+	GtkTreeIter *user_iter;
+	GtkTreeIter iter;
+	gchar *line;
+	gchar *login_text;
+
+	/* already listed, eg a login the tracker ignored */
+	if (g_hash_table_contains(popup->session_rows, key) == TRUE) {
+		return;
+	}
+
+	user_iter = g_hash_table_lookup(popup->user_rows, user_name);
+	if (user_iter == NULL) {
+		gtk_tree_store_insert_with_values(popup->store, &iter, NULL,
+						  -1, POPUP_NAME_COLUMN,
+						  user_name, -1);
+		user_iter = xfce_usermon_popup_iter_copy(&iter);
+		g_hash_table_insert(popup->user_rows, (gpointer) user_name,
+				    user_iter);
+	}
+
+	line = g_strndup(key->line, sizeof(key->line));
+	login_text = xfce_usermon_format_time(login_time);
+	gtk_tree_store_insert_with_values(popup->store, &iter, user_iter, -1,
+					  POPUP_NAME_COLUMN, line,
+					  POPUP_HOST_COLUMN,
+					  xfce_usermon_tracker_lookup_origin
+					  (popup->tracker, host),
+					  POPUP_LOGIN_COLUMN, login_text,
+					  POPUP_ADDRESS_COLUMN, host, -1);
+	g_free(line);
+	g_free(login_text);
+	g_hash_table_insert(popup->session_rows,
+			    g_slice_dup(UserMonitorSessionKey, key),
+			    xfce_usermon_popup_iter_copy(&iter));
+	xfce_usermon_popup_index(popup, key, host);
+
+	xfce_usermon_popup_set_count(popup, user_iter);
+}
+
+static void xfce_usermon_popup_remove(UserMonitorPopup * popup,
+				      const UserMonitorSessionKey * key,
+				      const gchar * user_name)
+{
+	GtkTreeIter *iter = g_hash_table_lookup(popup->session_rows, key);
+	GtkTreeIter *user_iter;
+	gchar *address = NULL;
+
+	if (iter == NULL) {
+		return;
+	}
+	gtk_tree_model_get(GTK_TREE_MODEL(popup->store), iter,
+			   POPUP_ADDRESS_COLUMN, &address, -1);
+	xfce_usermon_popup_unindex(popup, key, address);
+	g_free(address);
+	gtk_tree_store_remove(popup->store, iter);
+	g_hash_table_remove(popup->session_rows, key);
+
+	user_iter = g_hash_table_lookup(popup->user_rows, user_name);
+	if (user_iter == NULL) {
+		return;
+	}
+	if (gtk_tree_model_iter_has_child(GTK_TREE_MODEL(popup->store),
+					  user_iter) == FALSE) {
+		gtk_tree_store_remove(popup->store, user_iter);
+		g_hash_table_remove(popup->user_rows, user_name);
+	} else {
+		xfce_usermon_popup_set_count(popup, user_iter);
+	}
+}
+
+static void xfce_usermon_popup_add_user(const gchar * user_name,
+					const GPtrArray * user_sessions,
+					gpointer user_data)
+{
+	UserMonitorPopup *popup = (UserMonitorPopup *) user_data;
+	guint i;
+
+	for (i = 0; i < user_sessions->len; ++i) {
+		const UserMonitorSession *session =
+		    g_ptr_array_index(user_sessions, i);
+
+		xfce_usermon_popup_add(popup, &session->key,
+				       session->user_name, session->host,
+				       session->login_time);
+	}
+}
+
+static void xfce_usermon_popup_hide(UserMonitorPopup * popup)
+{
+	if (gtk_widget_get_visible(popup->window) == FALSE) {
+		return;
+	}
+
+	gtk_widget_hide(popup->window);
+	popup->hide_time = g_get_monotonic_time();
+	xfce_panel_plugin_block_autohide(popup->plugin, FALSE);
+}
+
+static gboolean xfce_usermon_popup_focus_out(GtkWidget * widget,
+					     GdkEventFocus * event,
+					     UserMonitorPopup * popup)
+{
+	xfce_usermon_popup_hide(popup);
+
+	return FALSE;
+}
+
+static gboolean xfce_usermon_popup_delete(GtkWidget * widget,
+					  GdkEvent * event,
+					  UserMonitorPopup * popup)
+{
+	xfce_usermon_popup_hide(popup);
+
+	/* kept for next time */
+	return TRUE;
+}
+
+static void xfce_usermon_popup_create_window(UserMonitorPopup * popup)
+{
+	GtkWidget *scrolled_window;
+	const gchar *titles[POPUP_SHOWN_COLUMNS_COUNT] = {
+		_("User"), _("Host"), _("Login")
+	};
+	gint column;
+
+	popup->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	gtk_window_set_decorated(GTK_WINDOW(popup->window), FALSE);
+	gtk_window_set_skip_taskbar_hint(GTK_WINDOW(popup->window), TRUE);
+	gtk_window_set_skip_pager_hint(GTK_WINDOW(popup->window), TRUE);
+	gtk_window_set_type_hint(GTK_WINDOW(popup->window),
+				 GDK_WINDOW_TYPE_HINT_UTILITY);
+	gtk_window_set_default_size(GTK_WINDOW(popup->window), 400, 300);
+
+	popup->tree_view =
+	    gtk_tree_view_new_with_model(GTK_TREE_MODEL(popup->store));
+	for (column = 0; column < POPUP_SHOWN_COLUMNS_COUNT; ++column) {
+		gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW
+							    (popup->tree_view),
+							    -1,
+							    titles[column],
+							    gtk_cell_renderer_text_new
+							    (), "text",
+							    column, NULL);
+	}
+	scrolled_window = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scrolled_window),
+				       GTK_POLICY_AUTOMATIC,
+				       GTK_POLICY_AUTOMATIC);
+	gtk_container_add(GTK_CONTAINER(scrolled_window), popup->tree_view);
+	gtk_container_add(GTK_CONTAINER(popup->window), scrolled_window);
+
+	g_signal_connect(G_OBJECT(popup->window), "focus-out-event",
+			 G_CALLBACK(xfce_usermon_popup_focus_out), popup);
+	g_signal_connect(G_OBJECT(popup->window), "delete-event",
+			 G_CALLBACK(xfce_usermon_popup_delete), popup);
+
+	gtk_widget_show(popup->tree_view);
+	gtk_widget_show(scrolled_window);
+}
+
+UserMonitorPopup *xfce_usermon_popup_new(XfcePanelPlugin * plugin,
+					 UserMonitorTracker * tracker)
+{
+	UserMonitorPopup *popup = g_slice_new0(UserMonitorPopup);
+
+	popup->plugin = plugin;
+	popup->tracker = tracker;
+	popup->store = gtk_tree_store_new(POPUP_COLUMNS_COUNT, G_TYPE_STRING,
+					  G_TYPE_STRING, G_TYPE_STRING,
+					  G_TYPE_STRING);
+	/* users by name, and their sessions by line */
+	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(popup->store),
+					     POPUP_NAME_COLUMN,
+					     GTK_SORT_ASCENDING);
+	popup->user_rows = g_hash_table_new_full(g_direct_hash,
+						 g_direct_equal, NULL,
+						 xfce_usermon_popup_iter_free);
+	popup->session_rows =
+	    g_hash_table_new_full(xfce_usermon_sessions_key_hash,
+				  xfce_usermon_sessions_key_equal,
+				  xfce_usermon_popup_key_free,
+				  xfce_usermon_popup_iter_free);
+	popup->address_rows = g_hash_table_new_full(g_str_hash, g_str_equal,
+						    g_free, (GDestroyNotify)
+						    g_ptr_array_unref);
+	popup->window = NULL;
+	popup->tree_view = NULL;
+	popup->hide_time = 0;
+
+	return popup;
+}
+
+void xfce_usermon_popup_free(UserMonitorPopup * popup)
+{
+	if (popup == NULL) {
+		return;
+	}
+
+	if (popup->window != NULL) {
+		xfce_usermon_popup_hide(popup);
+		gtk_widget_destroy(popup->window);
+	}
+	g_hash_table_destroy(popup->address_rows);
+	g_hash_table_destroy(popup->session_rows);
+	g_hash_table_destroy(popup->user_rows);
+	g_object_unref(G_OBJECT(popup->store));
+
+	g_slice_free(UserMonitorPopup, popup);
+}
+
+void xfce_usermon_popup_update(UserMonitorPopup * popup,
+			       const GArray * logins, const GArray * logouts)
+{
+	guint i;
+
+	for (i = 0; i < logouts->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(logouts, UserMonitorScanEntry, i);
+
+		xfce_usermon_popup_remove(popup, &entry->key,
+					  entry->user_name);
+	}
+
+	for (i = 0; i < logins->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(logins, UserMonitorScanEntry, i);
+
+		xfce_usermon_popup_add(popup, &entry->key, entry->user_name,
+				       entry->host, entry->login_time);
+	}
+}
+
+void xfce_usermon_popup_set_origin(UserMonitorPopup * popup,
+				   const gchar * address, const gchar * name)
+{
+	GPtrArray *keys = g_hash_table_lookup(popup->address_rows, address);
+	guint i;
+
+	if (keys == NULL) {
+		return;
+	}
+
+	for (i = 0; i < keys->len; ++i) {
+		GtkTreeIter *iter = g_hash_table_lookup(popup->session_rows,
+							g_ptr_array_index
+							(keys, i));
+
+		if (iter != NULL) {
+			gtk_tree_store_set(popup->store, iter,
+					   POPUP_HOST_COLUMN, name, -1);
+		}
+	}
+}
+
+void xfce_usermon_popup_reset(UserMonitorPopup * popup,
+			      UserMonitorSessions * sessions)
+{
+	g_hash_table_remove_all(popup->address_rows);
+	g_hash_table_remove_all(popup->session_rows);
+	g_hash_table_remove_all(popup->user_rows);
+	gtk_tree_store_clear(popup->store);
+
+	xfce_usermon_sessions_foreach_user(sessions,
+					   xfce_usermon_popup_add_user, popup);
+}
+
+void xfce_usermon_popup_toggle(UserMonitorPopup * popup,
+			       GtkWidget * widget)
+{
+	gint x, y;
+
+	if (popup->window == NULL) {
+		xfce_usermon_popup_create_window(popup);
+	} else if (gtk_widget_get_visible(popup->window) == TRUE) {
+		xfce_usermon_popup_hide(popup);
+		return;
+	} else if (g_get_monotonic_time() - popup->hide_time <
+		   POPUP_REOPEN_DELAY) {
+		/* the click took the focus away from it */
+		return;
+	}
+
+	/* keep the panel shown while the popup is */
+	xfce_panel_plugin_block_autohide(popup->plugin, TRUE);
+
+	gtk_tree_view_expand_all(GTK_TREE_VIEW(popup->tree_view));
+	gtk_widget_realize(popup->window);
+	xfce_panel_plugin_position_widget(popup->plugin, popup->window,
+					  widget, &x, &y);
+	gtk_window_move(GTK_WINDOW(popup->window), x, y);
+	gtk_window_present(GTK_WINDOW(popup->window));
+}
@@ -0,0 +1,52 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_POPUP_H__
+#define __USER_MONITOR_POPUP_H__
+
+#include "usermon-sessions.h"
+#include "usermon-tracker.h"
+
+/* lists the current sessions, grouped by user; the model is updated
+ * row by row as sessions start and end, whether shown or not */
+G_BEGIN_DECLS typedef struct _UserMonitorPopup UserMonitorPopup;
+
+/* hosts are shown by name when the tracker knows it */
+UserMonitorPopup *xfce_usermon_popup_new(XfcePanelPlugin * plugin,
+					 UserMonitorTracker * tracker);
+
+void xfce_usermon_popup_free(UserMonitorPopup * popup);
+
+/* logins and logouts are arrays of UserMonitorScanEntry */
+void xfce_usermon_popup_update(UserMonitorPopup * popup,
+			       const GArray * logins, const GArray * logouts);
+
+/* the sessions from address come from name */
+void xfce_usermon_popup_set_origin(UserMonitorPopup * popup,
+				   const gchar * address, const gchar * name);
+
+/* starts over from the sessions table, eg after it was replaced */
+void xfce_usermon_popup_reset(UserMonitorPopup * popup,
+			      UserMonitorSessions * sessions);
+
+/* shows the popup next to the widget, or hides it */
+void xfce_usermon_popup_toggle(UserMonitorPopup * popup,
+			       GtkWidget * widget);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_POPUP_H__ */
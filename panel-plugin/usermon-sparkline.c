@@ -0,0 +1,272 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gtk/gtk.h>
+
+#include "usermon-sparkline.h"
+#include "usermon-stats.h"
+
+#define SPARKLINE_WIDTH	48
+/* logins are drawn fainter than sessions */
+#define SPARKLINE_LOGINS_ALPHA	0.4
+
+struct _UserMonitorSparkline {
+	GtkWidget *area;
+	UserMonitorSeries *series;
+	UserMonitorSeriesLevel level;
+	/* what was last drawn */
+	cairo_surface_t *surface;
+	gint surface_width;
+	gint surface_height;
+	/* fires when the next bucket closes */
+	guint source_id;
+};
+
+/* prototypes */
+static void xfce_usermon_sparkline_schedule(UserMonitorSparkline * sparkline);
+
+static void xfce_usermon_sparkline_invalidate(UserMonitorSparkline *
+					      sparkline)
+{
+	if (sparkline->surface != NULL) {
+		cairo_surface_destroy(sparkline->surface);
+		sparkline->surface = NULL;
+	}
+	gtk_widget_queue_draw(sparkline->area);
+}
+
+static void xfce_usermon_sparkline_closed(UserMonitorSparkline * sparkline,
+					  guint closed)
+{
+	if ((closed & (1 << sparkline->level)) != 0) {
+		xfce_usermon_sparkline_invalidate(sparkline);
+	}
+}
+
+static gboolean xfce_usermon_sparkline_tick(gpointer user_data)
+{
+	UserMonitorSparkline *sparkline = (UserMonitorSparkline *) user_data;
+
+	sparkline->source_id = 0;
+	xfce_usermon_sparkline_closed(sparkline,
+				      xfce_usermon_series_advance
+				      (sparkline->series,
+				       g_get_real_time() / G_USEC_PER_SEC));
+	xfce_usermon_sparkline_schedule(sparkline);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void xfce_usermon_sparkline_schedule(UserMonitorSparkline * sparkline)
+{
+	guint width = xfce_usermon_series_get_width(sparkline->level);
+	gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+	if (sparkline->source_id > 0) {
+		g_source_remove(sparkline->source_id);
+	}
+
+	/* just past the end of the open bucket */
+	sparkline->source_id =
+	    g_timeout_add_seconds((guint) (width - now % width) + 1,
+				  xfce_usermon_sparkline_tick, sparkline);
+}
+
+static void xfce_usermon_sparkline_render(UserMonitorSparkline * sparkline,
+					  cairo_t * cr, gint width,
+					  gint height)
+{
+	GtkStyleContext *context = gtk_widget_get_style_context(sparkline->area);
+	GdkRGBA color;
+	guint length = xfce_usermon_series_get_length(sparkline->level);
+	guint max_sessions_count = 1;
+	guint max_logins_count = 1;
+	gdouble step = (gdouble) width / length;
+	guint age;
+
+	gtk_style_context_get_color(context,
+				    gtk_widget_get_state_flags(sparkline->area),
+				    &color);
+
+	for (age = 0; age < length; ++age) {
+		const UserMonitorSeriesBucket *bucket =
+		    xfce_usermon_series_get(sparkline->series,
+					    sparkline->level, age);
+
+		if (bucket == NULL) {
+			break;
+		}
+		max_sessions_count = MAX(max_sessions_count,
+					 bucket->sessions_count);
+		max_logins_count = MAX(max_logins_count,
+				       bucket->logins_count);
+	}
+	if (age == 0) {
+		return;
+	}
+
+	/* logins as bars, the newest on the right */
+	cairo_set_source_rgba(cr, color.red, color.green, color.blue,
+			      color.alpha * SPARKLINE_LOGINS_ALPHA);
+	for (age = 0; age < length; ++age) {
+		const UserMonitorSeriesBucket *bucket =
+		    xfce_usermon_series_get(sparkline->series,
+					    sparkline->level, age);
+		gdouble bar_height;
+
+		if (bucket == NULL) {
+			break;
+		}
+		bar_height = (gdouble) height * bucket->logins_count /
+		    max_logins_count;
+		cairo_rectangle(cr, width - (age + 1) * step,
+				height - bar_height, step, bar_height);
+	}
+	cairo_fill(cr);
+
+	/* sessions as a line */
+	gdk_cairo_set_source_rgba(cr, &color);
+	cairo_set_line_width(cr, 1.0);
+	for (age = 0; age < length; ++age) {
+		const UserMonitorSeriesBucket *bucket =
+		    xfce_usermon_series_get(sparkline->series,
+					    sparkline->level, age);
+		gdouble y;
+
+		if (bucket == NULL) {
+			break;
+		}
+		y = 0.5 + (height - 1) * (1.0 - (gdouble)
+					  bucket->sessions_count /
+					  max_sessions_count);
+		cairo_line_to(cr, width - (age + 0.5) * step, y);
+	}
+	cairo_stroke(cr);
+}
+
+static gboolean xfce_usermon_sparkline_draw(GtkWidget * widget,
+					    cairo_t * cr,
+					    UserMonitorSparkline * sparkline)
+{
+	gint width = gtk_widget_get_allocated_width(widget);
+	gint height = gtk_widget_get_allocated_height(widget);
+
+	if ((sparkline->surface != NULL) &&
+	    ((sparkline->surface_width != width) ||
+	     (sparkline->surface_height != height))) {
+		cairo_surface_destroy(sparkline->surface);
+		sparkline->surface = NULL;
+	}
+
+	/* panel exposes only copy the surface */
+	if (sparkline->surface == NULL) {
+		cairo_t *surface_cr;
+
+		sparkline->surface =
+		    gdk_window_create_similar_surface(gtk_widget_get_window
+						      (widget),
+						      CAIRO_CONTENT_COLOR_ALPHA,
+						      width, height);
+		sparkline->surface_width = width;
+		sparkline->surface_height = height;
+		surface_cr = cairo_create(sparkline->surface);
+		xfce_usermon_sparkline_render(sparkline, surface_cr, width,
+					      height);
+		cairo_destroy(surface_cr);
+		xfce_usermon_stats_count(USERMON_COUNTER_SPARKLINE_RENDERS, 1);
+	}
+
+	cairo_set_source_surface(cr, sparkline->surface, 0, 0);
+	cairo_paint(cr);
+
+	return FALSE;
+}
+
+UserMonitorSparkline *xfce_usermon_sparkline_new(UserMonitorSeriesLevel
+						 level)
+{
+	UserMonitorSparkline *sparkline = g_slice_new0(UserMonitorSparkline);
+
+	sparkline->series = xfce_usermon_series_new();
+	sparkline->level = level;
+	sparkline->surface = NULL;
+	sparkline->surface_width = 0;
+	sparkline->surface_height = 0;
+	sparkline->source_id = 0;
+
+	sparkline->area = gtk_drawing_area_new();
+	gtk_widget_set_size_request(sparkline->area, SPARKLINE_WIDTH, -1);
+	g_signal_connect(G_OBJECT(sparkline->area), "draw",
+			 G_CALLBACK(xfce_usermon_sparkline_draw), sparkline);
+
+	xfce_usermon_sparkline_schedule(sparkline);
+
+	return sparkline;
+}
+
+void xfce_usermon_sparkline_free(UserMonitorSparkline * sparkline)
+{
+	if (sparkline == NULL) {
+		return;
+	}
+
+	/* the widget belongs to its container */
+	g_signal_handlers_disconnect_by_data(sparkline->area, sparkline);
+	if (sparkline->source_id > 0) {
+		g_source_remove(sparkline->source_id);
+	}
+	if (sparkline->surface != NULL) {
+		cairo_surface_destroy(sparkline->surface);
+	}
+	xfce_usermon_series_free(sparkline->series);
+
+	g_slice_free(UserMonitorSparkline, sparkline);
+}
+
+GtkWidget *xfce_usermon_sparkline_get_widget(UserMonitorSparkline *
+					     sparkline)
+{
+	return sparkline->area;
+}
+
+void xfce_usermon_sparkline_set_level(UserMonitorSparkline * sparkline,
+				      UserMonitorSeriesLevel level)
+{
+	if (sparkline->level == level) {
+		return;
+	}
+
+	sparkline->level = level;
+	xfce_usermon_sparkline_schedule(sparkline);
+	xfce_usermon_sparkline_invalidate(sparkline);
+}
+
+void xfce_usermon_sparkline_add(UserMonitorSparkline * sparkline,
+				guint sessions_count, guint logins_count)
+{
+	/* the open bucket isn't drawn */
+	xfce_usermon_sparkline_closed(sparkline,
+				      xfce_usermon_series_add
+				      (sparkline->series,
+				       g_get_real_time() / G_USEC_PER_SEC,
+				       sessions_count, logins_count));
+}
@@ -0,0 +1,44 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __USER_MONITOR_SPARKLINE_H__
+#define __USER_MONITOR_SPARKLINE_H__
+
+#include "usermon-series.h"
+
+/* draws the trend of sessions and logins; what's drawn is kept in a
+ * surface, and only drawn again when a bucket closes or the size
+ * changes */
+G_BEGIN_DECLS typedef struct _UserMonitorSparkline UserMonitorSparkline;
+
+UserMonitorSparkline *xfce_usermon_sparkline_new(UserMonitorSeriesLevel
+						 level);
+
+void xfce_usermon_sparkline_free(UserMonitorSparkline * sparkline);
+
+GtkWidget *xfce_usermon_sparkline_get_widget(UserMonitorSparkline *
+					     sparkline);
+
+void xfce_usermon_sparkline_set_level(UserMonitorSparkline * sparkline,
+				      UserMonitorSeriesLevel level);
+
+void xfce_usermon_sparkline_add(UserMonitorSparkline * sparkline,
+				guint sessions_count, guint logins_count);
+
+G_END_DECLS
+#endif				/* !__USER_MONITOR_SPARKLINE_H__ */
@@ -1,5 +1,5 @@
 /*
- *  Copyright 2003-2020 Fabrice Colin
+ *  Copyright 2003-2021 Fabrice Colin
  *
  *  This program is free software; you can redistribute it and/or modify
  *  it under the terms of the GNU General Public License as published by
@@ -19,19 +19,13 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
-#ifdef HAVE_STRING_H
-#include <string.h>
-#endif
 #include <stdio.h>
 #include <unistd.h>
-#include <utmpx.h>
-#include <sys/time.h>
 #include <sys/types.h>
 #include <pwd.h>
 #include <time.h>
 
 #include <gtk/gtk.h>
-#include <libnotify/notify.h>
 #include <libxfce4util/libxfce4util.h>
 #include <libxfce4panel/libxfce4panel.h>
 
@@ -42,8 +36,17 @@
 #define DEFAULT_MAX_USERS_COUNT	2
 #define DEFAULT_USERS_COUNT	1
 #define DEFAULT_ALARM_PERIOD	5
-
-UserMonitorPlugin *the_usermon_plugin = NULL;
+#define DEFAULT_IDLE_THRESHOLD	10
+#define DEFAULT_TREND	(USERMON_SERIES_MINUTES + 1)
+#define DEFAULT_NOTIFICATIONS_QUEUE	8
+#define DEFAULT_NOTIFICATIONS_TIMEOUT	5000
+#define DEFAULT_HISTORY_INDEX	"xfce4-usermon-plugin-wtmp.idx"
+#define DEFAULT_SNAPSHOT	"xfce4-usermon-plugin-sessions.snap"
+#define DEFAULT_JOURNAL	"xfce4-usermon-plugin-sessions.journal"
+#define DEFAULT_LOG_FILE	"xfce4-usermon_plugin-plugin.log"
+#define DEFAULT_LOG_BUFFER_SIZE	65536
+#define DEFAULT_LOG_FILE_SIZE	(1024 * 1024)
+#define DEFAULT_LOG_FILES	3
 
 /* prototypes */
 static void xfce_usermon_construct(XfcePanelPlugin * plugin);
@@ -51,7 +54,16 @@ static void xfce_usermon_free(XfcePanelPlugin * plugin);
 static gboolean xfce_usermon_size_changed(XfcePanelPlugin * plugin, gint size);
 static void xfce_usermon_mode_changed(XfcePanelPlugin * plugin,
 				      XfcePanelPluginMode mode);
-static void xfce_usermon_set_timer(void);
+static void xfce_usermon_sessions_changed(UserMonitorTracker * tracker,
+					  const GArray * logins,
+					  const GArray * logouts,
+					  gpointer user_data);
+static void xfce_usermon_show_notification(UserMonitorUrgency urgency,
+					   const gchar * body,
+					   gpointer user_data);
+static void xfce_usermon_origin_resolved(const gchar * address,
+					 const gchar * name,
+					 gpointer user_data);
 
 /* define the plugin */
 XFCE_PANEL_DEFINE_PLUGIN(UserMonitorPlugin, user_monitor)
@@ -74,15 +86,13 @@ static void xfce_usermon_read(UserMonitorPlugin * usermon_plugin)
 	XfceRc *rc;
 	struct passwd *passwd = getpwuid(geteuid());
 	gchar *file_name;
+	const gchar *metrics_file;
 
 	g_debug("xfce_usermon_read");
 
 	/* record the current user */
 	if ((passwd != NULL) && (passwd->pw_name != NULL)) {
 		usermon_plugin->user_name = g_strdup(passwd->pw_name);
-		g_hash_table_insert(usermon_plugin->all_users_list,
-				    usermon_plugin->user_name,
-				    usermon_plugin->user_name);
 		usermon_plugin->users_count = 1;
 	}
 
@@ -104,9 +114,38 @@ static void xfce_usermon_read(UserMonitorPlugin * usermon_plugin)
 			usermon_plugin->max_users_count =
 			    xfce_rc_read_int_entry(rc, "max_users_count",
 						   DEFAULT_MAX_USERS_COUNT);
+			usermon_plugin->max_user_cpu =
+			    xfce_rc_read_int_entry(rc, "max_user_cpu", 0);
+			usermon_plugin->max_user_rss =
+			    xfce_rc_read_int_entry(rc, "max_user_rss", 0);
+			usermon_plugin->idle_threshold =
+			    xfce_rc_read_int_entry(rc, "idle_threshold",
+						   DEFAULT_IDLE_THRESHOLD);
+			usermon_plugin->trend =
+			    CLAMP(xfce_rc_read_int_entry(rc, "trend",
+							 DEFAULT_TREND), 0,
+				  USERMON_SERIES_LEVELS_COUNT);
 			usermon_plugin->alarm_period =
 			    xfce_rc_read_int_entry(rc, "alarm_period",
 						   DEFAULT_ALARM_PERIOD);
+			if (g_strcmp0(xfce_rc_read_entry(rc, "backend",
+							 "utmp"),
+				      "logind") == 0) {
+				usermon_plugin->backend =
+				    USERMON_BACKEND_LOGIND;
+			}
+			usermon_plugin->sources =
+			    xfce_rc_read_list_entry(rc, "sources", ";");
+			usermon_plugin->rules =
+			    xfce_rc_read_list_entry(rc, "rules", ";");
+			usermon_plugin->group_limits =
+			    xfce_rc_read_list_entry(rc, "group_limits", ";");
+			metrics_file =
+			    xfce_rc_read_entry(rc, "metrics_file", "");
+			if (*metrics_file != '\0') {
+				usermon_plugin->metrics_file =
+				    g_strdup(metrics_file);
+			}
 
 			/* cleanup */
 			xfce_rc_close(rc);
@@ -117,22 +156,35 @@ static void xfce_usermon_read(UserMonitorPlugin * usermon_plugin)
 static void user_monitor_init(UserMonitorPlugin * usermon_plugin)
 {
 	GtkOrientation orientation;
+	gchar *index_path;
 
 	/* make only g_error critical */
 	g_log_set_always_fatal(G_LOG_LEVEL_ERROR);
 
-	usermon_plugin->log_file = NULL;
+	usermon_plugin->log = NULL;
 	usermon_plugin->ebox = NULL;
 	usermon_plugin->hvbox = NULL;
 	usermon_plugin->label = NULL;
-	usermon_plugin->all_users_list = NULL;
-	usermon_plugin->found_users_list = NULL;
+	usermon_plugin->sparkline = NULL;
+	usermon_plugin->tracker = NULL;
+	usermon_plugin->popup = NULL;
+	usermon_plugin->history = NULL;
+	usermon_plugin->history_thread = NULL;
+	usermon_plugin->notifier = NULL;
 	usermon_plugin->user_name = NULL;
+	usermon_plugin->backend = USERMON_BACKEND_UTMP;
+	usermon_plugin->sources = NULL;
+	usermon_plugin->rules = NULL;
+	usermon_plugin->group_limits = NULL;
+	usermon_plugin->metrics_file = NULL;
 	usermon_plugin->max_users_count = DEFAULT_MAX_USERS_COUNT;
+	usermon_plugin->max_user_cpu = 0;
+	usermon_plugin->max_user_rss = 0;
+	usermon_plugin->idle_threshold = DEFAULT_IDLE_THRESHOLD;
+	usermon_plugin->trend = DEFAULT_TREND;
 	usermon_plugin->users_count = DEFAULT_USERS_COUNT;
 	usermon_plugin->alarm_period = DEFAULT_ALARM_PERIOD;
 	usermon_plugin->start_time = time(NULL);
-	usermon_plugin->last_alarm_time = 0;
 
 	/* get the current orientation */
 	orientation =
@@ -148,19 +200,46 @@ static void user_monitor_init(UserMonitorPlugin * usermon_plugin)
 	gtk_container_add(GTK_CONTAINER(usermon_plugin->ebox),
 			  usermon_plugin->hvbox);
 
+	/* shown once the settings are read */
+	usermon_plugin->sparkline =
+	    xfce_usermon_sparkline_new(USERMON_SERIES_MINUTES);
+	gtk_box_pack_start(GTK_BOX(usermon_plugin->hvbox),
+			   xfce_usermon_sparkline_get_widget
+			   (usermon_plugin->sparkline), FALSE, FALSE,
+			   DEFAULT_USERMON_PADDING);
+
 	usermon_plugin->label = gtk_label_new(_("1 User"));
 	gtk_widget_show(usermon_plugin->label);
 	gtk_box_pack_start(GTK_BOX(usermon_plugin->hvbox),
 			   usermon_plugin->label, FALSE, FALSE,
 			   DEFAULT_USERMON_PADDING);
 
-	/* create the users lists */
-	usermon_plugin->all_users_list =
-	    g_hash_table_new(g_str_hash, g_str_equal);
-	usermon_plugin->found_users_list =
-	    g_hash_table_new(g_str_hash, g_str_equal);
-
-	the_usermon_plugin = usermon_plugin;
+	/* notifications are delivered off the main thread */
+	usermon_plugin->notifier =
+	    xfce_usermon_notifier_new(GETTEXT_PACKAGE,
+				      PACKAGE_ICON_DIR
+				      "/48x48/apps/usermon.png",
+				      DEFAULT_NOTIFICATIONS_QUEUE,
+				      DEFAULT_NOTIFICATIONS_TIMEOUT);
+
+	/* the tracker keeps the sessions table up to date */
+	usermon_plugin->tracker =
+	    xfce_usermon_tracker_new(xfce_usermon_sessions_changed,
+				     xfce_usermon_show_notification,
+				     usermon_plugin);
+	usermon_plugin->popup =
+	    xfce_usermon_popup_new(XFCE_PANEL_PLUGIN(usermon_plugin),
+				   usermon_plugin->tracker);
+	xfce_usermon_tracker_set_origin_func(usermon_plugin->tracker,
+					     xfce_usermon_origin_resolved,
+					     usermon_plugin);
+
+	/* index wtmp for the history */
+	index_path = g_build_filename(g_get_user_cache_dir(),
+				      DEFAULT_HISTORY_INDEX, NULL);
+	usermon_plugin->history = xfce_usermon_history_new(USERMON_WTMP_PATH,
+							   index_path);
+	g_free(index_path);
 }
 
 static void xfce_usermon_free(XfcePanelPlugin * plugin)
@@ -175,23 +254,48 @@ static void xfce_usermon_free(XfcePanelPlugin * plugin)
 	dialog = g_object_get_data(G_OBJECT(plugin), "dialog");
 	if (G_UNLIKELY(dialog != NULL))
 		gtk_widget_destroy(dialog);
+	dialog = g_object_get_data(G_OBJECT(plugin), "history-dialog");
+	if (G_UNLIKELY(dialog != NULL))
+		gtk_widget_destroy(dialog);
+	dialog = g_object_get_data(G_OBJECT(plugin), "stats-dialog");
+	if (G_UNLIKELY(dialog != NULL))
+		gtk_widget_destroy(dialog);
+
+	/* stop watching sessions, remembering them for next time */
+	xfce_usermon_tracker_save_snapshot(usermon_plugin->tracker);
+	xfce_usermon_tracker_free(usermon_plugin->tracker);
+	xfce_usermon_popup_free(usermon_plugin->popup);
+	xfce_usermon_sparkline_free(usermon_plugin->sparkline);
 
 	/* destroy the panel widgets */
 	gtk_widget_destroy(usermon_plugin->hvbox);
 
-	/* destroy the users lists */
-	g_hash_table_destroy(usermon_plugin->all_users_list);
-	g_hash_table_destroy(usermon_plugin->found_users_list);
+	/* stop indexing wtmp */
+	if (usermon_plugin->history_thread != NULL) {
+		xfce_usermon_history_cancel(usermon_plugin->history);
+		g_thread_join(usermon_plugin->history_thread);
+		usermon_plugin->history_thread = NULL;
+	}
+	g_idle_remove_by_data(usermon_plugin);
+	xfce_usermon_history_free(usermon_plugin->history);
+
+	/* destroy the notifier */
+	xfce_usermon_notifier_free(usermon_plugin->notifier);
 
 	/* cleanup the settings */
 	if (G_LIKELY(usermon_plugin->user_name != NULL))
 		g_free(usermon_plugin->user_name);
+	g_strfreev(usermon_plugin->sources);
+	g_strfreev(usermon_plugin->rules);
+	g_strfreev(usermon_plugin->group_limits);
+	g_free(usermon_plugin->metrics_file);
+
+	/* stop logging to the file, flushing what's left */
+	g_log_set_default_handler(g_log_default_handler, NULL);
+	xfce_usermon_log_free(usermon_plugin->log);
 
 	/* free the plugin structure */
 	g_slice_free(UserMonitorPlugin, usermon_plugin);
-	the_usermon_plugin = NULL;
-
-	notify_uninit();
 }
 
 static gboolean xfce_usermon_size_changed(XfcePanelPlugin * plugin, gint size)
@@ -223,6 +327,9 @@ void xfce_usermon_save(XfcePanelPlugin * plugin)
 	g_debug("xfce_usermon_save");
 	usermon_plugin = XFCE_USERMON_PLUGIN(plugin);
 
+	/* sessions known now aren't notified again after a restart */
+	xfce_usermon_tracker_save_snapshot(usermon_plugin->tracker);
+
 	/* get the config file location */
 	file = xfce_panel_plugin_save_location(plugin, TRUE);
 
@@ -239,8 +346,41 @@ void xfce_usermon_save(XfcePanelPlugin * plugin)
 		/* save the settings */
 		xfce_rc_write_int_entry(rc, "max_users_count",
 					usermon_plugin->max_users_count);
+		xfce_rc_write_int_entry(rc, "max_user_cpu",
+					usermon_plugin->max_user_cpu);
+		xfce_rc_write_int_entry(rc, "max_user_rss",
+					usermon_plugin->max_user_rss);
+		xfce_rc_write_int_entry(rc, "idle_threshold",
+					usermon_plugin->idle_threshold);
+		xfce_rc_write_int_entry(rc, "trend", usermon_plugin->trend);
 		xfce_rc_write_int_entry(rc, "alarm_period",
 					usermon_plugin->alarm_period);
+		xfce_rc_write_entry(rc, "backend",
+				    (usermon_plugin->backend ==
+				     USERMON_BACKEND_LOGIND) ? "logind" :
+				    "utmp");
+		if (usermon_plugin->sources != NULL) {
+			xfce_rc_write_list_entry(rc, "sources",
+						 usermon_plugin->sources, ";");
+		} else {
+			xfce_rc_write_entry(rc, "sources", "");
+		}
+		if (usermon_plugin->rules != NULL) {
+			xfce_rc_write_list_entry(rc, "rules",
+						 usermon_plugin->rules, ";");
+		} else {
+			xfce_rc_write_entry(rc, "rules", "");
+		}
+		if (usermon_plugin->group_limits != NULL) {
+			xfce_rc_write_list_entry(rc, "group_limits",
+						 usermon_plugin->group_limits,
+						 ";");
+		} else {
+			xfce_rc_write_entry(rc, "group_limits", "");
+		}
+		xfce_rc_write_entry(rc, "metrics_file",
+				    (usermon_plugin->metrics_file != NULL) ?
+				    usermon_plugin->metrics_file : "");
 
 		/* close the rc file */
 		xfce_rc_close(rc);
@@ -248,261 +388,289 @@ void xfce_usermon_save(XfcePanelPlugin * plugin)
 	}
 }
 
-static void xfce_usermon_show_notification(NotifyUrgency urgency,
-					   gchar * body, gint timeout)
+static void xfce_usermon_show_notification(UserMonitorUrgency urgency,
+					   const gchar * body,
+					   gpointer user_data)
 {
-	NotifyNotification *notification_popup = NULL;
-
-	notification_popup =
-	    notify_notification_new(_("User Monitor"),
-				    body,
-				    PACKAGE_ICON_DIR "/48x48/apps/usermon.png");
+	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
 
-	/* display a notification popup */
-	if (notification_popup != NULL) {
-		notify_notification_set_timeout(notification_popup, timeout);
-		notify_notification_set_urgency(notification_popup, urgency);
-		notify_notification_show(notification_popup, NULL);
-
-		g_object_unref(G_OBJECT(notification_popup));
-	}
+	/* the popup is updated in place if still shown */
+	xfce_usermon_notifier_post(usermon_plugin->notifier, urgency,
+				   _("User Monitor"), body,
+				   usermon_plugin->alarm_period * 1000);
 }
 
-static void xfce_usermon_notify_for_login(gpointer key,
-					  gpointer value, gpointer user_data)
+static void xfce_usermon_update_label(UserMonitorPlugin * usermon_plugin,
+				      guint users_count)
 {
-	UserMonitorPlugin *usermon_plugin;
-
-	usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
-
-	if (key != NULL && value != NULL && (usermon_plugin->user_name != key)) {
-		NotifyUrgency urgency = NOTIFY_URGENCY_NORMAL;
-		gchar *body = g_strdup_printf(_("%s logged in"),
-					      (gchar *) key);
+	guint sessions_count =
+	    xfce_usermon_sessions_get_count(xfce_usermon_tracker_get_sessions
+					    (usermon_plugin->tracker));
+	guint idle_count =
+	    xfce_usermon_tracker_get_idle_count(usermon_plugin->tracker);
+	gchar *tooltip_text;
+
+	if (idle_count > 0) {
+		tooltip_text = g_strdup_printf(_("%d active, %d idle sessions"),
+					       sessions_count - idle_count,
+					       idle_count);
+	} else {
+		tooltip_text =
+		    g_strdup_printf(ngettext("%d session", "%d sessions",
+					     sessions_count), sessions_count);
+	}
+	gtk_widget_set_tooltip_text(usermon_plugin->ebox, tooltip_text);
+	g_free(tooltip_text);
 
-		if (usermon_plugin->users_count >
-		    usermon_plugin->max_users_count) {
-			urgency = NOTIFY_URGENCY_CRITICAL;
-		}
+	if (usermon_plugin->users_count == users_count) {
+		return;
+	}
 
-		xfce_usermon_show_notification(urgency, body,
-					       usermon_plugin->alarm_period *
-					       1000);
+	gtk_widget_destroy(usermon_plugin->label);
+	xfce_usermon_stats_count(USERMON_COUNTER_LABEL_REBUILDS, 1);
 
-		g_free(body);
+	/* if utmp is broken for some reason, we may get 0 users */
+	if (users_count <= 1) {
+		usermon_plugin->label = gtk_label_new(_("1 User"));
+	} else {
+		gchar *label_text = g_strdup_printf(_("%d Users"), users_count);
+		usermon_plugin->label = gtk_label_new(label_text);
+		g_free(label_text);
 	}
+	gtk_widget_show(usermon_plugin->label);
+	gtk_box_pack_start(GTK_BOX(usermon_plugin->hvbox),
+			   usermon_plugin->label, FALSE, FALSE,
+			   DEFAULT_USERMON_PADDING);
 }
 
-static void xfce_usermon_notify_for_logout(gpointer key,
-					   gpointer value, gpointer user_data)
+static void xfce_usermon_sessions_changed(UserMonitorTracker * tracker,
+					  const GArray * logins,
+					  const GArray * logouts,
+					  gpointer user_data)
 {
-	UserMonitorPlugin *usermon_plugin;
-
-	usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
+	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
+	UserMonitorSessions *sessions =
+	    xfce_usermon_tracker_get_sessions(tracker);
+	guint users_count;
+	guint logins_count = 0;
+	guint i;
 
-	if (key != NULL && value != NULL && (usermon_plugin->user_name != key)) {
-		NotifyUrgency urgency = NOTIFY_URGENCY_NORMAL;
-
-		g_debug("xfce_usermon_notify_for_logout %s %s", (gchar *) key,
-			(gchar *) value);
+	/* update the label? */
+	users_count = xfce_usermon_sessions_get_users_count(sessions);
+	xfce_usermon_update_label(usermon_plugin, users_count);
+	usermon_plugin->users_count = users_count;
+
+	/* sessions found on start aren't logins */
+	for (i = 0; i < logins->len; ++i) {
+		if (g_array_index(logins, UserMonitorScanEntry, i).login_time >=
+		    (gint64) usermon_plugin->start_time) {
+			++logins_count;
+		}
+	}
+	xfce_usermon_sparkline_add(usermon_plugin->sparkline,
+				   xfce_usermon_sessions_get_count(sessions),
+				   logins_count);
 
-		/* is this user still logged in? */
-		if (g_hash_table_contains
-		    (the_usermon_plugin->found_users_list, key) == FALSE) {
-			gchar *body = g_strdup_printf(_("%s logged out"),
-						      (gchar *) key);
+	/* only the rows of these sessions change */
+	xfce_usermon_popup_update(usermon_plugin->popup, logins, logouts);
+}
 
-			xfce_usermon_show_notification(urgency, body,
-						       usermon_plugin->
-						       alarm_period * 1000);
+static void xfce_usermon_origin_resolved(const gchar * address,
+					 const gchar * name,
+					 gpointer user_data)
+{
+	UserMonitorPlugin *usermon_plugin = (UserMonitorPlugin *) user_data;
 
-			g_free(body);
-		}
+	if (name != NULL) {
+		xfce_usermon_popup_set_origin(usermon_plugin->popup, address,
+					      name);
 	}
 }
 
-static void xfce_usermon_record_user(gpointer key,
-				     gpointer value, gpointer user_data)
+static gboolean xfce_usermon_button_pressed(GtkWidget * widget,
+					    GdkEventButton * event,
+					    UserMonitorPlugin * usermon_plugin)
 {
-	UserMonitorPlugin *usermon_plugin;
+	/* the panel handles the other buttons */
+	if ((event->button != 1) || (event->type != GDK_BUTTON_PRESS)) {
+		return FALSE;
+	}
 
-	usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
+	xfce_usermon_popup_toggle(usermon_plugin->popup, widget);
 
-	if (key != NULL && value != NULL) {
-		gchar *user_name = g_strdup(key);
+	return TRUE;
+}
+
+static gboolean xfce_usermon_history_updated(gpointer user_data)
+{
+	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
 
-		g_debug("xfce_usermon_record_user %s %s", (gchar *) key,
-			(gchar *) value);
-		g_hash_table_insert(usermon_plugin->all_users_list, user_name,
-				    user_name);
+	g_debug("xfce_usermon_history_updated");
+	if (usermon_plugin->history_thread == NULL) {
+		return G_SOURCE_REMOVE;
 	}
+
+	g_thread_join(usermon_plugin->history_thread);
+	usermon_plugin->history_thread = NULL;
+
+	xfce_usermon_refresh_history(XFCE_PANEL_PLUGIN(usermon_plugin));
+
+	return G_SOURCE_REMOVE;
 }
 
-static void xfce_usermon_free_user(gpointer key,
-				   gpointer value, gpointer user_data)
+static gpointer xfce_usermon_history_run(gpointer user_data)
 {
-	UserMonitorPlugin *usermon_plugin;
+	UserMonitorPlugin *usermon_plugin = (UserMonitorPlugin *) user_data;
 
-	usermon_plugin = XFCE_USERMON_PLUGIN(user_data);
+	xfce_usermon_history_update(usermon_plugin->history);
 
-	if (key != NULL && value != NULL && (usermon_plugin->user_name != key)) {
-		/* keys are also values */
-		g_debug("xfce_usermon_free_user %s %s", (gchar *) key,
-			(gchar *) value);
-		g_free(key);
-	}
+	/* back to the main thread */
+	g_idle_add(xfce_usermon_history_updated, usermon_plugin);
+
+	return NULL;
 }
 
-static void xfce_usermon_update_users_list(void)
+void xfce_usermon_update_history(UserMonitorPlugin * usermon_plugin)
 {
-	GHashTable *new_users_list = NULL;
-	struct utmpx *u = NULL;
-	guint users_count = 0;
-
-	g_debug("xfce_usermon_update_users_list");
-	if (the_usermon_plugin == NULL) {
+	g_debug("xfce_usermon_update_history");
+	if ((usermon_plugin->history == NULL) ||
+	    (usermon_plugin->history_thread != NULL)) {
 		return;
 	}
-	g_debug("Found %d users so far", the_usermon_plugin->users_count);
 
-	new_users_list = g_hash_table_new(g_str_hash, g_str_equal);
+	/* a large wtmp takes a while to index the first time */
+	usermon_plugin->history_thread =
+	    g_thread_new("usermon-history", xfce_usermon_history_run,
+			 usermon_plugin);
+}
 
-	g_debug("Current user is %s", the_usermon_plugin->user_name);
+static void xfce_usermon_history_activated(GtkMenuItem * menu_item,
+					   XfcePanelPlugin * plugin)
+{
+	xfce_usermon_show_history(plugin);
+}
 
-	/* rewind to the beginning of utmpx */
-	setutxent();
-	/* read utmp */
-	while ((u = getutxent())) {
-		gchar *user_name;
+static void xfce_usermon_stats_activated(GtkMenuItem * menu_item,
+					 XfcePanelPlugin * plugin)
+{
+	xfce_usermon_show_stats(plugin);
+}
 
-		if (u->ut_type != USER_PROCESS) {
-			continue;
-		}
+void xfce_usermon_set_backend(UserMonitorPlugin * usermon_plugin,
+			      UserMonitorBackend backend)
+{
+	usermon_plugin->backend = backend;
+	xfce_usermon_tracker_set_backend(usermon_plugin->tracker, backend);
 
-		user_name = g_strdup(u->ut_user);
-		g_hash_table_insert(the_usermon_plugin->found_users_list,
-				    user_name, user_name);
+	/* the sessions table was replaced */
+	xfce_usermon_popup_reset(usermon_plugin->popup,
+				 xfce_usermon_tracker_get_sessions
+				 (usermon_plugin->tracker));
+}
 
-		/* is this a new user? */
-		if (g_hash_table_contains
-		    (the_usermon_plugin->all_users_list, user_name) == FALSE) {
-			user_name = g_strdup(u->ut_user);
+void xfce_usermon_set_alarm_period(UserMonitorPlugin * usermon_plugin,
+				   guint alarm_period)
+{
+	usermon_plugin->alarm_period = alarm_period;
+	xfce_usermon_tracker_set_poll_period(usermon_plugin->tracker,
+					     alarm_period);
+}
 
-			g_debug("Found new user %s", user_name);
-			g_hash_table_insert(new_users_list, user_name,
-					    user_name);
-		} else {
-			g_debug("Found known user %s", user_name);
-		}
+void xfce_usermon_set_sources(UserMonitorPlugin * usermon_plugin,
+			      const gchar * sources)
+{
+	gchar *joined = (usermon_plugin->sources != NULL) ?
+	    g_strjoinv(";", usermon_plugin->sources) : g_strdup("");
+
+	/* refreshing means going through the file system */
+	if (g_strcmp0(joined, sources) != 0) {
+		g_strfreev(usermon_plugin->sources);
+		usermon_plugin->sources = g_strsplit(sources, ";", -1);
+		xfce_usermon_tracker_set_sources(usermon_plugin->tracker,
+						 (const gchar * const *)
+						 usermon_plugin->sources);
 	}
-	/* close utmpx */
-	endutxent();
+	g_free(joined);
+}
 
-	/* update the label? */
-	users_count = g_hash_table_size(the_usermon_plugin->found_users_list);
-	if (the_usermon_plugin->users_count != users_count) {
-		gtk_widget_destroy(the_usermon_plugin->label);
+void xfce_usermon_set_rules(UserMonitorPlugin * usermon_plugin,
+			    const gchar * rules)
+{
+	g_strfreev(usermon_plugin->rules);
+	usermon_plugin->rules = g_strsplit(rules, ";", -1);
+	xfce_usermon_tracker_set_rules(usermon_plugin->tracker,
+				       (const gchar * const *)
+				       usermon_plugin->rules);
+}
 
-		/* if utmp is broken for some reason, we may get 0 users */
-		if (users_count <= 1) {
-			the_usermon_plugin->label = gtk_label_new(_("1 User"));
-		} else {
-			gchar *label_text =
-			    g_strdup_printf(_("%d Users"), users_count);
-			the_usermon_plugin->label = gtk_label_new(label_text);
-			g_free(label_text);
-		}
-		gtk_widget_show(the_usermon_plugin->label);
-		gtk_box_pack_start(GTK_BOX(the_usermon_plugin->hvbox),
-				   the_usermon_plugin->label, FALSE, FALSE,
-				   DEFAULT_USERMON_PADDING);
-	}
-	g_debug("Found %d new users, %d users in total, max is %d",
-		g_hash_table_size(new_users_list),
-		users_count, the_usermon_plugin->max_users_count);
-
-	/* check for users who have logged out since the last check */
-	g_hash_table_foreach(the_usermon_plugin->all_users_list,
-			     xfce_usermon_notify_for_logout,
-			     the_usermon_plugin);
-
-	/* free the all users list */
-	g_hash_table_foreach(the_usermon_plugin->all_users_list,
-			     xfce_usermon_free_user, the_usermon_plugin);
-	g_hash_table_remove_all(the_usermon_plugin->all_users_list);
-
-	/* copy the current users list into the all users list */
-	g_hash_table_insert(the_usermon_plugin->all_users_list,
-			    the_usermon_plugin->user_name,
-			    the_usermon_plugin->user_name);
-	if (users_count > 0) {
-		g_hash_table_foreach(the_usermon_plugin->found_users_list,
-				     xfce_usermon_record_user,
-				     the_usermon_plugin);
+void xfce_usermon_set_group_limits(UserMonitorPlugin * usermon_plugin,
+				   const gchar * group_limits)
+{
+	g_strfreev(usermon_plugin->group_limits);
+	usermon_plugin->group_limits = g_strsplit(group_limits, ";", -1);
+	xfce_usermon_tracker_set_group_limits(usermon_plugin->tracker,
+					      (const gchar * const *)
+					      usermon_plugin->group_limits);
+}
+
+void xfce_usermon_set_metrics_file(UserMonitorPlugin * usermon_plugin,
+				   const gchar * metrics_file)
+{
+	/* empty for none */
+	if ((metrics_file != NULL) && (*metrics_file == '\0')) {
+		metrics_file = NULL;
 	}
-	the_usermon_plugin->users_count =
-	    g_hash_table_size(the_usermon_plugin->all_users_list);
-	g_debug("Reset users list to %d", the_usermon_plugin->users_count);
-
-	/* notify for each new user */
-	if (g_hash_table_size(new_users_list) > 0) {
-		g_hash_table_foreach(new_users_list,
-				     xfce_usermon_notify_for_login,
-				     the_usermon_plugin);
-
-		/* update the last alarm time */
-		the_usermon_plugin->last_alarm_time = time(NULL);
+
+	/* the file would be written again */
+	if (g_strcmp0(usermon_plugin->metrics_file, metrics_file) != 0) {
+		g_free(usermon_plugin->metrics_file);
+		usermon_plugin->metrics_file = g_strdup(metrics_file);
+		xfce_usermon_tracker_set_metrics_path(usermon_plugin->tracker,
+						      usermon_plugin->metrics_file);
 	}
+}
 
-	/* free the current users list */
-	g_hash_table_foreach(the_usermon_plugin->found_users_list,
-			     xfce_usermon_free_user, the_usermon_plugin);
-	g_hash_table_remove_all(the_usermon_plugin->found_users_list);
-	g_hash_table_destroy(new_users_list);
+void xfce_usermon_set_max_users_count(UserMonitorPlugin * usermon_plugin,
+				      guint max_users_count)
+{
+	usermon_plugin->max_users_count = max_users_count;
+	xfce_usermon_tracker_set_max_users_count(usermon_plugin->tracker,
+						 max_users_count);
 }
 
-static void xfce_usermon_timer_handler(int sig_num)
+void xfce_usermon_set_user_limits(UserMonitorPlugin * usermon_plugin,
+				  guint max_user_cpu, guint max_user_rss)
 {
-	struct itimerval new_timer;
-	g_debug("xfce_usermon_timer_handler");
-	if (sig_num == SIGALRM) {
-		xfce_usermon_update_users_list();
-
-		if (getitimer(ITIMER_REAL, &new_timer) == 0) {
-			/* rearm the timer? */
-			if (new_timer.it_value.tv_sec == 0
-			    && new_timer.it_value.tv_usec == 0) {
-				xfce_usermon_set_timer();
-			}
-		}
-	}
+	usermon_plugin->max_user_cpu = max_user_cpu;
+	usermon_plugin->max_user_rss = max_user_rss;
+	xfce_usermon_tracker_set_user_limits(usermon_plugin->tracker,
+					     max_user_cpu,
+					     (guint64) max_user_rss * 1024 *
+					     1024);
 }
 
-static void xfce_usermon_set_timer(void)
+void xfce_usermon_set_trend(UserMonitorPlugin * usermon_plugin, guint trend)
 {
-	struct itimerval new_timer;
-	struct sigaction new_action;
-
-	g_debug("xfce_usermon_set_timer");
-	memset(&new_action, 0, sizeof(new_action));
-	new_action.sa_handler = xfce_usermon_timer_handler;
-	sigemptyset(&new_action.sa_mask);
-	new_action.sa_flags = 0;
-
-	sigaction(SIGALRM, NULL, NULL);
-	if (sigaction(SIGALRM, &new_action, NULL) != 0) {
-		g_debug("Failed to set alarm");
+	GtkWidget *widget =
+	    xfce_usermon_sparkline_get_widget(usermon_plugin->sparkline);
+
+	usermon_plugin->trend = trend;
+	if (trend == 0) {
+		gtk_widget_hide(widget);
 		return;
 	}
 
-	new_timer.it_value.tv_sec = DEFAULT_ALARM_PERIOD;
-	new_timer.it_value.tv_usec = 0;
-	new_timer.it_interval.tv_sec = DEFAULT_ALARM_PERIOD;
-	new_timer.it_interval.tv_usec = 0;
+	xfce_usermon_sparkline_set_level(usermon_plugin->sparkline,
+					 (UserMonitorSeriesLevel) (trend - 1));
+	gtk_widget_show(widget);
+}
 
-	if (setitimer(ITIMER_REAL, &new_timer, NULL) != 0) {
-		g_debug("Failed to set timer");
-	}
+void xfce_usermon_set_idle_threshold(UserMonitorPlugin * usermon_plugin,
+				     guint idle_threshold)
+{
+	usermon_plugin->idle_threshold = idle_threshold;
+	xfce_usermon_tracker_set_idle_threshold(usermon_plugin->tracker,
+						idle_threshold * 60);
 }
 
 static void
@@ -511,19 +679,9 @@ xfce_usermon_log_handler(const gchar * domain,
 			 const gchar * message, gpointer data)
 {
 	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(data);
-	gchar *path;
 	const gchar *prefix;
 
-	if (usermon_plugin->log_file == NULL) {
-		g_mkdir_with_parents(g_get_user_cache_dir(), 0755);
-		path =
-		    g_build_filename(g_get_user_cache_dir(),
-				     "xfce4-usermon_plugin-plugin.log", NULL);
-		usermon_plugin->log_file = fopen(path, "w");
-		g_free(path);
-	}
-
-	if (usermon_plugin->log_file) {
+	if (usermon_plugin->log) {
 		switch (level & G_LOG_LEVEL_MASK) {
 		case G_LOG_LEVEL_ERROR:
 			prefix = "ERROR";
@@ -552,9 +710,9 @@ xfce_usermon_log_handler(const gchar * domain,
 			break;
 		}
 
-		fprintf(usermon_plugin->log_file, "%-10s %-25s %s\n", prefix,
-			domain, message);
-		fflush(usermon_plugin->log_file);
+		/* written out later by the logger's thread */
+		xfce_usermon_log_write(usermon_plugin->log, prefix, domain,
+				       message);
 	}
 
 	/* print log to stdout */
@@ -566,8 +724,11 @@ xfce_usermon_log_handler(const gchar * domain,
 static void xfce_usermon_construct(XfcePanelPlugin * plugin)
 {
 	UserMonitorPlugin *usermon_plugin = XFCE_USERMON_PLUGIN(plugin);
-
-	notify_init(GETTEXT_PACKAGE);
+	GtkWidget *history_item;
+	GtkWidget *stats_item;
+	gchar *log_path;
+	gchar *snapshot_path;
+	gchar *journal_path;
 
 	xfce_panel_plugin_menu_show_configure(plugin);
 	xfce_panel_plugin_menu_show_about(plugin);
@@ -576,6 +737,14 @@ static void xfce_usermon_construct(XfcePanelPlugin * plugin)
 	xfce_textdomain(GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR, "UTF-8");
 
 	/* log messages to a file */
+	g_mkdir_with_parents(g_get_user_cache_dir(), 0755);
+	log_path = g_build_filename(g_get_user_cache_dir(), DEFAULT_LOG_FILE,
+				    NULL);
+	usermon_plugin->log = xfce_usermon_log_new(log_path,
+						   DEFAULT_LOG_BUFFER_SIZE,
+						   DEFAULT_LOG_FILE_SIZE,
+						   DEFAULT_LOG_FILES);
+	g_free(log_path);
 	g_log_set_default_handler(xfce_usermon_log_handler, plugin);
 
 	/* init theme/icon stuff */
@@ -596,6 +765,64 @@ static void xfce_usermon_construct(XfcePanelPlugin * plugin)
 	g_signal_connect(G_OBJECT(plugin), "save",
 			 G_CALLBACK(xfce_usermon_save), usermon_plugin);
 
-	/* set the timer */
-	xfce_usermon_set_timer();
+	/* list the sessions when the label is clicked */
+	g_signal_connect(G_OBJECT(usermon_plugin->ebox), "button-press-event",
+			 G_CALLBACK(xfce_usermon_button_pressed),
+			 usermon_plugin);
+
+	/* browse the login history */
+	history_item = gtk_menu_item_new_with_label(_("History"));
+	g_signal_connect(G_OBJECT(history_item), "activate",
+			 G_CALLBACK(xfce_usermon_history_activated), plugin);
+	gtk_widget_show(history_item);
+	xfce_panel_plugin_menu_insert_item(plugin, GTK_MENU_ITEM(history_item));
+
+	/* see what the monitor is doing */
+	stats_item = gtk_menu_item_new_with_label(_("Statistics"));
+	g_signal_connect(G_OBJECT(stats_item), "activate",
+			 G_CALLBACK(xfce_usermon_stats_activated), plugin);
+	gtk_widget_show(stats_item);
+	xfce_panel_plugin_menu_insert_item(plugin, GTK_MENU_ITEM(stats_item));
+
+	/* start watching sessions */
+	xfce_usermon_tracker_set_user_name(usermon_plugin->tracker,
+					   usermon_plugin->user_name);
+	xfce_usermon_tracker_set_max_users_count(usermon_plugin->tracker,
+						 usermon_plugin->max_users_count);
+	xfce_usermon_tracker_set_rules(usermon_plugin->tracker,
+				       (const gchar * const *)
+				       usermon_plugin->rules);
+	xfce_usermon_tracker_set_group_limits(usermon_plugin->tracker,
+					      (const gchar * const *)
+					      usermon_plugin->group_limits);
+	xfce_usermon_set_user_limits(usermon_plugin,
+				     usermon_plugin->max_user_cpu,
+				     usermon_plugin->max_user_rss);
+	xfce_usermon_set_idle_threshold(usermon_plugin,
+					usermon_plugin->idle_threshold);
+	xfce_usermon_set_trend(usermon_plugin, usermon_plugin->trend);
+	xfce_usermon_tracker_set_backend(usermon_plugin->tracker,
+					 usermon_plugin->backend);
+	xfce_usermon_tracker_set_poll_period(usermon_plugin->tracker,
+					     usermon_plugin->alarm_period);
+	xfce_usermon_tracker_set_sources(usermon_plugin->tracker,
+					 (const gchar * const *)
+					 usermon_plugin->sources);
+	xfce_usermon_tracker_set_shared(usermon_plugin->tracker, TRUE);
+	snapshot_path = g_build_filename(g_get_user_cache_dir(),
+					 DEFAULT_SNAPSHOT, NULL);
+	xfce_usermon_tracker_set_snapshot_path(usermon_plugin->tracker,
+					       snapshot_path);
+	g_free(snapshot_path);
+	journal_path = g_build_filename(g_get_user_cache_dir(),
+					DEFAULT_JOURNAL, NULL);
+	xfce_usermon_tracker_set_journal_path(usermon_plugin->tracker,
+					      journal_path);
+	g_free(journal_path);
+	xfce_usermon_tracker_set_metrics_path(usermon_plugin->tracker,
+					      usermon_plugin->metrics_file);
+	xfce_usermon_tracker_start(usermon_plugin->tracker);
+
+	/* keep the wtmp index up to date */
+	xfce_usermon_update_history(usermon_plugin);
 }
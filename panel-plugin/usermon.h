@@ -19,9 +19,16 @@
 #ifndef __USER_MONITOR_H__
 #define __USER_MONITOR_H__
 
-#include <stdio.h>
 #include <time.h>
 
+#include "usermon-history.h"
+#include "usermon-log.h"
+#include "usermon-notify.h"
+#include "usermon-popup.h"
+#include "usermon-sparkline.h"
+#include "usermon-stats.h"
+#include "usermon-tracker.h"
+
 G_BEGIN_DECLS typedef struct {
 	XfcePanelPluginClass __parent__;
 } UserMonitorPluginClass;
@@ -29,24 +36,47 @@ G_BEGIN_DECLS typedef struct {
 typedef struct {
 	XfcePanelPlugin __parent__;
 
-	FILE *log_file;
+	UserMonitorLog *log;
 
 	/* panel widgets */
 	GtkWidget *ebox;
 	GtkWidget *hvbox;
 	GtkWidget *label;
+	UserMonitorSparkline *sparkline;
+
+	/* sessions table, kept up to date from the selected backend */
+	UserMonitorTracker *tracker;
+
+	/* sessions list shown when the label is clicked */
+	UserMonitorPopup *popup;
+
+	/* wtmp index, updated in the background */
+	UserMonitorHistory *history;
+	GThread *history_thread;
 
-	/* users lists */
-	GHashTable *all_users_list;
-	GHashTable *found_users_list;
+	/* notifications */
+	UserMonitorNotifier *notifier;
 
 	/* settings */
 	gchar *user_name;
+	UserMonitorBackend backend;
+	gchar **sources;
+	gchar **rules;
+	/* "GROUP:MAX" */
+	gchar **group_limits;
+	/* for node_exporter, NULL for none */
+	gchar *metrics_file;
 	guint max_users_count;
+	/* per user, 0 for none */
+	guint max_user_cpu;
+	guint max_user_rss;
+	/* in minutes, 0 for never */
+	guint idle_threshold;
+	/* 0 for none, else the series level plus one */
+	guint trend;
 	guint users_count;
 	guint alarm_period;
 	time_t start_time;
-	time_t last_alarm_time;
 } UserMonitorPlugin;
 
 #define XFCE_TYPE_USERMON_PLUGIN    (user_monitor_get_type ())
@@ -62,5 +92,39 @@ void user_monitor_register_type(XfcePanelTypeModule * type_module);
 
 void xfce_usermon_save(XfcePanelPlugin * plugin);
 
+void xfce_usermon_update_history(UserMonitorPlugin * usermon_plugin);
+
+void xfce_usermon_set_backend(UserMonitorPlugin * usermon_plugin,
+			      UserMonitorBackend backend);
+
+void xfce_usermon_set_alarm_period(UserMonitorPlugin * usermon_plugin,
+				   guint alarm_period);
+
+void xfce_usermon_set_sources(UserMonitorPlugin * usermon_plugin,
+			      const gchar * sources);
+
+void xfce_usermon_set_rules(UserMonitorPlugin * usermon_plugin,
+			    const gchar * rules);
+
+void xfce_usermon_set_group_limits(UserMonitorPlugin * usermon_plugin,
+				   const gchar * group_limits);
+
+void xfce_usermon_set_metrics_file(UserMonitorPlugin * usermon_plugin,
+				   const gchar * metrics_file);
+
+void xfce_usermon_set_max_users_count(UserMonitorPlugin * usermon_plugin,
+				      guint max_users_count);
+
+/* max_user_cpu in percent of a core, max_user_rss in MB */
+void xfce_usermon_set_user_limits(UserMonitorPlugin * usermon_plugin,
+				  guint max_user_cpu, guint max_user_rss);
+
+/* trend is 0 for none, else the series level plus one */
+void xfce_usermon_set_trend(UserMonitorPlugin * usermon_plugin, guint trend);
+
+/* idle_threshold in minutes */
+void xfce_usermon_set_idle_threshold(UserMonitorPlugin * usermon_plugin,
+				     guint idle_threshold);
+
 G_END_DECLS
 #endif				/* !__USER_MONITOR_H__ */
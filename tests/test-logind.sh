@@ -0,0 +1,35 @@
+#!/bin/sh
+#
+# Runs usermon-test-logind against usermon-stub-logind, on a private
+# dbus-daemon; skipped when dbus-daemon isn't installed.
+
+command -v dbus-daemon >/dev/null 2>&1 || exit 77
+
+dir=`mktemp -d` || exit 1
+dbus-daemon --session --fork --nopidfile --print-address=3 \
+	--print-pid=4 3>"$dir/address" 4>"$dir/pid" || exit 1
+address=`head -n 1 "$dir/address"`
+daemon_pid=`head -n 1 "$dir/pid"`
+
+DBUS_SESSION_BUS_ADDRESS="$address" ./usermon-stub-logind \
+	c1:alice::user g1:gdm::greeter &
+stub_pid=$!
+
+# wait for the stub to own its name
+i=0
+until dbus-send --bus="$address" --print-reply \
+	--dest=org.freedesktop.login1 /org/freedesktop/login1 \
+	org.freedesktop.login1.Manager.ListSessions >/dev/null 2>&1; do
+	i=`expr $i + 1`
+	if [ $i -gt 50 ]; then
+		break
+	fi
+	sleep 0.1
+done
+
+USERMON_LOGIND_ADDRESS="$address" ./usermon-test-logind
+status=$?
+
+kill $stub_pid $daemon_pid 2>/dev/null
+rm -rf "$dir"
+exit $status
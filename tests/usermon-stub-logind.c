@@ -0,0 +1,306 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+
+#include <gio/gio.h>
+
+/* a stand-in for systemd-logind on a private bus: the Manager lists
+ * its sessions and signals new and removed ones, and each session has
+ * the properties usermon reads; AddSession and RemoveSession, which
+ * logind doesn't have, let tests start and end sessions */
+#define STUB_NAME		"org.freedesktop.login1"
+#define STUB_PATH		"/org/freedesktop/login1"
+#define STUB_MANAGER		"org.freedesktop.login1.Manager"
+#define STUB_SESSION		"org.freedesktop.login1.Session"
+
+typedef struct {
+	gchar *id;
+	gchar *user_name;
+	gchar *host;
+	gchar *class;
+	guint64 timestamp;
+	gchar *object_path;
+	guint registration_id;
+} StubSession;
+
+static const gchar introspection_xml[] =
+    "<node>"
+    " <interface name='org.freedesktop.login1.Manager'>"
+    "  <method name='ListSessions'>"
+    "   <arg type='a(susso)' direction='out'/>"
+    "  </method>"
+    "  <method name='AddSession'>"
+    "   <arg type='s' name='id' direction='in'/>"
+    "   <arg type='s' name='user' direction='in'/>"
+    "   <arg type='s' name='host' direction='in'/>"
+    "   <arg type='s' name='class' direction='in'/>"
+    "  </method>"
+    "  <method name='RemoveSession'>"
+    "   <arg type='s' name='id' direction='in'/>"
+    "  </method>"
+    "  <signal name='SessionNew'>"
+    "   <arg type='s'/><arg type='o'/>"
+    "  </signal>"
+    "  <signal name='SessionRemoved'>"
+    "   <arg type='s'/><arg type='o'/>"
+    "  </signal>"
+    " </interface>"
+    " <interface name='org.freedesktop.login1.Session'>"
+    "  <property name='Name' type='s' access='read'/>"
+    "  <property name='RemoteHost' type='s' access='read'/>"
+    "  <property name='Class' type='s' access='read'/>"
+    "  <property name='Timestamp' type='t' access='read'/>"
+    " </interface>" "</node>";
+
+static GDBusNodeInfo *introspection = NULL;
+static GDBusConnection *bus = NULL;
+/* id to StubSession, in the order they were added */
+static GHashTable *sessions = NULL;
+static GPtrArray *order = NULL;
+
+static GVariant *stub_session_get_property(GDBusConnection * connection,
+					   const gchar * sender,
+					   const gchar * object_path,
+					   const gchar * interface_name,
+					   const gchar * property_name,
+					   GError ** error, gpointer user_data)
+{
+	StubSession *session = (StubSession *) user_data;
+
+	if (g_strcmp0(property_name, "Name") == 0) {
+		return g_variant_new_string(session->user_name);
+	} else if (g_strcmp0(property_name, "RemoteHost") == 0) {
+		return g_variant_new_string(session->host);
+	} else if (g_strcmp0(property_name, "Class") == 0) {
+		return g_variant_new_string(session->class);
+	} else if (g_strcmp0(property_name, "Timestamp") == 0) {
+		return g_variant_new_uint64(session->timestamp);
+	}
+
+	g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY,
+		    "No property %s", property_name);
+	return NULL;
+}
+
+static const GDBusInterfaceVTable session_vtable = {
+	NULL, stub_session_get_property, NULL
+};
+
+static void stub_session_free(gpointer data)
+{
+	StubSession *session = (StubSession *) data;
+
+	g_dbus_connection_unregister_object(bus, session->registration_id);
+	g_free(session->id);
+	g_free(session->user_name);
+	g_free(session->host);
+	g_free(session->class);
+	g_free(session->object_path);
+	g_slice_free(StubSession, session);
+}
+
+static gboolean stub_is_valid_id(const gchar * id)
+{
+	const gchar *p;
+
+	/* it goes in an object path */
+	if (*id == '\0') {
+		return FALSE;
+	}
+	for (p = id; *p != '\0'; ++p) {
+		if ((g_ascii_isalnum(*p) == FALSE) && (*p != '_')) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean stub_add_session(const gchar * id, const gchar * user_name,
+				 const gchar * host, const gchar * class)
+{
+	StubSession *session;
+
+	if ((stub_is_valid_id(id) == FALSE) ||
+	    (g_hash_table_contains(sessions, id) == TRUE)) {
+		return FALSE;
+	}
+
+	session = g_slice_new0(StubSession);
+	session->id = g_strdup(id);
+	session->user_name = g_strdup(user_name);
+	session->host = g_strdup(host);
+	session->class = g_strdup(class);
+	session->timestamp = g_get_real_time();
+	session->object_path = g_strdup_printf("%s/session/%s", STUB_PATH, id);
+	session->registration_id =
+	    g_dbus_connection_register_object(bus, session->object_path,
+					      g_dbus_node_info_lookup_interface
+					      (introspection, STUB_SESSION),
+					      &session_vtable, session, NULL,
+					      NULL);
+	g_hash_table_insert(sessions, session->id, session);
+	g_ptr_array_add(order, session);
+
+	g_dbus_connection_emit_signal(bus, NULL, STUB_PATH, STUB_MANAGER,
+				      "SessionNew",
+				      g_variant_new("(so)", session->id,
+						    session->object_path),
+				      NULL);
+
+	return TRUE;
+}
+
+static gboolean stub_remove_session(const gchar * id)
+{
+	StubSession *session = g_hash_table_lookup(sessions, id);
+
+	if (session == NULL) {
+		return FALSE;
+	}
+
+	g_dbus_connection_emit_signal(bus, NULL, STUB_PATH, STUB_MANAGER,
+				      "SessionRemoved",
+				      g_variant_new("(so)", session->id,
+						    session->object_path),
+				      NULL);
+	g_ptr_array_remove(order, session);
+	g_hash_table_remove(sessions, id);
+
+	return TRUE;
+}
+
+static void stub_manager_call(GDBusConnection * connection,
+			      const gchar * sender,
+			      const gchar * object_path,
+			      const gchar * interface_name,
+			      const gchar * method_name,
+			      GVariant * parameters,
+			      GDBusMethodInvocation * invocation,
+			      gpointer user_data)
+{
+	const gchar *id, *user_name, *host, *class;
+	GVariantBuilder builder;
+	gboolean done;
+	guint i;
+
+	if (g_strcmp0(method_name, "ListSessions") == 0) {
+		g_variant_builder_init(&builder, G_VARIANT_TYPE("a(susso)"));
+		for (i = 0; i < order->len; ++i) {
+			StubSession *session =
+			    (StubSession *) g_ptr_array_index(order, i);
+
+			g_variant_builder_add(&builder, "(susso)",
+					      session->id, 1000,
+					      session->user_name, "seat0",
+					      session->object_path);
+		}
+		g_dbus_method_invocation_return_value(invocation,
+						      g_variant_new
+						      ("(a(susso))",
+						       &builder));
+		return;
+	}
+
+	if (g_strcmp0(method_name, "AddSession") == 0) {
+		g_variant_get(parameters, "(&s&s&s&s)", &id, &user_name,
+			      &host, &class);
+		done = stub_add_session(id, user_name, host, class);
+	} else {
+		g_variant_get(parameters, "(&s)", &id);
+		done = stub_remove_session(id);
+	}
+
+	if (done == TRUE) {
+		g_dbus_method_invocation_return_value(invocation, NULL);
+	} else {
+		g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+						      G_DBUS_ERROR_INVALID_ARGS,
+						      "Can't %s %s",
+						      method_name, id);
+	}
+}
+
+static const GDBusInterfaceVTable manager_vtable = {
+	stub_manager_call, NULL, NULL
+};
+
+static void stub_name_lost(GDBusConnection * connection, const gchar * name,
+			   gpointer user_data)
+{
+	GMainLoop *loop = (GMainLoop *) user_data;
+
+	g_printerr("Lost or couldn't own %s\n", name);
+	g_main_loop_quit(loop);
+}
+
+/* usage: usermon-stub-logind [ID:USER:HOST:CLASS...], on the session
+ * bus, the sessions given being there from the start */
+int main(int argc, char **argv)
+{
+	GMainLoop *loop;
+	GError *error = NULL;
+	gint i;
+
+	introspection = g_dbus_node_info_new_for_xml(introspection_xml, NULL);
+	bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+	if (bus == NULL) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	sessions = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+					 stub_session_free);
+	order = g_ptr_array_new();
+	loop = g_main_loop_new(NULL, FALSE);
+
+	g_dbus_connection_register_object(bus, STUB_PATH,
+					  g_dbus_node_info_lookup_interface
+					  (introspection, STUB_MANAGER),
+					  &manager_vtable, NULL, NULL, NULL);
+	for (i = 1; i < argc; ++i) {
+		gchar **fields = g_strsplit(argv[i], ":", 4);
+
+		if ((g_strv_length(fields) != 4) ||
+		    (stub_add_session(fields[0], fields[1], fields[2],
+				      fields[3]) == FALSE)) {
+			g_printerr("Invalid session %s\n", argv[i]);
+			g_strfreev(fields);
+			return EXIT_FAILURE;
+		}
+		g_strfreev(fields);
+	}
+
+	/* owned once everything is in place */
+	g_bus_own_name_on_connection(bus, STUB_NAME,
+				     G_BUS_NAME_OWNER_FLAGS_NONE, NULL,
+				     stub_name_lost, loop, NULL);
+	g_main_loop_run(loop);
+
+	g_ptr_array_free(order, TRUE);
+	g_hash_table_destroy(sessions);
+	g_main_loop_unref(loop);
+	g_object_unref(bus);
+	g_dbus_node_info_unref(introspection);
+
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,287 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "usermon-groups.h"
+
+#define TEST_TIMEOUT		10
+/* how long the stub takes to resolve a user, like a slow LDAP server */
+#define TEST_RESOLVE_DELAY	(G_USEC_PER_SEC / 2)
+/* lookups are answered from the cache, far quicker than that */
+#define TEST_LOOKUP_MAX_TIME	(G_USEC_PER_SEC / 10)
+/* in seconds; short, so that alice is resolved again */
+#define TEST_TTL		1
+#define TEST_NEGATIVE_TTL	600
+/* in ms; a request queued by mistake has been resolved by then */
+#define TEST_SETTLE_DELAY	(2 * TEST_RESOLVE_DELAY / 1000)
+/* unknown has no account */
+#define TEST_UNKNOWN		"mallory"
+
+typedef enum {
+	TEST_STAGE_RESOLVING,
+	TEST_STAGE_EXPIRING,
+	TEST_STAGE_REFRESHING,
+	TEST_STAGE_SETTLING
+} TestStage;
+
+typedef struct {
+	GMainLoop *loop;
+	UserMonitorGroups *groups;
+	TestStage stage;
+	gboolean alice_resolved;
+	gboolean unknown_resolved;
+	gboolean passed;
+	gboolean failed;
+} TestState;
+
+/* how many times each user was resolved, by the worker threads */
+static gint test_alice_resolves = 0;
+static gint test_unknown_resolves = 0;
+
+static void test_fail(TestState * state, const gchar * message)
+{
+	g_printerr("FAIL: %s\n", message);
+	state->failed = TRUE;
+	g_main_loop_quit(state->loop);
+}
+
+/* runs in the worker thread */
+static gboolean test_resolve(const gchar * user_name, uid_t * uid,
+			     GPtrArray * group_names)
+{
+	g_usleep(TEST_RESOLVE_DELAY);
+	if (g_strcmp0(user_name, "alice") != 0) {
+		if (g_strcmp0(user_name, TEST_UNKNOWN) == 0) {
+			g_atomic_int_inc(&test_unknown_resolves);
+		}
+		return FALSE;
+	}
+	g_atomic_int_inc(&test_alice_resolves);
+
+	*uid = 1000;
+	g_ptr_array_add(group_names, g_strdup("alice"));
+	g_ptr_array_add(group_names, g_strdup("students"));
+
+	return TRUE;
+}
+
+static gboolean test_check_resolves(TestState * state, gint alice_resolves,
+				    gint unknown_resolves)
+{
+	gint alice = g_atomic_int_get(&test_alice_resolves);
+	gint unknown = g_atomic_int_get(&test_unknown_resolves);
+
+	g_print("alice resolved %d times, %s %d times\n", alice,
+		TEST_UNKNOWN, unknown);
+	if (alice != alice_resolves) {
+		test_fail(state, "alice resolved more or less than expected");
+		return FALSE;
+	}
+	if (unknown != unknown_resolves) {
+		test_fail(state, "unknown user not negatively cached");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean test_check_alice(TestState * state)
+{
+	uid_t uid = 0;
+
+	if ((xfce_usermon_groups_is_member(state->groups, "alice",
+					   "students") !=
+	     USERMON_MEMBERSHIP_MEMBER) ||
+	    (xfce_usermon_groups_is_member(state->groups, "alice",
+					   "contractors") !=
+	     USERMON_MEMBERSHIP_NONE) ||
+	    (xfce_usermon_groups_get_uid(state->groups, "alice", &uid) ==
+	     FALSE) || (uid != 1000)) {
+		test_fail(state, "resolved groups not answered");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean test_check_unknown(TestState * state)
+{
+	uid_t uid = 0;
+
+	if ((xfce_usermon_groups_is_member(state->groups, TEST_UNKNOWN,
+					   "students") !=
+	     USERMON_MEMBERSHIP_NONE) ||
+	    (xfce_usermon_groups_get_uid(state->groups, TEST_UNKNOWN, &uid)
+	     == TRUE)) {
+		test_fail(state, "unknown user not answered");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* nothing was resolved again since the last stage */
+static gboolean test_settled(gpointer user_data)
+{
+	TestState *state = (TestState *) user_data;
+
+	if (test_check_resolves(state, 2, 1) == TRUE) {
+		state->passed = TRUE;
+		g_main_loop_quit(state->loop);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/* alice's entry expired, unknown's didn't */
+static gboolean test_expired(gpointer user_data)
+{
+	TestState *state = (TestState *) user_data;
+
+	if ((test_check_resolves(state, 1, 1) == FALSE) ||
+	    (test_check_unknown(state) == FALSE)) {
+		return G_SOURCE_REMOVE;
+	}
+
+	/* the answer expired is given until the new one is in, and
+	 * asking twice refreshes it once */
+	state->stage = TEST_STAGE_REFRESHING;
+	if ((test_check_alice(state) == TRUE) &&
+	    (test_check_alice(state) == TRUE)) {
+		g_print("alice expired\n");
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void test_resolved(const gchar * user_name, gpointer user_data)
+{
+	TestState *state = (TestState *) user_data;
+
+	g_print("%s resolved\n", user_name);
+	if (g_strcmp0(user_name, "alice") == 0) {
+		if (test_check_alice(state) == FALSE) {
+			return;
+		}
+		if (state->stage == TEST_STAGE_REFRESHING) {
+			if (test_check_resolves(state, 2, 1) == TRUE) {
+				state->stage = TEST_STAGE_SETTLING;
+				g_timeout_add(TEST_SETTLE_DELAY,
+					      test_settled, state);
+			}
+			return;
+		}
+		state->alice_resolved = TRUE;
+	} else if (g_strcmp0(user_name, TEST_UNKNOWN) == 0) {
+		if (test_check_unknown(state) == FALSE) {
+			return;
+		}
+		state->unknown_resolved = TRUE;
+	} else {
+		test_fail(state, "unexpected user resolved");
+		return;
+	}
+
+	if (state->stage != TEST_STAGE_RESOLVING) {
+		test_fail(state, "resolved again too soon");
+		return;
+	}
+	if ((state->alice_resolved == TRUE) &&
+	    (state->unknown_resolved == TRUE) &&
+	    (test_check_resolves(state, 1, 1) == TRUE)) {
+		/* past alice's ttl, well within unknown's */
+		state->stage = TEST_STAGE_EXPIRING;
+		g_timeout_add(TEST_TTL * 1000 + TEST_SETTLE_DELAY,
+			      test_expired, state);
+	}
+}
+
+static gboolean test_timed_out(gpointer user_data)
+{
+	TestState *state = (TestState *) user_data;
+
+	test_fail(state, "timed out");
+
+	return G_SOURCE_REMOVE;
+}
+
+/* a resolve function that takes its time mustn't hold up lookups, each
+ * user is resolved once until its entry expires, whether it was found
+ * or not */
+int main(int argc, char **argv)
+{
+	TestState state;
+	UserMonitorMembership membership, unknown_membership;
+	gint64 start_time, elapsed;
+
+	state.loop = g_main_loop_new(NULL, FALSE);
+	state.stage = TEST_STAGE_RESOLVING;
+	state.alice_resolved = FALSE;
+	state.unknown_resolved = FALSE;
+	state.passed = FALSE;
+	state.failed = FALSE;
+	state.groups = xfce_usermon_groups_new(TEST_TTL, TEST_NEGATIVE_TTL,
+					       test_resolve, test_resolved,
+					       &state);
+
+	start_time = g_get_monotonic_time();
+	membership = xfce_usermon_groups_is_member(state.groups, "alice",
+						   "students");
+	unknown_membership =
+	    xfce_usermon_groups_is_member(state.groups, TEST_UNKNOWN,
+					  "students");
+	/* asking again doesn't queue another request */
+	if ((membership == USERMON_MEMBERSHIP_UNKNOWN) &&
+	    (unknown_membership == USERMON_MEMBERSHIP_UNKNOWN)) {
+		membership =
+		    xfce_usermon_groups_is_member(state.groups, "alice",
+						  "students");
+		unknown_membership =
+		    xfce_usermon_groups_is_member(state.groups, TEST_UNKNOWN,
+						  "students");
+	}
+	elapsed = g_get_monotonic_time() - start_time;
+	g_print("lookups took %" G_GINT64_FORMAT " us\n", elapsed);
+	if ((membership != USERMON_MEMBERSHIP_UNKNOWN) ||
+	    (unknown_membership != USERMON_MEMBERSHIP_UNKNOWN) ||
+	    (elapsed >= TEST_LOOKUP_MAX_TIME)) {
+		g_printerr("FAIL: lookup blocked on the resolver\n");
+		xfce_usermon_groups_free(state.groups);
+		g_main_loop_unref(state.loop);
+		return EXIT_FAILURE;
+	}
+
+	g_timeout_add_seconds(TEST_TIMEOUT, test_timed_out, &state);
+	g_main_loop_run(state.loop);
+
+	xfce_usermon_groups_free(state.groups);
+	g_main_loop_unref(state.loop);
+
+	if ((state.failed == TRUE) || (state.passed == FALSE)) {
+		return EXIT_FAILURE;
+	}
+	g_print("PASS\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,222 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+#include <stdlib.h>
+
+#include <gio/gio.h>
+
+#include "usermon-logind.h"
+
+/* exit status for automake's test driver */
+#define TEST_SKIPPED		77
+#define TEST_TIMEOUT		10
+
+/* the stub starts with alice's session c1 and a greeter's, g1 */
+typedef enum {
+	TEST_LISTED = 0,
+	TEST_ADDED,
+	TEST_REMOVED,
+	TEST_DONE
+} TestStep;
+
+typedef struct {
+	GMainLoop *loop;
+	GDBusConnection *control;
+	TestStep step;
+	guint logins_count;
+	gboolean failed;
+} TestState;
+
+static void test_fail(TestState * state, const gchar * message)
+{
+	g_printerr("FAIL: %s\n", message);
+	state->failed = TRUE;
+	g_main_loop_quit(state->loop);
+}
+
+static gboolean test_call(TestState * state, const gchar * method,
+			  GVariant * parameters)
+{
+	GError *error = NULL;
+	GVariant *reply;
+
+	reply = g_dbus_connection_call_sync(state->control,
+					    "org.freedesktop.login1",
+					    "/org/freedesktop/login1",
+					    "org.freedesktop.login1.Manager",
+					    method, parameters, NULL,
+					    G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+					    &error);
+	if (reply == NULL) {
+		g_printerr("%s failed: %s\n", method, error->message);
+		g_error_free(error);
+		return FALSE;
+	}
+	g_variant_unref(reply);
+
+	return TRUE;
+}
+
+static const UserMonitorScanEntry *test_find(const GArray * entries,
+					     const gchar * id)
+{
+	guint i;
+
+	for (i = 0; i < entries->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(entries, UserMonitorScanEntry, i);
+
+		if (strncmp(entry->key.line, id, sizeof(entry->key.line)) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void test_changed(const GArray * logins, const GArray * logouts,
+			 gpointer user_data)
+{
+	TestState *state = (TestState *) user_data;
+	const UserMonitorScanEntry *entry;
+
+	g_print("%u logins, %u logouts\n", logins->len, logouts->len);
+	switch (state->step) {
+	case TEST_LISTED:
+		/* the greeter isn't a user session */
+		entry = test_find(logins, "c1");
+		if ((logins->len != 1) || (logouts->len != 0) ||
+		    (entry == NULL) ||
+		    (g_strcmp0(entry->user_name, "alice") != 0) ||
+		    (entry->login_time == 0)) {
+			test_fail(state, "existing sessions not listed");
+			return;
+		}
+		state->step = TEST_ADDED;
+		if ((test_call(state, "AddSession",
+			       g_variant_new("(ssss)", "c2", "bob",
+					     "192.0.2.1", "user")) == FALSE) ||
+		    (test_call(state, "AddSession",
+			       g_variant_new("(ssss)", "c3", "carol", "",
+					     "user")) == FALSE)) {
+			test_fail(state, "couldn't add sessions");
+		}
+		break;
+	case TEST_ADDED:
+		/* one batch or two, depending on the replies */
+		entry = test_find(logins, "c2");
+		if ((logouts->len != 0) ||
+		    ((entry != NULL) &&
+		     (g_strcmp0(entry->host, "192.0.2.1") != 0))) {
+			test_fail(state, "new sessions not reported");
+			return;
+		}
+		state->logins_count += logins->len;
+		if (state->logins_count < 2) {
+			return;
+		}
+		state->step = TEST_REMOVED;
+		if (test_call(state, "RemoveSession",
+			      g_variant_new("(s)", "c2")) == FALSE) {
+			test_fail(state, "couldn't remove a session");
+		}
+		break;
+	case TEST_REMOVED:
+		entry = test_find(logouts, "c2");
+		if ((logins->len != 0) || (logouts->len != 1) ||
+		    (entry == NULL) ||
+		    (g_strcmp0(entry->user_name, "bob") != 0)) {
+			test_fail(state, "removed session not reported");
+			return;
+		}
+		state->step = TEST_DONE;
+		g_main_loop_quit(state->loop);
+		break;
+	default:
+		test_fail(state, "unexpected changes");
+		break;
+	}
+}
+
+static gboolean test_timed_out(gpointer user_data)
+{
+	TestState *state = (TestState *) user_data;
+
+	test_fail(state, "timed out");
+
+	return G_SOURCE_REMOVE;
+}
+
+/* runs against usermon-stub-logind, on the bus at
+ * USERMON_LOGIND_ADDRESS, see test-logind.sh */
+int main(int argc, char **argv)
+{
+	const gchar *address = g_getenv("USERMON_LOGIND_ADDRESS");
+	UserMonitorNames *names;
+	UserMonitorLogind *logind;
+	TestState state;
+	GError *error = NULL;
+
+	if (address == NULL) {
+		g_printerr("USERMON_LOGIND_ADDRESS isn't set\n");
+		return TEST_SKIPPED;
+	}
+
+	state.control =
+	    g_dbus_connection_new_for_address_sync(address,
+						   G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+						   |
+						   G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+						   NULL, NULL, &error);
+	if (state.control == NULL) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		return EXIT_FAILURE;
+	}
+	state.loop = g_main_loop_new(NULL, FALSE);
+	state.step = TEST_LISTED;
+	state.logins_count = 0;
+	state.failed = FALSE;
+
+	names = xfce_usermon_names_new();
+	logind = xfce_usermon_logind_new(address, names, test_changed, &state);
+	if (logind == NULL) {
+		g_printerr("FAIL: couldn't reach the bus\n");
+		return EXIT_FAILURE;
+	}
+	g_timeout_add_seconds(TEST_TIMEOUT, test_timed_out, &state);
+	g_main_loop_run(state.loop);
+
+	xfce_usermon_logind_free(logind);
+	xfce_usermon_names_free(names);
+	g_object_unref(state.control);
+	g_main_loop_unref(state.loop);
+
+	if ((state.failed == TRUE) || (state.step != TEST_DONE)) {
+		return EXIT_FAILURE;
+	}
+	g_print("PASS\n");
+
+	return EXIT_SUCCESS;
+}
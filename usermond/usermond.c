@@ -0,0 +1,282 @@
+/*
+ *  Copyright 2003-2021 Fabrice Colin
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <signal.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "usermon-stats.h"
+#include "usermon-tracker.h"
+
+/* command line options */
+static gchar *backend_name = NULL;
+static gchar *on_login = NULL;
+static gchar *on_logout = NULL;
+static gchar *stats_file = NULL;
+static gchar **source_patterns = NULL;
+static gchar **rules = NULL;
+static gchar **group_limits = NULL;
+static gchar *journal_path = NULL;
+static gchar *replay_path = NULL;
+static gdouble replay_speed = 1;
+static gchar *metrics_file = NULL;
+static gint poll_period = 0;
+static gint max_user_cpu = 0;
+static gint max_user_rss = 0;
+static gint idle_threshold = 0;
+
+static GOptionEntry option_entries[] = {
+	{"backend", 'b', 0, G_OPTION_ARG_STRING, &backend_name,
+	 "Where sessions are found, utmp or logind", "NAME"},
+	{"on-login", 0, 0, G_OPTION_ARG_STRING, &on_login,
+	 "Command to run for each new session", "COMMAND"},
+	{"on-logout", 0, 0, G_OPTION_ARG_STRING, &on_logout,
+	 "Command to run for each session that ended", "COMMAND"},
+	{"stats", 0, 0, G_OPTION_ARG_FILENAME, &stats_file,
+	 "File statistics are written to on SIGUSR1", "FILE"},
+	{"period", 'p', 0, G_OPTION_ARG_INT, &poll_period,
+	 "How often utmp is polled when it can't be watched", "SECONDS"},
+	{"max-cpu", 0, 0, G_OPTION_ARG_INT, &max_user_cpu,
+	 "Warn about users using more CPU, in percent of a core", "PERCENT"},
+	{"max-rss", 0, 0, G_OPTION_ARG_INT, &max_user_rss,
+	 "Warn about users using more memory, in MB", "MB"},
+	{"idle", 0, 0, G_OPTION_ARG_INT, &idle_threshold,
+	 "Don't count users idle for that long", "MINUTES"},
+	{"source", 's', 0, G_OPTION_ARG_FILENAME_ARRAY, &source_patterns,
+	 "Another utmp file to scan, or a pattern matching several",
+	 "PATTERN"},
+	{"rule", 'r', 0, G_OPTION_ARG_STRING_ARRAY, &rules,
+	 "A rule, eg \"ignore user svc-*\" or \"watch remote\"", "RULE"},
+	{"group-limit", 'g', 0, G_OPTION_ARG_STRING_ARRAY, &group_limits,
+	 "Warn about logins beyond that many users of a group",
+	 "GROUP:MAX"},
+	{"journal", 0, 0, G_OPTION_ARG_FILENAME, &journal_path,
+	 "File the logins and logouts seen are recorded to", "FILE"},
+	{"replay", 0, 0, G_OPTION_ARG_FILENAME, &replay_path,
+	 "Play a journal back instead of watching sessions, then exit",
+	 "FILE"},
+	{"speed", 0, 0, G_OPTION_ARG_DOUBLE, &replay_speed,
+	 "How many times faster the journal is played back, 0 for at once",
+	 "FACTOR"},
+	{"metrics", 0, 0, G_OPTION_ARG_FILENAME, &metrics_file,
+	 "File sessions and statistics are exported to for Prometheus",
+	 "FILE"},
+	{NULL}
+};
+
+static void usermond_run_hook(const gchar * command, const gchar * event,
+			      const UserMonitorScanEntry * entry)
+{
+	gchar **argv = NULL;
+	gchar **envp = NULL;
+	gchar *line = NULL;
+	GError *error = NULL;
+
+	if (command == NULL) {
+		return;
+	}
+
+	if (g_shell_parse_argv(command, NULL, &argv, &error) == FALSE) {
+		g_warning("Failed to parse %s: %s", command, error->message);
+		g_error_free(error);
+		return;
+	}
+
+	/* the line isn't necessarily terminated */
+	line = g_strndup(entry->key.line, sizeof(entry->key.line));
+
+	/* describe the session in the environment */
+	envp = g_get_environ();
+	envp = g_environ_setenv(envp, "USERMON_EVENT", event, TRUE);
+	envp = g_environ_setenv(envp, "USERMON_USER", entry->user_name, TRUE);
+	envp = g_environ_setenv(envp, "USERMON_LINE", line, TRUE);
+	envp = g_environ_setenv(envp, "USERMON_HOST",
+				entry->host, TRUE);
+
+	/* the child is reaped by GLib */
+	if (g_spawn_async(NULL, argv, envp, G_SPAWN_SEARCH_PATH,
+			  NULL, NULL, NULL, &error) == FALSE) {
+		g_warning("Failed to run %s: %s", command, error->message);
+		g_error_free(error);
+	}
+
+	g_free(line);
+	g_strfreev(envp);
+	g_strfreev(argv);
+}
+
+static void usermond_log_entries(const GArray * entries, const gchar * event,
+				 const gchar * command)
+{
+	guint i;
+
+	for (i = 0; i < entries->len; ++i) {
+		const UserMonitorScanEntry *entry =
+		    &g_array_index(entries, UserMonitorScanEntry, i);
+
+		g_message("%s %s %.*s %s", event, entry->user_name,
+			  (int)sizeof(entry->key.line), entry->key.line,
+			  entry->host);
+		usermond_run_hook(command, event, entry);
+	}
+}
+
+static void usermond_sessions_changed(UserMonitorTracker * tracker,
+				      const GArray * logins,
+				      const GArray * logouts,
+				      gpointer user_data)
+{
+	usermond_log_entries(logouts, "logout", on_logout);
+	usermond_log_entries(logins, "login", on_login);
+}
+
+static void usermond_deliver(UserMonitorUrgency urgency, const gchar * body,
+			     gpointer user_data)
+{
+	/* what the plugin would have shown in a popup */
+	if (urgency == USERMON_URGENCY_CRITICAL) {
+		g_warning("%s", body);
+	} else {
+		g_message("%s", body);
+	}
+}
+
+static gboolean usermond_dump_stats(gpointer user_data)
+{
+	gchar *report = xfce_usermon_stats_dump();
+
+	g_message("Statistics:\n%s", report);
+	g_free(report);
+
+	if (stats_file != NULL) {
+		xfce_usermon_stats_save(stats_file);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean usermond_quit(gpointer user_data)
+{
+	GMainLoop *loop = (GMainLoop *) user_data;
+
+	g_debug("usermond_quit");
+	g_main_loop_quit(loop);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void usermond_replay_done(gpointer user_data)
+{
+	GMainLoop *loop = (GMainLoop *) user_data;
+
+	g_debug("usermond_replay_done");
+	g_main_loop_quit(loop);
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GMainLoop *loop;
+	UserMonitorTracker *tracker;
+	GError *error = NULL;
+	int status = EXIT_SUCCESS;
+
+	context = g_option_context_new("- monitor user sessions");
+	g_option_context_add_main_entries(context, option_entries, NULL);
+	if (g_option_context_parse(context, &argc, &argv, &error) == FALSE) {
+		g_printerr("%s\n", error->message);
+		g_error_free(error);
+		g_option_context_free(context);
+		return EXIT_FAILURE;
+	}
+	g_option_context_free(context);
+
+	loop = g_main_loop_new(NULL, FALSE);
+	tracker = xfce_usermon_tracker_new(usermond_sessions_changed,
+					   usermond_deliver, NULL);
+
+	if (g_strcmp0(backend_name, "logind") == 0) {
+		xfce_usermon_tracker_set_backend(tracker,
+						 USERMON_BACKEND_LOGIND);
+	} else if ((backend_name != NULL) &&
+		   (g_strcmp0(backend_name, "utmp") != 0)) {
+		g_printerr("Unknown backend %s\n", backend_name);
+		xfce_usermon_tracker_free(tracker);
+		g_main_loop_unref(loop);
+		return EXIT_FAILURE;
+	}
+
+	/* scan utmp on behalf of the panels, unless playing a journal */
+	xfce_usermon_tracker_set_shared(tracker, replay_path == NULL);
+	if (poll_period > 0) {
+		xfce_usermon_tracker_set_poll_period(tracker,
+						     (guint) poll_period);
+	}
+	xfce_usermon_tracker_set_user_limits(tracker,
+					     (guint) MAX(max_user_cpu, 0),
+					     (guint64) MAX(max_user_rss,
+							   0) * 1024 * 1024);
+	xfce_usermon_tracker_set_idle_threshold(tracker,
+						(guint) MAX(idle_threshold,
+							    0) * 60);
+	xfce_usermon_tracker_set_sources(tracker,
+					 (const gchar * const *)source_patterns);
+	xfce_usermon_tracker_set_rules(tracker, (const gchar * const *)rules);
+	xfce_usermon_tracker_set_group_limits(tracker,
+					      (const gchar * const *)
+					      group_limits);
+	xfce_usermon_tracker_set_journal_path(tracker, journal_path);
+	xfce_usermon_tracker_set_metrics_path(tracker, metrics_file);
+
+	g_unix_signal_add(SIGINT, usermond_quit, loop);
+	g_unix_signal_add(SIGTERM, usermond_quit, loop);
+	g_unix_signal_add(SIGUSR1, usermond_dump_stats, NULL);
+
+	if (replay_path == NULL) {
+		xfce_usermon_tracker_start(tracker);
+		g_main_loop_run(loop);
+	} else if (xfce_usermon_tracker_start_replay(tracker, replay_path,
+						     MAX(replay_speed, 0),
+						     usermond_replay_done,
+						     loop) == TRUE) {
+		g_main_loop_run(loop);
+	} else {
+		g_printerr("No journal at %s\n", replay_path);
+		status = EXIT_FAILURE;
+	}
+
+	xfce_usermon_tracker_free(tracker);
+	g_main_loop_unref(loop);
+	g_free(backend_name);
+	g_free(on_login);
+	g_free(on_logout);
+	g_free(stats_file);
+	g_strfreev(source_patterns);
+	g_strfreev(rules);
+	g_strfreev(group_limits);
+	g_free(journal_path);
+	g_free(replay_path);
+	g_free(metrics_file);
+
+	return status;
+}